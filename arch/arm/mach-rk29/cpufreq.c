@@ -15,6 +15,7 @@
 
 #include <linux/clk.h>
 #include <linux/cpufreq.h>
+#include <linux/cpufreq_powercap.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/reboot.h>
@@ -58,17 +59,25 @@ static int vcore_uV;
 static struct workqueue_struct *wq;
 
 #ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
-static bool limit = true;
-module_param(limit, bool, 0644);
-
-static int limit_secs = 30;
-module_param(limit_secs, int, 0644);
-
-static int limit_secs_1200 = 6;
-module_param(limit_secs_1200, int, 0644);
-
-static int limit_temp;
-module_param(limit_temp, int, 0444);
+/*
+ * Thermal capping is left to the generic powercap engine.  Busy power is
+ * estimated at 0.5 mW per MHz per V^2 at each operating point's voltage,
+ * idle power from the voltage alone; both can be refined through
+ * /sys/devices/system/cpu/cpufreq/powercap/opp_power.  The default model
+ * allows 600 mW sustained and never caps below 816 MHz.
+ */
+static struct cpufreq_powercap_opp rk29_powercap_opps[16];
+static struct cpufreq_powercap rk29_powercap = {
+	.cpu		= 0,
+	.opps		= rk29_powercap_opps,
+	.resistance	= 20,		/* 20 C/W */
+	.tau_ms		= 20000,
+	.limit		= 12000,
+	.gain		= 100,
+	.period_ms	= 250,
+	.enabled	= true,
+	.lock		= __MUTEX_INITIALIZER(rk29_powercap.lock),
+};
 
 #define LIMIT_AVG_VOLTAGE	1200000 /* vU */
 #else /* !CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP */
@@ -129,6 +138,39 @@ static bool rk29_cpufreq_is_ondemand_policy(struct cpufreq_policy *policy)
 	return (c == 'o' || c == 'i' || c == 'c');
 }
 
+#ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
+static void rk29_cpufreq_update_powercap(struct cpufreq_frequency_table *table)
+{
+	unsigned int i, j, n = 0;
+
+	/* the engine and its sysfs files read the OPPs under the lock */
+	mutex_lock(&rk29_powercap.lock);
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		struct cpufreq_powercap_opp opp;
+		unsigned int mv = table[i].index / 1000;
+
+		if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (n == ARRAY_SIZE(rk29_powercap_opps))
+			break;
+
+		opp.frequency = table[i].frequency;
+		opp.busy_mw = div_u64((u64)opp.frequency * mv * mv, 2000000000);
+		opp.idle_mw = mv * mv / 25000;
+
+		/* the engine wants them in ascending order */
+		for (j = n; j > 0 && rk29_powercap_opps[j - 1].frequency > opp.frequency; j--)
+			rk29_powercap_opps[j] = rk29_powercap_opps[j - 1];
+		rk29_powercap_opps[j] = opp;
+		n++;
+	}
+
+	rk29_powercap.nr_opps = n;
+	rk29_powercap.min_freq = limit_index_816 >= 0 ? table[limit_index_816].frequency : 0;
+	mutex_unlock(&rk29_powercap.lock);
+}
+#endif
+
 static void board_do_update_cpufreq_table(struct cpufreq_frequency_table *table)
 {
 	unsigned int i;
@@ -167,6 +209,9 @@ static void board_do_update_cpufreq_table(struct cpufreq_frequency_table *table)
 
 	if (!limit_avg_freq)
 		limit_avg_freq = LIMIT_AVG_FREQ;
+#ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
+	rk29_cpufreq_update_powercap(table);
+#endif
 }
 
 int board_update_cpufreq_table(struct cpufreq_frequency_table *table)
@@ -198,93 +243,16 @@ static struct clk* clk_gpu;
 static unsigned long limit_gpu_low_rate = GPU_LOW_RATE;
 module_param(limit_gpu_low_rate, ulong, 0644);
 
-#define TEMP_COEFF_IDLE -1000
-#define TEMP_COEFF_408  -325
-#define TEMP_COEFF_624  -202
-#define TEMP_COEFF_816  -78
-#define TEMP_COEFF_1008 325
-#define TEMP_COEFF_1200 1300
-#define WORK_DELAY      HZ
-static void rk29_cpufreq_limit_by_temp(struct cpufreq_policy *policy, unsigned int relation, int *index)
+static void rk29_cpufreq_limit_by_clk(int *index)
 {
-	int c, ms;
-	ktime_t now;
-	static ktime_t last = { .tv64 = 0 };
-	cputime64_t wall;
-	u64 idle_time_us;
-	static u64 last_idle_time_us;
-	int idle;
-	unsigned int cur = policy->cur;
-	int overheat_temp_1200, overheat_temp;
-	int temp;
-	int target_index;
-	unsigned int target_freq;
-	bool overheat;
-
-	if (!limit || !rk29_cpufreq_is_ondemand_policy(policy) ||
-	    (limit_index_816 < 0) || (relation & MASK_FURTHER_CPUFREQ)) {
-		limit_temp = 0;
-		last.tv64 = 0;
-		return;
-	}
-
-	idle_time_us = get_cpu_idle_time_us(0, &wall);
-	now = ktime_get();
-	if (!last.tv64) {
-		last = now;
-		last_idle_time_us = idle_time_us;
-		return;
-	}
-
-	temp = limit_temp;
-	idle = idle_time_us - last_idle_time_us;
-	if (idle) {
-		temp -= idle; // -1000
-		last_idle_time_us = idle_time_us;
-	}
-
-	ms = div_u64(ktime_us_delta(now, last), 1000);
-	dprintk(DEBUG_TEMP, "%d kHz (%d uV) elapsed %d ms idle %d us\n", cur, vcore_uV, ms, idle);
-	last = now;
-
-	if (cur <= 408 * 1000)
-		c = TEMP_COEFF_408;
-	else if (cur <= 624 * 1000)
-		c = TEMP_COEFF_624;
-	else if (cur <= 816 * 1000)
-		c = TEMP_COEFF_816;
-	else if (cur <= 1008 * 1000)
-		c = TEMP_COEFF_1008;
-	else
-		c = TEMP_COEFF_1200;
-	temp += c * ms;
-
-	if (temp < 0)
-		temp = 0;
-
-	target_index = *index;
-	target_freq = freq_table[target_index].frequency;
-	overheat_temp = TEMP_COEFF_1008 * limit_secs * MSEC_PER_SEC;
-	overheat_temp_1200 = TEMP_COEFF_1200 * limit_secs_1200 * MSEC_PER_SEC;
-	overheat = false;
-
-	if (temp >= overheat_temp && target_freq > limit_freq_816) {
-		target_index = limit_index_816;
-		overheat = true;
-	} else if (target_freq > limit_freq_1008 && limit_freq_1008 > limit_freq_816 &&
-		 temp >= overheat_temp_1200 && temp < overheat_temp) {
-		target_index = limit_index_1008;
-		overheat = true;
-	} else if (target_freq > 1008000 && (limit_vpu_enabled || (limit_gpu_enabled && limit_gpu_high))) {
-		target_index = limit_index_1008;
+	if (freq_table[*index].frequency > 1008000 && limit_index_1008 >= 0 &&
+	    (limit_vpu_enabled || (limit_gpu_enabled && limit_gpu_high))) {
+		dprintk(DEBUG_TEMP, "vpu/gpu limit %d kHz\n", freq_table[limit_index_1008].frequency);
+		*index = limit_index_1008;
 	}
-
-	dprintk(DEBUG_TEMP, "%d kHz c %d temp %d (%s) selected %d kHz\n", target_freq, c, temp, overheat ? "overheat" : "normal", freq_table[target_index].frequency);
-	limit_temp = temp;
-	*index = target_index;
 }
 #else
-#define rk29_cpufreq_limit_by_temp(...) do {} while (0)
+#define rk29_cpufreq_limit_by_clk(...) do {} while (0)
 #endif
 
 #ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_DISP
@@ -348,7 +316,7 @@ static int rk29_cpufreq_do_target(struct cpufreq_policy *policy, unsigned int ta
 		return -EINVAL;
 	}
 	rk29_cpufreq_limit_by_disp(&index);
-	rk29_cpufreq_limit_by_temp(policy, relation, &index);
+	rk29_cpufreq_limit_by_clk(&index);
 	freq = &freq_table[index];
 
 	if (policy->cur == freq->frequency && !force)
@@ -414,44 +382,6 @@ static int rk29_cpufreq_target(struct cpufreq_policy *policy, unsigned int targe
 }
 
 #ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
-static void rk29_cpufreq_limit_by_temp_work_func(struct work_struct *work);
-static DECLARE_DELAYED_WORK(rk29_cpufreq_limit_by_temp_work, rk29_cpufreq_limit_by_temp_work_func);
-
-static int rk29_cpufreq_notifier_policy(struct notifier_block *nb,
-		unsigned long val, void *data)
-{
-	struct cpufreq_policy *policy = data;
-
-	if (val != CPUFREQ_NOTIFY)
-		return 0;
-
-	if (rk29_cpufreq_is_ondemand_policy(policy)) {
-		dprintk(DEBUG_TEMP, "queue work\n");
-		queue_delayed_work(wq, &rk29_cpufreq_limit_by_temp_work, WORK_DELAY);
-	} else {
-		dprintk(DEBUG_TEMP, "cancel work\n");
-		cancel_delayed_work(&rk29_cpufreq_limit_by_temp_work);
-	}
-
-	return 0;
-}
-
-static struct notifier_block notifier_policy_block = {
-	.notifier_call = rk29_cpufreq_notifier_policy
-};
-
-static void rk29_cpufreq_limit_by_temp_work_func(struct work_struct *work)
-{
-	struct cpufreq_policy *policy = cpufreq_cpu_get(0);
-
-	if (policy) {
-		dprintk(DEBUG_TEMP, "check %d kHz\n", policy->cur);
-		cpufreq_driver_target(policy, policy->cur, CPUFREQ_RELATION_L);
-		cpufreq_cpu_put(policy);
-	}
-	queue_delayed_work(wq, &rk29_cpufreq_limit_by_temp_work, WORK_DELAY);
-}
-
 static int rk29_cpufreq_vpu_notifier_event(struct notifier_block *this,
 		unsigned long event, void *ptr)
 {
@@ -620,11 +550,6 @@ static int rk29_cpufreq_init(struct cpufreq_policy *policy)
 	}
 
 #ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
-	if (rk29_cpufreq_is_ondemand_policy(policy)) {
-		dprintk(DEBUG_TEMP, "queue work\n");
-		queue_delayed_work(wq, &rk29_cpufreq_limit_by_temp_work, WORK_DELAY);
-	}
-	cpufreq_register_notifier(&notifier_policy_block, CPUFREQ_POLICY_NOTIFIER);
 	if (limit_max_freq > 1008000) {
 		clk_gpu = clk_get(NULL, "gpu");
 		clk_vpu = clk_get(NULL, "vpu");
@@ -650,9 +575,6 @@ static int rk29_cpufreq_exit(struct cpufreq_policy *policy)
 		clk_put(clk_gpu);
 		clk_put(clk_vpu);
 	}
-	cpufreq_unregister_notifier(&notifier_policy_block, CPUFREQ_POLICY_NOTIFIER);
-	if (wq)
-		cancel_delayed_work(&rk29_cpufreq_limit_by_temp_work);
 #endif
 	if (wq) {
 		flush_workqueue(wq);
@@ -738,10 +660,22 @@ static struct notifier_block rk29_cpufreq_reboot_notifier = {
 
 static int __init rk29_cpufreq_register(void)
 {
+	int ret;
+
 	register_pm_notifier(&rk29_cpufreq_pm_notifier);
 	register_reboot_notifier(&rk29_cpufreq_reboot_notifier);
 
-	return cpufreq_register_driver(&rk29_cpufreq_driver);
+	ret = cpufreq_register_driver(&rk29_cpufreq_driver);
+#ifdef CONFIG_RK29_CPU_FREQ_LIMIT_BY_TEMP
+	/*
+	 * Not from ->init: the powercap must be unregistered where the
+	 * policy rwsem is not held, which ->exit is not.  The policy and
+	 * the operating points exist once the driver is registered.
+	 */
+	if (!ret && cpufreq_powercap_register(&rk29_powercap))
+		pr_err("fail to register powercap\n");
+#endif
+	return ret;
 }
 
 device_initcall(rk29_cpufreq_register);
@@ -1,6 +1,7 @@
 #define DEBUG
 
 #include <linux/clk.h>
+#include <linux/cpuidle.h>
 #include <linux/delay.h>
 #include <linux/err.h>
 #include <linux/kernel.h>
@@ -9,6 +10,7 @@
 #include <linux/suspend.h>
 #include <linux/random.h> 
 #include <linux/crc32.h>
+#include <linux/device.h>
 #include <linux/io.h>
 #include <linux/wakelock.h>
 #include <asm/tlbflush.h>
@@ -28,6 +30,8 @@
 
 #include <asm/vfp.h>
 
+#include "devices.h"
+
 #define grf_readl(offset) readl(RK29_GRF_BASE + offset)
 #define grf_writel(v, offset) do { writel(v, RK29_GRF_BASE + offset); readl(RK29_GRF_BASE + offset); } while (0)
 
@@ -582,12 +586,115 @@ static void rk29_idle(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_CPU_IDLE
+/*
+ * Two idle states: plain WFI, and WFI with the ARM PLL bypassed (CPU in
+ * slow mode).  Leaving slow mode means waiting for the PLL to be selected
+ * again, so the governor only picks it when the next timer is far enough
+ * away.  The idle wake lock still forces plain WFI, as it did for
+ * rk29_idle().
+ */
+static int rk29_enter_idle(struct cpuidle_device *dev,
+			   struct cpuidle_state *state)
+{
+	ktime_t start = ktime_get();
+
+	arch_idle();
+	local_irq_enable();
+
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static int rk29_enter_slow(struct cpuidle_device *dev,
+			   struct cpuidle_state *state)
+{
+	ktime_t start = ktime_get();
+	u32 mode_con;
+
+#ifdef CONFIG_HAS_WAKELOCK
+	if (has_wake_lock(WAKE_LOCK_IDLE)) {
+		dev->last_state = &dev->states[0];
+		return rk29_enter_idle(dev, &dev->states[0]);
+	}
+#endif
+
+	mode_con = cru_readl(CRU_MODE_CON);
+	cru_writel((mode_con & ~CRU_CPU_MODE_MASK) | CRU_CPU_MODE_SLOW, CRU_MODE_CON);
+	arch_idle();
+	cru_writel(mode_con, CRU_MODE_CON);
+	local_irq_enable();
+
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static struct cpuidle_driver rk29_idle_driver = {
+	.name	= "rk29_idle",
+	.owner	= THIS_MODULE,
+};
+
+static DEFINE_PER_CPU(struct cpuidle_device, rk29_idle_device);
+
+static int __init rk29_idle_init(void)
+{
+	struct cpuidle_device *dev = &per_cpu(rk29_idle_device, 0);
+	struct cpuidle_state *state;
+	int ret;
+
+	ret = cpuidle_register_driver(&rk29_idle_driver);
+	if (ret)
+		return ret;
+
+	state = &dev->states[0];
+	strcpy(state->name, "WFI");
+	strcpy(state->desc, "ARM WFI");
+	state->exit_latency = 1;
+	state->target_residency = 1;
+	state->flags = CPUIDLE_FLAG_TIME_VALID;
+	state->enter = rk29_enter_idle;
+
+	state = &dev->states[1];
+	strcpy(state->name, "SLOW");
+	strcpy(state->desc, "ARM WFI, CPU clock from 24MHz");
+	state->exit_latency = 10;
+	state->target_residency = 100;
+	state->flags = CPUIDLE_FLAG_TIME_VALID;
+	state->enter = rk29_enter_slow;
+
+	dev->state_count = 2;
+	dev->cpu = 0;
+
+	ret = cpuidle_register_device(dev);
+	if (ret)
+		cpuidle_unregister_driver(&rk29_idle_driver);
+	return ret;
+}
+#else
+static inline int rk29_idle_init(void) { return -ENODEV; }
+#endif
+
+/*
+ * The SD/MMC controllers power up and re-initialise their cards on resume,
+ * which takes tens of milliseconds and needs nothing but the controller, so
+ * let them resume alongside everything else.
+ */
+static void __init rk29_pm_async_init(void)
+{
+#ifdef CONFIG_SDMMC0_RK29
+	device_enable_async_suspend(&rk29_device_sdmmc0.dev);
+#endif
+#ifdef CONFIG_SDMMC1_RK29
+	device_enable_async_suspend(&rk29_device_sdmmc1.dev);
+#endif
+}
+
 static int __init rk29_pm_init(void)
 {
 	suspend_set_ops(&rk29_pm_ops);
+	rk29_pm_async_init();
 
-	/* set idle function */
-	pm_idle = rk29_idle;
+	/* set idle function, unless cpuidle has taken over */
+	if (rk29_idle_init())
+		pm_idle = rk29_idle;
 	ddr_debug = 0;
 
 #ifdef CONFIG_EARLYSUSPEND
@@ -105,6 +105,9 @@ void device_pm_add(struct device *dev)
 	if (dev->parent && dev->parent->power.is_prepared)
 		dev_warn(dev, "parent %s should not be sleeping\n",
 			dev_name(dev->parent));
+	if ((dev->bus && dev->bus->async_suspend) ||
+	    (dev->class && dev->class->async_suspend))
+		dev->power.async_suspend = true;
 	list_add_tail(&dev->power.entry, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
 }
@@ -215,6 +218,12 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
 /**
  * pm_op - Execute the PM operation appropriate for given PM event.
  * @dev: Device to handle.
@@ -424,17 +433,24 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
  * device_resume_noirq - Execute an "early resume" callback for given device.
  * @dev: Device to handle.
  * @state: PM transition of the system being carried out.
+ * @async: If true, the device is being resumed asynchronously.
  *
  * The driver of @dev will not receive interrupts while this function is being
  * executed.
  */
-static int device_resume_noirq(struct device *dev, pm_message_t state)
+static int device_resume_noirq(struct device *dev, pm_message_t state,
+			       bool async)
 {
+	struct dpm_resume_timing t;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
+	dpm_resume_timing_begin(&t, DPM_RESUME_EARLY, async);
+	dpm_wait(dev->parent, async);
+	dpm_resume_timing_run(&t, dev);
+
 	if (dev->pwr_domain) {
 		pm_dev_dbg(dev, state, "EARLY power domain ");
 		error = pm_noirq_op(dev, &dev->pwr_domain->ops, state);
@@ -449,38 +465,70 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 		error = pm_noirq_op(dev, dev->bus->pm, state);
 	}
 
+	dpm_resume_timing_end(&t, dev, error);
+	complete_all(&dev->power.completion);
+
 	TRACE_RESUME(error);
 	return error;
 }
 
+static void async_resume_noirq(void *data, async_cookie_t cookie)
+{
+	struct device *dev = (struct device *)data;
+	int error;
+
+	error = device_resume_noirq(dev, pm_transition, true);
+	if (error)
+		pm_dev_err(dev, pm_transition, " async early", error);
+	put_device(dev);
+}
+
 /**
  * dpm_resume_noirq - Execute "early resume" callbacks for non-sysdev devices.
  * @state: PM transition of the system being carried out.
  *
  * Call the "noirq" resume handlers for all devices marked as DPM_OFF_IRQ and
- * enable device drivers to receive interrupts.
+ * enable device drivers to receive interrupts.  Devices set up for
+ * asynchronous suspend are handled in parallel here too, each one waiting
+ * for its parent.
  */
 void dpm_resume_noirq(pm_message_t state)
 {
+	struct device *dev;
 	ktime_t starttime = ktime_get();
 
+	dpm_resume_path_phase(DPM_RESUME_EARLY, false);
 	mutex_lock(&dpm_list_mtx);
-	while (!list_empty(&dpm_noirq_list)) {
-		struct device *dev = to_device(dpm_noirq_list.next);
-		int error;
+	pm_transition = state;
 
+	list_for_each_entry(dev, &dpm_noirq_list, power.entry) {
+		INIT_COMPLETION(dev->power.completion);
+		if (is_async(dev)) {
+			get_device(dev);
+			async_schedule(async_resume_noirq, dev);
+		}
+	}
+
+	while (!list_empty(&dpm_noirq_list)) {
+		dev = to_device(dpm_noirq_list.next);
 		get_device(dev);
 		list_move_tail(&dev->power.entry, &dpm_suspended_list);
-		mutex_unlock(&dpm_list_mtx);
+		if (!is_async(dev)) {
+			int error;
 
-		error = device_resume_noirq(dev, state);
-		if (error)
-			pm_dev_err(dev, state, " early", error);
+			mutex_unlock(&dpm_list_mtx);
 
-		mutex_lock(&dpm_list_mtx);
+			error = device_resume_noirq(dev, state, false);
+			if (error)
+				pm_dev_err(dev, state, " early", error);
+
+			mutex_lock(&dpm_list_mtx);
+		}
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full();
+	dpm_resume_path_phase(DPM_RESUME_EARLY, true);
 	dpm_show_time(starttime, state, "early");
 	resume_device_irqs();
 }
@@ -514,12 +562,15 @@ static int legacy_resume(struct device *dev, int (*cb)(struct device *dev))
  */
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
+	struct dpm_resume_timing t;
 	int error = 0;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
+	dpm_resume_timing_begin(&t, DPM_RESUME_NORMAL, async);
 	dpm_wait(dev->parent, async);
+	dpm_resume_timing_run(&t, dev);
 	device_lock(dev);
 
 	/*
@@ -570,6 +621,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
  Unlock:
 	device_unlock(dev);
+	dpm_resume_timing_end(&t, dev, error);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -587,12 +639,6 @@ static void async_resume(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static bool is_async(struct device *dev)
-{
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
-}
-
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -634,6 +680,7 @@ void dpm_resume(pm_message_t state)
 
 	might_sleep();
 
+	dpm_resume_path_phase(DPM_RESUME_NORMAL, false);
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
@@ -666,6 +713,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	dpm_resume_path_phase(DPM_RESUME_NORMAL, true);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -988,6 +1036,7 @@ int dpm_suspend(pm_message_t state)
 
 	might_sleep();
 
+	dpm_resume_path_reset();
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
@@ -1142,6 +1191,42 @@ void __suspend_report_result(const char *function, void *fn, int ret)
 }
 EXPORT_SYMBOL_GPL(__suspend_report_result);
 
+static int dpm_enable_async_fn(struct device *dev, void *unused)
+{
+	device_enable_async_suspend(dev);
+	return 0;
+}
+
+/**
+ * bus_enable_async_suspend - Suspend and resume a bus's devices asynchronously.
+ * @bus: Bus type to handle.
+ *
+ * Set power.async_suspend for the devices on @bus and for those added to it
+ * later.  Asynchronous devices still wait for their parents on resume and for
+ * their children on suspend; any other ordering a driver depends on has to be
+ * expressed with device_pm_wait_for_dev().
+ */
+void bus_enable_async_suspend(struct bus_type *bus)
+{
+	bus->async_suspend = true;
+	bus_for_each_dev(bus, NULL, NULL, dpm_enable_async_fn);
+}
+EXPORT_SYMBOL_GPL(bus_enable_async_suspend);
+
+/**
+ * class_enable_async_suspend - Suspend and resume a class's devices
+ *				asynchronously.
+ * @cls: Device class to handle.
+ *
+ * Like bus_enable_async_suspend(), for the devices of @cls.
+ */
+void class_enable_async_suspend(struct class *cls)
+{
+	cls->async_suspend = true;
+	class_for_each_device(cls, NULL, NULL, dpm_enable_async_fn);
+}
+EXPORT_SYMBOL_GPL(class_enable_async_suspend);
+
 /**
  * device_pm_wait_for_dev - Wait for suspend/resume of a device to complete.
  * @dev: Device to wait for.
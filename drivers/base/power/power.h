@@ -30,6 +30,29 @@ extern void device_pm_move_before(struct device *, struct device *);
 extern void device_pm_move_after(struct device *, struct device *);
 extern void device_pm_move_last(struct device *);
 
+/* drivers/base/power/resume_path.c */
+enum {
+	DPM_RESUME_EARLY,
+	DPM_RESUME_NORMAL,
+	DPM_RESUME_PHASES,
+};
+
+struct dpm_resume_timing {
+	ktime_t wait;
+	ktime_t run;
+	int phase;
+	bool async;
+};
+
+extern void dpm_resume_path_reset(void);
+extern void dpm_resume_path_phase(int phase, bool done);
+extern void dpm_resume_timing_begin(struct dpm_resume_timing *t, int phase,
+				    bool async);
+extern void dpm_resume_timing_run(struct dpm_resume_timing *t,
+				  struct device *dev);
+extern void dpm_resume_timing_end(struct dpm_resume_timing *t,
+				  struct device *dev, int error);
+
 #else /* !CONFIG_PM_SLEEP */
 
 static inline void device_pm_init(struct device *dev)
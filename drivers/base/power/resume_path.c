@@ -0,0 +1,331 @@
+/*
+ * drivers/base/power/resume_path.c - Device resume timing.
+ *
+ * This file is released under the GPLv2.
+ *
+ * Every device resumed during system resume gets a record of when it
+ * started waiting for its parent, when its callbacks started and when they
+ * returned.  Each record also names the record that held it up: the parent
+ * if the device had to wait for it, otherwise the synchronous device resumed
+ * before it.  Following that chain back from the device that finished last
+ * gives the critical path of the phase, which is what has to get faster for
+ * resume to get faster.  The last cycle is shown in debugfs as
+ * "pm_resume_path" and every device is also traced as device_pm_resume.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <trace/events/power.h>
+
+#include "power.h"
+
+#define DPM_RESUME_RECS		256
+
+struct dpm_resume_rec {
+	const struct device *dev;	/* identity only, never dereferenced */
+	char name[24];
+	char driver[16];
+	u8 phase;
+	bool async;
+	int blocker;
+	int error;
+	s64 wait;			/* us */
+	s64 run;
+	s64 end;
+};
+
+static const char * const dpm_resume_phase_names[DPM_RESUME_PHASES] = {
+	[DPM_RESUME_EARLY]	= "early",
+	[DPM_RESUME_NORMAL]	= "resume",
+};
+
+static struct dpm_resume_rec dpm_resume_recs[DPM_RESUME_RECS];
+static atomic_t dpm_resume_nr;
+static int dpm_resume_last_sync[DPM_RESUME_PHASES];
+static s64 dpm_resume_phase_start[DPM_RESUME_PHASES];
+static s64 dpm_resume_phase_end[DPM_RESUME_PHASES];
+
+/**
+ * dpm_resume_path_reset - Forget the previous resume cycle.
+ */
+void dpm_resume_path_reset(void)
+{
+	int i;
+
+	atomic_set(&dpm_resume_nr, 0);
+	for (i = 0; i < DPM_RESUME_PHASES; i++) {
+		dpm_resume_last_sync[i] = -1;
+		dpm_resume_phase_start[i] = 0;
+		dpm_resume_phase_end[i] = 0;
+	}
+}
+
+/**
+ * dpm_resume_path_phase - Mark the start or the end of a resume phase.
+ * @phase: Phase being started or finished.
+ * @done: False at the start of the phase, true once all devices are done.
+ */
+void dpm_resume_path_phase(int phase, bool done)
+{
+	s64 now = ktime_to_us(ktime_get());
+
+	if (done) {
+		dpm_resume_phase_end[phase] = now;
+	} else {
+		dpm_resume_phase_start[phase] = now;
+		dpm_resume_last_sync[phase] = -1;
+	}
+}
+
+static struct dpm_resume_rec *dpm_resume_rec(const struct device *dev,
+					     int phase)
+{
+	int idx = dev->power.resume_rec;
+	struct dpm_resume_rec *rec;
+
+	if (idx < 0 || idx >= min(atomic_read(&dpm_resume_nr), DPM_RESUME_RECS))
+		return NULL;
+	rec = &dpm_resume_recs[idx];
+	return rec->dev == dev && rec->phase == phase ? rec : NULL;
+}
+
+/**
+ * dpm_resume_timing_begin - Start timing the resume of a device.
+ * @t: Timing state, kept by the caller.
+ * @phase: Resume phase the device is in.
+ * @async: True if the device is being resumed asynchronously.
+ *
+ * Called before waiting for the parent.
+ */
+void dpm_resume_timing_begin(struct dpm_resume_timing *t, int phase,
+			     bool async)
+{
+	t->wait = ktime_get();
+	t->phase = phase;
+	t->async = async;
+}
+
+/**
+ * dpm_resume_timing_run - Record that the callbacks of a device are starting.
+ * @t: Timing state passed to dpm_resume_timing_begin().
+ * @dev: Device being resumed.
+ */
+void dpm_resume_timing_run(struct dpm_resume_timing *t, struct device *dev)
+{
+	struct dpm_resume_rec *rec, *prec;
+	int idx;
+
+	t->run = ktime_get();
+	dev->power.resume_rec = -1;
+
+	idx = atomic_inc_return(&dpm_resume_nr) - 1;
+	if (idx >= DPM_RESUME_RECS)
+		return;
+
+	rec = &dpm_resume_recs[idx];
+	rec->dev = dev;
+	strlcpy(rec->name, dev_name(dev), sizeof(rec->name));
+	strlcpy(rec->driver, dev->driver ? dev->driver->name : "",
+		sizeof(rec->driver));
+	rec->phase = t->phase;
+	rec->async = t->async;
+	rec->error = 0;
+	rec->wait = ktime_to_us(t->wait);
+	rec->run = ktime_to_us(t->run);
+	rec->end = 0;
+
+	prec = dev->parent ? dpm_resume_rec(dev->parent, t->phase) : NULL;
+	if (prec && prec->end > rec->wait)
+		rec->blocker = prec - dpm_resume_recs;
+	else if (!t->async)
+		rec->blocker = dpm_resume_last_sync[t->phase];
+	else
+		rec->blocker = -1;
+
+	/* Synchronous devices are only ever resumed by one thread */
+	if (!t->async)
+		dpm_resume_last_sync[t->phase] = idx;
+	dev->power.resume_rec = idx;
+}
+
+/**
+ * dpm_resume_timing_end - Record that the callbacks of a device returned.
+ * @t: Timing state passed to dpm_resume_timing_run().
+ * @dev: Device being resumed.
+ * @error: What the callbacks returned.
+ *
+ * Must be called before the device's completion is signalled, so that its
+ * children see the end time when they look for their blocker.
+ */
+void dpm_resume_timing_end(struct dpm_resume_timing *t, struct device *dev,
+			   int error)
+{
+	struct dpm_resume_rec *rec = dpm_resume_rec(dev, t->phase);
+	ktime_t now = ktime_get();
+
+	if (rec) {
+		rec->error = error;
+		rec->end = ktime_to_us(now);
+	}
+
+	trace_device_pm_resume(dev_name(dev),
+			       dev->driver ? dev->driver->name : "",
+			       dpm_resume_phase_names[t->phase], t->async,
+			       ktime_us_delta(t->run, t->wait),
+			       ktime_us_delta(now, t->run), error);
+}
+
+static void dpm_resume_path_show_rec(struct seq_file *m,
+				     struct dpm_resume_rec *rec, s64 base)
+{
+	seq_printf(m, "%9lld %8lld %8lld %5s  %s", rec->wait - base,
+		   rec->run - rec->wait, rec->end - rec->run,
+		   rec->async ? "yes" : "no", rec->name);
+	if (rec->driver[0])
+		seq_printf(m, " (%s)", rec->driver);
+	if (rec->error)
+		seq_printf(m, " error %d", rec->error);
+	seq_putc(m, '\n');
+}
+
+/*
+ * Find the critical path of @phase.  Its records are stored in @path from
+ * the last one back to the first and their number is returned.
+ */
+static int dpm_resume_path_walk(int phase, int *path, int *devices)
+{
+	int nr = min(atomic_read(&dpm_resume_nr), DPM_RESUME_RECS);
+	int i, last = -1, len = 0;
+
+	*devices = 0;
+	for (i = 0; i < nr; i++) {
+		if (dpm_resume_recs[i].phase != phase)
+			continue;
+		(*devices)++;
+		if (last < 0 || dpm_resume_recs[i].end > dpm_resume_recs[last].end)
+			last = i;
+	}
+
+	/* Blockers always come earlier, so the walk terminates */
+	for (i = last; i >= 0 && len < nr; i = dpm_resume_recs[i].blocker)
+		path[len++] = i;
+	return len;
+}
+
+static s64 dpm_resume_phase_us(int phase)
+{
+	s64 start = dpm_resume_phase_start[phase];
+	s64 end = dpm_resume_phase_end[phase];
+
+	return end > start ? end - start : 0;
+}
+
+static int dpm_resume_path_show(struct seq_file *m, void *unused)
+{
+	int nr = min(atomic_read(&dpm_resume_nr), DPM_RESUME_RECS);
+	int phase, i, len, devices, *path;
+
+	path = kmalloc(DPM_RESUME_RECS * sizeof(*path), GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+
+	if (atomic_read(&dpm_resume_nr) > DPM_RESUME_RECS)
+		seq_printf(m, "only the first %d of %d devices recorded\n\n",
+			   DPM_RESUME_RECS, atomic_read(&dpm_resume_nr));
+
+	for (phase = 0; phase < DPM_RESUME_PHASES; phase++) {
+		s64 base = dpm_resume_phase_start[phase];
+
+		if (!base)
+			continue;
+
+		len = dpm_resume_path_walk(phase, path, &devices);
+		seq_printf(m, "%s: %d devices in %lld us\n",
+			   dpm_resume_phase_names[phase], devices,
+			   dpm_resume_phase_us(phase));
+		if (!len) {
+			seq_putc(m, '\n');
+			continue;
+		}
+
+		seq_printf(m, "critical path, %lld us:\n",
+			   dpm_resume_recs[path[0]].end - base);
+		seq_puts(m, " start_us  wait_us   run_us async  device\n");
+		while (len--)
+			dpm_resume_path_show_rec(m, &dpm_resume_recs[path[len]],
+						 base);
+
+		seq_puts(m, "all devices:\n");
+		seq_puts(m, " start_us  wait_us   run_us async  device\n");
+		for (i = 0; i < nr; i++)
+			if (dpm_resume_recs[i].phase == phase)
+				dpm_resume_path_show_rec(m, &dpm_resume_recs[i],
+							 base);
+		seq_putc(m, '\n');
+	}
+
+	kfree(path);
+	return 0;
+}
+
+/**
+ * dpm_resume_path_report - Log the critical path of the last system resume.
+ */
+void dpm_resume_path_report(void)
+{
+	struct dpm_resume_rec *rec;
+	int phase, len, devices, *path;
+
+	path = kmalloc(DPM_RESUME_RECS * sizeof(*path), GFP_KERNEL);
+	if (!path)
+		return;
+
+	for (phase = 0; phase < DPM_RESUME_PHASES; phase++) {
+		s64 base = dpm_resume_phase_start[phase];
+
+		if (!base)
+			continue;
+
+		len = dpm_resume_path_walk(phase, path, &devices);
+		pr_info("PM: %s: %d devices in %lld us, critical path:\n",
+			dpm_resume_phase_names[phase], devices,
+			dpm_resume_phase_us(phase));
+		while (len--) {
+			rec = &dpm_resume_recs[path[len]];
+			pr_info("PM:   %s%s%s%s at %lld us, waited %lld us, "
+				"ran %lld us\n", rec->name,
+				rec->driver[0] ? " (" : "", rec->driver,
+				rec->driver[0] ? ")" : "", rec->wait - base,
+				rec->run - rec->wait, rec->end - rec->run);
+		}
+	}
+
+	kfree(path);
+}
+
+static int dpm_resume_path_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_resume_path_show, NULL);
+}
+
+static const struct file_operations dpm_resume_path_fops = {
+	.owner = THIS_MODULE,
+	.open = dpm_resume_path_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init dpm_resume_path_init(void)
+{
+	dpm_resume_path_reset();
+	debugfs_create_file("pm_resume_path", S_IRUGO, NULL, NULL,
+			    &dpm_resume_path_fops);
+	return 0;
+}
+postcore_initcall(dpm_resume_path_init);
@@ -0,0 +1,395 @@
+/*
+ * drivers/cpufreq/cpufreq_powercap.c
+ *
+ * Thermal model based frequency capping for cpufreq drivers.
+ *
+ * A driver describes the estimated power of each operating point and
+ * registers a struct cpufreq_powercap.  Every period_ms the engine turns
+ * the CPU's busy and idle time into an estimated power, advances a single
+ * stage RC thermal model with it and picks the highest operating point
+ * whose power at the current demand fits the budget the model leaves.
+ * The result is applied as a ceiling on policy->max through the policy
+ * notifier, so governors see an ordinary limits change.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cpufreq_powercap.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/tick.h>
+#include <linux/time.h>
+
+/* Only one instance is exported, as /sys/devices/system/cpu/cpufreq/powercap */
+static struct cpufreq_powercap *powercap;
+static DEFINE_MUTEX(powercap_mutex);
+
+/* Highest operating point not above @freq, or the lowest one */
+static const struct cpufreq_powercap_opp *
+powercap_opp(struct cpufreq_powercap *pc, unsigned int freq)
+{
+	int i;
+
+	for (i = pc->nr_opps - 1; i > 0; i--)
+		if (pc->opps[i].frequency <= freq)
+			break;
+	return &pc->opps[i];
+}
+
+/* Power at @opp when serving @demand kHz worth of cycles */
+static unsigned int powercap_estimate(const struct cpufreq_powercap_opp *opp,
+				      unsigned int demand)
+{
+	unsigned int busy = 1024;
+
+	if (demand < opp->frequency)
+		busy = div_u64((u64)demand << 10, opp->frequency);
+	return (busy * opp->busy_mw + (1024 - busy) * opp->idle_mw) >> 10;
+}
+
+unsigned int cpufreq_powercap_step(struct cpufreq_powercap *pc,
+				   unsigned int cur, u64 wall_us, u64 idle_us)
+{
+	const struct cpufreq_powercap_opp *opp = powercap_opp(pc, cur);
+	u64 busy_us = wall_us > idle_us ? wall_us - idle_us : 0;
+	unsigned int demand, allowed;
+	s64 rise, target, budget;
+	int i;
+
+	if (!wall_us)
+		return pc->cap_freq;
+
+	pc->power = div64_u64(busy_us * opp->busy_mw +
+			      (wall_us - busy_us) * opp->idle_mw, wall_us);
+
+	/*
+	 * Backward Euler step of the RC stage toward its steady state
+	 * rise; unlike a forward step it cannot overshoot when the
+	 * interval is long compared with tau, e.g. after a deferred run.
+	 */
+	rise = pc->rise;
+	target = (s64)pc->power * pc->resistance - rise;
+	rise += div64_s64(target * wall_us,
+			  (s64)pc->tau_ms * USEC_PER_MSEC + wall_us);
+	pc->rise = max_t(s64, rise, 0);
+
+	if (!pc->enabled) {
+		pc->cap_freq = pc->opps[pc->nr_opps - 1].frequency;
+		return pc->cap_freq;
+	}
+
+	budget = (s64)pc->limit * 100 +
+		 (s64)pc->gain * ((s64)pc->limit - pc->rise);
+	allowed = budget > 0 ?
+		  div64_u64(budget, 100 * max(pc->resistance, 1U)) : 0;
+
+	demand = div64_u64(busy_us * cur, wall_us);
+	for (i = pc->nr_opps - 1; i > 0; i--) {
+		opp = &pc->opps[i];
+		if (opp->frequency <= pc->min_freq ||
+		    powercap_estimate(opp, demand) <= allowed)
+			break;
+	}
+	pc->cap_freq = pc->opps[i].frequency;
+	return pc->cap_freq;
+}
+EXPORT_SYMBOL_GPL(cpufreq_powercap_step);
+
+static void powercap_sample(struct cpufreq_powercap *pc, u64 *wall, u64 *idle)
+{
+	*idle = get_cpu_idle_time_us(pc->cpu, wall);
+	if (*idle == -1ULL) {
+		/* No idle accounting: assume busy, which only errs hot */
+		*idle = 0;
+		*wall = ktime_to_us(ktime_get());
+	}
+}
+
+static void cpufreq_powercap_work(struct work_struct *work)
+{
+	struct cpufreq_powercap *pc =
+		container_of(work, struct cpufreq_powercap, work.work);
+	struct cpufreq_policy *policy;
+	unsigned int old_cap, cap;
+	u64 wall, idle;
+
+	policy = cpufreq_cpu_get(pc->cpu);
+	if (!policy)
+		goto rearm;
+
+	mutex_lock(&pc->lock);
+	if (!pc->registered) {
+		mutex_unlock(&pc->lock);
+		cpufreq_cpu_put(policy);
+		return;
+	}
+	powercap_sample(pc, &wall, &idle);
+	old_cap = pc->cap_freq;
+	cap = cpufreq_powercap_step(pc, policy->cur, wall - pc->last_wall,
+				    idle - pc->last_idle);
+	pc->last_wall = wall;
+	pc->last_idle = idle;
+	mutex_unlock(&pc->lock);
+	cpufreq_cpu_put(policy);
+
+	if (cap != old_cap)
+		cpufreq_update_policy(pc->cpu);
+
+rearm:
+	mutex_lock(&pc->lock);
+	if (pc->registered)
+		schedule_delayed_work_on(pc->cpu, &pc->work,
+					 msecs_to_jiffies(pc->period_ms));
+	mutex_unlock(&pc->lock);
+}
+
+static int cpufreq_powercap_notifier(struct notifier_block *nb,
+				     unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	struct cpufreq_powercap *pc = powercap;
+
+	if (val != CPUFREQ_ADJUST || !pc ||
+	    !cpumask_test_cpu(pc->cpu, policy->cpus))
+		return 0;
+
+	cpufreq_verify_within_limits(policy, 0, pc->cap_freq);
+	return 0;
+}
+
+static struct notifier_block cpufreq_powercap_nb = {
+	.notifier_call = cpufreq_powercap_notifier,
+};
+
+/* sysfs */
+
+#define show_one(name)							\
+static ssize_t show_##name(struct kobject *kobj,			\
+			   struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", powercap->name);			\
+}
+
+#define store_one(name, min)						\
+static ssize_t store_##name(struct kobject *kobj,			\
+			    struct attribute *attr, const char *buf,	\
+			    size_t count)				\
+{									\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret < 0)							\
+		return ret;						\
+	if (val < (min) || val > UINT_MAX)				\
+		return -EINVAL;						\
+	mutex_lock(&powercap->lock);					\
+	powercap->name = val;						\
+	mutex_unlock(&powercap->lock);					\
+	return count;							\
+}
+
+show_one(resistance);
+store_one(resistance, 1);
+show_one(tau_ms);
+store_one(tau_ms, 1);
+show_one(limit);
+store_one(limit, 0);
+show_one(gain);
+store_one(gain, 0);
+show_one(min_freq);
+store_one(min_freq, 0);
+show_one(period_ms);
+store_one(period_ms, 10);
+show_one(enabled);
+show_one(rise);
+show_one(power);
+show_one(cap_freq);
+
+static ssize_t store_enabled(struct kobject *kobj, struct attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&powercap->lock);
+	powercap->enabled = !!val;
+	if (!val)
+		powercap->cap_freq =
+			powercap->opps[powercap->nr_opps - 1].frequency;
+	mutex_unlock(&powercap->lock);
+
+	cpufreq_update_policy(powercap->cpu);
+	return count;
+}
+
+static ssize_t show_opp_power(struct kobject *kobj, struct attribute *attr,
+			      char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&powercap->lock);
+	for (i = 0; i < powercap->nr_opps; i++)
+		len += sprintf(buf + len, "%u %u %u\n",
+			       powercap->opps[i].frequency,
+			       powercap->opps[i].busy_mw,
+			       powercap->opps[i].idle_mw);
+	mutex_unlock(&powercap->lock);
+	return len;
+}
+
+/* Write "<kHz> <busy mW> <idle mW>" to update one operating point */
+static ssize_t store_opp_power(struct kobject *kobj, struct attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned int freq, busy, idle;
+	int i, ret = -EINVAL;
+
+	if (sscanf(buf, "%u %u %u", &freq, &busy, &idle) != 3)
+		return -EINVAL;
+
+	mutex_lock(&powercap->lock);
+	for (i = 0; i < powercap->nr_opps; i++) {
+		if (powercap->opps[i].frequency == freq) {
+			powercap->opps[i].busy_mw = busy;
+			powercap->opps[i].idle_mw = idle;
+			ret = count;
+			break;
+		}
+	}
+	mutex_unlock(&powercap->lock);
+	return ret;
+}
+
+define_one_global_rw(resistance);
+define_one_global_rw(tau_ms);
+define_one_global_rw(limit);
+define_one_global_rw(gain);
+define_one_global_rw(min_freq);
+define_one_global_rw(period_ms);
+define_one_global_rw(enabled);
+define_one_global_rw(opp_power);
+define_one_global_ro(rise);
+define_one_global_ro(power);
+define_one_global_ro(cap_freq);
+
+static struct attribute *powercap_attributes[] = {
+	&resistance.attr,
+	&tau_ms.attr,
+	&limit.attr,
+	&gain.attr,
+	&min_freq.attr,
+	&period_ms.attr,
+	&enabled.attr,
+	&opp_power.attr,
+	&rise.attr,
+	&power.attr,
+	&cap_freq.attr,
+	NULL
+};
+
+static struct attribute_group powercap_attr_group = {
+	.attrs = powercap_attributes,
+	.name = "powercap",
+};
+
+/**
+ * cpufreq_powercap_register - start capping a CPU's frequency
+ * @pc: model and operating points, filled in by the driver
+ *
+ * @pc->lock must be initialised by the driver, which holds it while it
+ * changes the operating points later on.  Typically called from the
+ * driver's ->init.  The ceiling starts at the highest operating point
+ * and is re-evaluated every @pc->period_ms.
+ */
+int cpufreq_powercap_register(struct cpufreq_powercap *pc)
+{
+	int rc;
+
+	if (!pc->nr_opps || !pc->tau_ms || !pc->resistance || pc->period_ms < 10)
+		return -EINVAL;
+
+	mutex_lock(&powercap_mutex);
+	if (powercap) {
+		rc = -EBUSY;
+		goto out;
+	}
+
+	pc->rise = 0;
+	pc->power = 0;
+	pc->cap_freq = pc->opps[pc->nr_opps - 1].frequency;
+	powercap_sample(pc, &pc->last_wall, &pc->last_idle);
+	INIT_DELAYED_WORK_DEFERRABLE(&pc->work, cpufreq_powercap_work);
+	pc->registered = true;
+	powercap = pc;
+
+	rc = sysfs_create_group(cpufreq_global_kobject, &powercap_attr_group);
+	if (rc)
+		goto err;
+	rc = cpufreq_register_notifier(&cpufreq_powercap_nb,
+				       CPUFREQ_POLICY_NOTIFIER);
+	if (rc) {
+		sysfs_remove_group(cpufreq_global_kobject,
+				   &powercap_attr_group);
+		goto err;
+	}
+
+	schedule_delayed_work_on(pc->cpu, &pc->work,
+				 msecs_to_jiffies(pc->period_ms));
+	goto out;
+
+err:
+	pc->registered = false;
+	powercap = NULL;
+out:
+	mutex_unlock(&powercap_mutex);
+	return rc;
+}
+EXPORT_SYMBOL_GPL(cpufreq_powercap_register);
+
+/**
+ * cpufreq_powercap_unregister - stop capping
+ * @pc: instance passed to cpufreq_powercap_register()
+ *
+ * Waits for the work, which takes the policy rwsem in
+ * cpufreq_update_policy(): must not be called with that rwsem held,
+ * e.g. from the driver's ->exit.  Call it before
+ * cpufreq_unregister_driver() instead.
+ */
+void cpufreq_powercap_unregister(struct cpufreq_powercap *pc)
+{
+	mutex_lock(&powercap_mutex);
+	if (powercap != pc) {
+		mutex_unlock(&powercap_mutex);
+		return;
+	}
+
+	mutex_lock(&pc->lock);
+	pc->registered = false;
+	mutex_unlock(&pc->lock);
+
+	cpufreq_unregister_notifier(&cpufreq_powercap_nb,
+				    CPUFREQ_POLICY_NOTIFIER);
+	sysfs_remove_group(cpufreq_global_kobject, &powercap_attr_group);
+	powercap = NULL;
+	mutex_unlock(&powercap_mutex);
+
+	/* Not re-armed once registered is clear */
+	cancel_delayed_work_sync(&pc->work);
+}
+EXPORT_SYMBOL_GPL(cpufreq_powercap_unregister);
@@ -0,0 +1,83 @@
+/*
+ * dummy.c - made-up idle states for exercising the governors
+ *
+ * This code is licenced under the GPL.
+ *
+ * Every state executes WFI and then burns its exit latency, so the cost
+ * of a wrong choice is visible in the residency numbers the same way it
+ * would be on real hardware, only without any power saved.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpuidle.h>
+#include <linux/delay.h>
+#include <linux/hrtimer.h>
+
+#include <asm/proc-fns.h>
+
+static struct {
+	const char *name;
+	unsigned int exit_latency;	/* us */
+	unsigned int target_residency;	/* us */
+	unsigned int power_usage;	/* mW */
+} dummy_states[] = {
+	{ "C1",    1,    1, 100 },
+	{ "C2",   50,  200,  50 },
+	{ "C3",  500, 2000,  10 },
+};
+
+static int dummy_enter(struct cpuidle_device *dev,
+		       struct cpuidle_state *state)
+{
+	ktime_t start = ktime_get();
+
+	cpu_do_idle();
+	if (state->exit_latency > 1)
+		udelay(state->exit_latency);
+	local_irq_enable();
+
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static struct cpuidle_driver dummy_idle_driver = {
+	.name	= "dummy_idle",
+	.owner	= THIS_MODULE,
+};
+
+static struct cpuidle_device dummy_idle_device;
+
+static int __init dummy_idle_init(void)
+{
+	struct cpuidle_device *dev = &dummy_idle_device;
+	int i, ret;
+
+	ret = cpuidle_register_driver(&dummy_idle_driver);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ARRAY_SIZE(dummy_states); i++) {
+		struct cpuidle_state *state = &dev->states[i];
+
+		snprintf(state->name, CPUIDLE_NAME_LEN, "%s",
+			 dummy_states[i].name);
+		snprintf(state->desc, CPUIDLE_DESC_LEN, "dummy, WFI + %uus",
+			 dummy_states[i].exit_latency);
+		state->exit_latency = dummy_states[i].exit_latency;
+		state->target_residency = dummy_states[i].target_residency;
+		state->power_usage = dummy_states[i].power_usage;
+		state->flags = CPUIDLE_FLAG_TIME_VALID;
+		state->enter = dummy_enter;
+	}
+
+	dev->state_count = ARRAY_SIZE(dummy_states);
+	dev->power_specified = 1;
+	dev->cpu = 0;
+
+	ret = cpuidle_register_device(dev);
+	if (ret)
+		cpuidle_unregister_driver(&dummy_idle_driver);
+	return ret;
+}
+late_initcall(dummy_idle_init);
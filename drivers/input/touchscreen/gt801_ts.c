@@ -514,7 +514,9 @@ static int gt801_ts_probe(struct i2c_client *client, const struct i2c_device_id
         hrtimer_start(&ts->timer, ktime_set(1, 0), HRTIMER_MODE_REL);
     }
 #ifdef CONFIG_HAS_EARLYSUSPEND
-    ts->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
+    /* Only resets the panel: run it alongside the framebuffer's */
+    ts->early_suspend.level = EARLY_SUSPEND_LEVEL_DISABLE_FB;
+    ts->early_suspend.async = true;
     ts->early_suspend.suspend = gt801_ts_early_suspend;
     ts->early_suspend.resume = gt801_ts_late_resume;
     register_early_suspend(&ts->early_suspend);
@@ -3259,7 +3259,7 @@ static int amsdu_to_msdu(_adapter *padapter, union recv_frame *prframe)
 			sub_skb->ip_summed = CHECKSUM_NONE;
 #endif
 
-			netif_rx(sub_skb);
+			rtw_netif_rx(padapter, sub_skb);
 		}
 	}
 
@@ -71,10 +71,18 @@ int	rtl8192cu_init_recv_priv(_adapter *padapter)
 #endif
 
 #ifdef PLATFORM_LINUX
+#ifdef CONFIG_RTW_NAPI
+	init_dummy_netdev(&precvpriv->napi_dev);
+	netif_napi_add(&precvpriv->napi_dev, &precvpriv->napi,
+	     rtl8192cu_recv_napi_poll, RTW_NAPI_WEIGHT);
+	precvpriv->napi_cpu = -1;
+	napi_enable(&precvpriv->napi);
+#else
 	tasklet_init(&precvpriv->recv_tasklet,
 	     (void(*)(unsigned long))rtl8192cu_recv_tasklet,
 	     (unsigned long)padapter);
 #endif
+#endif
 
 #ifdef CONFIG_USB_INTERRUPT_IN_PIPE
 #ifdef PLATFORM_LINUX
@@ -212,6 +220,13 @@ void rtl8192cu_free_recv_priv (_adapter *padapter)
 
 #ifdef PLATFORM_LINUX
 
+#ifdef CONFIG_RTW_NAPI
+	if (precvpriv->napi.poll) {
+		napi_disable(&precvpriv->napi);
+		netif_napi_del(&precvpriv->napi);
+	}
+#endif
+
 	if (skb_queue_len(&precvpriv->rx_skb_queue)) {
 		DBG_8192C(KERN_WARNING "rx_skb_queue not empty\n");
 	}
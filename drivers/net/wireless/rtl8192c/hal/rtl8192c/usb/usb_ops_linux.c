@@ -750,6 +750,15 @@ _func_exit_;
 }
 #endif
 
+static void rtl8192cu_recv_schedule(struct recv_priv *precvpriv)
+{
+#ifdef CONFIG_RTW_NAPI
+	napi_schedule(&precvpriv->napi);
+#else
+	tasklet_schedule(&precvpriv->recv_tasklet);
+#endif
+}
+
 #ifdef CONFIG_USE_USB_BUFFER_ALLOC_RX
 static int recvbuf2recvframe(_adapter *padapter, struct recv_buf *precvbuf)
 {
@@ -916,28 +925,35 @@ _exit_recvbuf2recvframe:
 	return _SUCCESS;	
 }
 
-void rtl8192cu_recv_tasklet(void *priv)
-{	
+//return 1 if a pending recv_buf was handled, 0 if there is nothing to do
+static int rtl8192cu_recv_one(_adapter *padapter)
+{
 	struct recv_buf *precvbuf = NULL;
-	_adapter	*padapter = (_adapter*)priv;
 	struct recv_priv	*precvpriv = &padapter->recvpriv;
 
-	while (NULL != (precvbuf = rtw_dequeue_recvbuf(&precvpriv->recv_buf_pending_queue)))
+	if (NULL == (precvbuf = rtw_dequeue_recvbuf(&precvpriv->recv_buf_pending_queue)))
+		return 0;
+
+	if ((padapter->bDriverStopped == _TRUE)||(padapter->bSurpriseRemoved== _TRUE))
 	{
-		if ((padapter->bDriverStopped == _TRUE)||(padapter->bSurpriseRemoved== _TRUE))
-		{
-			DBG_8192C("recv_tasklet => bDriverStopped or bSurpriseRemoved \n");
-			
-			break;
-		}
+		DBG_8192C("recv_tasklet => bDriverStopped or bSurpriseRemoved \n");
 		
+		return 0;
+	}
 
-		recvbuf2recvframe(padapter, precvbuf);
+	recvbuf2recvframe(padapter, precvbuf);
 
-		rtw_read_port(padapter, precvpriv->ff_hwaddr, 0, (unsigned char *)precvbuf);
-	}	
-	
+	rtw_read_port(padapter, precvpriv->ff_hwaddr, 0, (unsigned char *)precvbuf);
+
+	return 1;
+}
+
+#ifdef CONFIG_RTW_NAPI
+static int rtl8192cu_recv_pending(struct recv_priv *precvpriv)
+{
+	return !_rtw_queue_empty(&precvpriv->recv_buf_pending_queue);
 }
+#endif
 
 static void usb_read_port_complete(struct urb *purb, struct pt_regs *regs)
 {	
@@ -973,7 +989,7 @@ static void usb_read_port_complete(struct urb *purb, struct pt_regs *regs)
 			//rtw_enqueue_rx_transfer_buffer(precvpriv, rx_transfer_buf);			
 			rtw_enqueue_recvbuf(precvbuf, &precvpriv->recv_buf_pending_queue);
 
-			tasklet_schedule(&precvpriv->recv_tasklet);			
+			rtl8192cu_recv_schedule(precvpriv);
 		}		
 	}
 	else
@@ -1250,41 +1266,48 @@ _exit_recvbuf2recvframe:
 	return _SUCCESS;	
 }
 
-void rtl8192cu_recv_tasklet(void *priv)
+//return 1 if a pending rx skb was handled, 0 if there is nothing to do
+static int rtl8192cu_recv_one(_adapter *padapter)
 {
 	_pkt			*pskb;
-	_adapter		*padapter = (_adapter*)priv;
 	struct recv_priv	*precvpriv = &padapter->recvpriv;
-	
-	while (NULL != (pskb = skb_dequeue(&precvpriv->rx_skb_queue)))
+
+	if (NULL == (pskb = skb_dequeue(&precvpriv->rx_skb_queue)))
+		return 0;
+
+	if ((padapter->bDriverStopped == _TRUE)||(padapter->bSurpriseRemoved== _TRUE))
 	{
-		if ((padapter->bDriverStopped == _TRUE)||(padapter->bSurpriseRemoved== _TRUE))
-		{
-			DBG_8192C("recv_tasklet => bDriverStopped or bSurpriseRemoved \n");
-			dev_kfree_skb_any(pskb);
-			break;
-		}
-	
-		recvbuf2recvframe(padapter, pskb);
+		DBG_8192C("recv_tasklet => bDriverStopped or bSurpriseRemoved \n");
+		dev_kfree_skb_any(pskb);
+		return 0;
+	}
+
+	recvbuf2recvframe(padapter, pskb);
 
 #ifdef CONFIG_PREALLOC_RECV_SKB
 
 #ifdef NET_SKBUFF_DATA_USES_OFFSET			
-		skb_reset_tail_pointer(pskb);
+	skb_reset_tail_pointer(pskb);
 #else
-		pskb->tail = pskb->data;
+	pskb->tail = pskb->data;
 #endif
-		pskb->len = 0;
-		
-		skb_queue_tail(&precvpriv->free_recv_skb_queue, pskb);
-		
+	pskb->len = 0;
+	
+	skb_queue_tail(&precvpriv->free_recv_skb_queue, pskb);
+	
 #else
-		dev_kfree_skb_any(pskb);
+	dev_kfree_skb_any(pskb);
 #endif
-				
-	}
-	
+
+	return 1;
+}
+
+#ifdef CONFIG_RTW_NAPI
+static int rtl8192cu_recv_pending(struct recv_priv *precvpriv)
+{
+	return skb_queue_len(&precvpriv->rx_skb_queue) != 0;
 }
+#endif
 
 
 static void usb_read_port_complete(struct urb *purb, struct pt_regs *regs)
@@ -1342,8 +1365,12 @@ static void usb_read_port_complete(struct urb *purb, struct pt_regs *regs)
 			skb_put(precvbuf->pskb, purb->actual_length);	
 			skb_queue_tail(&precvpriv->rx_skb_queue, precvbuf->pskb);
 
+#ifdef CONFIG_RTW_NAPI
+			rtl8192cu_recv_schedule(precvpriv);
+#else
 			if (skb_queue_len(&precvpriv->rx_skb_queue)<=1)
-				tasklet_schedule(&precvpriv->recv_tasklet);
+				rtl8192cu_recv_schedule(precvpriv);
+#endif
 
 			precvbuf->pskb = NULL;
 			precvbuf->reuse = _FALSE;
@@ -1520,6 +1547,45 @@ _func_exit_;
 }
 #endif	// CONFIG_USE_USB_BUFFER_ALLOC_RX
 
+#ifdef CONFIG_RTW_NAPI
+/*
+ * NAPI poll, run instead of the recv tasklet.  The budget counts rx
+ * transfers, each of which may carry several aggregated frames; frames
+ * indicated from here go up through GRO, see rtw_netif_rx().
+ */
+int rtl8192cu_recv_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct recv_priv	*precvpriv = container_of(napi, struct recv_priv, napi);
+	_adapter		*padapter = container_of(precvpriv, _adapter, recvpriv);
+	int			work = 0;
+
+	precvpriv->napi_cpu = smp_processor_id();
+	while ((work < budget) && rtl8192cu_recv_one(padapter))
+		work++;
+	precvpriv->napi_cpu = -1;
+
+	if (work < budget)
+	{
+		napi_complete(napi);
+
+		//a transfer may have completed after the queue was found empty
+		if (rtl8192cu_recv_pending(precvpriv) &&
+		    (padapter->bDriverStopped == _FALSE) && (padapter->bSurpriseRemoved == _FALSE))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+#else
+void rtl8192cu_recv_tasklet(void *priv)
+{
+	_adapter	*padapter = (_adapter*)priv;
+
+	while (rtl8192cu_recv_one(padapter))
+		;
+}
+#endif
+
 static void usb_read_port_cancel(struct intf_hdl *pintfhdl)
 {
 	int i;	
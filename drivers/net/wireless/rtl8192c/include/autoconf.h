@@ -125,6 +125,7 @@
 #endif
 
 #define CONFIG_PREALLOC_RECV_SKB	1
+#define CONFIG_RTW_NAPI	1	// Receive from a NAPI poll instead of the recv tasklet, passing frames up through GRO.
 //#define CONFIG_REDUCE_USB_TX_INT	1	// Trade-off: Improve performance, but may cause TX URBs blocked by USB Host/Bus driver on few platforms.
 //#define CONFIG_EASY_REPLACEMENT	1
 
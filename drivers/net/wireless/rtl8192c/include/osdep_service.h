@@ -102,6 +102,10 @@
 #define CONFIG_AUTOSUSPEND	1
 #endif
 #endif
+#endif
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,29))
+#undef CONFIG_RTW_NAPI	// no GRO yet
 #endif
 
 	typedef struct 	semaphore _sema;
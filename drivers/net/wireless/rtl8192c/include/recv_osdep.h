@@ -31,6 +31,9 @@ extern void _rtw_free_recv_priv (struct recv_priv *precvpriv);
 
 extern s32  rtw_recv_entry(union recv_frame *precv_frame);	
 extern int rtw_recv_indicatepkt(_adapter *adapter, union recv_frame *precv_frame);
+#ifdef PLATFORM_LINUX
+extern int rtw_netif_rx(_adapter *padapter, _pkt *skb);
+#endif
 extern void rtw_recv_returnpacket(IN _nic_hdl cnxt, IN _pkt *preturnedpkt);
 
 extern void rtw_hostapd_mlme_rx(_adapter *padapter, union recv_frame *precv_frame);
@@ -35,6 +35,8 @@
 	#define NR_RECVBUFF (4)
 
 	#define NR_PREALLOC_RECV_SKB (8)
+
+	#define RTW_NAPI_WEIGHT (NR_RECVBUFF * 2)	// rx transfers per napi poll
 #endif
 
 
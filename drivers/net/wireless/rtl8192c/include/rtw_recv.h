@@ -266,6 +266,11 @@ struct recv_priv {
 #ifdef PLATFORM_LINUX
 	struct tasklet_struct irq_prepare_beacon_tasklet;
 	struct tasklet_struct recv_tasklet;
+#ifdef CONFIG_RTW_NAPI
+	struct net_device napi_dev;	// dummy, as pnetdev changes in rtw_change_ifname()
+	struct napi_struct napi;
+	int napi_cpu;	// cpu running the napi poll, -1 otherwise
+#endif
 	struct sk_buff_head free_recv_skb_queue;
 	struct sk_buff_head rx_skb_queue;
 
@@ -53,7 +53,11 @@ enum{
 #ifdef CONFIG_RTL8192C
 void rtl8192cu_set_intf_ops(struct _io_ops *pops);
 
+#ifdef CONFIG_RTW_NAPI
+int rtl8192cu_recv_napi_poll(struct napi_struct *napi, int budget);
+#else
 void rtl8192cu_recv_tasklet(void *priv);
+#endif
 
 void rtl8192cu_xmit_tasklet(void *priv);
 #endif
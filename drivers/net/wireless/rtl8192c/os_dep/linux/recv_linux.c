@@ -211,6 +211,30 @@ void rtw_hostapd_mlme_rx(_adapter *padapter, union recv_frame *precv_frame)
 #endif	
 }
 
+/*
+ * Hand a received frame to the stack.  Inside the napi poll it goes through
+ * GRO; from elsewhere, such as the reorder timeout, through netif_rx().
+ * GRO only merges TCP segments with a known checksum, so IP frames the
+ * hardware didn't check are summed here as CHECKSUM_COMPLETE.
+ */
+int rtw_netif_rx(_adapter *padapter, _pkt *skb)
+{
+#ifdef CONFIG_RTW_NAPI
+	struct recv_priv *precvpriv = &padapter->recvpriv;
+
+	if (in_softirq() && precvpriv->napi_cpu == smp_processor_id()) {
+		if (skb->ip_summed == CHECKSUM_NONE &&
+		    (skb->protocol == htons(ETH_P_IP) ||
+		     skb->protocol == htons(ETH_P_IPV6))) {
+			skb->csum = skb_checksum(skb, 0, skb->len, 0);
+			skb->ip_summed = CHECKSUM_COMPLETE;
+		}
+		return napi_gro_receive(&precvpriv->napi, skb);
+	}
+#endif
+	return netif_rx(skb);
+}
+
 int rtw_recv_indicatepkt(_adapter *padapter, union recv_frame *precv_frame)
 {	
 	struct recv_priv *precvpriv;
@@ -319,7 +343,7 @@ _func_enter_;
 	skb->dev = padapter->pnetdev;
 	skb->protocol = eth_type_trans(skb, padapter->pnetdev);
 
-	netif_rx(skb);
+	rtw_netif_rx(padapter, skb);
 
 _recv_indicatepkt_end:
 
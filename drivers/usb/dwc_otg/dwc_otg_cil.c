@@ -624,6 +624,9 @@ void dwc_otg_core_init(dwc_otg_core_if_t *_core_if)
 	ahbcfg.b.dmaenable = _core_if->dma_enable;
 	dwc_write_reg32(&global_regs->gahbcfg, ahbcfg.d32);
 
+	_core_if->dma_desc_enable = _core_if->dma_enable && 
+		(_core_if->core_params->dma_desc_enable == 1);
+
 	_core_if->en_multiple_tx_fifo = _core_if->hwcfg4.b.ded_fifo_en;
 
 	/* Enable common interrupts */
@@ -708,6 +711,8 @@ void dwc_otg_core_dev_init(dwc_otg_core_if_t *_core_if)
     volatile daint_data_t daintmsk = {.d32 = 0};
     volatile gahbcfg_data_t gahbcfg = {.d32 = 0};
 	volatile dthrctl_data_t dthrctl;
+	diepmsk_data_t diepmsk;
+	doepmsk_data_t doepmsk;
 	dwc_otg_core_reset(_core_if);
 	/* Restart the Phy Clock */
 	dwc_write_reg32(_core_if->pcgcctl, 0);
@@ -759,6 +764,7 @@ void dwc_otg_core_dev_init(dwc_otg_core_if_t *_core_if)
 	dcfg.b.perfrint = DWC_DCFG_FRAME_INTERVAL_80;
 	dcfg.b.devaddr = 0;		//reset device addr
 	dcfg.b.devspd = 0;		// high speed
+	dcfg.b.descdma = _core_if->dma_desc_enable;
 	dwc_write_reg32( &dev_if->dev_global_regs->dcfg, dcfg.d32 );
 
 	/* Flush all Txfifo */
@@ -797,8 +803,15 @@ void dwc_otg_core_dev_init(dwc_otg_core_if_t *_core_if)
     dwc_write_reg32( &dev_if->out_ep_regs[2]->doepint, 0xff );
 
     /* global register initial */
-    dwc_write_reg32( &dev_if->dev_global_regs->diepmsk, 0x2f );//device IN interrutp mask
-    dwc_write_reg32( &dev_if->dev_global_regs->doepmsk, 0x0f );//device OUT interrutp mask
+	diepmsk.d32 = 0x2f;		//device IN interrutp mask
+	doepmsk.d32 = 0x0f;		//device OUT interrutp mask
+	if (_core_if->dma_desc_enable) 
+	{
+		diepmsk.b.bna = 1;
+		doepmsk.b.bna = 1;
+	}
+    dwc_write_reg32( &dev_if->dev_global_regs->diepmsk, diepmsk.d32 );
+    dwc_write_reg32( &dev_if->dev_global_regs->doepmsk, doepmsk.d32 );
     dwc_write_reg32( &dev_if->dev_global_regs->daint, 0xffffffff ); //clear all pending intrrupt
     daintmsk.b.inep0 = 1;
     daintmsk.b.inep1 = 1;
@@ -2004,6 +2017,109 @@ void dwc_otg_ep_deactivate(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 	return;
 }
 
+/**
+ * This function starts the descriptor chain the PCD has built in the
+ * EP's descriptor ring.  The core fetches the descriptors from
+ * DIEPDMAn/DOEPDMAn on its own and stops at the one marked L, so
+ * DIEPTSIZn/DOEPTSIZn are not programmed.
+ *
+ * @param _core_if Programming view of DWC_otg controller.
+ * @param _ep The EP to start the transfer on.
+ */
+void dwc_otg_ep_start_ddma_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
+{
+	depctl_data_t depctl;
+	volatile uint32_t *addr;
+
+	DWC_DEBUGPL(DBG_PCD, "ep%d-%s desc_cnt=%d desc=%08x\n",
+		_ep->num, (_ep->is_in?"IN":"OUT"), _ep->desc_cnt, 
+		(uint32_t)_ep->dma_desc_addr);
+
+	if (_ep->is_in == 1) 
+	{
+		dwc_write_reg32(&_core_if->dev_if->in_ep_regs[_ep->num]->diepdma, 
+			(uint32_t)_ep->dma_desc_addr);
+		addr = &_core_if->dev_if->in_ep_regs[_ep->num]->diepctl;
+	} 
+	else 
+	{
+		dwc_write_reg32(&_core_if->dev_if->out_ep_regs[_ep->num]->doepdma, 
+			(uint32_t)_ep->dma_desc_addr);
+		addr = &_core_if->dev_if->out_ep_regs[_ep->num]->doepctl;
+	}
+
+	/* EP enable */
+	depctl.d32 = dwc_read_reg32(addr);
+	depctl.b.cnak = 1;
+	depctl.b.epena = 1;
+	dwc_write_reg32(addr, depctl.d32);
+}
+
+/**
+ * This function stops the descriptor chain an EP is running, so that a
+ * request can be taken out of it.  The EP is NAKed and disabled and the
+ * core is waited for: once EPDisbld is set it has closed every
+ * descriptor it worked on and fetches no more.  An IN EP's Tx FIFO is
+ * flushed of the packets it had already loaded.
+ *
+ * @param _core_if Programming view of DWC_otg controller.
+ * @param _ep The EP to stop.
+ */
+void dwc_otg_ep_stop_ddma_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
+{
+	depctl_data_t depctl;
+	diepint_data_t depint;
+	volatile uint32_t *ctl_addr;
+	volatile uint32_t *int_addr;
+	int count = 0;
+
+	if (_ep->is_in == 1) 
+	{
+		ctl_addr = &_core_if->dev_if->in_ep_regs[_ep->num]->diepctl;
+		int_addr = &_core_if->dev_if->in_ep_regs[_ep->num]->diepint;
+	} 
+	else 
+	{
+		ctl_addr = &_core_if->dev_if->out_ep_regs[_ep->num]->doepctl;
+		int_addr = &_core_if->dev_if->out_ep_regs[_ep->num]->doepint;
+	}
+
+	depctl.d32 = dwc_read_reg32(ctl_addr);
+	if (!depctl.b.epena) 
+	{
+		/* the chain has run to its end already */
+		return;
+	}
+	depctl.b.snak = 1;
+	depctl.b.epdis = 1;
+	dwc_write_reg32(ctl_addr, depctl.d32);
+
+	/* DIEPINTn and DOEPINTn share the EPDisbld bit */
+	do 
+	{
+		UDELAY(1);
+		depint.d32 = dwc_read_reg32(int_addr);
+		if (++count > 10000)
+		{
+			DWC_WARN("%s() HANG! ep%d-%s DEPCTL=%0x\n", __func__, 
+				_ep->num, (_ep->is_in?"IN":"OUT"), 
+				dwc_read_reg32(ctl_addr));
+			break;
+		}
+	} 
+	while (depint.b.epdisabled == 0);
+
+	/* handled here, not by the interrupt handler */
+	depint.d32 = 0;
+	depint.b.epdisabled = 1;
+	dwc_write_reg32(int_addr, depint.d32);
+
+	if (_ep->is_in == 1) 
+	{
+		dwc_otg_flush_tx_fifo(_core_if, _ep->tx_fifo_num);
+	}
+}
+
 /**
  * This function does the setup for a data transfer for an EP and
  * starts the transfer.	 For an IN transfer, the packets will be
@@ -2160,6 +2276,12 @@ void dwc_otg_ep_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 
 	DWC_DEBUGPL((DBG_PCDV | DBG_CILV), "%s()\n", __func__);
 		
+	if (_core_if->dma_desc_enable) 
+	{
+		dwc_otg_ep_start_ddma_transfer(_core_if, _ep);
+		return;
+	}
+
 	DWC_DEBUGPL(DBG_PCD, "ep%d-%s xfer_len=%d xfer_cnt=%d "
 		"xfer_buff=%p start_xfer_buff=%p\n",
 		_ep->num, (_ep->is_in?"IN":"OUT"), _ep->xfer_len, 
@@ -2333,6 +2455,32 @@ void dwc_otg_ep_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 }
 
 
+/**
+ * In descriptor DMA mode EP0 is driven one stage at a time, exactly as
+ * in buffer DMA mode, through a single descriptor per direction that is
+ * rewritten for each packet (IN) or data stage (OUT).
+ *
+ * @param _ep The EP0 data.
+ * @param _addr Bus address of the data.
+ * @param _bytes Bytes to transfer.
+ * @return the bus address of the descriptor, for DIEPDMA0/DOEPDMA0.
+ */
+static uint32_t ep0_ddma_desc(dwc_ep_t *_ep, uint32_t _addr, uint32_t _bytes)
+{
+	dwc_otg_dma_desc_t *desc = &_ep->desc_addr[_ep->is_in ? 0 : 1];
+	dev_dma_desc_sts_t sts = { .d32 = 0 };
+
+	sts.b.bytes = _bytes;
+	sts.b.sp = _ep->is_in && _bytes < _ep->maxpacket;
+	sts.b.l = 1;
+	sts.b.ioc = 1;
+	sts.b.bs = BS_HOST_READY;
+	desc->buf = _addr;
+	desc->status.d32 = sts.d32;
+
+	return (uint32_t)_ep->dma_desc_addr + (_ep->is_in ? 0 : sizeof(*desc));
+}
+
 /**
  * This function does the setup for a data transfer for EP0 and starts
  * the transfer.  For an IN transfer, the packets will be loaded into
@@ -2416,7 +2564,13 @@ void dwc_otg_ep0_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 			deptsiz.b.xfersize, deptsiz.b.pktcnt, deptsiz.d32);
 	
 		/* Write the DMA register */
-		if (_core_if->dma_enable) 
+		if (_core_if->dma_desc_enable) 
+		{
+			dwc_write_reg32 (&(in_regs->diepdma), 
+				ep0_ddma_desc(_ep, _ep->dma_addr, deptsiz.b.xfersize));
+		    _ep->dma_addr += _ep->xfer_len;
+		}
+		else if (_core_if->dma_enable) 
 		{	
 			dwc_write_reg32 (&(in_regs->diepdma), 
 				(uint32_t)_ep->dma_addr);
@@ -2486,7 +2640,16 @@ void dwc_otg_ep0_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 			_ep->xfer_len, 
 			deptsiz.b.xfersize, deptsiz.b.pktcnt);
 
-		if (_core_if->dma_enable) 
+		if (_core_if->dma_desc_enable) 
+		{
+			/* One descriptor takes the whole data stage */
+			uint32_t bytes = _ep->xfer_len ?
+				(_ep->xfer_len + _ep->maxpacket - 1) / _ep->maxpacket * _ep->maxpacket :
+				_ep->maxpacket;
+			dwc_write_reg32 (&(out_regs->doepdma), 
+					 ep0_ddma_desc(_ep, _ep->dma_addr, bytes));
+		}
+		else if (_core_if->dma_enable) 
 		{
 			dwc_write_reg32 (&(out_regs->doepdma), 
 					 (uint32_t)_ep->dma_addr);
@@ -2543,7 +2706,13 @@ void dwc_otg_ep0_continue_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep)
 			deptsiz.b.xfersize, deptsiz.b.pktcnt, deptsiz.d32);
 
 		/* Write the DMA register */
-		if (_core_if->hwcfg2.b.architecture == DWC_INT_DMA_ARCH) 
+		if (_core_if->dma_desc_enable) 
+		{
+			dwc_write_reg32 (&(in_regs->diepdma), 
+				ep0_ddma_desc(_ep, _ep->dma_addr, deptsiz.b.xfersize));
+			_ep->dma_addr += deptsiz.b.xfersize;
+		}
+		else if (_core_if->hwcfg2.b.architecture == DWC_INT_DMA_ARCH) 
 		{
 			dwc_write_reg32 (&(in_regs->diepdma), 
 					 (uint32_t)_ep->dma_addr);
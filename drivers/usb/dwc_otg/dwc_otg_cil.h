@@ -36,6 +36,7 @@
 
 #include "linux/dwc_otg_plat.h"
 #include "dwc_otg_regs.h"
+#include "dwc_otg_ddma.h"
 #ifdef DEBUG
 #include "linux/timer.h"
 #endif
@@ -107,6 +108,16 @@ typedef struct dwc_ep
 	
 	u32 bytes_pending;
 	/** @} */
+
+	/** @name Descriptor DMA */
+	/** @{ */
+	/** Descriptor ring (EP0: IN then OUT descriptor) */
+	dwc_otg_dma_desc_t *desc_addr;
+	/** Bus address of the descriptor ring */
+	dma_addr_t dma_desc_addr;
+	/** Descriptors in the running chain, 0 when idle */
+	uint16_t desc_cnt;
+	/** @} */
 } dwc_ep_t;
 
 /*
@@ -311,6 +322,17 @@ typedef struct dwc_otg_core_params
 	int32_t dma_enable;
 #define dwc_param_dma_enable_default 1
 
+	/**
+	 * Specifies whether device mode uses descriptor DMA, where the
+	 * core walks chains of buffer descriptors instead of being
+	 * programmed one transfer at a time. Needs DMA mode and a core
+	 * that reports descriptor DMA support in GHWCFG4.
+	 * 0 - Buffer DMA (default)
+	 * 1 - Descriptor DMA, if available
+	 */
+	int32_t dma_desc_enable;
+#define dwc_param_dma_desc_enable_default 0
+
 	/** The DMA Burst size (applicable only for External DMA
 	 * Mode). 1, 4, 8 16, 32, 64, 128, 256 (default 32)
 	 */
@@ -616,6 +638,9 @@ typedef struct dwc_otg_core_if
 	/** 1 if DMA is enabled, 0 otherwise. */
 	uint8_t dma_enable;
 
+	/** 1 if device mode descriptor DMA is enabled, 0 otherwise. */
+	uint8_t dma_desc_enable;
+
 	/** 1 if dedicated Tx FIFOs are enabled, 0 otherwise. */
 	uint8_t en_multiple_tx_fifo;
 
@@ -707,6 +732,8 @@ extern void dwc_otg_ep0_activate(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep_activate(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep_deactivate(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
+extern void dwc_otg_ep_start_ddma_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
+extern void dwc_otg_ep_stop_ddma_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep0_start_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep0_continue_transfer(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep);
 extern void dwc_otg_ep_write_packet(dwc_otg_core_if_t *_core_if, dwc_ep_t *_ep, int _dma);
@@ -0,0 +1,326 @@
+/*
+ * dwc_otg_ddma.h - Device mode descriptor DMA for the DWC_otg core
+ *
+ * With DCFG.DescDMA set the core no longer takes a buffer address and a
+ * transfer size per endpoint.  DIEPDMAn/DOEPDMAn instead point at a list
+ * of two-word descriptors in system memory which the core's DMA engine
+ * walks on its own: each descriptor carries a buffer address and a byte
+ * count, and the core hands it back by setting its buffer status to
+ * DMA_DONE.  The endpoint stops at a descriptor marked L (last), and an
+ * interrupt is raised only for descriptors marked IOC.
+ *
+ * The helpers below build descriptor chains for usb_requests and read
+ * back their results.  They touch nothing but the descriptors, so the
+ * same code runs under tools/usb/dwc-ddma-sim.c, which models the DMA
+ * engine in user space.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#if !defined(__DWC_OTG_DDMA_H__)
+#define __DWC_OTG_DDMA_H__
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/errno.h>
+#else
+#include <stdint.h>
+#include <errno.h>
+#endif
+
+/** Descriptors in each endpoint's ring */
+#define DWC_DDMA_DESC_CNT	64
+/** Descriptors used by EP0: SETUP, IN data/status, OUT data/status */
+#define DWC_DDMA_EP0_DESC_CNT	3
+/** Largest byte count a single descriptor can carry */
+#define DWC_DDMA_MAX_BYTES	0xffff
+
+/**
+ * This union represents the quadlet holding the status of a device
+ * mode DMA descriptor (non-isochronous layout).
+ */
+typedef union dev_dma_desc_sts
+{
+	/** raw descriptor data */
+	uint32_t d32;
+	/** descriptor bits */
+	struct
+	{
+		/** Bytes to transfer; the core leaves the residue here */
+		unsigned bytes : 16;
+		unsigned nak : 1;
+		unsigned reserved17_22 : 6;
+		/** Multiple transfer: carry on past a short OUT packet */
+		unsigned mtrf : 1;
+		/** SETUP packet received (OUT EP0) */
+		unsigned sr : 1;
+		/** Interrupt on complete */
+		unsigned ioc : 1;
+		/** Short packet: IN - send one here, OUT - one was received */
+		unsigned sp : 1;
+		/** Last descriptor of the chain */
+		unsigned l : 1;
+		/** Receive/transmit status */
+		unsigned sts : 2;
+#define STS_SUCC	0
+#define STS_BUFFLUSH	1
+#define STS_BUFERR	3
+		/** Buffer status */
+		unsigned bs : 2;
+#define BS_HOST_READY	0
+#define BS_DMA_BUSY	1
+#define BS_DMA_DONE	2
+#define BS_HOST_BUSY	3
+	} b;
+} dev_dma_desc_sts_t;
+
+/**
+ * Device mode DMA descriptor, as read by the core.
+ */
+typedef struct dwc_otg_dma_desc
+{
+	/** Buffer status quadlet */
+	dev_dma_desc_sts_t status;
+	/** Buffer address */
+	uint32_t buf;
+} dwc_otg_dma_desc_t;
+
+/**
+ * The part of an endpoint's descriptor ring one request occupies.
+ */
+typedef struct dwc_otg_ddma_xfer
+{
+	/** Index of the request's first descriptor */
+	uint16_t first;
+	/** Number of descriptors, 0 while the request is not loaded */
+	uint16_t cnt;
+	/** Bytes programmed into the descriptors */
+	uint32_t len;
+} dwc_otg_ddma_xfer_t;
+
+/**
+ * Number of descriptors one DMA segment of a request needs.
+ *
+ * Every segment but the last must be a whole number of packets: the core
+ * ends a packet at the end of each descriptor.  A ZLP needed at the end
+ * of an IN request takes a descriptor of its own.
+ *
+ * @param _len Segment length in bytes.
+ * @param _mps Endpoint max packet size.
+ * @param _is_in Endpoint direction.
+ * @param _last This is the request's last segment.
+ * @param _zero The request asks for a terminating ZLP.
+ * @return the descriptor count, or -EINVAL for a misaligned segment.
+ */
+static inline int dwc_otg_ddma_seg_descs(uint32_t _len, unsigned _mps,
+					 int _is_in, int _last, int _zero)
+{
+	uint32_t chunk = (DWC_DDMA_MAX_BYTES / _mps) * _mps;
+	int cnt;
+
+	if (!_last && (_len == 0 || _len % _mps))
+	{
+		return -EINVAL;
+	}
+	cnt = _len ? (_len + chunk - 1) / chunk : 1;
+	if (_is_in && _last && _zero && _len && _len % _mps == 0)
+	{
+		cnt++;
+	}
+	return cnt;
+}
+
+/**
+ * Append the descriptors for one DMA segment of a request to an
+ * endpoint's ring.  The caller has checked the segment with
+ * dwc_otg_ddma_seg_descs().
+ *
+ * IN descriptors carry exactly the segment bytes and SP marks the short
+ * packet (or ZLP) that ends the request.  OUT descriptors are rounded up
+ * to whole packets, as DOEPTSIZn is in buffer DMA mode.
+ *
+ * @param _ring The endpoint's descriptor ring.
+ * @param _ring_cnt Number of descriptors in the ring.
+ * @param _xfer The request's place in the ring; cnt and len grow.
+ * @param _addr Bus address of the segment.
+ * @param _len Segment length in bytes.
+ * @param _mps Endpoint max packet size.
+ * @param _is_in Endpoint direction.
+ * @param _last This is the request's last segment.
+ * @param _zero The request asks for a terminating ZLP.
+ * @return 0, or -ENOSPC when the ring is full.
+ */
+static inline int dwc_otg_ddma_add_seg(dwc_otg_dma_desc_t *_ring, int _ring_cnt,
+				       dwc_otg_ddma_xfer_t *_xfer,
+				       uint32_t _addr, uint32_t _len,
+				       unsigned _mps, int _is_in,
+				       int _last, int _zero)
+{
+	uint32_t chunk = (DWC_DDMA_MAX_BYTES / _mps) * _mps;
+	uint32_t bytes = 0;
+	int i = _xfer->first + _xfer->cnt;
+	int zlp;
+
+	zlp = _is_in && _last && _zero && _len && _len % _mps == 0;
+	do
+	{
+		dev_dma_desc_sts_t sts = { .d32 = 0 };
+
+		if (i >= _ring_cnt)
+		{
+			return -ENOSPC;
+		}
+		bytes = _len > chunk ? chunk : _len;
+		if (_is_in)
+		{
+			sts.b.bytes = bytes;
+			sts.b.sp = _last && bytes == _len &&
+				(bytes == 0 || bytes % _mps != 0);
+		}
+		else
+		{
+			sts.b.bytes = bytes ? (bytes + _mps - 1) / _mps * _mps : _mps;
+		}
+		sts.b.bs = BS_HOST_READY;
+
+		_ring[i].buf = _addr;
+		_ring[i].status.d32 = sts.d32;
+		_xfer->len += sts.b.bytes;
+		_xfer->cnt++;
+		i++;
+
+		_addr += bytes;
+		_len -= bytes;
+	} while (_len);
+
+	if (zlp)
+	{
+		dev_dma_desc_sts_t sts = { .d32 = 0 };
+
+		if (i >= _ring_cnt)
+		{
+			return -ENOSPC;
+		}
+		sts.b.sp = 1;
+		sts.b.bs = BS_HOST_READY;
+		_ring[i].buf = _addr;
+		_ring[i].status.d32 = sts.d32;
+		_xfer->cnt++;
+	}
+	return 0;
+}
+
+/**
+ * Ask for an interrupt once the core is done with a request.
+ */
+static inline void dwc_otg_ddma_set_ioc(dwc_otg_dma_desc_t *_ring,
+					const dwc_otg_ddma_xfer_t *_xfer)
+{
+	_ring[_xfer->first + _xfer->cnt - 1].status.b.ioc = 1;
+}
+
+/**
+ * End the chain after a request: the core stops there, clears EPEna
+ * and raises XferCompl.
+ */
+static inline void dwc_otg_ddma_close(dwc_otg_dma_desc_t *_ring,
+				      const dwc_otg_ddma_xfer_t *_xfer)
+{
+	dev_dma_desc_sts_t *sts = &_ring[_xfer->first + _xfer->cnt - 1].status;
+
+	sts->b.l = 1;
+	sts->b.ioc = 1;
+}
+
+/**
+ * Read back how far the core got with a request.
+ *
+ * A short OUT packet closes its descriptor with SP set and finishes the
+ * request there; as MTRF is never set the core also stops the chain, so
+ * the request's remaining descriptors are left untouched.  A descriptor
+ * closed with bytes left and no short packet was cut off by disabling
+ * the EP, which likewise ends the request.
+ *
+ * @param _ring The endpoint's descriptor ring.
+ * @param _xfer The request's place in the ring.
+ * @param _is_in Endpoint direction.
+ * @param _actual Returns the bytes moved.
+ * @return 1 when the request is finished, 0 while the core still owns
+ * part of it, -EIO when a descriptor was closed with an error,
+ * -ECONNRESET when the request was cut off.
+ */
+static inline int dwc_otg_ddma_xfer_done(const dwc_otg_dma_desc_t *_ring,
+					 const dwc_otg_ddma_xfer_t *_xfer,
+					 int _is_in, uint32_t *_actual)
+{
+	uint32_t remain = 0;
+	int ret = 1;
+	int i;
+
+	*_actual = 0;
+	for (i = 0; i < _xfer->cnt; i++)
+	{
+		dev_dma_desc_sts_t sts = _ring[_xfer->first + i].status;
+
+		if (sts.b.bs != BS_DMA_DONE)
+		{
+			return 0;
+		}
+		if (sts.b.sts != STS_SUCC)
+		{
+			return -EIO;
+		}
+		remain += sts.b.bytes;
+		if ((!_is_in && sts.b.sp) || sts.b.bytes)
+		{
+			if (_is_in || !sts.b.sp)
+			{
+				ret = -ECONNRESET;
+			}
+			for (i++; i < _xfer->cnt; i++)
+			{
+				remain += _ring[_xfer->first + i].status.b.bytes;
+			}
+			break;
+		}
+	}
+	*_actual = _xfer->len - remain;
+	return ret;
+}
+
+/**
+ * Read back how far the core got with a request whose EP was disabled
+ * part way through the chain.  Descriptors the core closed hold their
+ * residue, and those it never reached still hold the byte counts they
+ * were given.
+ *
+ * @param _ring The endpoint's descriptor ring.
+ * @param _xfer The request's place in the ring.
+ * @param _actual Returns the bytes moved.
+ * @return 1 when the core reached the request, 0 when it did not.
+ */
+static inline int dwc_otg_ddma_xfer_stopped(const dwc_otg_dma_desc_t *_ring,
+					    const dwc_otg_ddma_xfer_t *_xfer,
+					    uint32_t *_actual)
+{
+	uint32_t remain = 0;
+	int reached = 0;
+	int i;
+
+	for (i = 0; i < _xfer->cnt; i++)
+	{
+		dev_dma_desc_sts_t sts = _ring[_xfer->first + i].status;
+
+		if (sts.b.bs != BS_HOST_READY)
+		{
+			reached = 1;
+		}
+		remain += sts.b.bytes;
+	}
+	*_actual = remain < _xfer->len ? _xfer->len - remain : 0;
+	return reached;
+}
+
+#endif /* __DWC_OTG_DDMA_H__ */
@@ -89,6 +89,7 @@ static dwc_otg_core_params_t dwc_otg_module_params = {
 	.opt = -1,
 	.otg_cap = -1,
 	.dma_enable = -1,
+	.dma_desc_enable = -1,
 	.dma_burst_size = -1,
 	.speed = -1,
 	.host_support_fs_ls_low_power = -1,
@@ -162,6 +163,7 @@ static dwc_otg_core_params_t host11_module_params = {
 	.opt = -1,
 	.otg_cap = -1,
 	.dma_enable = -1,
+	.dma_desc_enable = -1,
 	.dma_burst_size = -1,
 	.speed = -1,
 	.host_support_fs_ls_low_power = 1,
@@ -235,6 +237,7 @@ static dwc_otg_core_params_t host20_module_params = {
 	.opt = -1,
 	.otg_cap = -1,
 	.dma_enable = -1,
+	.dma_desc_enable = -1,
 	.dma_burst_size = -1,
 	.speed = -1,
 	.host_support_fs_ls_low_power = -1,
@@ -716,6 +719,7 @@ static int check_parameters(dwc_otg_core_if_t *core_if)
 	DWC_OTG_PARAM_ERR(opt,0,1,"opt");
 	DWC_OTG_PARAM_ERR(otg_cap,0,2,"otg_cap");
 	DWC_OTG_PARAM_ERR(dma_enable,0,1,"dma_enable");
+	DWC_OTG_PARAM_ERR(dma_desc_enable,0,1,"dma_desc_enable");
 	DWC_OTG_PARAM_ERR(speed,0,1,"speed");
 	DWC_OTG_PARAM_ERR(host_support_fs_ls_low_power,0,1,"host_support_fs_ls_low_power");
 	DWC_OTG_PARAM_ERR(host_ls_low_power_phy_clk,0,1,"host_ls_low_power_phy_clk");
@@ -878,6 +882,11 @@ static int check_parameters(dwc_otg_core_if_t *core_if)
 				((core_params->dma_enable == 1) && (core_if->hwcfg2.b.architecture == 0)) ? 0 : 1, 
 				0);
 
+	retval += DWC_OTG_PARAM_CHECK_VALID(dma_desc_enable,"dma_desc_enable",
+				((core_params->dma_desc_enable == 1) && 
+				 ((core_params->dma_enable == 0) || (core_if->hwcfg4.b.desc_dma == 0))) ? 0 : 1, 
+				0);
+
 	retval += DWC_OTG_PARAM_CHECK_VALID(opt,"opt",
 				1,
 				0);
@@ -2297,6 +2306,8 @@ module_param_named(opt, dwc_otg_module_params.opt, int, 0444);
 MODULE_PARM_DESC(opt, "OPT Mode");
 module_param_named(dma_enable, dwc_otg_module_params.dma_enable, int, 0444);
 MODULE_PARM_DESC(dma_enable, "DMA Mode 0=Slave 1=DMA enabled");
+module_param_named(dma_desc_enable, dwc_otg_module_params.dma_desc_enable, int, 0444);
+MODULE_PARM_DESC(dma_desc_enable, "Device DMA Mode 0=Buffer DMA 1=Descriptor DMA");
 module_param_named(dma_burst_size, dwc_otg_module_params.dma_burst_size, int, 0444);
 MODULE_PARM_DESC(dma_burst_size, "DMA Burst Size 1, 4, 8, 16, 32, 64, 128, 256");
 module_param_named(speed, dwc_otg_module_params.speed, int, 0444);
@@ -2445,6 +2456,16 @@ MODULE_PARM_DESC(rx_thr_length, "Rx Threshold length in 32 bit DWORDs");
  - 1: DMA (default, if available)
  </td></tr>
  
+ <tr>
+ <td>dma_desc_enable</td>
+ <td>Specifies whether device mode uses descriptor DMA, letting the core
+ work through chains of transfers and scatter-gather requests without an
+ interrupt per transfer. Requires DMA mode and a core built with descriptor
+ DMA support; otherwise buffer DMA is used.
+ - 0: Buffer DMA (default)
+ - 1: Descriptor DMA, if available
+ </td></tr>
+ 
  <tr>
  <td>dma_burst_size</td>
  <td>The DMA Burst size (applicable only for External DMA Mode).
@@ -117,6 +117,14 @@ void request_done(dwc_otg_pcd_ep_t *_ep, dwc_otg_pcd_request_t *_req,
 	{	
 		_status = _req->req.status;
 	}
+	_req->xfer.cnt = 0;
+	if (_req->req.num_mapped_sgs) 
+	{
+		dma_unmap_sg(_ep->pcd->gadget.dev.parent, 
+			_req->req.sg, _req->req.num_sgs, 
+			_ep->dwc_ep.is_in ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+		_req->req.num_mapped_sgs = 0;
+	}
 #if 0
 
 		if (_req->mapped) {
@@ -164,6 +172,8 @@ void request_nuke( dwc_otg_pcd_ep_t *_ep )
 				 queue);
 		request_done(_ep, req, -ESHUTDOWN );
 	}
+	/* any descriptor chain went with the requests */
+	_ep->dwc_ep.desc_cnt = 0;
 }
 
 /* USB Endpoint Operations */
@@ -528,6 +538,38 @@ static void dwc_otg_pcd_free_buffer(struct usb_ep *_ep, void *_buf,
 	}
 }
 #endif
+/**
+ * This function counts the descriptors a request needs in descriptor
+ * DMA mode, and checks that its scatterlist splits into whole packets.
+ *
+ * @return the descriptor count or -EINVAL.
+ */
+static int pcd_ddma_count(dwc_otg_pcd_ep_t *_ep, dwc_otg_pcd_request_t *_req)
+{
+	struct scatterlist *sg;
+	int need = 0;
+	int i, n;
+
+	if (!_req->req.num_mapped_sgs) 
+	{
+		return dwc_otg_ddma_seg_descs(_req->req.length, _ep->dwc_ep.maxpacket, 
+					_ep->dwc_ep.is_in, 1, _req->req.zero);
+	}
+
+	for_each_sg(_req->req.sg, sg, _req->req.num_mapped_sgs, i) 
+	{
+		n = dwc_otg_ddma_seg_descs(sg_dma_len(sg), _ep->dwc_ep.maxpacket, 
+					_ep->dwc_ep.is_in, 
+					i == _req->req.num_mapped_sgs - 1, _req->req.zero);
+		if (n < 0) 
+		{
+			return n;
+		}
+		need += n;
+	}
+	return need;
+}
+
 /**
  * This function is used to submit an I/O Request to an EP.
  *
@@ -555,7 +597,7 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 				__func__, _ep, _req, _gfp_flags);
         
 	req = container_of(_req, dwc_otg_pcd_request_t, req);
-	if (!_req || !_req->complete || !_req->buf ) 
+	if (!_req || !_req->complete || (!_req->buf && !_req->num_sgs)) 
 	{
 		DWC_WARN("%s, bad params\n", __func__);
 		return -EINVAL;
@@ -585,6 +627,12 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 		DWC_WARN("%s, bogus device state\n", __func__);
 		return -ESHUTDOWN;
 	}
+	if (_req->num_sgs && 
+		(!GET_CORE_IF(pcd)->dma_desc_enable || ep->dwc_ep.num == 0)) 
+	{
+		DWC_WARN("%s, %s can't do scatter-gather\n", __func__, _ep->name);
+		return -EINVAL;
+	}
 
 
 	DWC_DEBUGPL(DBG_PCD, "%s queue req %p, len %d buf %p\n",
@@ -605,7 +653,17 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 	dump_msg(_req->buf, _req->length);
 #endif	
 	/* map virtual address to hardware */
-	if (req->req.dma == DMA_ADDR_INVALID) {
+	if (req->req.num_sgs) {
+		req->req.num_mapped_sgs = dma_map_sg(ep->pcd->gadget.dev.parent,
+					req->req.sg, req->req.num_sgs,
+					ep->dwc_ep.is_in
+						? DMA_TO_DEVICE
+						: DMA_FROM_DEVICE);
+		if (req->req.num_mapped_sgs == 0) {
+			SPIN_UNLOCK_IRQRESTORE(&pcd->lock, flags);
+			return -EAGAIN;
+		}
+	} else if (req->req.dma == DMA_ADDR_INVALID) {
 		req->req.dma = dma_map_single(ep->pcd->gadget.dev.parent,
 					req->req.buf,
 					req->req.length, ep->dwc_ep.is_in
@@ -623,6 +681,28 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 	_req->status = -EINPROGRESS;
 	_req->actual = 0;
 
+	if (ep->dwc_ep.num != 0 && GET_CORE_IF(pcd)->dma_desc_enable) 
+	{
+		int need = pcd_ddma_count(ep, req);
+
+		if (need < 0 || need > DWC_DDMA_DESC_CNT) 
+		{
+			DWC_WARN("%s, %s request doesn't fit the descriptor ring\n",
+				__func__, _ep->name);
+			if (req->req.num_mapped_sgs) 
+			{
+				dma_unmap_sg(ep->pcd->gadget.dev.parent, 
+					req->req.sg, req->req.num_sgs, 
+					ep->dwc_ep.is_in ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+				req->req.num_mapped_sgs = 0;
+			}
+			SPIN_UNLOCK_IRQRESTORE(&pcd->lock, flags);
+			return -EINVAL;
+		}
+		req->desc_need = need;
+		req->xfer.cnt = 0;
+	}
+
 	/* 
 	 * For EP0 IN without premature status, zlp is required?
 	 */
@@ -675,7 +755,7 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 			dwc_otg_ep0_start_transfer( GET_CORE_IF(pcd), 
 										&ep->dwc_ep );
 		} 
-		else 
+		else if (!GET_CORE_IF(pcd)->dma_desc_enable) 
 		{
 			/* Setup and start the Transfer */
 			ep->dwc_ep.dma_addr = _req->dma;
@@ -694,6 +774,11 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 	{
 		++pcd->request_pending;
 		list_add_tail(&req->queue, &ep->queue);
+		if (ep->dwc_ep.num != 0 && GET_CORE_IF(pcd)->dma_desc_enable) 
+		{
+			/* starts a chain unless one is running already */
+			dwc_otg_pcd_start_ddma_chain(ep);
+		}
 		if (ep->dwc_ep.is_in && ep->stopped && !(GET_CORE_IF(pcd)->dma_enable)) 
 		{
 			/** @todo NGS Create a function for this. */
@@ -707,6 +792,66 @@ static int dwc_otg_pcd_ep_queue(struct usb_ep *_ep,
 	return 0;
 }
 
+/**
+ * This function takes a request out of the running descriptor chain in
+ * descriptor DMA mode.  The core can't be told to skip descriptors, so
+ * the EP is stopped and the whole chain retired: requests the core
+ * finished complete as usual, the dequeued one and any the core was
+ * part way through complete with -ECONNRESET and the bytes moved, and
+ * those it never reached go out again in a new chain.  The results are
+ * read back before any completion runs, as the callbacks may queue.
+ *
+ * @param _ep The EP.
+ * @param _req The request being dequeued.
+ */
+static void pcd_ddma_dequeue(dwc_otg_pcd_ep_t *_ep, dwc_otg_pcd_request_t *_req)
+{
+	dwc_ep_t *dwc_ep = &_ep->dwc_ep;
+	dwc_otg_pcd_request_t *req, *tmp;
+	LIST_HEAD(retired);
+	uint32_t actual;
+	int ret;
+
+	dwc_otg_ep_stop_ddma_transfer(GET_CORE_IF(_ep->pcd), dwc_ep);
+
+	list_for_each_entry_safe(req, tmp, &_ep->queue, queue) 
+	{
+		if (req->xfer.cnt == 0) 
+		{
+			/* the rest of the queue wasn't in the chain */
+			break;
+		}
+		ret = dwc_otg_ddma_xfer_done(dwc_ep->desc_addr, &req->xfer, 
+					dwc_ep->is_in, &actual);
+		if (ret == 0) 
+		{
+			if (!dwc_otg_ddma_xfer_stopped(dwc_ep->desc_addr, 
+					&req->xfer, &actual) && req != _req) 
+			{
+				req->xfer.cnt = 0;
+				continue;
+			}
+			ret = -ECONNRESET;
+		}
+		else if (req == _req) 
+		{
+			ret = -ECONNRESET;
+		}
+		req->req.actual = min_t(uint32_t, actual, req->req.length);
+		req->req.status = ret < 0 ? ret : 0;
+		list_move_tail(&req->queue, &retired);
+	}
+
+	dwc_ep->desc_cnt = 0;
+	dwc_otg_pcd_start_ddma_chain(_ep);
+
+	while (!list_empty(&retired)) 
+	{
+		req = list_entry(retired.next, dwc_otg_pcd_request_t, queue);
+		request_done(_ep, req, req->req.status);
+	}
+}
+
 /**
  * This function cancels an I/O request from an EP.
  */
@@ -755,7 +900,15 @@ static int dwc_otg_pcd_ep_dequeue(struct usb_ep *_ep,
 
 	if (!list_empty(&req->queue)) 
 	{		 
-		request_done(ep, req, -ECONNRESET);
+		if (req->xfer.cnt && ep->dwc_ep.num != 0 && 
+			GET_CORE_IF(pcd)->dma_desc_enable) 
+		{
+			pcd_ddma_dequeue(ep, req);
+		}
+		else 
+		{
+			request_done(ep, req, -ECONNRESET);
+		}
 	} 
 	else 
 	{
@@ -1323,6 +1476,59 @@ static struct tasklet_struct start_xfer_tasklet = {
 	.func = start_xfer_tasklet_func,
 	.data = 0,//pcd
 };
+/**
+ * This function points an EP at its part of the descriptor DMA rings.
+ *
+ * @param _pcd the pcd structure.
+ * @param _ep the EP.
+ * @param _first index of the EP's first descriptor.
+ */
+static void pcd_ep_set_desc(dwc_otg_pcd_t *_pcd, dwc_otg_pcd_ep_t *_ep, int _first)
+{
+	_ep->dwc_ep.desc_cnt = 0;
+	if (_pcd->desc_ring == 0) 
+	{
+		_ep->dwc_ep.desc_addr = 0;
+		_ep->dwc_ep.dma_desc_addr = 0;
+		return;
+	}
+	_ep->dwc_ep.desc_addr = _pcd->desc_ring + _first;
+	_ep->dwc_ep.dma_desc_addr = _pcd->desc_ring_dma_handle + 
+		_first * sizeof(dwc_otg_dma_desc_t);
+}
+
+/**
+ * This function allocates the descriptor DMA rings for EP0 and all IN
+ * and OUT EPs.  If that fails the driver falls back to buffer DMA.
+ *
+ * @param _pcd the pcd structure.
+ */
+static void pcd_alloc_desc_ring(dwc_otg_pcd_t *_pcd)
+{
+	dwc_otg_core_if_t *core_if = GET_CORE_IF(_pcd);
+
+	if (!core_if->dma_desc_enable) 
+	{
+		return;
+	}
+
+	_pcd->desc_ring_size = sizeof(dwc_otg_dma_desc_t) * 
+		(DWC_DDMA_EP0_DESC_CNT + DWC_DDMA_DESC_CNT * 
+		 (core_if->dev_if->num_in_eps + core_if->dev_if->num_out_eps));
+	_pcd->desc_ring = dma_alloc_coherent (NULL, _pcd->desc_ring_size, 
+				&_pcd->desc_ring_dma_handle, GFP_KERNEL);
+	if (_pcd->desc_ring == 0) 
+	{
+		DWC_WARN("%s() descriptor DMA disabled, no memory for %zu bytes\n",
+				__func__, _pcd->desc_ring_size);
+		core_if->core_params->dma_desc_enable = 0;
+		core_if->dma_desc_enable = 0;
+		return;
+	}
+	memset(_pcd->desc_ring, 0, _pcd->desc_ring_size);
+	_pcd->gadget.sg_supported = 1;
+}
+
 /**
  * This function initialized the pcd Dp structures to there default
  * state.
@@ -1409,6 +1615,7 @@ void dwc_otg_pcd_reinit(dwc_otg_pcd_t *_pcd)
 	ep->dwc_ep.xfer_count = 0;
 	ep->dwc_ep.sent_zlp = 0;
 	ep->dwc_ep.total_len = 0;
+	pcd_ep_set_desc(_pcd, ep, 1);
 	ep->queue_sof = 0;
 
 	/* Init the usb_ep structure. */
@@ -1458,6 +1665,8 @@ void dwc_otg_pcd_reinit(dwc_otg_pcd_t *_pcd)
 			ep->dwc_ep.xfer_count = 0;
 			ep->dwc_ep.sent_zlp = 0;
 			ep->dwc_ep.total_len = 0;
+			pcd_ep_set_desc(_pcd, ep, DWC_DDMA_EP0_DESC_CNT + 
+				(in_ep_cntr - 1) * DWC_DDMA_DESC_CNT);
 			ep->queue_sof = 0;
 	
 			/* Init the usb_ep structure. */
@@ -1511,6 +1720,8 @@ void dwc_otg_pcd_reinit(dwc_otg_pcd_t *_pcd)
 			ep->dwc_ep.xfer_count = 0;
 			ep->dwc_ep.sent_zlp = 0;
 			ep->dwc_ep.total_len = 0;
+			pcd_ep_set_desc(_pcd, ep, DWC_DDMA_EP0_DESC_CNT + 
+				(num_in_eps + out_ep_cntr - 1) * DWC_DDMA_DESC_CNT);
 			ep->queue_sof = 0;
 	
 			/* Init the usb_ep structure. */
@@ -1871,13 +2082,15 @@ int dwc_otg_pcd_init(struct device *dev)
 	/*
 	 * Initialize EP structures
 	 */
+	pcd_alloc_desc_ring( pcd );
 	dwc_otg_pcd_reinit( pcd );
 	/* 
 	 * Initialize the DMA buffer for SETUP packets
 	 */
 	if (GET_CORE_IF(pcd)->dma_enable) 
 	{
-		pcd->setup_pkt = dma_alloc_coherent (NULL, sizeof (*pcd->setup_pkt) * 5, &pcd->setup_pkt_dma_handle, 0);
+		/* a whole EP0 packet, the size of the SETUP descriptor's buffer */
+		pcd->setup_pkt = dma_alloc_coherent (NULL, sizeof (*pcd->setup_pkt) * 8, &pcd->setup_pkt_dma_handle, 0);
 		pcd->status_buf = dma_alloc_coherent (NULL, sizeof (uint16_t), &pcd->status_buf_dma_handle, 0);
 	}
 	else 
@@ -1939,7 +2152,7 @@ void dwc_otg_pcd_remove( struct device *dev )
 		
 	if (GET_CORE_IF(pcd)->dma_enable) 
 	{
-		dma_free_coherent (NULL, sizeof (*pcd->setup_pkt) * 5, pcd->setup_pkt, pcd->setup_pkt_dma_handle);
+		dma_free_coherent (NULL, sizeof (*pcd->setup_pkt) * 8, pcd->setup_pkt, pcd->setup_pkt_dma_handle);
 		dma_free_coherent (NULL, sizeof (uint16_t), pcd->status_buf, pcd->status_buf_dma_handle);
 	}
 	else 
@@ -1947,6 +2160,10 @@ void dwc_otg_pcd_remove( struct device *dev )
 		kfree (pcd->setup_pkt);
 		kfree (pcd->status_buf);
 	}
+	if (pcd->desc_ring) 
+	{
+		dma_free_coherent (NULL, pcd->desc_ring_size, pcd->desc_ring, pcd->desc_ring_dma_handle);
+	}
 	
 	kfree( pcd );
 	otg_dev->pcd = 0;
@@ -163,6 +163,14 @@ typedef struct dwc_otg_pcd
 	uint16_t *status_buf;
 	dma_addr_t status_buf_dma_handle;
 
+	/** Descriptor DMA rings: the SETUP descriptor, EP0's IN and OUT
+	 * descriptors, then DWC_DDMA_DESC_CNT descriptors for each IN and
+	 * each OUT EP.  Null in buffer DMA and slave mode.
+	 */
+	dwc_otg_dma_desc_t *desc_ring;
+	dma_addr_t desc_ring_dma_handle;
+	size_t desc_ring_size;
+
 	/** Array of EPs. */
 	dwc_otg_pcd_ep_t ep0; 
 	/** Array of IN EPs. */
@@ -216,6 +224,10 @@ typedef struct dwc_otg_pcd_request
 	struct usb_request	req; /**< USB Request. */
 	struct list_head	queue;	/**< queue of these requests. */
 	unsigned int		mapped:1;
+	/** Descriptors the request needs in descriptor DMA mode */
+	unsigned int		desc_need;
+	/** Where the request sits in the EP's descriptor chain */
+	dwc_otg_ddma_xfer_t	xfer;
 } dwc_otg_pcd_request_t;
 
 
@@ -224,6 +236,7 @@ extern int /*__init*/ dwc_otg_pcd_init(struct device *dev);
 //extern void dwc_otg_pcd_remove( struct dwc_otg_device *_otg_dev );
 extern void dwc_otg_pcd_remove( struct device *dev );
 extern int32_t dwc_otg_pcd_handle_intr( dwc_otg_pcd_t *_pcd );
+extern void dwc_otg_pcd_start_ddma_chain( dwc_otg_pcd_ep_t *_ep );
 extern void dwc_otg_pcd_start_srp_timer(dwc_otg_pcd_t *_pcd );
 
 extern void dwc_otg_pcd_initiate_srp(dwc_otg_pcd_t *_pcd);
@@ -168,6 +168,12 @@ void start_next_request( dwc_otg_pcd_ep_t *_ep )
 {
 	dwc_otg_pcd_request_t *req = 0;
 		
+	if (GET_CORE_IF(_ep->pcd)->dma_desc_enable && _ep->dwc_ep.num != 0) 
+	{
+		dwc_otg_pcd_start_ddma_chain( _ep );
+		return;
+	}
+
 	if (!list_empty(&_ep->queue))
 	{
 		req = list_entry(_ep->queue.next, 
@@ -189,6 +195,75 @@ void start_next_request( dwc_otg_pcd_ep_t *_ep )
 	}
 }
 
+/**
+ * This function starts a descriptor chain in descriptor DMA mode.  As
+ * many queued requests as fit in the EP's descriptor ring are loaded
+ * and the core works through them without the CPU.  The chain ends
+ * with the only descriptor marked IOC on an IN EP, so a whole chain of
+ * IN requests costs one interrupt.  OUT requests each get IOC: they end
+ * on short packets, and one may be the last the host sends for a while.
+ *
+ * Requests queued while a chain runs wait for the next one.
+ */
+void dwc_otg_pcd_start_ddma_chain( dwc_otg_pcd_ep_t *_ep )
+{
+	dwc_ep_t *dwc_ep = &_ep->dwc_ep;
+	dwc_otg_pcd_request_t *req;
+	dwc_otg_pcd_request_t *last = 0;
+	struct scatterlist *sg;
+	int used = 0;
+	int i;
+
+	if (dwc_ep->desc_cnt || _ep->stopped || dwc_ep->desc_addr == 0) 
+	{
+		return;
+	}
+
+	list_for_each_entry(req, &_ep->queue, queue) 
+	{
+		if (used + req->desc_need > DWC_DDMA_DESC_CNT) 
+		{
+			break;
+		}
+
+		req->xfer.first = used;
+		req->xfer.cnt = 0;
+		req->xfer.len = 0;
+		if (req->req.num_mapped_sgs) 
+		{
+			for_each_sg(req->req.sg, sg, req->req.num_mapped_sgs, i) 
+			{
+				dwc_otg_ddma_add_seg(dwc_ep->desc_addr, DWC_DDMA_DESC_CNT, 
+					&req->xfer, sg_dma_address(sg), sg_dma_len(sg), 
+					dwc_ep->maxpacket, dwc_ep->is_in, 
+					i == req->req.num_mapped_sgs - 1, req->req.zero);
+			}
+		} 
+		else 
+		{
+			dwc_otg_ddma_add_seg(dwc_ep->desc_addr, DWC_DDMA_DESC_CNT, 
+				&req->xfer, req->req.dma, req->req.length, 
+				dwc_ep->maxpacket, dwc_ep->is_in, 1, req->req.zero);
+		}
+		if (!dwc_ep->is_in) 
+		{
+			dwc_otg_ddma_set_ioc(dwc_ep->desc_addr, &req->xfer);
+		}
+		used += req->xfer.cnt;
+		last = req;
+	}
+
+	if (last == 0) 
+	{
+		return;
+	}
+	dwc_otg_ddma_close(dwc_ep->desc_addr, &last->xfer);
+	dwc_ep->desc_cnt = used;
+
+	DWC_DEBUGPL(DBG_PCD, "%s chain of %d descriptors\n", _ep->ep.name, used);
+	dwc_otg_ep_start_transfer( GET_CORE_IF(_ep->pcd), dwc_ep );
+}
+
 /**
  * This function handles the SOF Interrupts. At this time the SOF
  * Interrupt is disabled.
@@ -685,7 +760,28 @@ static inline void ep0_out_start( dwc_otg_core_if_t *_core_if, dwc_otg_pcd_t *_p
 	dwc_write_reg32( &dev_if->out_ep_regs[0]->doeptsiz, 
 					 doeptsize0.d32 );		 
 
-	if (_core_if->dma_enable) 
+	if (_core_if->dma_desc_enable) 
+	{
+		dwc_otg_dma_desc_t *desc = _pcd->desc_ring;
+		dev_dma_desc_sts_t sts = { .d32 = 0 };
+		depctl_data_t doepctl = { .d32 = 0 };
+
+		/* SETUP descriptor, first in the PCD's descriptor block */
+		sts.b.bytes = MAX_EP0_SIZE;
+		sts.b.l = 1;
+		sts.b.ioc = 1;
+		sts.b.bs = BS_HOST_READY;
+		desc->buf = _pcd->setup_pkt_dma_handle;
+		desc->status.d32 = sts.d32;
+
+		dwc_write_reg32(&dev_if->out_ep_regs[0]->doepdma, 
+		_pcd->desc_ring_dma_handle);
+		// EP enable
+		doepctl.d32 = 0x80008000;
+				dwc_write_reg32(&dev_if->out_ep_regs[0]->doepctl,
+				doepctl.d32);
+	}
+	else if (_core_if->dma_enable) 
 	{
 		depctl_data_t doepctl = { .d32 = 0 };
 		/** @todo dma needs to handle multiple setup packets (up to 3) */
@@ -784,6 +880,12 @@ int32_t dwc_otg_pcd_handle_usb_reset_intr( dwc_otg_pcd_t * _pcd)
 	diepmsk.b.epdisabled = 1;
 	diepmsk.b.ahberr = 1;
 	diepmsk.b.intknepmis = 1;
+	if (core_if->dma_desc_enable) 
+	{
+		doepmsk.b.bna = 1;
+		diepmsk.b.bna = 1;
+		dwc_write_reg32( &dev_if->dev_global_regs->doepmsk, doepmsk.d32 );
+	}
 	dwc_write_reg32( &dev_if->dev_global_regs->diepmsk, diepmsk.d32 );		 
 	/* Reset Device Address */
 	dcfg.d32 = dwc_read_reg32( &dev_if->dev_global_regs->dcfg);
@@ -1464,7 +1566,8 @@ static inline void pcd_setup( dwc_otg_pcd_t *_pcd )
 	doeptsize0.d32 = dwc_read_reg32( &dev_if->out_ep_regs[0]->doeptsiz );
 
 	/** @todo handle > 1 setup packet , assert error for now */
-	if (core_if->dma_enable && (doeptsize0.b.supcnt < 2)) 
+	if (core_if->dma_enable && !core_if->dma_desc_enable && 
+		(doeptsize0.b.supcnt < 2)) 
 	{
 		DWC_ERROR ("\n\n-----------	 CANNOT handle > 1 setup packet in DMA mode\n\n");
 	}
@@ -1672,6 +1775,15 @@ static int32_t ep0_complete_request( dwc_otg_pcd_ep_t *_ep )
 						deptsiz.b.xfersize, 
 						deptsiz.b.pktcnt);
 #endif
+		if (core_if->dma_desc_enable) 
+		{
+			/* the OUT descriptor holds what is left of the data stage */
+			dwc_ep_t *dwc_ep = &_ep->dwc_ep;
+			uint32_t mps = dwc_ep->maxpacket;
+			uint32_t len = dwc_ep->xfer_len ? roundup(dwc_ep->xfer_len, mps) : mps;
+			len -= dwc_ep->desc_addr[1].status.b.bytes;
+			dwc_ep->xfer_count = min_t(uint32_t, len, dwc_ep->xfer_len);
+		}
 		req->req.actual = _ep->dwc_ep.xfer_count;
 		
 		/* Is a Zero Len Packet needed? */
@@ -1791,6 +1903,66 @@ static void complete_ep( dwc_otg_pcd_ep_t *_ep )
 	}
 }
 
+/**
+ * This function completes the requests the core is done with in
+ * descriptor DMA mode.  Once the chain has stopped, the requests it did
+ * not reach and those queued since go out in a new chain.
+ *
+ * @param _ep The EP.
+ * @param _halted The core stopped before the end of the chain (BNA).
+ */
+static void complete_ddma_ep( dwc_otg_pcd_ep_t *_ep, int _halted )
+{
+	dwc_otg_core_if_t *core_if = GET_CORE_IF(_ep->pcd);
+	dwc_otg_dev_if_t *dev_if = core_if->dev_if;
+	dwc_ep_t *dwc_ep = &_ep->dwc_ep;
+	dwc_otg_pcd_request_t *req;
+	depctl_data_t depctl;
+	uint32_t actual;
+	int ret;
+
+	while (!list_empty(&_ep->queue)) 
+	{
+		req = list_entry(_ep->queue.next, dwc_otg_pcd_request_t, queue);
+		if (req->xfer.cnt == 0) 
+		{
+			break;
+		}
+		ret = dwc_otg_ddma_xfer_done(dwc_ep->desc_addr, &req->xfer, 
+					dwc_ep->is_in, &actual);
+		if (ret == 0) 
+		{
+			break;
+		}
+		req->req.actual = min_t(uint32_t, actual, req->req.length);
+		request_done(_ep, req, ret < 0 ? ret : 0);
+	}
+
+	if (dwc_ep->desc_cnt && !_halted) 
+	{
+		/* the core clears EPEna when it stops */
+		if (dwc_ep->is_in) 
+		{
+			depctl.d32 = dwc_read_reg32(&dev_if->in_ep_regs[dwc_ep->num]->diepctl);
+		}
+		else 
+		{
+			depctl.d32 = dwc_read_reg32(&dev_if->out_ep_regs[dwc_ep->num]->doepctl);
+		}
+		if (depctl.b.epena) 
+		{
+			return;
+		}
+	}
+
+	list_for_each_entry(req, &_ep->queue, queue) 
+	{
+		req->xfer.cnt = 0;
+	}
+	dwc_ep->desc_cnt = 0;
+	dwc_otg_pcd_start_ddma_chain( _ep );
+}
+
 /**
  * This function handles EP0 Control transfers.	 
  *
@@ -2203,11 +2375,25 @@ do { \
 				{
 					handle_ep0( _pcd );
 				}
+				else if (core_if->dma_desc_enable) 
+				{
+					complete_ddma_ep( ep, 0 );
+				}
 				else 
 				{
 					complete_ep( ep );
 				}
 			}
+			/* Buffer Not Available (descriptor DMA) */
+			if ( diepint.b.bna ) 
+			{
+				DWC_DEBUGPL(DBG_ANY,"EP%d IN BNA\n", epnum);
+				CLEAR_IN_EP_INTR(core_if,epnum,bna);
+				if (epnum != 0) 
+				{
+					complete_ddma_ep( ep, 1 );
+				}
+			}
 			/* Endpoint disable	 */
 			if ( diepint.b.epdisabled ) 
 			{
@@ -2350,12 +2536,26 @@ do { \
 				{
 					handle_ep0( _pcd );
 				} 
+				else if (core_if->dma_desc_enable) 
+				{
+					complete_ddma_ep( get_out_ep(_pcd, epnum), 0 );
+				}
 				else 
 				{
 					complete_ep( get_out_ep(_pcd, epnum) );
 //						complete_ep( &_pcd->out_ep[ epnum - 1] );
 				}
 			}
+			/* Buffer Not Available (descriptor DMA) */
+			if ( doepint.b.bna ) 
+			{
+				DWC_DEBUGPL(DBG_ANY,"EP%d OUT BNA\n", epnum);
+				CLEAR_OUT_EP_INTR(core_if,epnum,bna);
+				if (epnum != 0) 
+				{
+					complete_ddma_ep( get_out_ep(_pcd, epnum), 1 );
+				}
+			}
 			/* Endpoint disable	 */
 			if ( doepint.b.epdisabled ) 
 			{
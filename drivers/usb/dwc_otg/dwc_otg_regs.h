@@ -771,7 +771,10 @@ typedef union hwcfg4_data
 		unsigned session_end_filt_en : 1;				 
 		unsigned ded_fifo_en : 1;
 		unsigned num_in_eps : 4;
-		unsigned reserved31_30 : 2;
+		/** Descriptor DMA supported */
+		unsigned desc_dma : 1;
+		/** Dynamic descriptor DMA mode supported */
+		unsigned desc_dma_dyn : 1;
 	} b;
 } hwcfg4_data_t;
 
@@ -859,6 +862,10 @@ typedef union dcfg_data
 		unsigned reserved13_17 : 5;
 		/** In Endpoint Mis-match count */
 		unsigned epmscnt : 4;
+		unsigned reserved22 : 1;
+		/** Enable Descriptor DMA (Scatter/Gather) mode */
+		unsigned descdma : 1;
+		unsigned reserved24_31 : 8;
 	} b;
 } dcfg_data_t;
 
@@ -959,8 +966,10 @@ typedef union diepint_data
 		unsigned emptyintr : 1;
 		
 		unsigned txfifoundrn : 1;
+		/** Buffer Not Available (descriptor DMA) */
+		unsigned bna : 1;
 
-		unsigned reserved08_31 : 23;
+		unsigned reserved10_31 : 22;
 		} b;
 } diepint_data_t;
 /**
@@ -991,7 +1000,18 @@ typedef union doepint_data
 		unsigned ahberr : 1;
 		/** Setup Phase Done (contorl EPs) */
 		unsigned setup : 1;
-		unsigned reserved04_31 : 28;
+		/** OUT Token Received when Endpoint Disabled */
+		unsigned outtknepdis : 1;
+		/** Status Phase Received for Control Write */
+		unsigned stsphsercvd : 1;
+		/** Back-to-Back SETUP Packets Received */
+		unsigned back2backsetup : 1;
+		unsigned reserved07 : 1;
+		/** OUT Packet Error */
+		unsigned outpkterr : 1;
+		/** Buffer Not Available (descriptor DMA) */
+		unsigned bna : 1;
+		unsigned reserved10_31 : 22;
 	} b;
 } doepint_data_t;
 /**
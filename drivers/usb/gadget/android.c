@@ -545,6 +545,8 @@ static int mass_storage_function_init(struct android_usb_function *f,
 	config->fsg.nluns = 2;
 	config->fsg.luns[0].removable = 1;
 	config->fsg.luns[1].removable = 1;
+	config->fsg.luns[0].direct = 1;
+	config->fsg.luns[1].direct = 1;
 
 	common = fsg_common_init(NULL, cdev, &config->fsg);
 	if (IS_ERR(common)) {
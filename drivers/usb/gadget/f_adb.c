@@ -26,11 +26,42 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/moduleparam.h>
+#include <linux/splice.h>
 
 #define ADB_BULK_BUFFER_SIZE           4096
 
-/* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+/* largest bulk request we try to allocate */
+#define ADB_BULK_BUFFER_MAX            (64 * 1024)
+
+/* number of tx and rx requests to allocate */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 8
+
+/*
+ * Size and number of the bulk requests.  They are read when the function
+ * is bound, so a change takes effect the next time the gadget is enabled.
+ * If buffers of the requested size can't be had, the size is halved down
+ * to ADB_BULK_BUFFER_SIZE before giving up.
+ *
+ * A read() may ask for up to adb_rx_reqs * adb_rx_req_len bytes; all the
+ * requests it needs are queued at once.
+ */
+static unsigned int adb_tx_req_len = 16384;
+module_param(adb_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_req_len, "ADB IN request size in bytes");
+
+static unsigned int adb_tx_reqs = 8;
+module_param(adb_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_reqs, "Number of ADB IN requests");
+
+static unsigned int adb_rx_req_len = 65536;
+module_param(adb_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_req_len, "ADB OUT request size in bytes");
+
+static unsigned int adb_rx_reqs = 4;
+module_param(adb_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_reqs, "Number of ADB OUT requests");
 
 static const char adb_shortname[] = "android_adb";
 
@@ -53,8 +84,19 @@ struct adb_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+	struct usb_request *rx_req[RX_REQ_MAX];
+
+	/* requests queued for the current read, and how many completed */
+	unsigned rx_armed;
+	atomic_t rx_completed;
+	/* where the data not yet copied to user space starts */
+	unsigned rx_head;
+	unsigned rx_off;
+
+	/* bulk request sizes and rx request count actually allocated */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned rx_reqs;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -204,13 +246,21 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	atomic_inc(&dev->rx_completed);
+	/* -ECONNRESET is a request we dequeued ourselves */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->error = 1;
 
 	wake_up(&dev->read_wq);
 }
 
+/* sanitize a requested bulk request size: whole 512 byte packets */
+static unsigned adb_bulk_req_len(unsigned len)
+{
+	len = clamp_t(unsigned, len, ADB_BULK_BUFFER_SIZE, ADB_BULK_BUFFER_MAX);
+	return len & ~511;
+}
+
 static int adb_create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -241,19 +291,41 @@ static int adb_create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
-
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, ADB_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->rx_req_len = adb_bulk_req_len(adb_rx_req_len);
+	dev->rx_reqs = clamp_t(unsigned, adb_rx_reqs, 1, RX_REQ_MAX);
+retry_rx:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = adb_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= ADB_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--)
+				adb_request_free(dev->rx_req[i], dev->ep_out);
+			dev->rx_req_len /= 2;
+			goto retry_rx;
+		}
+		req->complete = adb_complete_out;
+		dev->rx_req[i] = req;
+	}
+
+	dev->tx_req_len = adb_bulk_req_len(adb_tx_req_len);
+retry_tx:
+	for (i = 0; i < clamp_t(unsigned, adb_tx_reqs, 2, TX_REQ_MAX); i++) {
+		req = adb_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= ADB_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = adb_req_get(dev, &dev->tx_idle)))
+				adb_request_free(req, dev->ep_in);
+			dev->tx_req_len /= 2;
+			goto retry_tx;
+		}
 		req->complete = adb_complete_in;
 		adb_req_put(dev, &dev->tx_idle, req);
 	}
+	DBG(cdev, "%u x %u byte IN, %u x %u byte OUT requests\n",
+	    clamp_t(unsigned, adb_tx_reqs, 2, TX_REQ_MAX), dev->tx_req_len,
+	    dev->rx_reqs, dev->rx_req_len);
 
 	return 0;
 
@@ -262,26 +334,104 @@ fail:
 	return -1;
 }
 
+/* queue the rx requests for a read of count bytes */
+static int adb_rx_arm(struct adb_dev *dev, size_t count)
+{
+	struct usb_request *req;
+	int ret;
+
+	atomic_set(&dev->rx_completed, 0);
+	dev->rx_head = 0;
+	dev->rx_off = 0;
+	dev->rx_armed = 0;
+	while (count > 0) {
+		req = dev->rx_req[dev->rx_armed];
+		req->length = min_t(size_t, count, dev->rx_req_len);
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			pr_debug("adb_read: failed to queue req %p (%d)\n",
+				 req, ret);
+			return ret;
+		}
+		pr_debug("rx %p queue\n", req);
+		dev->rx_armed++;
+		count -= req->length;
+	}
+	return 0;
+}
+
+/*
+ * The armed read has its data: all its requests completed, or one of
+ * them ended with a short packet.  Requests complete in order.
+ */
+static int adb_rx_ready(struct adb_dev *dev)
+{
+	unsigned done = atomic_read(&dev->rx_completed);
+	unsigned i;
+
+	if (done >= dev->rx_armed)
+		return 1;
+	for (i = 0; i < done; i++)
+		if (dev->rx_req[i]->actual < dev->rx_req[i]->length)
+			return 1;
+	return 0;
+}
+
+/* dequeue the armed requests not completed yet and wait for them */
+static void adb_rx_dequeue(struct adb_dev *dev)
+{
+	unsigned i;
+
+	for (i = atomic_read(&dev->rx_completed); i < dev->rx_armed; i++)
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[i]);
+	wait_event_timeout(dev->read_wq,
+		atomic_read(&dev->rx_completed) >= dev->rx_armed,
+		msecs_to_jiffies(1000));
+}
+
+/* throw away the armed read and whatever it received */
+static void adb_rx_flush(struct adb_dev *dev)
+{
+	adb_rx_dequeue(dev);
+	dev->rx_armed = 0;
+}
+
+/*
+ * Like the other read paths, adb_read() reads no more than the caller asks
+ * for: the host doesn't end a transfer that fills whole packets with a
+ * ZLP, so a larger request would wait for the next transfer.  What can be
+ * overlapped is the caller's own work: a non-blocking read() queues the
+ * requests and returns -EAGAIN, poll() reports POLLIN once the data is in,
+ * and the next read() returns it.
+ */
 static ssize_t adb_read(struct file *fp, char __user *buf,
 				size_t count, loff_t *pos)
 {
 	struct adb_dev *dev = fp->private_data;
 	struct usb_request *req;
-	int r = count, xfer;
+	int nonblock = fp->f_flags & O_NONBLOCK;
+	ssize_t r = 0;
+	size_t xfer;
 	int ret;
 
 	pr_debug("adb_read(%d)\n", count);
 	if (!_adb_dev)
 		return -ENODEV;
 
-	if (count > ADB_BULK_BUFFER_SIZE)
+	if (count > dev->rx_reqs * dev->rx_req_len)
 		return -EINVAL;
+	if (count == 0)
+		return 0;
 
 	if (adb_lock(&dev->read_excl))
 		return -EBUSY;
 
 	/* we will block until we're online */
 	while (!(dev->online || dev->error)) {
+		if (nonblock) {
+			r = -EAGAIN;
+			goto done;
+		}
 		pr_debug("adb_read: waiting for online state\n");
 		ret = wait_event_interruptible(dev->read_wq,
 				(dev->online || dev->error));
@@ -292,57 +442,121 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 	}
 	if (dev->error) {
 		r = -EIO;
-		goto done;
+		goto flush;
 	}
 
 requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		pr_debug("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		dev->error = 1;
-		goto done;
-	} else {
-		pr_debug("rx %p queue\n", req);
+	/* queue the requests, unless an earlier read did */
+	if (!dev->rx_armed) {
+		ret = adb_rx_arm(dev, count);
+		if (ret < 0) {
+			r = -EIO;
+			dev->error = 1;
+			goto flush;
+		}
 	}
 
-	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
+	/* wait for them to complete */
+	if (nonblock && !adb_rx_ready(dev)) {
+		r = -EAGAIN;
+		goto done;
+	}
+	ret = wait_event_interruptible(dev->read_wq,
+			adb_rx_ready(dev) || dev->error);
 	if (ret < 0) {
 		dev->error = 1;
 		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
-		goto done;
+		goto flush;
+	}
+	if (dev->error) {
+		r = -EIO;
+		goto flush;
 	}
-	if (!dev->error) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
 
+	/* a short packet ended the transfer, nothing more is coming */
+	if (atomic_read(&dev->rx_completed) < dev->rx_armed)
+		adb_rx_dequeue(dev);
+
+	while (dev->rx_head < dev->rx_armed && r < count) {
+		req = dev->rx_req[dev->rx_head];
+		xfer = min_t(size_t, req->actual - dev->rx_off, count - r);
 		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
+		if (xfer && copy_to_user(buf + r, req->buf + dev->rx_off, xfer)) {
 			r = -EFAULT;
+			goto flush;
+		}
+		r += xfer;
+		dev->rx_off += xfer;
+		if (dev->rx_off < req->actual)
+			break;
 
-	} else
-		r = -EIO;
+		dev->rx_head++;
+		dev->rx_off = 0;
+		if (req->actual < req->length)
+			dev->rx_head = dev->rx_armed;
+	}
+	if (dev->rx_head == dev->rx_armed)
+		dev->rx_armed = 0;
+
+	/* If we got a 0-len packet, throw it back and try again. */
+	if (r == 0)
+		goto requeue_req;
+	goto done;
 
+flush:
+	if (dev->rx_armed)
+		adb_rx_flush(dev);
 done:
 	adb_unlock(&dev->read_excl);
 	pr_debug("adb_read returning %d\n", r);
 	return r;
 }
 
+/* get an idle tx request, waiting for one unless nonblock is set */
+static struct usb_request *adb_tx_get(struct adb_dev *dev, int nonblock)
+{
+	struct usb_request *req = 0;
+	int ret;
+
+	if (dev->error) {
+		pr_debug("adb_write dev->error\n");
+		return ERR_PTR(-EIO);
+	}
+	if (nonblock) {
+		req = adb_req_get(dev, &dev->tx_idle);
+		return req ? req : ERR_PTR(-EAGAIN);
+	}
+
+	ret = wait_event_interruptible(dev->write_wq,
+		(req = adb_req_get(dev, &dev->tx_idle)) || dev->error);
+	if (ret < 0)
+		return ERR_PTR(ret);
+	return req ? req : ERR_PTR(-EIO);
+}
+
+/* queue a filled tx request; it goes back to tx_idle on failure */
+static int adb_tx_queue(struct adb_dev *dev, struct usb_request *req)
+{
+	int ret;
+
+	ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
+	if (ret < 0) {
+		pr_debug("adb_write: xfer error %d\n", ret);
+		dev->error = 1;
+		adb_req_put(dev, &dev->tx_idle, req);
+		return -EIO;
+	}
+	return 0;
+}
+
 static ssize_t adb_write(struct file *fp, const char __user *buf,
 				 size_t count, loff_t *pos)
 {
 	struct adb_dev *dev = fp->private_data;
-	struct usb_request *req = 0;
-	int r = count, xfer;
+	struct usb_request *req;
+	int nonblock = fp->f_flags & O_NONBLOCK;
+	ssize_t r = count;
+	size_t xfer;
 	int ret;
 
 	if (!_adb_dev)
@@ -353,57 +567,148 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		return -EBUSY;
 
 	while (count > 0) {
-		if (dev->error) {
-			pr_debug("adb_write dev->error\n");
-			r = -EIO;
+		/* get an idle tx request to use */
+		req = adb_tx_get(dev, nonblock);
+		if (IS_ERR(req)) {
+			ret = PTR_ERR(req);
+			/* a non-blocking write returns what it got rid of */
+			if (ret == -EAGAIN && r > count)
+				r -= count;
+			else
+				r = ret;
 			break;
 		}
 
-		/* get an idle tx request to use */
-		req = 0;
-		ret = wait_event_interruptible(dev->write_wq,
-			(req = adb_req_get(dev, &dev->tx_idle)) || dev->error);
+		xfer = min_t(size_t, count, dev->tx_req_len);
+		if (copy_from_user(req->buf, buf, xfer)) {
+			adb_req_put(dev, &dev->tx_idle, req);
+			r = -EFAULT;
+			break;
+		}
 
+		req->length = xfer;
+		ret = adb_tx_queue(dev, req);
 		if (ret < 0) {
 			r = ret;
 			break;
 		}
 
-		if (req != 0) {
-			if (count > ADB_BULK_BUFFER_SIZE)
-				xfer = ADB_BULK_BUFFER_SIZE;
-			else
-				xfer = count;
-			if (copy_from_user(req->buf, buf, xfer)) {
-				r = -EFAULT;
-				break;
-			}
-
-			req->length = xfer;
-			ret = usb_ep_queue(dev->ep_in, req, GFP_ATOMIC);
-			if (ret < 0) {
-				pr_debug("adb_write: xfer error %d\n", ret);
-				dev->error = 1;
-				r = -EIO;
-				break;
-			}
-
-			buf += xfer;
-			count -= xfer;
-
-			/* zero this so we don't try to free it on error exit */
-			req = 0;
+		buf += xfer;
+		count -= xfer;
+	}
+
+	adb_unlock(&dev->write_excl);
+	pr_debug("adb_write returning %d\n", r);
+	return r;
+}
+
+struct adb_splice {
+	struct adb_dev *dev;
+	/* tx request being filled */
+	struct usb_request *req;
+	int nonblock;
+};
+
+/* copy one pipe buffer into tx requests, queueing those that fill up */
+static int adb_splice_actor(struct pipe_inode_info *pipe,
+		struct pipe_buffer *buf, struct splice_desc *sd)
+{
+	struct adb_splice *as = sd->u.data;
+	struct adb_dev *dev = as->dev;
+	size_t len;
+	char *src;
+	int ret;
+
+	if (!as->req) {
+		as->req = adb_tx_get(dev, as->nonblock);
+		if (IS_ERR(as->req)) {
+			ret = PTR_ERR(as->req);
+			as->req = 0;
+			return ret;
 		}
+		as->req->length = 0;
 	}
 
-	if (req)
-		adb_req_put(dev, &dev->tx_idle, req);
+	len = min_t(size_t, sd->len, dev->tx_req_len - as->req->length);
+	src = buf->ops->map(pipe, buf, 0);
+	memcpy(as->req->buf + as->req->length, src + buf->offset, len);
+	buf->ops->unmap(pipe, buf, src);
+	as->req->length += len;
+
+	if (as->req->length == dev->tx_req_len) {
+		ret = adb_tx_queue(dev, as->req);
+		as->req = 0;
+		if (ret < 0)
+			return ret;
+	}
+	return len;
+}
+
+/*
+ * sendfile() and splice() to the adb device: the data goes straight from
+ * the pipe's pages into whole tx requests, where write() from the default
+ * splice path would send it one page per request.  Every call ends the
+ * transfer it sent, as a write() does.
+ */
+static ssize_t adb_splice_write(struct pipe_inode_info *pipe,
+		struct file *fp, loff_t *ppos, size_t len, unsigned int flags)
+{
+	struct adb_dev *dev = fp->private_data;
+	struct adb_splice as = {
+		.dev = dev,
+		.nonblock = (flags & SPLICE_F_NONBLOCK) ||
+			    (fp->f_flags & O_NONBLOCK),
+	};
+	struct splice_desc sd = {
+		.total_len = len,
+		.flags = flags,
+		.pos = *ppos,
+		.u.data = &as,
+	};
+	ssize_t r;
+	int ret;
+
+	if (!_adb_dev)
+		return -ENODEV;
+	pr_debug("adb_splice_write(%d)\n", len);
+
+	if (adb_lock(&dev->write_excl))
+		return -EBUSY;
+
+	pipe_lock(pipe);
+	r = __splice_from_pipe(pipe, &sd, adb_splice_actor);
+	pipe_unlock(pipe);
+
+	if (as.req) {
+		ret = adb_tx_queue(dev, as.req);
+		if (ret < 0)
+			r = ret;
+	}
 
 	adb_unlock(&dev->write_excl);
-	pr_debug("adb_write returning %d\n", r);
+	pr_debug("adb_splice_write returning %d\n", r);
 	return r;
 }
 
+static unsigned int adb_poll(struct file *fp, poll_table *wait)
+{
+	struct adb_dev *dev = fp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(fp, &dev->read_wq, wait);
+	poll_wait(fp, &dev->write_wq, wait);
+
+	if (dev->error)
+		return POLLERR;
+
+	/* data for a read armed by a non-blocking read() is in */
+	if (dev->rx_armed && adb_rx_ready(dev))
+		mask |= POLLIN | POLLRDNORM;
+	if (dev->online && !list_empty(&dev->tx_idle))
+		mask |= POLLOUT | POLLWRNORM;
+	return mask;
+}
+
 static int adb_open(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_open\n");
@@ -424,6 +729,11 @@ static int adb_open(struct inode *ip, struct file *fp)
 static int adb_release(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_release\n");
+
+	/* drop a read left armed by a non-blocking read() */
+	if (_adb_dev->rx_armed)
+		adb_rx_flush(_adb_dev);
+
 	adb_unlock(&_adb_dev->open_excl);
 	return 0;
 }
@@ -433,6 +743,8 @@ static struct file_operations adb_fops = {
 	.owner = THIS_MODULE,
 	.read = adb_read,
 	.write = adb_write,
+	.splice_write = adb_splice_write,
+	.poll = adb_poll,
 	.open = adb_open,
 	.release = adb_release,
 };
@@ -488,14 +800,20 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_adb(f);
 	struct usb_request *req;
-
+	int i;
 
 	dev->online = 0;
 	dev->error = 1;
 
 	wake_up(&dev->read_wq);
+	wake_up(&dev->write_wq);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	/* an armed read must not be flushed once its requests are freed */
+	dev->rx_armed = 0;
+	for (i = 0; i < dev->rx_reqs; i++) {
+		adb_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = adb_req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 }
@@ -526,6 +844,8 @@ static int adb_function_set_alt(struct usb_function *f,
 
 	/* readers may be blocked waiting for us to go online */
 	wake_up(&dev->read_wq);
+	/* and pollers for the IN requests */
+	wake_up(&dev->write_wq);
 	return 0;
 }
 
@@ -539,9 +859,12 @@ static void adb_function_disable(struct usb_function *f)
 	dev->error = 1;
 	usb_ep_disable(dev->ep_in);
 	usb_ep_disable(dev->ep_out);
+	/* that completed any armed rx requests, nothing is left to flush */
+	dev->rx_armed = 0;
 
 	/* readers may be blocked waiting for us to go online */
 	wake_up(&dev->read_wq);
+	wake_up(&dev->write_wq);
 
 	VDBG(cdev, "%s disabled\n", dev->function.name);
 }
@@ -74,6 +74,9 @@
  *				being a CD-ROM.
  *	->nofua		Flag specifying that FUA flag in SCSI WRITE(10,12)
  *				commands for this LUN shall be ignored.
+ *	->direct	Flag specifying that a block device backing the
+ *				LUN shall be accessed directly, around
+ *				the page cache.
  *
  *	lun_name_format	A printf-like format for names of the LUN
  *				devices.  This determines how the
@@ -130,6 +133,8 @@
  *				a CD-ROM drive.
  *	nofua=b[,b...]	Default false, booleans for ignore FUA flag
  *				in SCSI WRITE(10,12) commands
+ *	direct=b[,b...]	Default false, booleans for bypassing the page
+ *				cache of block device backing files
  *	luns=N		Default N = number of filenames, number of
  *				LUNs to support.
  *	stall		Default determined according to the type of
@@ -143,10 +148,13 @@
  * (look for FSG_MODULE_PARAMETERS() macro usage, what's inside it is
  * the prefix).
  *
+ * Independent of that, num_buffers (default 4) and buflen (default 64K)
+ * set the depth and the size of the buffer ring shared by all LUNs.
+ *
  *
  * Requirements are modest; only a bulk-in and a bulk-out endpoint are
- * needed.  The memory requirement amounts to two 16K buffers, size
- * configurable by a parameter.  Support is included for both
+ * needed.  The memory requirement amounts to num_buffers + 1 buffers of
+ * buflen bytes, the extra one holding read-ahead for direct LUNs.  Support is included for both
  * full-speed and high-speed operation.
  *
  * Note that the driver is slightly non-portable in that it assumes a
@@ -277,6 +285,8 @@
 #include <linux/completion.h>
 #include <linux/dcache.h>
 #include <linux/delay.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
 #include <linux/device.h>
 #include <linux/fcntl.h>
 #include <linux/file.h>
@@ -284,6 +294,7 @@
 #include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/limits.h>
+#include <linux/log2.h>
 #include <linux/rwsem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
@@ -341,6 +352,22 @@ static const char fsg_string_interface[] = "Mass Storage";
 
 #include "storage_common.c"
 
+/*
+ * Depth and size of the buffer ring, read when the function is set up.
+ * The size is rounded down to a power of two, so the buffers are aligned
+ * well enough for direct I/O.
+ */
+#define FSG_MAX_NUM_BUFFERS	32
+#define FSG_MAX_BUFLEN		((u32)262144)
+
+static unsigned int fsg_num_buffers = 4;
+module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
+
+static unsigned int fsg_buflen = 65536;
+module_param_named(buflen, fsg_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(buflen, "Size of each pipeline buffer in bytes");
+
 
 /*-------------------------------------------------------------------------*/
 
@@ -392,7 +419,17 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
+	unsigned int		num_buffers;
+	u32			buflen;
+
+	/* Data read ahead of the next READ from a direct LUN */
+	void			*ra_buf;
+	struct fsg_lun		*ra_lun;
+	unsigned int		ra_filp_gen;
+	loff_t			ra_offset;
+	unsigned int		ra_len;
+	unsigned int		ra_pending:1;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -446,6 +483,7 @@ struct fsg_config {
 		char removable;
 		char cdrom;
 		char nofua;
+		char direct;
 	} luns[FSG_MAX_LUNS];
 
 	const char		*lun_name_format;
@@ -765,6 +803,177 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * Direct I/O to LUNs backed by a block device.  The buffers are kmalloc()ed
+ * and physically contiguous, so they are handed to the block layer as they
+ * are instead of being copied through the page cache, which is left to
+ * the rest of the system.  Regular files, and transfers the device can't
+ * take at their alignment, go through vfs_read()/vfs_write().
+ */
+
+struct fsg_dio {
+	atomic_t		pending;
+	int			error;
+	struct completion	done;
+};
+
+static void fsg_dio_end_io(struct bio *bio, int err)
+{
+	struct fsg_dio *dio = bio->bi_private;
+
+	if (err)
+		dio->error = -EIO;
+	if (atomic_dec_and_test(&dio->pending))
+		complete(&dio->done);
+	bio_put(bio);
+}
+
+static struct block_device *fsg_lun_bdev(struct fsg_lun *curlun)
+{
+	struct inode *inode = curlun->filp->f_mapping->host;
+
+	if (!curlun->direct || !S_ISBLK(inode->i_mode))
+		return NULL;
+	return I_BDEV(inode);
+}
+
+/*
+ * Read or write @amount bytes at @offset of @bdev from or to @buf.
+ * Returns @amount, -EIO, or -EINVAL without doing anything if the
+ * transfer isn't aligned to the logical block size.
+ */
+static ssize_t fsg_dio(struct block_device *bdev, int rw, void *buf,
+		       unsigned int amount, loff_t offset)
+{
+	unsigned int mask = bdev_logical_block_size(bdev) - 1;
+	unsigned int left = amount, len, off;
+	struct fsg_dio dio;
+	struct bio *bio;
+
+	if ((offset | amount | (unsigned long)buf) & mask)
+		return -EINVAL;
+
+	atomic_set(&dio.pending, 1);
+	dio.error = 0;
+	init_completion(&dio.done);
+
+	while (left) {
+		bio = bio_alloc(GFP_KERNEL, min_t(unsigned int, BIO_MAX_PAGES,
+				DIV_ROUND_UP(left, PAGE_SIZE) + 1));
+		bio->bi_sector = offset >> 9;
+		bio->bi_bdev = bdev;
+		bio->bi_end_io = fsg_dio_end_io;
+		bio->bi_private = &dio;
+
+		while (left) {
+			off = offset_in_page(buf);
+			len = min_t(unsigned int, left, PAGE_SIZE - off);
+			if (!bio_add_page(bio, virt_to_page(buf), len, off))
+				break;
+			buf += len;
+			offset += len;
+			left -= len;
+		}
+		if (!bio->bi_size) {
+			bio_put(bio);
+			dio.error = -EIO;
+			break;
+		}
+
+		atomic_inc(&dio.pending);
+		submit_bio(rw, bio);
+	}
+
+	if (!atomic_dec_and_test(&dio.pending))
+		wait_for_completion(&dio.done);
+	return dio.error ?: amount;
+}
+
+static ssize_t fsg_lun_read(struct fsg_common *common, struct fsg_buffhd *bh,
+			    unsigned int amount, loff_t offset)
+{
+	struct fsg_lun		*curlun = common->curlun;
+	struct block_device	*bdev = fsg_lun_bdev(curlun);
+	ssize_t			nread;
+
+	if (bdev) {
+		/*
+		 * Copy out of the read-ahead buffer if it holds what we
+		 * need.  The buffer can't be swapped into the ring: the
+		 * requests were queued before, and a UDC may keep the DMA
+		 * mapping of their first buffer.
+		 */
+		if (common->ra_len >= amount && common->ra_lun == curlun &&
+		    common->ra_filp_gen == curlun->filp_gen &&
+		    common->ra_offset == offset) {
+			memcpy(bh->buf, common->ra_buf, amount);
+			common->ra_len = 0;
+			return amount;
+		}
+
+		nread = fsg_dio(bdev, READ, bh->buf, amount, offset);
+		if (nread != -EINVAL)
+			return nread;
+	}
+	return vfs_read(curlun->filp, (char __user *)bh->buf, amount, &offset);
+}
+
+static ssize_t fsg_lun_write(struct fsg_common *common, struct fsg_buffhd *bh,
+			     unsigned int amount, loff_t offset)
+{
+	struct fsg_lun		*curlun = common->curlun;
+	struct block_device	*bdev = fsg_lun_bdev(curlun);
+	ssize_t			nwritten;
+
+	if (bdev) {
+		nwritten = fsg_dio(bdev, curlun->filp->f_flags & O_SYNC ?
+				   WRITE_FUA : WRITE_SYNC,
+				   bh->buf, amount, offset);
+		if (nwritten != -EINVAL) {
+			/* Don't let stale cached copies be read later */
+			invalidate_mapping_pages(curlun->filp->f_mapping,
+				offset >> PAGE_CACHE_SHIFT,
+				(offset + amount - 1) >> PAGE_CACHE_SHIFT);
+			return nwritten;
+		}
+	}
+	return vfs_write(curlun->filp, (char __user *)bh->buf, amount,
+			 &offset);
+}
+
+/*
+ * Called after a READ from a direct LUN, once the CBW of the next command
+ * has been queued: while the host takes the status and sends its next
+ * command, the data following the READ is read into the spare buffer.
+ * A sequential READ then starts without waiting for the device.
+ */
+static void fsg_prefetch(struct fsg_common *common)
+{
+	struct fsg_lun		*curlun = common->ra_lun;
+	struct block_device	*bdev;
+	unsigned int		amount;
+
+	if (!common->ra_pending)
+		return;
+	common->ra_pending = 0;
+
+	down_read(&common->filesem);
+	if (!fsg_lun_is_open(curlun))
+		goto out;
+	bdev = fsg_lun_bdev(curlun);
+	amount = min_t(loff_t, common->buflen,
+		       curlun->file_length - common->ra_offset);
+	if (!bdev || !amount)
+		goto out;
+	if (fsg_dio(bdev, READ, common->ra_buf, amount,
+		    common->ra_offset) == amount) {
+		common->ra_filp_gen = curlun->filp_gen;
+		common->ra_len = amount;
+	}
+out:
+	up_read(&common->filesem);
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -772,7 +981,7 @@ static int do_read(struct fsg_common *common)
 	struct fsg_buffhd	*bh;
 	int			rc;
 	u32			amount_left;
-	loff_t			file_offset, file_offset_tmp;
+	loff_t			file_offset;
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nread;
@@ -818,7 +1027,7 @@ static int do_read(struct fsg_common *common)
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
@@ -856,10 +1065,7 @@ static int do_read(struct fsg_common *common)
 		}
 
 		/* Perform the read */
-		file_offset_tmp = file_offset;
-		nread = vfs_read(curlun->filp,
-				 (char __user *)bh->buf,
-				 amount, &file_offset_tmp);
+		nread = fsg_lun_read(common, bh, amount, file_offset);
 		VLDBG(curlun, "file read %u @ %llu -> %d\n", amount,
 		      (unsigned long long)file_offset, (int)nread);
 		if (signal_pending(current))
@@ -887,8 +1093,14 @@ static int do_read(struct fsg_common *common)
 			break;
 		}
 
-		if (amount_left == 0)
+		if (amount_left == 0) {
+			/* Read ahead for a following sequential READ */
+			common->ra_lun = curlun;
+			common->ra_offset = file_offset;
+			common->ra_len = 0;
+			common->ra_pending = 1;
 			break;		/* No more left to read */
+		}
 
 		/* Send this buffer and go read some more */
 		bh->inreq->zero = 0;
@@ -911,7 +1123,7 @@ static int do_write(struct fsg_common *common)
 	struct fsg_buffhd	*bh;
 	int			get_some_more;
 	u32			amount_left_to_req, amount_left_to_write;
-	loff_t			usb_offset, file_offset, file_offset_tmp;
+	loff_t			usb_offset, file_offset;
 	unsigned int		amount;
 	unsigned int		partial_page;
 	ssize_t			nwritten;
@@ -921,6 +1133,7 @@ static int do_write(struct fsg_common *common)
 		curlun->sense_data = SS_WRITE_PROTECTED;
 		return -EINVAL;
 	}
+	common->ra_len = 0;		/* May be about to go stale */
 	spin_lock(&curlun->filp->f_lock);
 	curlun->filp->f_flags &= ~O_SYNC;	/* Default is not to wait */
 	spin_unlock(&curlun->filp->f_lock);
@@ -978,7 +1191,7 @@ static int do_write(struct fsg_common *common)
 			 *	to write past the end of file.
 			 * Finally, round down to a block boundary.
 			 */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 			amount = min((loff_t)amount,
 				     curlun->file_length - usb_offset);
 			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
@@ -1060,10 +1273,8 @@ static int do_write(struct fsg_common *common)
 			}
 
 			/* Perform the write */
-			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					     (char __user *)bh->buf,
-					     amount, &file_offset_tmp);
+			nwritten = fsg_lun_write(common, bh, amount,
+						 file_offset);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 			      (unsigned long long)file_offset, (int)nwritten);
 			if (signal_pending(current))
@@ -1084,8 +1295,11 @@ static int do_write(struct fsg_common *common)
 			common->residue -= nwritten;
 
 #ifdef MAX_UNFLUSHED_PACKETS
-			curlun->unflushed_packet ++;
-			curlun->unflushed_bytes += nwritten;
+			/* Direct writes are on the medium already */
+			if (!fsg_lun_bdev(curlun)) {
+				curlun->unflushed_packet ++;
+				curlun->unflushed_bytes += nwritten;
+			}
 			if( (curlun->unflushed_packet >= MAX_UNFLUSHED_PACKETS) || (curlun->unflushed_bytes >= MAX_UNFLUSHED_BYTES)) {
 				fsg_lun_fsync_sub(curlun);
 				curlun->unflushed_packet = 0;
@@ -1203,7 +1417,7 @@ static int do_verify(struct fsg_common *common)
 		 * If this means reading 0 then we were asked to read
 		 * past the end of file.
 		 */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t)amount,
 			     curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1672,7 +1886,7 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left, common->buflen);
 
 			/*
 			 * amount is always divisible by 512, hence by
@@ -2534,6 +2748,8 @@ static int get_next_command(struct fsg_common *common)
 	 * next_buffhd_to_fill.
 	 */
 
+	fsg_prefetch(common);
+
 	/* Wait for the CBW to arrive */
 	while (bh->state != BUF_STATE_FULL) {
 		rc = sleep_thread(common);
@@ -2587,7 +2803,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2639,7 +2855,7 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2710,7 +2926,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2722,7 +2938,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < common->num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2745,12 +2961,14 @@ static void handle_exception(struct fsg_common *common)
 	 */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
 	common->next_buffhd_to_fill = &common->buffhds[0];
 	common->next_buffhd_to_drain = &common->buffhds[0];
+	common->ra_len = 0;
+	common->ra_pending = 0;
 	exception_req_tag = common->exception_req_tag;
 	old_state = common->state;
 
@@ -2918,9 +3136,43 @@ static int fsg_main_thread(void *common_)
 
 /*************************** DEVICE ATTRIBUTES ***************************/
 
+static ssize_t fsg_show_direct(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+
+	return sprintf(buf, "%u\n", curlun->direct);
+}
+
+static ssize_t fsg_store_direct(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct fsg_lun	*curlun = fsg_lun_from_dev(dev);
+	struct rw_semaphore	*filesem = dev_get_drvdata(dev);
+	unsigned	direct;
+	int		ret;
+
+	ret = kstrtouint(buf, 2, &direct);
+	if (ret)
+		return ret;
+
+	/* Write out and drop what the page cache holds before bypassing it */
+	down_write(filesem);
+	if (direct && !curlun->direct && fsg_lun_is_open(curlun)) {
+		fsg_lun_fsync_sub(curlun);
+		invalidate_sub(curlun);
+	}
+	curlun->direct = direct;
+	up_write(filesem);
+
+	return count;
+}
+
 /* Write permission is checked per LUN in store_*() functions. */
 static DEVICE_ATTR(ro, 0644, fsg_show_ro, fsg_store_ro);
 static DEVICE_ATTR(nofua, 0644, fsg_show_nofua, fsg_store_nofua);
+static DEVICE_ATTR(direct, 0644, fsg_show_direct, fsg_store_direct);
 static DEVICE_ATTR(file, 0644, fsg_show_file, fsg_store_file);
 
 
@@ -3007,6 +3259,7 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		curlun->ro = lcfg->cdrom || lcfg->ro;
 		curlun->initially_ro = curlun->ro;
 		curlun->removable = lcfg->removable;
+		curlun->direct = lcfg->direct;
 		curlun->dev.release = fsg_lun_release;
 		curlun->dev.parent = &gadget->dev;
 		/* curlun->dev.driver = &fsg_driver.driver; XXX */
@@ -3032,6 +3285,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 		if (rc)
 			goto error_luns;
 		rc = device_create_file(&curlun->dev, &dev_attr_nofua);
+		if (rc)
+			goto error_luns;
+		rc = device_create_file(&curlun->dev, &dev_attr_direct);
 		if (rc)
 			goto error_luns;
 
@@ -3048,14 +3304,25 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 	common->nluns = nluns;
 
 	/* Data buffers cyclic list */
+	common->num_buffers = clamp_t(unsigned int, fsg_num_buffers,
+				      2, FSG_MAX_NUM_BUFFERS);
+	common->buflen = rounddown_pow_of_two(clamp_t(u32, fsg_buflen,
+						      FSG_BUFLEN,
+						      FSG_MAX_BUFLEN));
+	common->buffhds = kcalloc(common->num_buffers,
+				  sizeof *common->buffhds, GFP_KERNEL);
+	if (unlikely(!common->buffhds)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
 	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
+	i = common->num_buffers;
 	goto buffhds_first_it;
 	do {
 		bh->next = bh + 1;
 		++bh;
 buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
+		bh->buf = kmalloc(common->buflen, GFP_KERNEL);
 		if (unlikely(!bh->buf)) {
 			rc = -ENOMEM;
 			goto error_release;
@@ -3063,6 +3330,12 @@ buffhds_first_it:
 	} while (--i);
 	bh->next = common->buffhds;
 
+	common->ra_buf = kmalloc(common->buflen, GFP_KERNEL);
+	if (unlikely(!common->ra_buf)) {
+		rc = -ENOMEM;
+		goto error_release;
+	}
+
 	/* Prepare inquiryString */
 	if (cfg->release != 0xffff) {
 		i = cfg->release;
@@ -3164,6 +3437,7 @@ static void fsg_common_release(struct kref *ref)
 		/* In error recovery common->nluns may be zero. */
 		for (; i; --i, ++lun) {
 			device_remove_file(&lun->dev, &dev_attr_nofua);
+			device_remove_file(&lun->dev, &dev_attr_direct);
 			device_remove_file(&lun->dev, &dev_attr_ro);
 			device_remove_file(&lun->dev, &dev_attr_file);
 			fsg_lun_close(lun);
@@ -3173,13 +3447,15 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
+	if (common->buffhds) {
 		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
+		unsigned i = common->num_buffers;
 		do {
 			kfree(bh->buf);
 		} while (++bh, --i);
+		kfree(common->buffhds);
 	}
+	kfree(common->ra_buf);
 
 	if (common->free_storage_on_release)
 		kfree(common);
@@ -3321,9 +3597,10 @@ struct fsg_module_parameters {
 	int		removable[FSG_MAX_LUNS];
 	int		cdrom[FSG_MAX_LUNS];
 	int		nofua[FSG_MAX_LUNS];
+	int		direct[FSG_MAX_LUNS];
 
 	unsigned int	file_count, ro_count, removable_count, cdrom_count;
-	unsigned int	nofua_count;
+	unsigned int	nofua_count, direct_count;
 	unsigned int	luns;	/* nluns */
 	int		stall;	/* can_stall */
 };
@@ -3350,6 +3627,8 @@ struct fsg_module_parameters {
 				"true to simulate CD-ROM instead of disk"); \
 	_FSG_MODULE_PARAM_ARRAY(prefix, params, nofua, bool,		\
 				"true to ignore SCSI WRITE(10,12) FUA bit"); \
+	_FSG_MODULE_PARAM_ARRAY(prefix, params, direct, bool,		\
+				"true to bypass the page cache");	\
 	_FSG_MODULE_PARAM(prefix, params, luns, uint,			\
 			  "number of LUNs");				\
 	_FSG_MODULE_PARAM(prefix, params, stall, bool,			\
@@ -3368,6 +3647,7 @@ fsg_config_from_params(struct fsg_config *cfg,
 	for (i = 0, lun = cfg->luns; i < cfg->nluns; ++i, ++lun) {
 		lun->ro = !!params->ro[i];
 		lun->cdrom = !!params->cdrom[i];
+		lun->direct = !!params->direct[i];
 		lun->removable = /* Removable by default */
 			params->removable_count <= i || params->removable[i];
 		lun->filename =
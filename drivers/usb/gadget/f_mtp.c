@@ -28,8 +28,16 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/fs.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/moduleparam.h>
+#include <linux/backing-dev.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+#include <linux/scatterlist.h>
+#include <linux/writeback.h>
+#include <linux/fsnotify.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -50,10 +58,51 @@
 #define STATE_ERROR                 4   /* error from completion routine */
 
 /* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 16
 #define INTR_REQ_MAX 5
 
+/* largest bulk request we try to allocate */
+#define MTP_BULK_BUFFER_MAX        (1024 * 1024)
+
+/*
+ * Size and number of the bulk requests.  They are read when the function
+ * is bound, so a change takes effect the next time the gadget is enabled.
+ * If buffers of the requested size can't be had, the size is halved down
+ * to MTP_BULK_BUFFER_SIZE before giving up.
+ */
+static unsigned int mtp_tx_req_len = 65536;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "MTP IN request size in bytes");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "Number of MTP IN requests");
+
+static unsigned int mtp_rx_req_len = 65536;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "MTP OUT request size in bytes");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "Number of MTP OUT requests");
+
+/*
+ * File transfers stream through the page cache: every this many bytes
+ * received, writeback of them is started, and what has been sent or
+ * written back is dropped from the cache again.  0 turns this off.
+ */
+static unsigned int mtp_cache_chunk = 4 * 1024 * 1024;
+module_param(mtp_cache_chunk, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_cache_chunk, "MTP page cache writeback/drop chunk");
+
+/*
+ * Scatterlist entries of a bulk request moving file data straight from
+ * or to the page cache.  Every entry takes a DMA descriptor, so this
+ * stays well below what a controller's descriptor ring holds.
+ */
+#define MTP_SG_MAX                 32
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -69,6 +118,22 @@
 
 static const char mtp_shortname[] = "mtp_usb";
 
+/*
+ * Page cache state of a bulk request, kept in req->context on gadgets
+ * with sg_supported.  Packets that lie within one page are moved to or
+ * from the page itself, the rest go through req->buf at their offset in
+ * the request.  @pages holds a reference on each page in @sg; for an IN
+ * request they are page cache pages, for an OUT request new pages for
+ * the file pages from @index on, added to the page cache once full.
+ */
+struct mtp_sg_req {
+	struct scatterlist	sg[MTP_SG_MAX];
+	struct page		*pages[MTP_SG_MAX + 1];
+	int			nr_pages;
+	loff_t			offset;		/* file offset of the data */
+	pgoff_t			index;		/* of pages[0], OUT only */
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -94,6 +159,12 @@ struct mtp_dev {
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	atomic_t rx_completed;
+
+	/* bulk request sizes and rx queue depth actually allocated */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned rx_reqs;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -294,9 +365,24 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 	return req;
 }
 
+/* drop the pages of a page cache request, it is a plain one again */
+static void mtp_sg_release(struct usb_request *req)
+{
+	struct mtp_sg_req *sgr = req->context;
+
+	if (!sgr)
+		return;
+	while (sgr->nr_pages)
+		page_cache_release(sgr->pages[--sgr->nr_pages]);
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		mtp_sg_release(req);
+		kfree(req->context);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
@@ -353,6 +439,8 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	/* the page cache pages of send_file_work are done with */
+	mtp_sg_release(req);
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -363,7 +451,10 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0 && dev->state != STATE_CANCELED)
+	atomic_inc(&dev->rx_completed);
+	/* -ECONNRESET is a request we dequeued ourselves */
+	if (req->status != 0 && req->status != -ECONNRESET &&
+	    dev->state != STATE_CANCELED)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -381,6 +472,13 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
+/* sanitize a requested bulk request size: whole 512 byte packets */
+static unsigned mtp_bulk_req_len(unsigned len)
+{
+	len = clamp_t(unsigned, len, MTP_BULK_BUFFER_SIZE, MTP_BULK_BUFFER_MAX);
+	return len & ~511;
+}
+
 static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc,
@@ -430,20 +528,47 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = mtp_bulk_req_len(mtp_tx_req_len);
+retry_tx:
+	for (i = 0; i < clamp_t(unsigned, mtp_tx_reqs, 2, TX_REQ_MAX); i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len /= 2;
+			goto retry_tx;
+		}
 		req->complete = mtp_complete_in;
+		if (cdev->gadget->sg_supported)
+			req->context = kzalloc(sizeof(struct mtp_sg_req),
+					       GFP_KERNEL);
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+
+	dev->rx_req_len = mtp_bulk_req_len(mtp_rx_req_len);
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 2, RX_REQ_MAX);
+retry_rx:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--)
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+			dev->rx_req_len /= 2;
+			goto retry_rx;
+		}
 		req->complete = mtp_complete_out;
+		if (cdev->gadget->sg_supported)
+			req->context = kzalloc(sizeof(struct mtp_sg_req),
+					       GFP_KERNEL);
 		dev->rx_req[i] = req;
 	}
+	DBG(cdev, "%u x %u byte IN, %u x %u byte OUT requests\n",
+	    clamp_t(unsigned, mtp_tx_reqs, 2, TX_REQ_MAX), dev->tx_req_len,
+	    dev->rx_reqs, dev->rx_req_len);
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -470,8 +595,8 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
-        count = MTP_BULK_BUFFER_SIZE;
+	if (count > dev->rx_req_len)
+		count = dev->rx_req_len;
 
 	/* we will block until we're online */
 	DBG(cdev, "mtp_read: waiting for online state\n");
@@ -590,8 +715,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -628,6 +753,347 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* a file being sent is read once, front to back: double its readahead
+ * window, as POSIX_FADV_SEQUENTIAL would
+ */
+static void mtp_file_sequential(struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = bdi->ra_pages * 2;
+	spin_unlock(&filp->f_lock);
+}
+
+/* drop the clean page cache pages of [start, end) after a transfer */
+static void mtp_file_drop(struct file *filp, loff_t start, loff_t end)
+{
+	pgoff_t first = (start + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	pgoff_t last = end >> PAGE_CACHE_SHIFT;
+
+	if (last > first)
+		invalidate_mapping_pages(filp->f_mapping, first, last - 1);
+}
+
+/*
+ * Can the file's data move straight between the page cache and the
+ * bulk requests?  That needs a controller doing scatter-gather and a
+ * filesystem with the usual address_space operations.
+ */
+static bool mtp_file_sg(struct mtp_dev *dev, struct file *filp)
+{
+	struct address_space *mapping = filp->f_mapping;
+
+	return dev->cdev->gadget->sg_supported &&
+		S_ISREG(mapping->host->i_mode) &&
+		mapping->a_ops->readpage &&
+		mapping->a_ops->write_begin && mapping->a_ops->write_end;
+}
+
+/* an uptodate page of the file being sent, reading ahead to @last */
+static struct page *mtp_file_page(struct file *filp, pgoff_t index,
+				  pgoff_t last)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (!page)
+		page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					  index, last - index + 1);
+	else if (PageReadahead(page))
+		page_cache_async_readahead(mapping, &filp->f_ra, filp, page,
+					   index, last - index + 1);
+	if (page && PageUptodate(page))
+		return page;
+	if (page)
+		page_cache_release(page);
+
+	return read_mapping_page(mapping, index, filp);
+}
+
+/* the page of @index for an IN request, looked up once per request */
+static struct page *mtp_sg_tx_page(struct mtp_sg_req *sgr,
+				   struct file *filp, pgoff_t index,
+				   pgoff_t last)
+{
+	struct page *page;
+
+	if (sgr->nr_pages && sgr->pages[sgr->nr_pages - 1]->index == index)
+		return sgr->pages[sgr->nr_pages - 1];
+	page = mtp_file_page(filp, index, last);
+	if (!IS_ERR(page))
+		sgr->pages[sgr->nr_pages++] = page;
+	return page;
+}
+
+/*
+ * Describe @len bytes of an IN data phase in req->sg: @hdr_size bytes
+ * of header already in req->buf, then the file from @offset.  Each
+ * entry but the last must be whole packets, so packets that straddle a
+ * page boundary, or the header, are copied to req->buf.  Returns the
+ * bytes described, fewer than @len if the scatterlist filled up, or a
+ * negative errno.
+ */
+static int mtp_sg_tx_build(struct mtp_dev *dev, struct usb_request *req,
+			   struct file *filp, loff_t offset, int hdr_size,
+			   int len)
+{
+	struct mtp_sg_req *sgr = req->context;
+	unsigned mps = dev->ep_in->maxpacket;
+	pgoff_t last = (offset + len - hdr_size - 1) >> PAGE_CACHE_SHIFT;
+	struct scatterlist *sg = NULL;
+	struct page *page;
+	bool bounce = false;
+	int nents = 0, pos = 0;
+
+	mtp_sg_release(req);
+	sg_init_table(sgr->sg, MTP_SG_MAX);
+	sgr->offset = offset;
+
+	while (pos < len && nents < MTP_SG_MAX && sgr->nr_pages < MTP_SG_MAX) {
+		int plen = min_t(int, mps, len - pos);
+		loff_t start = offset + pos - hdr_size;
+		unsigned poff = start & ~PAGE_CACHE_MASK;
+
+		if (pos >= hdr_size && poff + plen <= PAGE_CACHE_SIZE) {
+			/* the packet lies within one page, send it from there */
+			page = mtp_sg_tx_page(sgr, filp,
+					      start >> PAGE_CACHE_SHIFT, last);
+			if (IS_ERR(page))
+				goto fail;
+			if (!sg || bounce || sg_page(sg) != page) {
+				sg = &sgr->sg[nents++];
+				sg_set_page(sg, page, 0, poff);
+			}
+			bounce = false;
+		} else {
+			/* copy it to its place in req->buf */
+			int done = max(hdr_size - pos, 0);
+
+			while (done < plen) {
+				loff_t from = start + done;
+				unsigned off = from & ~PAGE_CACHE_MASK;
+				unsigned n = min_t(unsigned, plen - done,
+						   PAGE_CACHE_SIZE - off);
+				char *kaddr;
+
+				page = mtp_sg_tx_page(sgr, filp,
+						from >> PAGE_CACHE_SHIFT, last);
+				if (IS_ERR(page))
+					goto fail;
+				kaddr = kmap_atomic(page, KM_USER0);
+				memcpy(req->buf + pos + done, kaddr + off, n);
+				kunmap_atomic(kaddr, KM_USER0);
+				done += n;
+			}
+			if (!sg || !bounce) {
+				sg = &sgr->sg[nents++];
+				sg_set_buf(sg, req->buf + pos, 0);
+			}
+			bounce = true;
+		}
+		sg->length += plen;
+		pos += plen;
+	}
+
+	sg_mark_end(sg);
+	req->sg = sgr->sg;
+	req->num_sgs = nents;
+	return pos;
+
+fail:
+	mtp_sg_release(req);
+	return PTR_ERR(page);
+}
+
+/*
+ * Describe an OUT request of up to @len bytes for the file from @offset
+ * in req->sg.  Whole packets that land within one page are received
+ * into a new page for it; the others, and a short last one, which the
+ * controller may round up to a whole packet, go to req->buf.  Returns
+ * the length of the request or a negative errno.
+ */
+static int mtp_sg_rx_build(struct mtp_dev *dev, struct usb_request *req,
+			   struct file *filp, loff_t offset, int len)
+{
+	struct mtp_sg_req *sgr = req->context;
+	unsigned mps = dev->ep_out->maxpacket;
+	struct scatterlist *sg = NULL;
+	struct page *page;
+	bool bounce = false;
+	int nents = 0, pos = 0;
+
+	mtp_sg_release(req);
+	sg_init_table(sgr->sg, MTP_SG_MAX);
+	sgr->offset = offset;
+
+	while (pos < len && nents < MTP_SG_MAX && sgr->nr_pages < MTP_SG_MAX) {
+		int plen = min_t(int, mps, len - pos);
+		loff_t start = offset + pos;
+		pgoff_t index = start >> PAGE_CACHE_SHIFT;
+		unsigned poff = start & ~PAGE_CACHE_MASK;
+
+		if (plen == mps && poff + plen <= PAGE_CACHE_SIZE) {
+			if (!sgr->nr_pages)
+				sgr->index = index;
+			while (sgr->index + sgr->nr_pages <= index) {
+				page = page_cache_alloc(filp->f_mapping);
+				if (!page) {
+					mtp_sg_release(req);
+					return -ENOMEM;
+				}
+				sgr->pages[sgr->nr_pages++] = page;
+			}
+			page = sgr->pages[index - sgr->index];
+			if (!sg || bounce || sg_page(sg) != page) {
+				sg = &sgr->sg[nents++];
+				sg_set_page(sg, page, 0, poff);
+			}
+			bounce = false;
+		} else {
+			if (!sg || !bounce) {
+				sg = &sgr->sg[nents++];
+				sg_set_buf(sg, req->buf + pos, 0);
+			}
+			bounce = true;
+		}
+		sg->length += plen;
+		pos += plen;
+	}
+
+	sg_mark_end(sg);
+	req->sg = sgr->sg;
+	req->num_sgs = nents;
+	return pos;
+}
+
+/* copy the file bytes [from, to) an OUT request got in req->buf to @page */
+static void mtp_sg_fill(struct usb_request *req, struct page *page,
+			loff_t from, loff_t to)
+{
+	struct mtp_sg_req *sgr = req->context;
+	char *kaddr;
+
+	if (from >= to)
+		return;
+	kaddr = kmap_atomic(page, KM_USER0);
+	memcpy(kaddr + (from & ~PAGE_CACHE_MASK),
+	       req->buf + (from - sgr->offset), to - from);
+	kunmap_atomic(kaddr, KM_USER0);
+}
+
+/*
+ * Put a page an OUT request filled into the page cache at @pos, and
+ * have the filesystem take it as written, as generic_perform_write()
+ * would.  If the file has a page there already, the data is copied.
+ */
+static int mtp_file_commit_page(struct file *filp, struct page *page,
+				loff_t pos)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct inode *inode = mapping->host;
+	struct page *dst;
+	void *fsdata;
+	int ret;
+
+	mutex_lock(&inode->i_mutex);
+	if (!add_to_page_cache_lru(page, mapping, pos >> PAGE_CACHE_SHIFT,
+				   GFP_KERNEL)) {
+		/* so write_begin() won't read it in */
+		SetPageUptodate(page);
+		unlock_page(page);
+	}
+	ret = mapping->a_ops->write_begin(filp, mapping, pos, PAGE_CACHE_SIZE,
+					  0, &dst, &fsdata);
+	if (!ret) {
+		if (dst != page)
+			copy_highpage(dst, page);
+		flush_dcache_page(dst);
+		ret = mapping->a_ops->write_end(filp, mapping, pos,
+				PAGE_CACHE_SIZE, PAGE_CACHE_SIZE, dst, fsdata);
+	}
+	mutex_unlock(&inode->i_mutex);
+
+	if (ret < 0)
+		return ret;
+	balance_dirty_pages_ratelimited(mapping);
+	return ret == PAGE_CACHE_SIZE ? 0 : -EIO;
+}
+
+/*
+ * Write what an OUT request built by mtp_sg_rx_build() received to the
+ * file, page by page.  Pages it filled completely go into the page
+ * cache as they are, the rest is copied with vfs_write().  The
+ * request's pages are dropped.  Returns the bytes written or a
+ * negative errno.
+ */
+static int mtp_sg_rx_write(struct mtp_dev *dev, struct usb_request *req,
+			   struct file *filp, loff_t *offset)
+{
+	struct mtp_sg_req *sgr = req->context;
+	struct inode *inode = filp->f_mapping->host;
+	unsigned mps = dev->ep_out->maxpacket;
+	loff_t start = sgr->offset;
+	loff_t end = start + req->actual;
+	loff_t pos = start;
+	bool committed = false;
+	int ret = 0;
+
+	while (pos < end) {
+		pgoff_t index = pos >> PAGE_CACHE_SHIFT;
+		loff_t pstart = (loff_t)index << PAGE_CACHE_SHIFT;
+		loff_t pend = pstart + PAGE_CACHE_SIZE;
+		loff_t to = min(pend, end);
+		ssize_t n;
+
+		if (index >= sgr->index && index - sgr->index < sgr->nr_pages) {
+			struct page *page = sgr->pages[index - sgr->index];
+			/* the packets mtp_sg_rx_build() sent to the page */
+			int first = roundup((int)(pos - start), mps);
+			int last = rounddown((int)(min_t(loff_t, pend,
+					start + req->length) - start), mps);
+			loff_t d0 = start + first, d1 = start + last;
+			char *kaddr;
+
+			if (d1 <= d0)
+				d0 = d1 = to;
+			mtp_sg_fill(req, page, pos, min(d0, to));
+			mtp_sg_fill(req, page, d1, to);
+
+			if (pos == pstart && to == pend) {
+				ret = mtp_file_commit_page(filp, page, pos);
+				if (ret)
+					break;
+				committed = true;
+				pos = to;
+				continue;
+			}
+			kaddr = kmap(page);
+			n = vfs_write(filp, kaddr + (pos - pstart), to - pos, &pos);
+			kunmap(page);
+		} else {
+			n = vfs_write(filp, req->buf + (pos - start), to - pos,
+				      &pos);
+		}
+		if (n < 0 || pos != to) {
+			ret = n < 0 ? n : -EIO;
+			break;
+		}
+	}
+
+	if (committed) {
+		mutex_lock(&inode->i_mutex);
+		file_update_time(filp);
+		mutex_unlock(&inode->i_mutex);
+		fsnotify_modify(filp);
+	}
+	mtp_sg_release(req);
+	*offset = pos;
+
+	return ret ? ret : pos - start;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data) {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, send_file_work);
@@ -635,20 +1101,27 @@ static void send_file_work(struct work_struct *data) {
 	struct usb_request *req = 0;
 	struct mtp_data_header *header;
 	struct file *filp;
-	loff_t offset;
+	loff_t offset, dropped;
 	int64_t count;
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool sg;
 
 	/* read our parameters */
 	smp_rmb();
 	filp = dev->xfer_file;
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
+	dropped = offset;
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	mtp_file_sequential(filp);
+	sg = mtp_file_sg(dev, filp);
+	if (sg)
+		file_accessed(filp);
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -682,8 +1155,8 @@ static void send_file_work(struct work_struct *data) {
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -696,18 +1169,39 @@ static void send_file_work(struct work_struct *data) {
 			header->transaction_id = __cpu_to_le32(dev->xfer_transaction_id);
 		}
 
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size, &offset);
-		if (ret < 0) {
-			r = ret;
-			break;
+		/* send from the page cache what the file has to offer */
+		if (sg && req->context && xfer > hdr_size &&
+		    offset + xfer - hdr_size <=
+				i_size_read(filp->f_mapping->host)) {
+			ret = mtp_sg_tx_build(dev, req, filp, offset,
+					      hdr_size, xfer);
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
+			xfer = ret;
+			offset += xfer - hdr_size;
+		} else {
+			ret = vfs_read(filp, req->buf + hdr_size,
+				       xfer - hdr_size, &offset);
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
+			xfer = ret + hdr_size;
 		}
-		xfer = ret + hdr_size;
 		hdr_size = 0;
 
+		if (mtp_cache_chunk && offset - dropped >= mtp_cache_chunk) {
+			mtp_file_drop(filp, dropped, offset);
+			dropped = offset;
+		}
+
 		req->length = xfer;
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			mtp_sg_release(req);
 			dev->state = STATE_ERROR;
 			r = -EIO;
 			break;
@@ -728,82 +1222,129 @@ static void send_file_work(struct work_struct *data) {
 	smp_wmb();
 }
 
+/* dequeue the rx requests in [head, tail) and wait for them to complete */
+static void mtp_rx_flush(struct mtp_dev *dev, unsigned head, unsigned tail)
+{
+	unsigned i;
+
+	for (i = head; i != tail; i++)
+		if (atomic_read(&dev->rx_completed) <= i)
+			usb_ep_dequeue(dev->ep_out, dev->rx_req[i % dev->rx_reqs]);
+	wait_event_timeout(dev->read_wq,
+		atomic_read(&dev->rx_completed) >= tail, msecs_to_jiffies(1000));
+}
+
 /* read from USB and write to a local file */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
-	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	loff_t offset, synced, dropped, queued_offset;
+	int64_t count, queued;
+	/* rx_req[] is used as a ring, requests head to tail are queued */
+	unsigned head = 0, tail = 0, depth;
+	int ret;
 	int r = 0;
+	bool sg;
 
 	/* read our parameters */
 	smp_rmb();
 	filp = dev->xfer_file;
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
+	synced = dropped = queued_offset = offset;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* receive into the page cache what we know the length of */
+	sg = count != 0xFFFFFFFF && mtp_file_sg(dev, filp);
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet.  Nothing may be queued behind it, or the request
+	 * would swallow the start of the next transfer.
+	 */
+	depth = count == 0xFFFFFFFF ? 1 : dev->rx_reqs;
+	queued = count;
+	atomic_set(&dev->rx_completed, 0);
+
+	while (count > 0) {
+		/* keep the queue full while the file is written */
+		while (tail - head < depth && queued > 0) {
+			req = dev->rx_req[tail % dev->rx_reqs];
+			req->length = min_t(int64_t, queued, dev->rx_req_len);
+			if (sg && req->context) {
+				/* without pages, this one is copied */
+				ret = mtp_sg_rx_build(dev, req, filp,
+						      queued_offset, req->length);
+				if (ret > 0)
+					req->length = ret;
+			}
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
+				mtp_sg_release(req);
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			tail++;
+			if (count != 0xFFFFFFFF)
+				queued -= req->length;
+			queued_offset += req->length;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* requests complete in order, wait for the oldest */
+		req = dev->rx_req[head % dev->rx_reqs];
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&dev->rx_completed) > head ||
+			dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
+		}
+		if (atomic_read(&dev->rx_completed) <= head || req->status) {
+			r = ret < 0 ? ret : -EIO;
+			goto out;
+		}
+		head++;
+
+		if (count != 0xFFFFFFFF)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		if (req->num_sgs)
+			ret = mtp_sg_rx_write(dev, req, filp, &offset);
+		else
+			ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		/* start writeback of the last chunk, drop the one before */
+		if (mtp_cache_chunk && offset - synced >= mtp_cache_chunk) {
+			filemap_flush(filp->f_mapping);
+			mtp_file_drop(filp, dropped, synced);
+			dropped = synced;
+			synced = offset;
 		}
 	}
 
+out:
+	mtp_rx_flush(dev, head, tail);
+	/* drop the pages of requests that were not written out */
+	for (; head != tail; head++)
+		if (atomic_read(&dev->rx_completed) > head)
+			mtp_sg_release(dev->rx_req[head % dev->rx_reqs]);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1126,7 +1667,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < dev->rx_reqs; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
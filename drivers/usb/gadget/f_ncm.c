@@ -60,6 +60,8 @@ enum ncm_notify_state {
 	NCM_NOTIFY_SPEED,		/* issue SPEED_CHANGE next */
 };
 
+#define NCM_MAX_DGRAMS	32	/* per NTB we send */
+
 struct f_ncm {
 	struct gether			port;
 	u8				ctrl_id, data_id;
@@ -78,6 +80,11 @@ struct f_ncm {
 	struct ndp_parser_opts		*parser_opts;
 	bool				is_crc;
 
+	/* datagrams of the NTB being built by ncm_agg_add() */
+	unsigned			tx_dgrams;
+	u32				tx_dgram[NCM_MAX_DGRAMS][2];
+	u16				tx_seq;
+
 	/*
 	 * for notification, it is accessed from both
 	 * callback and ethernet open/close
@@ -102,12 +109,14 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 /*-------------------------------------------------------------------------*/
 
 /*
- * We cannot group frames so use just the minimal size which ok to put
- * one max-size ethernet frame.
- * If the host can group frames, allow it to do that, 16K is selected,
- * because it's used by default by the current linux host driver
+ * Without aggregation in u_ether we send one frame per NTB, and the
+ * minimal size is enough for one max-size ethernet frame; with it, up
+ * to 16K may be grouped.  If the host can group frames, allow it to do
+ * that, 16K is selected, because it's used by default by the current
+ * linux host driver
  */
 #define NTB_DEFAULT_IN_SIZE	USB_CDC_NCM_NTB_MIN_IN_SIZE
+#define NTB_IN_MAX_SIZE		16384
 #define NTB_OUT_SIZE		16384
 
 /*
@@ -123,7 +132,7 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 static struct usb_cdc_ncm_ntb_parameters ntb_parameters = {
 	.wLength = sizeof ntb_parameters,
 	.bmNtbFormatsSupported = cpu_to_le16(FORMATS_SUPPORTED),
-	.dwNtbInMaxSize = cpu_to_le32(NTB_DEFAULT_IN_SIZE),
+	.dwNtbInMaxSize = cpu_to_le32(NTB_IN_MAX_SIZE),
 	.wNdpInDivisor = cpu_to_le16(4),
 	.wNdpInPayloadRemainder = cpu_to_le16(0),
 	.wNdpInAlignment = cpu_to_le16(4),
@@ -460,7 +469,9 @@ static inline void ncm_reset_values(struct f_ncm *ncm)
 	ncm->port.header_len = 0;
 
 	ncm->port.fixed_out_len = le32_to_cpu(ntb_parameters.dwNtbOutMaxSize);
-	ncm->port.fixed_in_len = NTB_DEFAULT_IN_SIZE;
+	ncm->port.fixed_in_len = le32_to_cpu(ntb_parameters.dwNtbInMaxSize);
+	ncm->port.dl_max_xfer_size = ncm->port.fixed_in_len;
+	ncm->tx_dgrams = 0;
 }
 
 /*
@@ -597,6 +608,7 @@ static void ncm_ep0out_complete(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	ncm->port.fixed_in_len = in_size;
+	ncm->port.dl_max_xfer_size = in_size;
 	VDBG(cdev, "Set NTB INPUT SIZE %d\n", in_size);
 	return;
 
@@ -892,6 +904,7 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 	unsigned	max_size = ncm->port.fixed_in_len;
 	struct ndp_parser_opts *opts = ncm->parser_opts;
 	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
+	bool		pad_ntb;
 
 	ncb_len += opts->nth_size;
 	ndp_pad = ALIGN(ncb_len, ndp_align) - ncb_len;
@@ -907,8 +920,14 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		return NULL;
 	}
 
+	/* padding to a full NTB saves a ZLP, but isn't worth it once the
+	 * host raised the NTB size beyond what one frame needs
+	 */
+	pad_ntb = max_size <= NTB_DEFAULT_IN_SIZE;
+
 	skb2 = skb_copy_expand(skb, ncb_len,
-			       max_size - skb->len - ncb_len - crc_len,
+			       pad_ntb ? max_size - skb->len - ncb_len - crc_len
+				       : crc_len,
 			       GFP_ATOMIC);
 	dev_kfree_skb_any(skb);
 	if (!skb2)
@@ -957,19 +976,109 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 	put_ncm(&tmp, opts->dgram_item_len, skb->len - ncb_len);
 	/* (d)wDatagramIndex[1] and  (d)wDatagramLength[1] already zeroed */
 
-	if (skb->len > MAX_TX_NONFIXED)
+	if (pad_ntb && skb->len > MAX_TX_NONFIXED)
 		memset(skb_put(skb, max_size - skb->len),
 		       0, max_size - skb->len);
 
 	return skb;
 }
 
-static int ncm_unwrap_ntb(struct gether *port,
-			  struct sk_buff *skb,
-			  struct sk_buff_head *list)
+/* append one datagram to the NTB in buf; the NTH and NDP come last */
+static int ncm_agg_add(struct gether *port, void *buf, unsigned len,
+		       unsigned size, struct sk_buff *skb)
+{
+	struct f_ncm	*ncm = func_to_ncm(&port->func);
+	struct ndp_parser_opts *opts = ncm->parser_opts;
+	int		div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
+	int		rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
+	int		ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
+	unsigned	index, end;
+
+	if (!len) {
+		ncm->tx_dgrams = 0;
+		len = opts->nth_size;
+	}
+	if (ncm->tx_dgrams == NCM_MAX_DGRAMS)
+		return -ENOSPC;
+
+	index = ALIGN(len, div) + rem;
+	end = index + skb->len + crc_len;
+
+	/* keep room for the NDP: this entry, the others and the zero one */
+	if (ALIGN(end, ndp_align) + opts->ndp_size
+			+ (ncm->tx_dgrams + 2) * 2 * 2 * opts->dgram_item_len
+			> size)
+		return -ENOSPC;
+
+	memset(buf + len, 0, index - len);
+	skb_copy_bits(skb, 0, buf + index, skb->len);
+	if (ncm->is_crc) {
+		uint32_t crc;
+
+		crc = ~crc32_le(~0, buf + index, skb->len);
+		put_unaligned_le32(crc, buf + index + skb->len);
+	}
+
+	ncm->tx_dgram[ncm->tx_dgrams][0] = index;
+	ncm->tx_dgram[ncm->tx_dgrams][1] = skb->len + crc_len;
+	ncm->tx_dgrams++;
+
+	return end;
+}
+
+/* write the NDP after the datagrams, and the NTH pointing to it */
+static unsigned ncm_agg_finish(struct gether *port, void *buf, unsigned len)
+{
+	struct f_ncm	*ncm = func_to_ncm(&port->func);
+	struct ndp_parser_opts *opts = ncm->parser_opts;
+	int		ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	unsigned	ndp_index, ndp_len, i;
+	__le16		*tmp;
+
+	ndp_index = ALIGN(len, ndp_align);
+	ndp_len = opts->ndp_size
+		+ (ncm->tx_dgrams + 1) * 2 * 2 * opts->dgram_item_len;
+	/* alignment, reserved fields and the zero entry */
+	memset(buf + len, 0, ndp_index + ndp_len - len);
+
+	tmp = buf + ndp_index;
+	put_unaligned_le32(opts->ndp_sign, tmp); /* dwSignature */
+	tmp += 2;
+	put_unaligned_le16(ndp_len, tmp++); /* wLength */
+
+	tmp += opts->reserved1;
+	tmp += opts->next_fp_index; /* skip reserved (d)wNextFpIndex */
+	tmp += opts->reserved2;
+
+	for (i = 0; i < ncm->tx_dgrams; i++) {
+		/* (d)wDatagramIndex[i] */
+		put_ncm(&tmp, opts->dgram_item_len, ncm->tx_dgram[i][0]);
+		/* (d)wDatagramLength[i] */
+		put_ncm(&tmp, opts->dgram_item_len, ncm->tx_dgram[i][1]);
+	}
+	ncm->tx_dgrams = 0;
+
+	tmp = buf;
+	memset(tmp, 0, opts->nth_size);
+	put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
+	tmp += 2;
+	/* wHeaderLength */
+	put_unaligned_le16(opts->nth_size, tmp++);
+	put_unaligned_le16(ncm->tx_seq++, tmp++); /* wSequence */
+	/* (d)wBlockLength */
+	put_ncm(&tmp, opts->block_length, ndp_index + ndp_len);
+	/* (d)wFpIndex */
+	put_ncm(&tmp, opts->fp_index, ndp_index);
+
+	return ndp_index + ndp_len;
+}
+
+static int ncm_unwrap_frames(struct gether *port, void *buf, unsigned len,
+			     struct sk_buff_head *list)
 {
 	struct f_ncm	*ncm = func_to_ncm(&port->func);
-	__le16		*tmp = (void *) skb->data;
+	__le16		*tmp = buf;
 	unsigned	index, index2;
 	unsigned	dg_len, dg_len2;
 	unsigned	ndp_len;
@@ -980,12 +1089,17 @@ static int ncm_unwrap_ntb(struct gether *port,
 	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
 	int		dgram_counter;
 
+	if (len < opts->nth_size) {
+		INFO(port->func.config->cdev, "Short NTB, len %d\n", len);
+		goto err;
+	}
+
 	/* dwSignature */
 	if (get_unaligned_le32(tmp) != opts->nth_sign) {
-		INFO(port->func.config->cdev, "Wrong NTH SIGN, skblen %d\n",
-			skb->len);
+		INFO(port->func.config->cdev, "Wrong NTH SIGN, len %d\n",
+			len);
 		print_hex_dump(KERN_INFO, "HEAD:", DUMP_PREFIX_ADDRESS, 32, 1,
-			       skb->data, 32, false);
+			       buf, min_t(unsigned, len, 32), false);
 
 		goto err;
 	}
@@ -1010,9 +1124,13 @@ static int ncm_unwrap_ntb(struct gether *port,
 			index);
 		goto err;
 	}
+	if (index + opts->ndp_size > len) {
+		ret = -EOVERFLOW;
+		goto err;
+	}
 
 	/* walk through NDP */
-	tmp = ((void *)skb->data) + index;
+	tmp = buf + index;
 	if (get_unaligned_le32(tmp) != opts->ndp_sign) {
 		INFO(port->func.config->cdev, "Wrong NDP SIGN\n");
 		goto err;
@@ -1031,6 +1149,10 @@ static int ncm_unwrap_ntb(struct gether *port,
 		INFO(port->func.config->cdev, "Bad NDP length: %x\n", ndp_len);
 		goto err;
 	}
+	if (index + ndp_len > len) {
+		ret = -EOVERFLOW;
+		goto err;
+	}
 	tmp += opts->reserved1;
 	tmp += opts->next_fp_index; /* skip reserved (d)wNextFpIndex */
 	tmp += opts->reserved2;
@@ -1048,14 +1170,15 @@ static int ncm_unwrap_ntb(struct gether *port,
 			     dg_len);
 			goto err;
 		}
+		if (index > len || dg_len > len - index) {
+			ret = -EOVERFLOW;
+			goto err;
+		}
 		if (ncm->is_crc) {
 			uint32_t crc, crc2;
 
-			crc = get_unaligned_le32(skb->data +
-						 index + dg_len - crc_len);
-			crc2 = ~crc32_le(~0,
-					 skb->data + index,
-					 dg_len - crc_len);
+			crc = get_unaligned_le32(buf + index + dg_len - crc_len);
+			crc2 = ~crc32_le(~0, buf + index, dg_len - crc_len);
 			if (crc != crc2) {
 				INFO(port->func.config->cdev, "Bad CRC\n");
 				goto err;
@@ -1065,20 +1188,11 @@ static int ncm_unwrap_ntb(struct gether *port,
 		index2 = get_ncm(&tmp, opts->dgram_item_len);
 		dg_len2 = get_ncm(&tmp, opts->dgram_item_len);
 
-		if (index2 == 0 || dg_len2 == 0) {
-			skb2 = skb;
-		} else {
-			skb2 = skb_clone(skb, GFP_ATOMIC);
-			if (skb2 == NULL)
-				goto err;
-		}
-
-		if (!skb_pull(skb2, index)) {
-			ret = -EOVERFLOW;
+		skb2 = gether_rx_frame(port, buf + index, dg_len - crc_len);
+		if (skb2 == NULL) {
+			ret = -ENOMEM;
 			goto err;
 		}
-
-		skb_trim(skb2, dg_len - crc_len);
 		skb_queue_tail(list, skb2);
 
 		ndp_len -= 2 * (opts->dgram_item_len * 2);
@@ -1094,7 +1208,6 @@ static int ncm_unwrap_ntb(struct gether *port,
 	return 0;
 err:
 	skb_queue_purge(list);
-	dev_kfree_skb_any(skb);
 	return ret;
 }
 
@@ -1396,7 +1509,9 @@ int __init ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	ncm->port.func.disable = ncm_disable;
 
 	ncm->port.wrap = ncm_wrap_ntb;
-	ncm->port.unwrap = ncm_unwrap_ntb;
+	ncm->port.agg_add = ncm_agg_add;
+	ncm->port.agg_finish = ncm_agg_finish;
+	ncm->port.unwrap_frames = ncm_unwrap_frames;
 
 	status = usb_add_function(c, &ncm->port.func);
 	if (status) {
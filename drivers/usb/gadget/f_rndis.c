@@ -76,6 +76,12 @@
  *   - MS-Windows drivers sometimes emit undocumented requests.
  */
 
+/* packet messages the host may put in one OUT transfer */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"Maximum packets per transfer for UL aggregation");
+
 struct rndis_ep_descs {
 	struct usb_endpoint_descriptor	*in;
 	struct usb_endpoint_descriptor	*out;
@@ -398,6 +404,10 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	if (status < 0)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
+
+	/* INITIALIZE tells how much we may send at once */
+	rndis->port.dl_max_xfer_size =
+		rndis_get_dl_max_xfer_size(rndis->config);
 //	spin_unlock(&dev->lock);
 }
 
@@ -706,6 +716,8 @@ rndis_bind(struct usb_configuration *c, struct usb_function *f)
 	rndis->config = status;
 
 	rndis_set_param_medium(rndis->config, NDIS_MEDIUM_802_3, 0);
+	rndis_set_param_max_pkt_xfer(rndis->config,
+			rndis_ul_max_pkt_per_xfer);
 	rndis_set_host_mac(rndis->config, rndis->ethaddr);
 
 	if (rndis_set_param_vendor(rndis->config, rndis->vendorID,
@@ -843,6 +855,9 @@ rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
+	rndis->port.agg_add = rndis_agg_add;
+	rndis->port.unwrap_frames = rndis_unwrap_frames;
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
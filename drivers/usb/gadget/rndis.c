@@ -586,16 +586,19 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->max_pkt_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->max_pkt_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
 
+	/* the most we may send in one transfer */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -903,6 +906,7 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 			rndis_per_dev_params[i].used = 1;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
+			rndis_per_dev_params[i].max_pkt_per_xfer = 1;
 			pr_debug("%s: configNr = %d\n", __func__, i);
 			return i;
 		}
@@ -945,6 +949,23 @@ int rndis_set_param_vendor(u8 configNr, u32 vendorID, const char *vendorDescr)
 	return 0;
 }
 
+int rndis_set_param_max_pkt_xfer(u8 configNr, u32 max)
+{
+	pr_debug("%s: %u\n", __func__, max);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params[configNr].max_pkt_per_xfer = max ? : 1;
+
+	return 0;
+}
+
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+
 int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 {
 	pr_debug("%s: %u %u\n", __func__, medium, speed);
@@ -970,6 +991,28 @@ void rndis_add_hdr(struct sk_buff *skb)
 	header->DataLength = cpu_to_le32(skb->len - sizeof(*header));
 }
 
+/* append one packet message to a multi-packet IN transfer */
+int rndis_agg_add(struct gether *port, void *buf, unsigned len,
+			unsigned size, struct sk_buff *skb)
+{
+	struct rndis_packet_msg_type *header = buf + len;
+	unsigned msg_len = ALIGN(sizeof(*header) + skb->len, 4);
+
+	if (len + msg_len > size)
+		return -ENOSPC;
+
+	memset(header, 0, sizeof *header);
+	header->MessageType = cpu_to_le32(REMOTE_NDIS_PACKET_MSG);
+	header->MessageLength = cpu_to_le32(msg_len);
+	header->DataOffset = cpu_to_le32(36);
+	header->DataLength = cpu_to_le32(skb->len);
+	skb_copy_bits(skb, 0, header + 1, skb->len);
+	memset((void *)(header + 1) + skb->len, 0,
+			msg_len - sizeof(*header) - skb->len);
+
+	return len + msg_len;
+}
+
 void rndis_free_response(int configNr, u8 *buf)
 {
 	rndis_resp_t *r;
@@ -1050,6 +1093,52 @@ int rndis_rm_hdr(struct gether *port,
 	return 0;
 }
 
+/* split an OUT transfer carrying up to max_pkt_per_xfer packet messages */
+int rndis_unwrap_frames(struct gether *port, void *buf, unsigned len,
+			struct sk_buff_head *list)
+{
+	struct sk_buff *skb;
+	u32 msg_len, data_offset, data_len;
+	int status = 0;
+
+	/* anything shorter than a header is padding */
+	while (len >= sizeof(struct rndis_packet_msg_type)) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = buf;
+
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			status = -EINVAL;
+			break;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+		data_offset = get_unaligned_le32(tmp++);
+		data_len = get_unaligned_le32(tmp++);
+
+		if (msg_len > len
+				|| msg_len < sizeof(struct rndis_packet_msg_type)
+				|| data_offset > msg_len - 8
+				|| data_len > msg_len - 8 - data_offset) {
+			status = -EOVERFLOW;
+			break;
+		}
+
+		skb = gether_rx_frame(port, buf + 8 + data_offset, data_len);
+		if (!skb) {
+			status = -ENOMEM;
+			break;
+		}
+		skb_queue_tail(list, skb);
+
+		buf += msg_len;
+		len -= msg_len;
+	}
+
+	if (status < 0)
+		skb_queue_purge(list);
+	return status;
+}
+
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
 
 static int rndis_proc_show(struct seq_file *m, void *v)
@@ -236,6 +236,8 @@ typedef struct rndis_params
 
 	u32			vendorID;
 	const char		*vendorDescr;
+	u32			max_pkt_per_xfer;	/* we accept */
+	u32			dl_max_xfer_size;	/* host accepts */
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
@@ -253,6 +255,12 @@ int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
+int rndis_agg_add(struct gether *port, void *buf, unsigned len,
+			unsigned size, struct sk_buff *skb);
+int rndis_unwrap_frames(struct gether *port, void *buf, unsigned len,
+			struct sk_buff_head *list);
+int rndis_set_param_max_pkt_xfer(u8 configNr, u32 max);
+u32 rndis_get_dl_max_xfer_size(u8 configNr);
 u8   *rndis_get_next_response (int configNr, u32 *length);
 void rndis_free_response (int configNr, u8 *buf);
 
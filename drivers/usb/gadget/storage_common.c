@@ -231,6 +231,7 @@ struct interrupt_data {
 
 struct fsg_lun {
 	struct file	*filp;
+	unsigned int	filp_gen;	/* bumped when the backing file changes */
 	loff_t		file_length;
 	loff_t		num_sectors;
 #ifdef MAX_UNFLUSHED_PACKETS
@@ -246,6 +247,7 @@ struct fsg_lun {
 	unsigned int	registered:1;
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
+	unsigned int	direct:1;	/* bypass the page cache if possible */
 
 	u32		sense_data;
 	u32		sense_data_info;
@@ -605,6 +607,7 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
+	curlun->filp_gen++;
 	curlun->file_length = size;
 	curlun->num_sectors = num_sectors;
 	LDBG(curlun, "open backing file: %s\n", filename);
@@ -622,6 +625,7 @@ static void fsg_lun_close(struct fsg_lun *curlun)
 		LDBG(curlun, "close backing file\n");
 		fput(curlun->filp);
 		curlun->filp = NULL;
+		curlun->filp_gen++;
 	}
 }
 
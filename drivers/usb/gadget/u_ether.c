@@ -28,6 +28,8 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
+#include <linux/slab.h>
 
 #include "u_ether.h"
 
@@ -51,6 +53,19 @@
  * responsible for ensuring that each configuration includes at most one
  * instance of is network link.  (The network layer provides ways for
  * this single "physical" link to be used by multiple virtual links.)
+ *
+ * Functions whose framing allows it (RNDIS, NCM) may also let several
+ * frames share one USB transfer.  On TX, frames are then copied into a
+ * transfer buffer while earlier transfers are still in flight, and the
+ * buffer is queued once it is full or the link goes idle.  On RX, the
+ * transfer lands in a page-backed buffer; small frames are copied out and
+ * larger ones reference the pages, so no second large buffer is needed.
+ *
+ * Completed OUT transfers are only queued by rx_complete(); eth_poll()
+ * unwraps them under NAPI and passes the frames through GRO, so a burst
+ * of TCP segments reaches the stack as a few large packets.  Links with
+ * one frame per transfer and no framing (ECM, subset) receive into page
+ * fragments shared by a few requests, which GRO merges without copying.
  */
 
 #define UETH__VERSION	"29-May-2008"
@@ -69,7 +84,13 @@ struct eth_dev {
 	struct list_head	tx_reqs, rx_reqs;
 	atomic_t		tx_qlen;
 
-	struct sk_buff_head	rx_frames;
+	struct sk_buff_head	rx_frames;	/* unwrapped, for eth_poll() */
+	struct napi_struct	napi;
+	struct list_head	rx_done;	/* completed; uses req_lock */
+
+	/* page carved into rx buffers of unframed links; uses req_lock */
+	struct page		*rx_page;
+	unsigned		rx_page_off;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -84,6 +105,15 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* multi-frame transfers; the tx_agg_* fields use req_lock */
+	bool			tx_agg;
+	bool			rx_agg;
+	unsigned		tx_agg_size;
+	struct usb_request	*tx_agg_req;	/* being filled */
+	unsigned		tx_agg_len;
+	unsigned		tx_agg_cnt;
+	struct hrtimer		tx_agg_timer;
 };
 
 /*-------------------------------------------------------------------------*/
@@ -92,6 +122,11 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define RX_COPYBREAK	256	/* aggregated rx frames copied whole */
+#define RX_COPY_HDR	128	/* else only this much goes in the head */
+
+#define ETH_NAPI_WEIGHT	64	/* frames per eth_poll() call */
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -103,6 +138,23 @@ MODULE_PARM_DESC(qmult, "queue length multiplier at high speed");
 #define qmult		1
 #endif
 
+/* IN transfers carrying several frames are closed after tx_agg_pkts
+ * frames, when the next frame won't fit in tx_agg_size bytes (or what
+ * the host accepts), when no other transfer is in flight, or after
+ * tx_agg_timeout usecs.
+ */
+static unsigned tx_agg_pkts = 8;
+module_param(tx_agg_pkts, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_agg_pkts, "max frames per IN transfer, 1 to disable");
+
+static unsigned tx_agg_size = 16384;
+module_param(tx_agg_size, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_agg_size, "IN transfer buffer size when aggregating");
+
+static unsigned tx_agg_timeout = 500;
+module_param(tx_agg_timeout, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_agg_timeout, "usecs an IN transfer may wait for frames");
+
 /* for dual-speed hardware, use deeper queues at highspeed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -203,10 +255,60 @@ static void defer_kevent(struct eth_dev *dev, int flag)
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req);
 
+/* carve a cache aligned rx buffer out of the page shared by requests */
+static void *rx_frag_alloc(struct eth_dev *dev, unsigned size, gfp_t gfp_flags)
+{
+	struct page	*page = NULL;
+	void		*buf = NULL;
+	unsigned long	flags;
+
+	size = ALIGN(size, L1_CACHE_BYTES);
+again:
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (dev->rx_page && dev->rx_page_off + size > PAGE_SIZE) {
+		put_page(dev->rx_page);
+		dev->rx_page = NULL;
+	}
+	if (!dev->rx_page && page) {
+		dev->rx_page = page;
+		dev->rx_page_off = 0;
+		page = NULL;
+	}
+	if (dev->rx_page) {
+		get_page(dev->rx_page);
+		buf = page_address(dev->rx_page) + dev->rx_page_off;
+		dev->rx_page_off += size;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (!buf && !page) {
+		page = alloc_page(gfp_flags | __GFP_NOWARN);
+		if (page)
+			goto again;
+	}
+
+	/* someone else installed a page meanwhile */
+	if (page)
+		put_page(page);
+	return buf;
+}
+
+/* free the buffer of an rx request whose data won't be used */
+static void rx_free_buf(struct eth_dev *dev, struct usb_request *req)
+{
+	if (req->context)
+		dev_kfree_skb_any(req->context);
+	else if (dev->rx_agg)
+		free_pages_exact(req->buf, req->length);
+	else
+		put_page(virt_to_page(req->buf));
+	req->context = NULL;
+}
+
 static int
 rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 {
-	struct sk_buff	*skb;
+	struct sk_buff	*skb = NULL;
 	int		retval = -ENOMEM;
 	size_t		size = 0;
 	struct usb_ep	*out;
@@ -237,25 +339,44 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->rx_agg)
+		size *= max_t(u32, dev->port_usb->ul_max_pkts_per_xfer, 1);
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
 	if (dev->port_usb->is_fixed)
 		size = max_t(size_t, size, dev->port_usb->fixed_out_len);
 
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
-	if (skb == NULL) {
-		DBG(dev, "no rx skb\n");
-		goto enomem;
-	}
+	req->buf = NULL;
+	if (dev->rx_agg) {
+		/* frames are built over these pages by unwrap_frames() */
+		req->buf = alloc_pages_exact(size, gfp_flags | __GFP_NOWARN);
+		if (req->buf == NULL) {
+			DBG(dev, "no rx pages\n");
+			goto enomem;
+		}
+	} else if (!dev->unwrap && size <= PAGE_SIZE) {
+		/* the frame is built over this fragment by eth_poll() */
+		req->buf = rx_frag_alloc(dev, size, gfp_flags);
+		if (req->buf == NULL) {
+			DBG(dev, "no rx fragment\n");
+			goto enomem;
+		}
+	} else {
+		skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+		if (skb == NULL) {
+			DBG(dev, "no rx skb\n");
+			goto enomem;
+		}
 
-	/* Some platforms perform better when IP packets are aligned,
-	 * but on at least one, checksumming fails otherwise.  Note:
-	 * RNDIS headers involve variable numbers of LE32 values.
-	 */
-	skb_reserve(skb, NET_IP_ALIGN);
+		/* Some platforms perform better when IP packets are aligned,
+		 * but on at least one, checksumming fails otherwise.  Note:
+		 * RNDIS headers involve variable numbers of LE32 values.
+		 */
+		skb_reserve(skb, NET_IP_ALIGN);
+		req->buf = skb->data;
+	}
 
-	req->buf = skb->data;
 	req->length = size;
 	req->complete = rx_complete;
 	req->context = skb;
@@ -266,8 +387,8 @@ enomem:
 		defer_kevent(dev, WORK_RX_MEMORY);
 	if (retval) {
 		DBG(dev, "rx submit --> %d\n", retval);
-		if (skb)
-			dev_kfree_skb_any(skb);
+		if (req->buf)
+			rx_free_buf(dev, req);
 		spin_lock_irqsave(&dev->req_lock, flags);
 		list_add(&req->list, &dev->rx_reqs);
 		spin_unlock_irqrestore(&dev->req_lock, flags);
@@ -275,16 +396,109 @@ enomem:
 	return retval;
 }
 
-static void rx_complete(struct usb_ep *ep, struct usb_request *req)
+static struct sk_buff *rx_frame(struct eth_dev *dev, void *data, unsigned len)
 {
-	struct sk_buff	*skb = req->context, *skb2;
-	struct eth_dev	*dev = ep->driver_data;
-	int		status = req->status;
+	struct sk_buff	*skb;
+	unsigned	copy = len <= RX_COPYBREAK ? len : RX_COPY_HDR;
+
+	skb = netdev_alloc_skb_ip_align(dev->net, copy);
+	if (!skb)
+		return NULL;
+	memcpy(skb_put(skb, copy), data, copy);
+	data += copy;
+	len -= copy;
+
+	while (len) {
+		struct page	*page = virt_to_page(data);
+		unsigned	offset = offset_in_page(data);
+		unsigned	n = min_t(unsigned, len, PAGE_SIZE - offset);
+		int		i = skb_shinfo(skb)->nr_frags;
+
+		if (i == MAX_SKB_FRAGS) {
+			dev_kfree_skb_any(skb);
+			return NULL;
+		}
+		get_page(page);
+		skb_fill_page_desc(skb, i, page, offset, n);
+		skb->len += n;
+		skb->data_len += n;
+		skb->truesize += n;
+		data += n;
+		len -= n;
+	}
+	return skb;
+}
 
-	switch (status) {
+/**
+ * gether_rx_frame - build an skb for one frame of an aggregated transfer
+ * @port: the USB link whose unwrap_frames() hook is running
+ * @data: start of the frame, inside the transfer buffer
+ * @len: length of the frame
+ *
+ * Short frames are copied.  Longer ones get their headers copied into
+ * the skb head and the rest attached as fragments of the transfer's
+ * pages, which stay allocated until the last such skb is freed.
+ *
+ * Returns the skb, or NULL if none could be allocated.
+ */
+struct sk_buff *gether_rx_frame(struct gether *port, void *data, unsigned len)
+{
+	return rx_frame(port->ioport, data, len);
+}
 
-	/* normal completion */
-	case 0:
+static int rx_unwrap_frames(struct eth_dev *dev, struct usb_request *req,
+		struct sk_buff_head *list)
+{
+	unsigned long	flags;
+	int		status;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		status = dev->port_usb->unwrap_frames(dev->port_usb, req->buf,
+				req->actual, list);
+	else
+		status = -ENOTCONN;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	/* the frames hold their own references to the pages */
+	free_pages_exact(req->buf, req->length);
+	return status;
+}
+
+/* give an rx request back to the hardware, or park it while we're down */
+static void rx_requeue(struct eth_dev *dev, struct usb_request *req)
+{
+	unsigned long	flags;
+
+	if (netif_running(dev->net)) {
+		rx_submit(dev, req, GFP_ATOMIC);
+		return;
+	}
+	spin_lock_irqsave(&dev->req_lock, flags);
+	list_add(&req->list, &dev->rx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+/* split a completed transfer into frames on rx_frames and requeue it */
+static void rx_unwrap(struct eth_dev *dev, struct usb_request *req)
+{
+	struct sk_buff		*skb = req->context;
+	struct sk_buff_head	frames;
+	int			status = 0;
+
+	skb_queue_head_init(&frames);
+
+	if (dev->rx_agg) {
+		status = rx_unwrap_frames(dev, req, &frames);
+	} else if (!skb) {
+		/* the frame keeps its own reference to the fragment */
+		skb = rx_frame(dev, req->buf, req->actual);
+		put_page(virt_to_page(req->buf));
+		if (skb)
+			__skb_queue_tail(&frames, skb);
+		else
+			dev->net->stats.rx_dropped++;
+	} else {
 		skb_put(skb, req->actual);
 
 		if (dev->unwrap) {
@@ -294,40 +508,143 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 			if (dev->port_usb) {
 				status = dev->unwrap(dev->port_usb,
 							skb,
-							&dev->rx_frames);
+							&frames);
 			} else {
 				dev_kfree_skb_any(skb);
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
 		} else {
-			skb_queue_tail(&dev->rx_frames, skb);
+			__skb_queue_tail(&frames, skb);
 		}
-		skb = NULL;
-
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
+	}
+	req->context = NULL;
 
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+	if (status < 0) {
+		while ((skb = __skb_dequeue(&frames)) != NULL) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx unwrap %d\n", status);
+			dev_kfree_skb_any(skb);
 		}
-		break;
+	} else {
+		skb_queue_splice_tail(&frames, &dev->rx_frames);
+	}
+
+	rx_requeue(dev, req);
+}
+
+static struct usb_request *rx_done_get(struct eth_dev *dev)
+{
+	struct usb_request	*req = NULL;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!list_empty(&dev->rx_done)) {
+		req = container_of(dev->rx_done.next,
+				struct usb_request, list);
+		list_del(&req->list);
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	return req;
+}
+
+/* throw away transfers which completed but weren't polled */
+static void rx_done_flush(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	while ((req = rx_done_get(dev)) != NULL) {
+		rx_free_buf(dev, req);
+		spin_lock_irqsave(&dev->req_lock, flags);
+		list_add(&req->list, &dev->rx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	}
+}
+
+/*
+ * GRO only merges TCP segments whose checksum is already known, and the
+ * link offloads none.  Sum IP frames here, from the network header on as
+ * CHECKSUM_COMPLETE expects; the TCP checksum is then checked against
+ * the pseudo header without another pass over the data.
+ */
+static void rx_csum(struct sk_buff *skb)
+{
+	if (skb->protocol != htons(ETH_P_IP) &&
+	    skb->protocol != htons(ETH_P_IPV6))
+		return;
+
+	skb->csum = skb_checksum(skb, 0, skb->len, 0);
+	skb->ip_summed = CHECKSUM_COMPLETE;
+}
+
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev		*dev = container_of(napi, struct eth_dev, napi);
+	struct usb_request	*req;
+	struct sk_buff		*skb;
+	int			work = 0;
+
+	while (work < budget) {
+		skb = __skb_dequeue(&dev->rx_frames);
+		if (!skb) {
+			req = rx_done_get(dev);
+			if (!req)
+				break;
+			rx_unwrap(dev, req);
+			continue;
+		}
+
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+		rx_csum(skb);
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		unsigned long	flags;
+		bool		more;
+
+		napi_complete(napi);
+
+		/* a transfer may have completed after we looked */
+		spin_lock_irqsave(&dev->req_lock, flags);
+		more = !list_empty(&dev->rx_done);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		if (more)
+			napi_schedule(napi);
+	}
+	return work;
+}
+
+static void rx_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct eth_dev	*dev = ep->driver_data;
+	int		status = req->status;
+
+	switch (status) {
+
+	/* normal completion; eth_poll() takes it from here */
+	case 0:
+		spin_lock(&dev->req_lock);
+		list_add_tail(&req->list, &dev->rx_done);
+		spin_unlock(&dev->req_lock);
+		napi_schedule(&dev->napi);
+		return;
 
 	/* software-driven interface shutdown */
 	case -ECONNRESET:		/* unlink */
@@ -340,7 +657,7 @@ next_frame:
 		DBG(dev, "rx %s reset\n", ep->name);
 		defer_kevent(dev, WORK_RX_MEMORY);
 quiesce:
-		dev_kfree_skb_any(skb);
+		rx_free_buf(dev, req);
 		goto clean;
 
 	/* data overrun */
@@ -354,8 +671,7 @@ quiesce:
 		break;
 	}
 
-	if (skb)
-		dev_kfree_skb_any(skb);
+	rx_free_buf(dev, req);
 	if (!netif_running(dev->net)) {
 clean:
 		spin_lock(&dev->req_lock);
@@ -425,6 +741,34 @@ done:
 	return status;
 }
 
+static int tx_agg_alloc(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	int			status = 0;
+
+	dev->tx_agg_size = clamp_t(unsigned, tx_agg_size, 2048, 65536);
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list)
+		req->buf = NULL;
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(dev->tx_agg_size, GFP_ATOMIC);
+		if (!req->buf) {
+			status = -ENOMEM;
+			break;
+		}
+	}
+	if (status < 0) {
+		DBG(dev, "can't alloc tx buffers, not aggregating\n");
+		list_for_each_entry(req, &dev->tx_reqs, list) {
+			kfree(req->buf);
+			req->buf = NULL;
+		}
+	}
+	spin_unlock(&dev->req_lock);
+	return status;
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -461,6 +805,8 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_agg_flush(struct eth_dev *dev);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -475,20 +821,198 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* aggregated frames were counted as they were added */
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	/* once the link goes idle, don't hold back collected frames */
+	if (atomic_dec_and_test(&dev->tx_qlen) && dev->tx_agg)
+		tx_agg_flush(dev);
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
+/*
+ * Close the IN transfer being filled and hand it back for queueing.
+ * Caller holds dev->lock (for port) and dev->req_lock.
+ */
+static struct usb_request *
+tx_agg_take(struct eth_dev *dev, struct gether *port, unsigned *cnt)
+{
+	struct usb_request	*req = dev->tx_agg_req;
+	struct usb_ep		*in = port->in_ep;
+	unsigned		length = dev->tx_agg_len;
+
+	if (!req)
+		return NULL;
+	dev->tx_agg_req = NULL;
+	*cnt = dev->tx_agg_cnt;
+
+	if (port->agg_finish)
+		length = port->agg_finish(port, req->buf, length);
+
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (port->is_fixed &&
+	    length == port->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* the buffer keeps a spare byte for this */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0)
+		length++;
+
+	req->length = length;
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->no_interrupt = 0;
+	return req;
+}
+
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, unsigned cnt)
+{
+	unsigned long	flags;
+	int		retval;
 
-	atomic_dec(&dev->tx_qlen);
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval == 0) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped += cnt;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+static void tx_agg_flush(struct eth_dev *dev)
+{
+	struct usb_request	*req = NULL;
+	struct usb_ep		*in = NULL;
+	unsigned long		flags;
+	unsigned		cnt;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb) {
+		in = dev->port_usb->in_ep;
+		spin_lock(&dev->req_lock);
+		req = tx_agg_take(dev, dev->port_usb, &cnt);
+		spin_unlock(&dev->req_lock);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (req)
+		tx_agg_queue(dev, in, req, cnt);
+}
+
+static enum hrtimer_restart tx_agg_timer_fn(struct hrtimer *timer)
+{
+	tx_agg_flush(container_of(timer, struct eth_dev, tx_agg_timer));
+	return HRTIMER_NORESTART;
+}
+
+/* copy the frame into the IN transfer being filled */
+static netdev_tx_t eth_agg_xmit(struct eth_dev *dev, struct sk_buff *skb)
+{
+	struct usb_request	*req, *full = NULL, *now = NULL;
+	struct gether		*port;
+	struct usb_ep		*in;
+	unsigned long		flags;
+	unsigned		limit, full_cnt = 0, now_cnt = 0;
+	unsigned		length = skb->len;
+	netdev_tx_t		ret = NETDEV_TX_OK;
+	bool			arm = false;
+	int			status;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	port = dev->port_usb;
+	if (!port) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+	in = port->in_ep;
+
+	spin_lock(&dev->req_lock);
+	for (;;) {
+		req = dev->tx_agg_req;
+		if (!req) {
+			if (list_empty(&dev->tx_reqs)) {
+				netif_stop_queue(dev->net);
+				ret = NETDEV_TX_BUSY;
+				goto unlock;
+			}
+			req = container_of(dev->tx_reqs.next,
+					struct usb_request, list);
+			list_del(&req->list);
+			dev->tx_agg_req = req;
+			dev->tx_agg_len = 0;
+			dev->tx_agg_cnt = 0;
+		}
+
+		/* a lone frame only has to fit the buffer */
+		limit = dev->tx_agg_size;
+		if (dev->tx_agg_cnt && port->dl_max_xfer_size)
+			limit = min(limit, port->dl_max_xfer_size);
+		status = port->agg_add(port, req->buf, dev->tx_agg_len,
+				limit - 1, skb);
+		if (status != -ENOSPC || !dev->tx_agg_cnt || full)
+			break;
+
+		/* this one is full, start another */
+		full = tx_agg_take(dev, port, &full_cnt);
+	}
+
+	if (status < 0) {
+		DBG(dev, "tx agg err %d\n", status);
+		dev->net->stats.tx_dropped++;
+	} else {
+		dev->tx_agg_len = status;
+		dev->tx_agg_cnt++;
+		dev->net->stats.tx_packets++;
+		dev->net->stats.tx_bytes += length;
+	}
+	dev_kfree_skb_any(skb);
+
+	if (dev->tx_agg_cnt >= tx_agg_pkts || !tx_agg_timeout
+			|| (!full && !atomic_read(&dev->tx_qlen)))
+		now = tx_agg_take(dev, port, &now_cnt);
+	else if (dev->tx_agg_req && dev->tx_agg_cnt == 1)
+		arm = true;
+
+	if (!dev->tx_agg_req && list_empty(&dev->tx_reqs))
+		netif_stop_queue(dev->net);
+unlock:
+	spin_unlock(&dev->req_lock);
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (full)
+		tx_agg_queue(dev, in, full, full_cnt);
+	if (now)
+		tx_agg_queue(dev, in, now, now_cnt);
+	if (arm)
+		hrtimer_start(&dev->tx_agg_timer,
+				ns_to_ktime(tx_agg_timeout * NSEC_PER_USEC),
+				HRTIMER_MODE_REL);
+	return ret;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -542,6 +1066,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_agg)
+		return eth_agg_xmit(dev, skb);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -647,6 +1174,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -666,6 +1194,7 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -699,6 +1228,9 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	rx_done_flush(dev);
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -802,6 +1334,9 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_WORK(&dev->work, eth_work);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	INIT_LIST_HEAD(&dev->rx_done);
+	hrtimer_init(&dev->tx_agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_agg_timer.function = tx_agg_timer_fn;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -820,6 +1355,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 		memcpy(ethaddr, dev->host_mac, ETH_ALEN);
 
 	net->netdev_ops = &eth_netdev_ops;
+	netif_napi_add(net, &dev->napi, eth_poll, ETH_NAPI_WEIGHT);
 
 	SET_ETHTOOL_OPS(net, &ops);
 
@@ -860,6 +1396,8 @@ void gether_cleanup(void)
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	if (the_dev->rx_page)
+		put_page(the_dev->rx_page);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -917,6 +1455,13 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		dev->tx_agg = link->agg_add && tx_agg_pkts > 1
+				&& tx_agg_alloc(dev) == 0;
+		dev->rx_agg = link->unwrap_frames
+				&& (link->is_fixed
+					|| link->ul_max_pkts_per_xfer > 1);
+		DBG(dev, "aggregation tx %d rx %d\n", dev->tx_agg, dev->rx_agg);
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -976,21 +1521,30 @@ void gether_disconnect(struct gether *link)
 	 * and forget about the endpoints.
 	 */
 	usb_ep_disable(link->in_ep);
+	hrtimer_cancel(&dev->tx_agg_timer);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_agg)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
 	spin_unlock(&dev->req_lock);
+	dev->tx_agg = false;
 	link->in_ep->driver_data = NULL;
 	link->in = NULL;
 
 	usb_ep_disable(link->out_ep);
+	rx_done_flush(dev);
 	spin_lock(&dev->req_lock);
 	while (!list_empty(&dev->rx_reqs)) {
 		req = container_of(dev->rx_reqs.next,
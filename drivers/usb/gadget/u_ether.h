@@ -72,6 +72,26 @@ struct gether {
 						struct sk_buff *skb,
 						struct sk_buff_head *list);
 
+	/* optional hooks for carrying several frames per transfer.
+	 * agg_add() appends one frame to a transfer buffer which already
+	 * holds len bytes, returning the new length or -ENOSPC if the
+	 * frame would take the transfer past size bytes; agg_finish()
+	 * fills in any framing which depends on the whole transfer.
+	 * unwrap_frames() splits a received transfer into frames built
+	 * with gether_rx_frame().
+	 */
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
+	int				(*agg_add)(struct gether *port,
+						void *buf, unsigned len,
+						unsigned size,
+						struct sk_buff *skb);
+	unsigned			(*agg_finish)(struct gether *port,
+						void *buf, unsigned len);
+	int				(*unwrap_frames)(struct gether *port,
+						void *buf, unsigned len,
+						struct sk_buff_head *list);
+
 	/* called on network open/close */
 	void				(*open)(struct gether *);
 	void				(*close)(struct gether *);
@@ -94,6 +114,10 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 struct net_device *gether_connect(struct gether *);
 void gether_disconnect(struct gether *);
 
+/* for unwrap_frames(): a frame backed by the transfer buffer */
+struct sk_buff *gether_rx_frame(struct gether *port, void *data,
+		unsigned len);
+
 /* Some controllers can't support CDC Ethernet (ECM) ... */
 static inline bool can_support_ecm(struct usb_gadget *gadget)
 {
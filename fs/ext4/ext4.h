@@ -1212,6 +1212,8 @@ struct ext4_sb_info {
 	struct ext4_li_request *s_li_request;
 	/* Wait multiplier for lazy initialization thread */
 	unsigned int s_li_wait_mult;
+	/* Times lazy init backed off because of foreground I/O */
+	unsigned long s_li_deferrals;
 
 	/* Kernel thread for multiple mount protection */
 	struct task_struct *s_mmp_tsk;
@@ -1613,6 +1615,7 @@ void ext4_get_group_no_and_offset(struct super_block *sb, ext4_fsblk_t blocknr,
  */
 #define EXT4_DEF_LI_WAIT_MULT			10
 #define EXT4_DEF_LI_MAX_START_DELAY		5
+#define EXT4_DEF_LI_MAX_DEFER			8
 #define EXT4_LAZYINIT_QUIT			0x0001
 #define EXT4_LAZYINIT_RUNNING			0x0002
 
@@ -1632,6 +1635,8 @@ struct ext4_li_request {
 	struct list_head	lr_request;
 	unsigned long		lr_next_sched;
 	unsigned long		lr_timeout;
+	unsigned long		lr_io_sectors;	/* device I/O at last check */
+	unsigned int		lr_deferred;	/* consecutive back-offs */
 };
 
 struct ext4_features {
@@ -2167,6 +2172,9 @@ extern void ext4_ext_init(struct super_block *);
 extern void ext4_ext_release(struct super_block *);
 extern long ext4_fallocate(struct file *file, int mode, loff_t offset,
 			  loff_t len);
+extern int __ext4_convert_unwritten_extents(handle_t *handle,
+					    struct inode *inode,
+					    loff_t offset, ssize_t len);
 extern int ext4_convert_unwritten_extents(struct inode *inode, loff_t offset,
 			  ssize_t len);
 extern int ext4_map_blocks(handle_t *handle, struct inode *inode,
@@ -2184,7 +2192,7 @@ extern void ext4_exit_pageio(void);
 extern void ext4_ioend_wait(struct inode *);
 extern void ext4_free_io_end(ext4_io_end_t *io);
 extern ext4_io_end_t *ext4_init_io_end(struct inode *inode, gfp_t flags);
-extern int ext4_end_io_nolock(ext4_io_end_t *io);
+extern int ext4_end_io_batch(struct inode *inode);
 extern void ext4_io_submit(struct ext4_io_submit *io);
 extern int ext4_bio_write_page(struct ext4_io_submit *io,
 			       struct page *page,
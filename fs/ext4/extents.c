@@ -3857,22 +3857,18 @@ retry:
 }
 
 /*
- * This function convert a range of blocks to written extents
- * The caller of this function will pass the start offset and the size.
- * all unwritten extents within this range will be converted to
- * written extents.
- *
- * This function is called from the direct IO end io call back
- * function, to convert the fallocated extents after IO is completed.
+ * Convert a range of blocks to written extents within the running
+ * transaction @handle.  The handle is extended, or restarted if it
+ * cannot be extended, whenever it runs short of credits, so a caller
+ * can convert several ranges under one handle.
  * Returns 0 on success.
  */
-int ext4_convert_unwritten_extents(struct inode *inode, loff_t offset,
-				    ssize_t len)
+int __ext4_convert_unwritten_extents(handle_t *handle, struct inode *inode,
+				     loff_t offset, ssize_t len)
 {
-	handle_t *handle;
 	unsigned int max_blocks;
 	int ret = 0;
-	int ret2 = 0;
+	int err;
 	struct ext4_map_blocks map;
 	unsigned int credits, blkbits = inode->i_blkbits;
 
@@ -3890,10 +3886,15 @@ int ext4_convert_unwritten_extents(struct inode *inode, loff_t offset,
 	while (ret >= 0 && ret < max_blocks) {
 		map.m_lblk += ret;
 		map.m_len = (max_blocks -= ret);
-		handle = ext4_journal_start(inode, credits);
-		if (IS_ERR(handle)) {
-			ret = PTR_ERR(handle);
-			break;
+		if (ext4_handle_valid(handle) &&
+		    handle->h_buffer_credits < credits) {
+			err = ext4_journal_extend(handle, credits);
+			if (err > 0)
+				err = ext4_journal_restart(handle, credits);
+			if (err) {
+				ret = err;
+				break;
+			}
 		}
 		ret = ext4_map_blocks(handle, inode, &map,
 				      EXT4_GET_BLOCKS_IO_CONVERT_EXT);
@@ -3903,13 +3904,40 @@ int ext4_convert_unwritten_extents(struct inode *inode, loff_t offset,
 				    "returned error inode#%lu, block=%u, "
 				    "max_blocks=%u", __func__,
 				    inode->i_ino, map.m_lblk, map.m_len);
-		}
-		ext4_mark_inode_dirty(handle, inode);
-		ret2 = ext4_journal_stop(handle);
-		if (ret <= 0 || ret2 )
 			break;
+		}
 	}
-	return ret > 0 ? ret2 : ret;
+	return ret > 0 ? 0 : ret;
+}
+
+/*
+ * This function convert a range of blocks to written extents
+ * The caller of this function will pass the start offset and the size.
+ * all unwritten extents within this range will be converted to
+ * written extents.
+ *
+ * This function is called from the direct IO end io call back
+ * function, to convert the fallocated extents after IO is completed.
+ * Returns 0 on success.
+ */
+int ext4_convert_unwritten_extents(struct inode *inode, loff_t offset,
+				    ssize_t len)
+{
+	handle_t *handle;
+	unsigned int max_blocks, blkbits = inode->i_blkbits;
+	int ret, ret2;
+
+	max_blocks = (EXT4_BLOCK_ALIGN(len + offset, blkbits) >> blkbits) -
+		     (offset >> blkbits);
+	handle = ext4_journal_start(inode,
+				    ext4_chunk_trans_blocks(inode, max_blocks));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	ret = __ext4_convert_unwritten_extents(handle, inode, offset, len);
+	ext4_mark_inode_dirty(handle, inode);
+	ret2 = ext4_journal_stop(handle);
+	return ret ? ret : ret2;
 }
 
 /*
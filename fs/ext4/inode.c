@@ -37,6 +37,7 @@
 #include <linux/namei.h>
 #include <linux/uio.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
 #include <linux/workqueue.h>
 #include <linux/kernel.h>
 #include <linux/printk.h>
@@ -2913,6 +2914,7 @@ static int ext4_da_writepages(struct address_space *mapping,
 	struct ext4_sb_info *sbi = EXT4_SB(mapping->host->i_sb);
 	pgoff_t done_index = 0;
 	pgoff_t end;
+	struct blk_plug plug;
 
 	trace_ext4_da_writepages(inode, wbc);
 
@@ -2987,6 +2989,14 @@ static int ext4_da_writepages(struct address_space *mapping,
 		wbc->nr_to_write = desired_nr_to_write;
 	}
 
+	/*
+	 * Each extent is submitted in its own bio(s) from inside its own
+	 * transaction.  Hold a plug across the whole range so that bios
+	 * for physically adjacent extents are merged into large requests
+	 * before they reach the elevator.  The plug is flushed whenever
+	 * we sleep, e.g. waiting on the journal in ext4_journal_start().
+	 */
+	blk_start_plug(&plug);
 retry:
 	if (wbc->sync_mode == WB_SYNC_ALL || wbc->tagged_writepages)
 		tag_pages_for_writeback(mapping, index, end);
@@ -3073,6 +3083,7 @@ retry:
 		mapping->writeback_index = done_index;
 
 out_writepages:
+	blk_finish_plug(&plug);
 	wbc->nr_to_write -= nr_to_writebump;
 	wbc->range_start = range_start;
 	trace_ext4_da_writepages_result(inode, wbc, ret, pages_written);
@@ -30,6 +30,8 @@
 #include "acl.h"
 #include "ext4_extents.h"
 
+#include <trace/events/ext4.h>
+
 static struct kmem_cache *io_page_cachep, *io_end_cachep;
 
 int __init ext4_init_pageio(void)
@@ -86,48 +88,100 @@ void ext4_free_io_end(ext4_io_end_t *io)
 }
 
 /*
- * check a range of space and convert unwritten extents to written.
+ * Finish an io_end whose unwritten extents have been converted.
  */
-int ext4_end_io_nolock(ext4_io_end_t *io)
+static void ext4_end_io_done(ext4_io_end_t *io)
 {
 	struct inode *inode = io->inode;
-	loff_t offset = io->offset;
-	ssize_t size = io->size;
 	wait_queue_head_t *wq;
-	int ret = 0;
 
-	ext4_debug("ext4_end_io_nolock: io 0x%p from inode %lu,list->next 0x%p,"
-		   "list->prev 0x%p\n",
-		   io, inode->i_ino, io->list.next, io->list.prev);
+	if (io->iocb)
+		aio_complete(io->iocb, io->result, 0);
+	/* clear the DIO AIO unwritten flag */
+	io->flag &= ~EXT4_IO_END_UNWRITTEN;
+	/* Wake up anyone waiting on unwritten extent conversion */
+	wq = ext4_ioend_wq(inode);
+	if (atomic_dec_and_test(&EXT4_I(inode)->i_aiodio_unwritten) &&
+	    waitqueue_active(wq))
+		wake_up_all(wq);
+}
 
-	if (list_empty(&io->list))
-		return ret;
+/*
+ * Convert the unwritten extents of every completed IO queued on the
+ * inode.  All conversions share one transaction (unless it runs out
+ * of credits and has to be restarted), so a stream of small io_ends
+ * does not cost one journal handle each.  Converted io_ends are taken
+ * off the completed list but are not freed; that is left to their own
+ * work item.  On error the unprocessed io_ends stay on the list.
+ *
+ * Caller must hold i_mutex.
+ */
+int ext4_end_io_batch(struct inode *inode)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	ext4_io_end_t *io, *tmp;
+	unsigned long flags;
+	handle_t *handle;
+	LIST_HEAD(batch);
+	LIST_HEAD(done);
+	unsigned int blkbits = inode->i_blkbits;
+	int nr_ios = 0;
+	loff_t bytes = 0;
+	int ret = 0, ret2;
 
-	if (!(io->flag & EXT4_IO_END_UNWRITTEN))
-		return ret;
+	spin_lock_irqsave(&ei->i_completed_io_lock, flags);
+	list_splice_init(&ei->i_completed_io_list, &batch);
+	spin_unlock_irqrestore(&ei->i_completed_io_lock, flags);
 
-	ret = ext4_convert_unwritten_extents(inode, offset, size);
-	if (ret < 0) {
-		printk(KERN_EMERG "%s: failed to convert unwritten "
-			"extents to written extents, error is %d "
-			"io is still on inode %lu aio dio list\n",
-		       __func__, ret, inode->i_ino);
-		return ret;
+	if (list_empty(&batch))
+		return 0;
+
+	io = list_first_entry(&batch, ext4_io_end_t, list);
+	handle = ext4_journal_start(inode, ext4_chunk_trans_blocks(inode,
+					(io->size >> blkbits) + 1));
+	if (IS_ERR(handle)) {
+		ret = PTR_ERR(handle);
+		goto out;
 	}
 
-	if (io->iocb)
-		aio_complete(io->iocb, io->result, 0);
-	/* clear the DIO AIO unwritten flag */
-	if (io->flag & EXT4_IO_END_UNWRITTEN) {
-		io->flag &= ~EXT4_IO_END_UNWRITTEN;
-		/* Wake up anyone waiting on unwritten extent conversion */
-		wq = ext4_ioend_wq(io->inode);
-		if (atomic_dec_and_test(&EXT4_I(inode)->i_aiodio_unwritten) &&
-		    waitqueue_active(wq)) {
-			wake_up_all(wq);
+	list_for_each_entry_safe(io, tmp, &batch, list) {
+		ext4_debug("ext4_end_io_batch: io 0x%p from inode %lu\n",
+			   io, inode->i_ino);
+		if (io->flag & EXT4_IO_END_UNWRITTEN) {
+			ret = __ext4_convert_unwritten_extents(handle, inode,
+							io->offset, io->size);
+			if (ret < 0) {
+				printk(KERN_EMERG "%s: failed to convert "
+				       "unwritten extents to written extents, "
+				       "error is %d io is still on inode %lu "
+				       "aio dio list\n",
+				       __func__, ret, inode->i_ino);
+				break;
+			}
+			nr_ios++;
+			bytes += io->size;
 		}
+		list_move_tail(&io->list, &done);
 	}
 
+	ext4_mark_inode_dirty(handle, inode);
+	ret2 = ext4_journal_stop(handle);
+	if (!ret)
+		ret = ret2;
+	trace_ext4_end_io_batch(inode, nr_ios, bytes, ret);
+
+	list_for_each_entry_safe(io, tmp, &done, list) {
+		if (io->flag & EXT4_IO_END_UNWRITTEN)
+			ext4_end_io_done(io);
+		list_del_init(&io->list);
+	}
+out:
+	/* Put back whatever we did not get to, ahead of newer entries */
+	if (!list_empty(&batch)) {
+		spin_lock_irqsave(&ei->i_completed_io_lock, flags);
+		list_splice(&batch, &ei->i_completed_io_list);
+		spin_unlock_irqrestore(&ei->i_completed_io_lock, flags);
+	}
 	return ret;
 }
 
@@ -140,21 +194,22 @@ static void ext4_end_io_work(struct work_struct *work)
 	struct inode		*inode = io->inode;
 	struct ext4_inode_info	*ei = EXT4_I(inode);
 	unsigned long		flags;
-	int			ret;
+	int			pending;
 
 	mutex_lock(&inode->i_mutex);
-	ret = ext4_end_io_nolock(io);
-	if (ret < 0) {
-		mutex_unlock(&inode->i_mutex);
-		return;
-	}
+	ext4_end_io_batch(inode);
 
+	/*
+	 * Our io_end has normally been converted by now, either by this
+	 * batch or by an earlier one (work item or fsync).  If the
+	 * conversion failed it is still queued and must not be freed.
+	 */
 	spin_lock_irqsave(&ei->i_completed_io_lock, flags);
-	if (!list_empty(&io->list))
-		list_del_init(&io->list);
+	pending = !list_empty(&io->list);
 	spin_unlock_irqrestore(&ei->i_completed_io_lock, flags);
 	mutex_unlock(&inode->i_mutex);
-	ext4_free_io_end(io);
+	if (!pending)
+		ext4_free_io_end(io);
 }
 
 ext4_io_end_t *ext4_init_io_end(struct inode *inode, gfp_t flags)
@@ -262,6 +317,8 @@ void ext4_io_submit(struct ext4_io_submit *io)
 	struct bio *bio = io->io_bio;
 
 	if (bio) {
+		trace_ext4_io_submit(io->io_end->inode, bio->bi_sector,
+				     bio->bi_size, io->io_op);
 		bio_get(io->io_bio);
 		submit_bio(io->io_op, io->io_bio);
 		BUG_ON(bio_flagged(io->io_bio, BIO_EOPNOTSUPP));
@@ -2451,6 +2451,30 @@ static ssize_t lifetime_write_kbytes_show(struct ext4_attr *a,
 			  EXT4_SB(sb)->s_sectors_written_start) >> 1)));
 }
 
+static ssize_t lazyinit_groups_left_show(struct ext4_attr *a,
+					 struct ext4_sb_info *sbi, char *buf)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	struct ext4_group_desc *gdp;
+	ext4_group_t group, left = 0;
+
+	if (EXT4_HAS_RO_COMPAT_FEATURE(sb, EXT4_FEATURE_RO_COMPAT_GDT_CSUM)) {
+		for (group = 0; group < sbi->s_groups_count; group++) {
+			gdp = ext4_get_group_desc(sb, group, NULL);
+			if (gdp && !(gdp->bg_flags &
+				     cpu_to_le16(EXT4_BG_INODE_ZEROED)))
+				left++;
+		}
+	}
+	return snprintf(buf, PAGE_SIZE, "%u\n", left);
+}
+
+static ssize_t lazyinit_deferrals_show(struct ext4_attr *a,
+				       struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%lu\n", sbi->s_li_deferrals);
+}
+
 static ssize_t extent_cache_hits_show(struct ext4_attr *a,
 				      struct ext4_sb_info *sbi, char *buf)
 {
@@ -2522,6 +2546,8 @@ EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
 EXT4_RO_ATTR(extent_cache_hits);
 EXT4_RO_ATTR(extent_cache_misses);
+EXT4_RO_ATTR(lazyinit_groups_left);
+EXT4_RO_ATTR(lazyinit_deferrals);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2539,6 +2565,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(lifetime_write_kbytes),
 	ATTR_LIST(extent_cache_hits),
 	ATTR_LIST(extent_cache_misses),
+	ATTR_LIST(lazyinit_groups_left),
+	ATTR_LIST(lazyinit_deferrals),
 	ATTR_LIST(inode_readahead_blks),
 	ATTR_LIST(inode_goal),
 	ATTR_LIST(mb_stats),
@@ -2701,6 +2729,47 @@ static void print_daily_error_info(unsigned long arg)
 	mod_timer(&sbi->s_err_report, jiffies + 24*60*60*HZ);  /* Once a day */
 }
 
+static unsigned long ext4_li_io_sectors(struct super_block *sb)
+{
+	struct hd_struct *part = sb->s_bdev->bd_part;
+
+	if (!part)
+		return 0;
+	return part_stat_read(part, sectors[READ]) +
+	       part_stat_read(part, sectors[WRITE]);
+}
+
+/*
+ * Check whether anybody else used the device since we last looked.
+ * Our own zeroout I/O has completed by the time the baseline is taken,
+ * so apart from the journal commit of the descriptor we just updated
+ * (a few blocks, hence EXT4_LI_IDLE_SECTORS of slack) any progress of
+ * the counters means foreground I/O.  To make sure initialization
+ * eventually finishes on a busy device, we only back off
+ * EXT4_DEF_LI_MAX_DEFER times in a row.
+ */
+#define EXT4_LI_IDLE_SECTORS	256
+
+static int ext4_li_should_defer(struct ext4_li_request *elr)
+{
+	struct super_block *sb = elr->lr_super;
+	struct hd_struct *part = sb->s_bdev->bd_part;
+	unsigned long sectors = ext4_li_io_sectors(sb);
+	int busy;
+
+	busy = sectors - elr->lr_io_sectors > EXT4_LI_IDLE_SECTORS ||
+	       (part && part_in_flight(part));
+	elr->lr_io_sectors = sectors;
+
+	if (!busy || elr->lr_deferred >= EXT4_DEF_LI_MAX_DEFER) {
+		elr->lr_deferred = 0;
+		return 0;
+	}
+	elr->lr_deferred++;
+	elr->lr_sbi->s_li_deferrals++;
+	return 1;
+}
+
 /* Find next suitable group and run ext4_init_inode_table */
 static int ext4_run_li_request(struct ext4_li_request *elr)
 {
@@ -2727,6 +2796,12 @@ static int ext4_run_li_request(struct ext4_li_request *elr)
 	if (group == ngroups)
 		ret = 1;
 
+	if (!ret && ext4_li_should_defer(elr)) {
+		elr->lr_next_sched = jiffies + max(elr->lr_timeout, 1UL * HZ);
+		elr->lr_next_group = group;
+		return 0;
+	}
+
 	if (!ret) {
 		timeout = jiffies;
 		ret = ext4_init_inode_table(sb, group,
@@ -2738,6 +2813,7 @@ static int ext4_run_li_request(struct ext4_li_request *elr)
 		}
 		elr->lr_next_sched = jiffies + elr->lr_timeout;
 		elr->lr_next_group = group + 1;
+		elr->lr_io_sectors = ext4_li_io_sectors(sb);
 	}
 
 	return ret;
@@ -2951,6 +3027,7 @@ static struct ext4_li_request *ext4_li_request_new(struct super_block *sb,
 	elr->lr_super = sb;
 	elr->lr_sbi = sbi;
 	elr->lr_next_group = start;
+	elr->lr_io_sectors = ext4_li_io_sectors(sb);
 
 	/*
 	 * Randomize first schedule time of the request to
@@ -3421,6 +3498,15 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 
 	bgl_lock_init(sbi->s_blockgroup_lock);
 
+	/*
+	 * Start reading all descriptor blocks at once rather than
+	 * waiting for each one in turn below.
+	 */
+	for (i = 0; i < db_count; i++) {
+		block = descriptor_loc(sb, logical_sb_block, i);
+		sb_breadahead(sb, block);
+	}
+
 	for (i = 0; i < db_count; i++) {
 		block = descriptor_loc(sb, logical_sb_block, i);
 		sbi->s_group_desc[i] = sb_bread(sb, block);
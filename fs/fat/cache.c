@@ -15,9 +15,18 @@
 
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
+/*
+ * Large regular files (video) get many more extents, so that seeking
+ * around in them doesn't walk the cluster chain over and over again.
+ * The extents are indexed by an rbtree, so a big limit is cheap.
+ */
+#define FAT_MAX_CACHE_REG	64
+/* Walks of the cluster chain longer than this read ahead the FAT */
+#define FAT_CHAIN_READA		64
 
 struct fat_cache {
 	struct list_head cache_list;
+	struct rb_node cache_node;	/* in ->cache_tree, by fcluster */
 	int nr_contig;	/* number of contiguous clusters */
 	int fcluster;	/* cluster number in the file. */
 	int dcluster;	/* cluster number on disk. */
@@ -32,6 +41,8 @@ struct fat_cache_id {
 
 static inline int fat_max_cache(struct inode *inode)
 {
+	if (S_ISREG(inode->i_mode))
+		return FAT_MAX_CACHE_REG;
 	return FAT_MAX_CACHE;
 }
 
@@ -42,6 +53,7 @@ static void init_once(void *foo)
 	struct fat_cache *cache = (struct fat_cache *)foo;
 
 	INIT_LIST_HEAD(&cache->cache_list);
+	RB_CLEAR_NODE(&cache->cache_node);
 }
 
 int __init fat_cache_init(void)
@@ -78,29 +90,60 @@ static inline void fat_cache_update_lru(struct inode *inode,
 		list_move(&cache->cache_list, &MSDOS_I(inode)->cache_lru);
 }
 
+/* Find the cache with the largest fcluster <= "fclus" */
+static struct fat_cache *fat_cache_find(struct inode *inode, int fclus)
+{
+	struct rb_node *n = MSDOS_I(inode)->cache_tree.rb_node;
+	struct fat_cache *hit = NULL, *p;
+
+	while (n) {
+		p = rb_entry(n, struct fat_cache, cache_node);
+		if (p->fcluster <= fclus) {
+			hit = p;
+			if (p->fcluster == fclus)
+				break;
+			n = n->rb_right;
+		} else
+			n = n->rb_left;
+	}
+	return hit;
+}
+
+static void fat_cache_insert(struct inode *inode, struct fat_cache *cache)
+{
+	struct rb_node **p = &MSDOS_I(inode)->cache_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct fat_cache *tmp;
+
+	while (*p) {
+		parent = *p;
+		tmp = rb_entry(parent, struct fat_cache, cache_node);
+		if (cache->fcluster < tmp->fcluster)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&cache->cache_node, parent, p);
+	rb_insert_color(&cache->cache_node, &MSDOS_I(inode)->cache_tree);
+}
+
 static int fat_cache_lookup(struct inode *inode, int fclus,
 			    struct fat_cache_id *cid,
 			    int *cached_fclus, int *cached_dclus)
 {
-	static struct fat_cache nohit = { .fcluster = 0, };
-
-	struct fat_cache *hit = &nohit, *p;
+	struct fat_cache *hit;
 	int offset = -1;
 
 	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the cache of "fclus" or nearest cache. */
-		if (p->fcluster <= fclus && hit->fcluster < p->fcluster) {
-			hit = p;
-			if ((hit->fcluster + hit->nr_contig) < fclus) {
-				offset = hit->nr_contig;
-			} else {
-				offset = fclus - hit->fcluster;
-				break;
-			}
-		}
-	}
-	if (hit != &nohit) {
+	/* Find the cache of "fclus" or nearest cache. */
+	hit = fat_cache_find(inode, fclus);
+	/* fcluster 0 is never cached, ->i_start already gives it */
+	if (hit && hit->fcluster > 0) {
+		if ((hit->fcluster + hit->nr_contig) < fclus)
+			offset = hit->nr_contig;
+		else
+			offset = fclus - hit->fcluster;
+
 		fat_cache_update_lru(inode, hit);
 
 		cid->id = MSDOS_I(inode)->cache_valid_id;
@@ -120,14 +163,13 @@ static struct fat_cache *fat_cache_merge(struct inode *inode,
 {
 	struct fat_cache *p;
 
-	list_for_each_entry(p, &MSDOS_I(inode)->cache_lru, cache_list) {
-		/* Find the same part as "new" in cluster-chain. */
-		if (p->fcluster == new->fcluster) {
-			BUG_ON(p->dcluster != new->dcluster);
-			if (new->nr_contig > p->nr_contig)
-				p->nr_contig = new->nr_contig;
-			return p;
-		}
+	/* Find the same part as "new" in cluster-chain. */
+	p = fat_cache_find(inode, new->fcluster);
+	if (p && p->fcluster == new->fcluster) {
+		BUG_ON(p->dcluster != new->dcluster);
+		if (new->nr_contig > p->nr_contig)
+			p->nr_contig = new->nr_contig;
+		return p;
 	}
 	return NULL;
 }
@@ -169,10 +211,12 @@ static void fat_cache_add(struct inode *inode, struct fat_cache_id *new)
 		} else {
 			struct list_head *p = MSDOS_I(inode)->cache_lru.prev;
 			cache = list_entry(p, struct fat_cache, cache_list);
+			rb_erase(&cache->cache_node, &MSDOS_I(inode)->cache_tree);
 		}
 		cache->fcluster = new->fcluster;
 		cache->dcluster = new->dcluster;
 		cache->nr_contig = new->nr_contig;
+		fat_cache_insert(inode, cache);
 	}
 out_update_lru:
 	fat_cache_update_lru(inode, cache);
@@ -192,6 +236,7 @@ static void __fat_cache_inval_inode(struct inode *inode)
 	while (!list_empty(&i->cache_lru)) {
 		cache = list_entry(i->cache_lru.next, struct fat_cache, cache_list);
 		list_del_init(&cache->cache_list);
+		rb_erase(&cache->cache_node, &i->cache_tree);
 		i->nr_caches--;
 		fat_cache_free(cache);
 	}
@@ -208,6 +253,37 @@ void fat_cache_inval_inode(struct inode *inode)
 	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
 }
 
+/*
+ * The cluster "dclus" was just linked at "fclus", the end of the chain.
+ * Grow the extent in front of it if it is contiguous, so appending
+ * writers don't have to walk the new part of the chain again.
+ */
+void fat_cache_append(struct inode *inode, int fclus, int dclus)
+{
+	struct fat_cache *cache;
+	struct fat_cache_id cid;
+
+	if (fclus <= 0)
+		return;
+
+	spin_lock(&MSDOS_I(inode)->cache_lru_lock);
+	cache = fat_cache_find(inode, fclus - 1);
+	if (cache && cache->fcluster + cache->nr_contig == fclus - 1 &&
+	    cache->dcluster + cache->nr_contig + 1 == dclus) {
+		cache->nr_contig++;
+		fat_cache_update_lru(inode, cache);
+		spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+		return;
+	}
+	cid.id = MSDOS_I(inode)->cache_valid_id;
+	spin_unlock(&MSDOS_I(inode)->cache_lru_lock);
+
+	cid.fcluster = fclus;
+	cid.dcluster = dclus;
+	cid.nr_contig = 0;
+	fat_cache_add(inode, &cid);
+}
+
 static inline int cache_contiguous(struct fat_cache_id *cid, int dclus)
 {
 	cid->nr_contig++;
@@ -228,7 +304,7 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 	const int limit = sb->s_maxbytes >> MSDOS_SB(sb)->cluster_bits;
 	struct fat_entry fatent;
 	struct fat_cache_id cid;
-	int nr;
+	int nr, steps = 0;
 
 	BUG_ON(MSDOS_I(inode)->i_start == 0);
 
@@ -257,6 +333,9 @@ int fat_get_cluster(struct inode *inode, int cluster, int *fclus, int *dclus)
 			goto out;
 		}
 
+		if (++steps == FAT_CHAIN_READA)
+			fat_ent_reada_chain(sb, *dclus, cluster - *fclus);
+
 		nr = fat_ent_read(inode, &fatent, *dclus);
 		if (nr < 0)
 			goto out;
@@ -18,6 +18,8 @@
 #include <linux/time.h>
 #include <linux/buffer_head.h>
 #include <linux/compat.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 #include <asm/uaccess.h>
 #include <linux/kernel.h>
 #include "fat.h"
@@ -333,12 +335,22 @@ parse_long:
 	return 0;
 }
 
+typedef int (*fat_name_actor_t)(void *priv, const unsigned char *name,
+				int len, loff_t slot_off);
+
 /*
- * Return values: negative -> error, 0 -> not found, positive -> found,
- * value is the total amount of slots, including the shortname entry.
+ * Walk the directory from @cpos and hand the shortname and, if present,
+ * the longname of every entry to @actor together with the offset of the
+ * entry's first slot.  If @one_record is set, only the entry starting at
+ * @cpos is looked at.
+ *
+ * A positive return from @actor stops the walk and fills @sinfo, and
+ * fat_scan_names() returns 0.  A negative one is passed back as error.
+ * -ENOENT means the walk ended without the actor stopping it.
  */
-int fat_search_long(struct inode *inode, const unsigned char *name,
-		    int name_len, struct fat_slot_info *sinfo)
+static int fat_scan_names(struct inode *inode, loff_t cpos, int one_record,
+			  fat_name_actor_t actor, void *priv,
+			  struct fat_slot_info *sinfo)
 {
 	struct super_block *sb = inode->i_sb;
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
@@ -351,11 +363,14 @@ int fat_search_long(struct inode *inode, const unsigned char *name,
 	unsigned char work[MSDOS_NAME];
 	unsigned char bufname[FAT_MAX_SHORT_SIZE];
 	unsigned short opt_shortname = sbi->options.shortname;
-	loff_t cpos = 0;
-	int chl, i, j, last_u, err, len;
+	loff_t slot_off;
+	int chl, i, j, last_u, err, len, done = 0;
 
 	err = -ENOENT;
 	while (1) {
+		if (one_record && done)
+			goto out_brelse;
+		done = 1;
 		if (fat_get_entry(inode, &cpos, &bh, &de) == -1)
 			goto end_of_dir;
 parse_record:
@@ -418,21 +433,31 @@ parse_record:
 		if (!last_u)
 			continue;
 
-		/* Compare shortname */
+		/* cpos is already past the de */
+		slot_off = cpos - (nr_slots + 1) * sizeof(*de);
+
+		/* Shortname */
 		bufuname[last_u] = 0x0000;
 		len = fat_uni_to_x8(sb, bufuname, bufname, sizeof(bufname));
-		if (fat_name_match(sbi, name, name_len, bufname, len))
+		err = actor(priv, bufname, len, slot_off);
+		if (err > 0)
 			goto found;
+		if (err < 0)
+			goto out_brelse;
 
 		if (nr_slots) {
 			void *longname = unicode + FAT_MAX_UNI_CHARS;
 			int size = PATH_MAX - FAT_MAX_UNI_SIZE;
 
-			/* Compare longname */
+			/* Longname */
 			len = fat_uni_to_x8(sb, unicode, longname, size);
-			if (fat_name_match(sbi, name, name_len, longname, len))
+			err = actor(priv, longname, len, slot_off);
+			if (err > 0)
 				goto found;
+			if (err < 0)
+				goto out_brelse;
 		}
+		err = -ENOENT;
 	}
 
 found:
@@ -443,6 +468,9 @@ found:
 	sinfo->bh = bh;
 	sinfo->i_pos = fat_make_i_pos(sb, sinfo->bh, sinfo->de);
 	err = 0;
+	goto end_of_dir;
+out_brelse:
+	brelse(bh);
 end_of_dir:
 	if (unicode)
 		__putname(unicode);
@@ -450,6 +478,294 @@ end_of_dir:
 	return err;
 }
 
+struct fat_match_arg {
+	struct msdos_sb_info *sbi;
+	const unsigned char *name;
+	int name_len;
+	loff_t slot_off;	/* -1 matches at any offset */
+};
+
+static int fat_match_actor(void *priv, const unsigned char *name, int len,
+			   loff_t slot_off)
+{
+	struct fat_match_arg *arg = priv;
+
+	if (arg->slot_off != -1 && arg->slot_off != slot_off)
+		return 0;
+	return fat_name_match(arg->sbi, arg->name, arg->name_len, name, len);
+}
+
+/*
+ * In-memory name index for large directories.
+ *
+ * A linear scan of a directory with thousands of entries has to convert
+ * every shortname and longname to the I/O charset, which makes lookups
+ * (and especially negative lookups on create) expensive.  The index maps
+ * the hash of each name, as seen by fat_name_match(), to the offset of
+ * the entry's first slot.  It is built on the first lookup in the
+ * directory and kept up to date by fat_add_entries() and
+ * fat_remove_entries(); anything that goes wrong while updating it just
+ * drops the whole index.  A hit is always verified against the on-disk
+ * entry, so the index only has to be complete, not exact.
+ *
+ * Users are serialized by the directory's i_mutex and lock_super().
+ */
+#define FAT_DIR_INDEX_MIN_SIZE	(8 * 1024)	/* 256 slots */
+#define FAT_DIR_INDEX_MIN_BITS	4
+#define FAT_DIR_INDEX_MAX_BITS	11
+
+struct fat_dir_index {
+	unsigned int nr_names;
+	unsigned int hash_bits;
+	struct hlist_head table[0];
+};
+
+struct fat_index_node {
+	struct hlist_node hnode;
+	u32 hash;
+	u32 slot_off;
+};
+
+static struct kmem_cache *fat_index_cachep;
+
+int __init fat_dir_index_init(void)
+{
+	fat_index_cachep = kmem_cache_create("fat_index_cache",
+					     sizeof(struct fat_index_node),
+					     0, SLAB_RECLAIM_ACCOUNT|SLAB_MEM_SPREAD,
+					     NULL);
+	if (fat_index_cachep == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+void fat_dir_index_destroy(void)
+{
+	kmem_cache_destroy(fat_index_cachep);
+}
+
+static u32 fat_index_hash(struct msdos_sb_info *sbi,
+			  const unsigned char *name, int len)
+{
+	unsigned long hash = init_name_hash();
+
+	if (sbi->options.name_check != 's') {
+		while (len--)
+			hash = partial_name_hash(nls_tolower(sbi->nls_io, *name++),
+						 hash);
+	} else {
+		while (len--)
+			hash = partial_name_hash(*name++, hash);
+	}
+	return end_name_hash(hash);
+}
+
+static inline struct hlist_head *fat_index_bucket(struct fat_dir_index *idx,
+						  u32 hash)
+{
+	return &idx->table[hash_32(hash, idx->hash_bits)];
+}
+
+void fat_dir_index_free(struct inode *dir)
+{
+	struct fat_dir_index *idx = MSDOS_I(dir)->i_dir_index;
+	struct fat_index_node *node;
+	struct hlist_node *pos, *n;
+	int i;
+
+	if (!idx)
+		return;
+	MSDOS_I(dir)->i_dir_index = NULL;
+
+	for (i = 0; i < (1 << idx->hash_bits); i++) {
+		hlist_for_each_entry_safe(node, pos, n, &idx->table[i], hnode)
+			kmem_cache_free(fat_index_cachep, node);
+	}
+	kfree(idx);
+}
+
+struct fat_index_arg {
+	struct msdos_sb_info *sbi;
+	struct fat_dir_index *idx;
+	loff_t slot_off;	/* -1 for any */
+	int count;
+};
+
+static int fat_index_insert_actor(void *priv, const unsigned char *name,
+				  int len, loff_t slot_off)
+{
+	struct fat_index_arg *arg = priv;
+	struct fat_index_node *node;
+
+	if (arg->slot_off != -1 && arg->slot_off != slot_off)
+		return 0;
+
+	node = kmem_cache_alloc(fat_index_cachep, GFP_NOFS);
+	if (!node)
+		return -ENOMEM;
+	node->hash = fat_index_hash(arg->sbi, name, len);
+	node->slot_off = slot_off;
+	hlist_add_head(&node->hnode, fat_index_bucket(arg->idx, node->hash));
+	arg->idx->nr_names++;
+	arg->count++;
+	return 0;
+}
+
+static int fat_index_delete_actor(void *priv, const unsigned char *name,
+				  int len, loff_t slot_off)
+{
+	struct fat_index_arg *arg = priv;
+	struct fat_index_node *node;
+	struct hlist_node *pos;
+	u32 hash;
+
+	if (arg->slot_off != slot_off)
+		return 0;
+
+	hash = fat_index_hash(arg->sbi, name, len);
+	hlist_for_each_entry(node, pos, fat_index_bucket(arg->idx, hash),
+			     hnode) {
+		if (node->hash == hash && node->slot_off == slot_off) {
+			hlist_del(&node->hnode);
+			kmem_cache_free(fat_index_cachep, node);
+			arg->idx->nr_names--;
+			arg->count++;
+			break;
+		}
+	}
+	return 0;
+}
+
+static int fat_dir_index_build(struct inode *dir)
+{
+	struct fat_index_arg arg;
+	struct fat_dir_index *idx;
+	unsigned int bits;
+	int err;
+
+	if (MSDOS_I(dir)->i_dir_index)
+		return 0;
+
+	/* Aim for about four slots per bucket */
+	bits = ilog2(max_t(loff_t, dir->i_size >> 7, 1));
+	bits = clamp_t(unsigned int, bits, FAT_DIR_INDEX_MIN_BITS,
+		       FAT_DIR_INDEX_MAX_BITS);
+
+	idx = kzalloc(sizeof(*idx) + (sizeof(struct hlist_head) << bits),
+		      GFP_NOFS);
+	if (!idx)
+		return -ENOMEM;
+	idx->hash_bits = bits;
+	MSDOS_I(dir)->i_dir_index = idx;
+
+	arg.sbi = MSDOS_SB(dir->i_sb);
+	arg.idx = idx;
+	arg.slot_off = -1;
+	arg.count = 0;
+	err = fat_scan_names(dir, 0, 0, fat_index_insert_actor, &arg, NULL);
+	if (err != -ENOENT) {
+		fat_dir_index_free(dir);
+		return err;
+	}
+	return 0;
+}
+
+/* The entry starting at @slot_off was just written */
+static void fat_dir_index_add(struct inode *dir, loff_t slot_off)
+{
+	struct fat_index_arg arg;
+	int err;
+
+	if (!MSDOS_I(dir)->i_dir_index)
+		return;
+
+	arg.sbi = MSDOS_SB(dir->i_sb);
+	arg.idx = MSDOS_I(dir)->i_dir_index;
+	arg.slot_off = slot_off;
+	arg.count = 0;
+	err = fat_scan_names(dir, slot_off, 1, fat_index_insert_actor, &arg,
+			     NULL);
+	/* A name missing from the index would turn into a false -ENOENT */
+	if (err != -ENOENT || !arg.count)
+		fat_dir_index_free(dir);
+}
+
+/* The entry starting at @slot_off is about to be removed */
+static void fat_dir_index_del(struct inode *dir, loff_t slot_off)
+{
+	struct fat_index_arg arg;
+
+	if (!MSDOS_I(dir)->i_dir_index)
+		return;
+
+	arg.sbi = MSDOS_SB(dir->i_sb);
+	arg.idx = MSDOS_I(dir)->i_dir_index;
+	arg.slot_off = slot_off;
+	arg.count = 0;
+	/* Stale nodes are harmless, lookups verify every hit */
+	fat_scan_names(dir, slot_off, 1, fat_index_delete_actor, &arg, NULL);
+}
+
+static int fat_dir_index_search(struct inode *dir, struct fat_dir_index *idx,
+				const unsigned char *name, int name_len,
+				struct fat_slot_info *sinfo)
+{
+	struct fat_match_arg arg;
+	struct fat_slot_info tmp;
+	struct fat_index_node *node;
+	struct hlist_node *pos;
+	u32 hash;
+	int err, found = 0;
+
+	arg.sbi = MSDOS_SB(dir->i_sb);
+	arg.name = name;
+	arg.name_len = name_len;
+
+	hash = fat_index_hash(arg.sbi, name, name_len);
+	hlist_for_each_entry(node, pos, fat_index_bucket(idx, hash), hnode) {
+		if (node->hash != hash)
+			continue;
+		/* Same result as a linear scan: the first entry wins */
+		if (found && node->slot_off >= sinfo->slot_off)
+			continue;
+
+		arg.slot_off = node->slot_off;
+		err = fat_scan_names(dir, node->slot_off, 1, fat_match_actor,
+				     &arg, &tmp);
+		if (err == -ENOENT)
+			continue;
+		if (found)
+			brelse(sinfo->bh);
+		if (err)
+			return err;
+		*sinfo = tmp;
+		found = 1;
+	}
+	return found ? 0 : -ENOENT;
+}
+
+/*
+ * Return values: negative -> error, 0 -> found.
+ */
+int fat_search_long(struct inode *inode, const unsigned char *name,
+		    int name_len, struct fat_slot_info *sinfo)
+{
+	struct fat_dir_index *idx = MSDOS_I(inode)->i_dir_index;
+	struct fat_match_arg arg;
+
+	if (!idx && inode->i_size >= FAT_DIR_INDEX_MIN_SIZE &&
+	    !fat_dir_index_build(inode))
+		idx = MSDOS_I(inode)->i_dir_index;
+	if (idx)
+		return fat_dir_index_search(inode, idx, name, name_len, sinfo);
+
+	arg.sbi = MSDOS_SB(inode->i_sb);
+	arg.name = name;
+	arg.name_len = name_len;
+	arg.slot_off = -1;
+	return fat_scan_names(inode, 0, 0, fat_match_actor, &arg, sinfo);
+}
+
 EXPORT_SYMBOL_GPL(fat_search_long);
 
 struct fat_ioctl_filldir_callback {
@@ -761,6 +1077,25 @@ static int fat_ioctl_volume_id(struct inode *dir)
 	return sbi->vol_id;
 }
 
+/*
+ * Build the name index up front, e.g. before a media scanner walks a
+ * large directory, instead of paying for it on the first lookup.
+ */
+static int fat_ioctl_preload_index(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+	int err;
+
+	mutex_lock(&inode->i_mutex);
+	lock_super(sb);
+	err = -ENOENT;
+	if (!IS_DEADDIR(inode))
+		err = fat_dir_index_build(inode);
+	unlock_super(sb);
+	mutex_unlock(&inode->i_mutex);
+	return err;
+}
+
 static long fat_dir_ioctl(struct file *filp, unsigned int cmd,
 			  unsigned long arg)
 {
@@ -779,6 +1114,8 @@ static long fat_dir_ioctl(struct file *filp, unsigned int cmd,
 		break;
 	case VFAT_IOCTL_GET_VOLUME_ID:
 		return fat_ioctl_volume_id(inode);
+	case VFAT_IOCTL_PRELOAD_INDEX:
+		return fat_ioctl_preload_index(inode);
 	default:
 		return fat_generic_ioctl(filp, cmd, arg);
 	}
@@ -819,6 +1156,8 @@ static long fat_compat_dir_ioctl(struct file *filp, unsigned cmd,
 		short_only = 0;
 		both = 1;
 		break;
+	case VFAT_IOCTL_PRELOAD_INDEX:
+		return fat_ioctl_preload_index(inode);
 	default:
 		return fat_generic_ioctl(filp, cmd, (unsigned long)arg);
 	}
@@ -998,6 +1337,8 @@ int fat_remove_entries(struct inode *dir, struct fat_slot_info *sinfo)
 	 * First stage: Remove the shortname. By this, the directory
 	 * entry is removed.
 	 */
+	fat_dir_index_del(dir, sinfo->slot_off);
+
 	nr_slots = sinfo->nr_slots;
 	de = sinfo->de;
 	sinfo->de = NULL;
@@ -1352,6 +1693,7 @@ found:
 	sinfo->de = de;
 	sinfo->bh = bh;
 	sinfo->i_pos = fat_make_i_pos(sb, sinfo->bh, sinfo->de);
+	fat_dir_index_add(dir, pos);
 
 	return 0;
 
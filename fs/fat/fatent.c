@@ -7,6 +7,7 @@
 #include <linux/fs.h>
 #include <linux/msdos_fs.h>
 #include <linux/blkdev.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -452,6 +453,99 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+/*
+ * Find free clusters in ->free_bitmap, starting after the last allocated
+ * cluster and wrapping around.  A run of "nr" contiguous free clusters is
+ * preferred, otherwise the first free cluster found is returned.  The
+ * length of the run found (<= nr) is stored in *len.
+ */
+static int fat_bitmap_find_run(struct msdos_sb_info *sbi, int nr, int *len)
+{
+	unsigned long *map = sbi->free_bitmap;
+	int max = sbi->max_cluster;
+	int start, limit, pass, c, end, first = -1, first_len = 0;
+
+	start = sbi->prev_free + 1;
+	if (start >= max)
+		start = FAT_START_ENT;
+
+	for (pass = 0; pass < 2; pass++) {
+		c = pass ? FAT_START_ENT : start;
+		limit = pass ? start : max;
+		while (c < limit) {
+			c = find_next_bit(map, limit, c);
+			if (c >= limit)
+				break;
+			end = find_next_zero_bit(map, min(c + nr, max), c);
+			if (end - c >= nr) {
+				*len = nr;
+				return c;
+			}
+			if (first == -1) {
+				first = c;
+				first_len = end - c;
+			}
+			c = end;
+		}
+	}
+	*len = first_len;
+	return first;
+}
+
+/* Called with the fat lock held, see fat_alloc_clusters() */
+static int fat_alloc_from_bitmap(struct inode *inode, int *cluster,
+				 int nr_cluster, struct buffer_head **bhs,
+				 int *nr_bhs, int *idx_clus)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent, prev_ent;
+	int entry, len, err = 0;
+
+	fatent_init(&prev_ent);
+	fatent_init(&fatent);
+	while (*idx_clus < nr_cluster) {
+		entry = fat_bitmap_find_run(sbi, nr_cluster - *idx_clus, &len);
+		if (entry < 0) {
+			err = -ENOSPC;
+			break;
+		}
+
+		for (; len; len--, entry++) {
+			err = fat_ent_read(inode, &fatent, entry);
+			if (err < 0)
+				goto out;
+			__clear_bit(entry, sbi->free_bitmap);
+			/* The FAT is authoritative, fix up a stale bit */
+			if (err != FAT_ENT_FREE)
+				continue;
+
+			/* make the cluster chain */
+			ops->ent_put(&fatent, FAT_ENT_EOF);
+			if (prev_ent.nr_bhs)
+				ops->ent_put(&prev_ent, entry);
+
+			fat_collect_bhs(bhs, nr_bhs, &fatent);
+
+			sbi->prev_free = entry;
+			if (sbi->free_clusters != -1)
+				sbi->free_clusters--;
+			sb->s_dirt = 1;
+
+			cluster[*idx_clus] = entry;
+			(*idx_clus)++;
+
+			/* fat_collect_bhs() holds the bhs of prev_ent */
+			prev_ent = fatent;
+		}
+		err = 0;
+	}
+out:
+	fatent_brelse(&fatent);
+	return err;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -471,6 +565,15 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	}
 
 	err = nr_bhs = idx_clus = 0;
+	if (sbi->free_bitmap) {
+		fatent_init(&fatent);
+		err = fat_alloc_from_bitmap(inode, cluster, nr_cluster,
+					    bhs, &nr_bhs, &idx_clus);
+		if (err == -ENOSPC)
+			goto out_nospc;
+		goto out;
+	}
+
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
 	fatent_init(&fatent);
@@ -517,6 +620,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 		} while (fat_ent_next(sbi, &fatent));
 	}
 
+out_nospc:
 	/* Couldn't allocate the free entries */
 	sbi->free_clusters = 0;
 	sbi->free_clus_valid = 1;
@@ -585,6 +689,8 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		if (sbi->free_bitmap)
+			__set_bit(fatent.entry, sbi->free_bitmap);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			sb->s_dirt = 1;
@@ -630,16 +736,58 @@ static void fat_ent_reada(struct super_block *sb, struct fat_entry *fatent,
 			  unsigned long reada_blocks)
 {
 	struct fatent_operations *ops = MSDOS_SB(sb)->fatent_ops;
+	struct blk_plug plug;
 	sector_t blocknr;
 	int i, offset;
 
 	ops->ent_blocknr(sb, fatent->entry, &offset, &blocknr);
 
+	/* Plugged, so the readahead goes out as a few large requests */
+	blk_start_plug(&plug);
 	for (i = 0; i < reada_blocks; i++)
 		sb_breadahead(sb, blocknr + i);
+	blk_finish_plug(&plug);
 }
 
-int fat_count_free_clusters(struct super_block *sb)
+/*
+ * Read ahead the FAT blocks holding "nr_entries" entries from "entry" on,
+ * for walks along a long cluster chain.  Chains of files written in one
+ * go are mostly ascending, so this saves a synchronous read per block.
+ */
+void fat_ent_reada_chain(struct super_block *sb, int entry, int nr_entries)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fat_entry fatent;
+	unsigned long reada_blocks;
+	sector_t blocknr;
+	u64 bytes;
+	int offset;
+
+	if (entry < FAT_START_ENT || sbi->max_cluster <= entry)
+		return;
+
+	if (sbi->fat_bits == 12)
+		bytes = (u64)nr_entries + (nr_entries >> 1);
+	else
+		bytes = (u64)nr_entries << sbi->fatent_shift;
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	if (bytes < FAT_READA_SIZE)
+		reada_blocks = (bytes >> sb->s_blocksize_bits) + 1;
+
+	sbi->fatent_ops->ent_blocknr(sb, entry, &offset, &blocknr);
+	if (blocknr + reada_blocks > sbi->fat_start + sbi->fat_length)
+		reada_blocks = sbi->fat_start + sbi->fat_length - blocknr;
+
+	fatent_set_entry(&fatent, entry);
+	fat_ent_reada(sb, &fatent, reada_blocks);
+}
+
+/*
+ * Scan the whole FAT, updating the free cluster count, and the free
+ * cluster bitmap if "map" isn't NULL.  Called with the fat lock held.
+ */
+static int __fat_count_free_clusters(struct super_block *sb,
+				     unsigned long *map)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 	struct fatent_operations *ops = sbi->fatent_ops;
@@ -647,10 +795,6 @@ int fat_count_free_clusters(struct super_block *sb)
 	unsigned long reada_blocks, reada_mask, cur_block;
 	int err = 0, free;
 
-	lock_fat(sbi);
-	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
-		goto out;
-
 	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
 	reada_mask = reada_blocks - 1;
 	cur_block = 0;
@@ -668,18 +812,62 @@ int fat_count_free_clusters(struct super_block *sb)
 
 		err = fat_ent_read_block(sb, &fatent);
 		if (err)
-			goto out;
+			return err;
 
 		do {
-			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE) {
 				free++;
+				if (map)
+					__set_bit(fatent.entry, map);
+			}
 		} while (fat_ent_next(sbi, &fatent));
 	}
 	sbi->free_clusters = free;
 	sbi->free_clus_valid = 1;
 	sb->s_dirt = 1;
 	fatent_brelse(&fatent);
+	return err;
+}
+
+int fat_count_free_clusters(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	int err = 0;
+
+	lock_fat(sbi);
+	if (sbi->free_clusters != -1 && sbi->free_clus_valid)
+		goto out;
+	err = __fat_count_free_clusters(sb, NULL);
 out:
 	unlock_fat(sbi);
 	return err;
 }
+
+/*
+ * Build the in-memory bitmap of free clusters, which lets
+ * fat_alloc_clusters() find (contiguous) free clusters without reading
+ * the FAT.  This also gives an exact free cluster count.
+ */
+int fat_build_free_bitmap(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned long *map;
+	int err = 0;
+
+	map = vzalloc(BITS_TO_LONGS(sbi->max_cluster) * sizeof(long));
+	if (!map)
+		return -ENOMEM;
+
+	lock_fat(sbi);
+	if (!sbi->free_bitmap) {
+		err = __fat_count_free_clusters(sb, map);
+		if (!err) {
+			sbi->free_bitmap = map;
+			map = NULL;
+		}
+	}
+	unlock_fat(sbi);
+
+	vfree(map);
+	return err;
+}
@@ -26,6 +26,7 @@
 #include <linux/writeback.h>
 #include <linux/log2.h>
 #include <linux/hash.h>
+#include <linux/vmalloc.h>
 #include <asm/unaligned.h>
 #include "fat.h"
 
@@ -456,6 +457,7 @@ static void fat_evict_inode(struct inode *inode)
 	invalidate_inode_buffers(inode);
 	end_writeback(inode);
 	fat_cache_inval_inode(inode);
+	fat_dir_index_free(inode);
 	fat_detach(inode);
 }
 
@@ -491,6 +493,7 @@ static void fat_put_super(struct super_block *sb)
 		fat_write_super(sb);
 
 	iput(sbi->fat_inode);
+	vfree(sbi->free_bitmap);
 
 	unload_nls(sbi->nls_disk);
 	unload_nls(sbi->nls_io);
@@ -533,7 +536,9 @@ static void init_once(void *foo)
 	ei->nr_caches = 0;
 	ei->cache_valid_id = FAT_CACHE_VALID + 1;
 	INIT_LIST_HEAD(&ei->cache_lru);
+	ei->cache_tree = RB_ROOT;
 	INIT_HLIST_NODE(&ei->i_fat_hash);
+	ei->i_dir_index = NULL;
 	inode_init_once(&ei->vfs_inode);
 }
 
@@ -558,6 +563,9 @@ static int fat_remount(struct super_block *sb, int *flags, char *data)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 	*flags |= MS_NODIRATIME | (sbi->options.isvfat ? 0 : MS_NOATIME);
+	/* The free cluster bitmap is only built for writable mounts */
+	if ((sb->s_flags & MS_RDONLY) && !(*flags & MS_RDONLY))
+		fat_build_free_bitmap(sb);
 	return 0;
 }
 
@@ -1515,6 +1523,14 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 		goto out_fail;
 	}
 
+	/*
+	 * Read the whole FAT once now, so that allocation can find free
+	 * clusters from memory.  Failure is not fatal, allocation then
+	 * scans the FAT as before.
+	 */
+	if (!(sb->s_flags & MS_RDONLY))
+		fat_build_free_bitmap(sb);
+
 	return 0;
 
 out_invalid:
@@ -1596,12 +1612,18 @@ static int __init init_fat_fs(void)
 	if (err)
 		return err;
 
-	err = fat_init_inodecache();
+	err = fat_dir_index_init();
 	if (err)
 		goto failed;
 
+	err = fat_init_inodecache();
+	if (err)
+		goto failed_index;
+
 	return 0;
 
+failed_index:
+	fat_dir_index_destroy();
 failed:
 	fat_cache_destroy();
 	return err;
@@ -1610,6 +1632,7 @@ failed:
 static void __exit exit_fat_fs(void)
 {
 	fat_cache_destroy();
+	fat_dir_index_destroy();
 	fat_destroy_inodecache();
 }
 
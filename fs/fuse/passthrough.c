@@ -0,0 +1,179 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+
+/*
+ * Open flags that change how read and write behave.  The I/O is done
+ * under the lower file's flags, so the two files must agree on these.
+ */
+#define FUSE_PASSTHROUGH_FLAGS	(O_APPEND | O_DIRECT | O_DSYNC | __O_SYNC)
+
+/*
+ * Passthrough lets a filesystem that merely forwards data to a file on
+ * another (local) filesystem skip the round trip through userspace for
+ * the data path.  When FUSE_PASSTHROUGH was negotiated at INIT, the reply
+ * to OPEN or CREATE may set FOPEN_PASSTHROUGH and put a file descriptor
+ * of the daemon into passthrough_fh.  Read, write and mmap on the FUSE
+ * file are then performed directly on that lower file, while lookup,
+ * permissions, attributes, fsync, locks and release still go through the
+ * daemon as usual.
+ */
+
+/*
+ * Called from fuse_dev_do_write() with the reply already copied into the
+ * request.  This runs in the context of the daemon, so passthrough_fh can
+ * be resolved against the daemon's file table.  Any failure silently
+ * falls back to ordinary FUSE I/O.
+ */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *lower;
+	struct inode *lower_inode;
+	unsigned int flags;
+
+	if (!fc->passthrough || req->out.h.error)
+		return;
+
+	/* The opener is still waiting for the reply, so its inarg is valid */
+	if (req->in.h.opcode == FUSE_OPEN && req->out.numargs == 1) {
+		const struct fuse_open_in *inarg = req->in.args[0].value;
+
+		flags = inarg->flags;
+		outarg = req->out.args[0].value;
+	} else if (req->in.h.opcode == FUSE_CREATE && req->out.numargs == 2) {
+		const struct fuse_create_in *inarg = req->in.args[0].value;
+
+		flags = inarg->flags;
+		outarg = req->out.args[1].value;
+	} else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	lower = fget(outarg->passthrough_fh);
+	if (!lower)
+		return;
+
+	lower_inode = lower->f_path.dentry->d_inode;
+	if (!S_ISREG(lower_inode->i_mode) ||
+	    !lower->f_op || !lower->f_op->aio_read || !lower->f_op->aio_write)
+		goto out_fput;
+
+	/* Don't allow stacking on top of another FUSE file */
+	if (lower_inode->i_sb->s_magic == FUSE_SUPER_MAGIC)
+		goto out_fput;
+
+	/* The lower file must allow everything the FUSE file is opened for */
+	if (OPEN_FMODE(flags) & ~lower->f_mode & (FMODE_READ | FMODE_WRITE))
+		goto out_fput;
+
+	if ((flags ^ lower->f_flags) & FUSE_PASSTHROUGH_FLAGS)
+		goto out_fput;
+
+	req->passthrough_filp = lower;
+	return;
+
+ out_fput:
+	fput(lower);
+}
+
+/*
+ * fcntl(F_SETFL) may change O_APPEND or O_DIRECT on the FUSE file after
+ * open.  Until the flags agree again, do the I/O through the daemon.
+ */
+bool fuse_passthrough_usable(struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+
+	return lower &&
+	       !((file->f_flags ^ lower->f_flags) & FUSE_PASSTHROUGH_FLAGS);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	ssize_t ret;
+
+	iocb->ki_filp = lower;
+	ret = lower->f_op->aio_read(iocb, iov, nr_segs, pos);
+	iocb->ki_filp = file;
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file->f_dentry->d_inode;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	ssize_t ret;
+
+	iocb->ki_filp = lower;
+	ret = lower->f_op->aio_write(iocb, iov, nr_segs, pos);
+	iocb->ki_filp = file;
+
+	if (ret > 0) {
+		/* Pages cached while the flags differed are now stale */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2(inode->i_mapping);
+		fuse_write_update_size(inode, iocb->ki_pos);
+		/* mtime and ctime were changed behind the daemon's back */
+		fuse_invalidate_attr(inode);
+	}
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int err;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	/*
+	 * Map the lower file itself, so page faults are served from its
+	 * page cache.  The reference mmap_region() took on the FUSE file
+	 * is swapped for one on the lower file.
+	 */
+	vma->vm_file = lower;
+	get_file(lower);
+	err = lower->f_op->mmap(lower, vma);
+	if (err) {
+		vma->vm_file = file;
+		fput(lower);
+		return err;
+	}
+	fput(file);
+
+	return 0;
+}
@@ -106,6 +106,49 @@ SYSCALL_DEFINE0(sync)
 	return 0;
 }
 
+static void sync_dirty_one_sb(struct super_block *sb, void *arg)
+{
+	struct backing_dev_info *bdi = sb->s_bdi;
+
+	if (sb->s_flags & MS_RDONLY || bdi == &noop_backing_dev_info)
+		return;
+	if (!bdi_has_dirty_io(bdi) && !bdi_stat_sum(bdi, BDI_WRITEBACK)) {
+		/*
+		 * Nothing to write back, but a journalling filesystem can
+		 * hold metadata changes (unlink, rename...) only in its
+		 * running transaction.  Have it commit them; that costs
+		 * nothing when the journal is clean.
+		 */
+		if (sb->s_op->sync_fs)
+			sb->s_op->sync_fs(sb, 1);
+		return;
+	}
+
+	__sync_filesystem(sb, 0);
+	__sync_filesystem(sb, 1);
+	(*(int *)arg)++;
+}
+
+/**
+ * sync_dirty_filesystems - sync only the filesystems with dirty data
+ *
+ * Like sys_sync(), except that a filesystem whose backing device has no
+ * dirty inodes and no pages under writeback only gets its ->sync_fs()
+ * call, to commit its journal, and the flusher threads are not kicked
+ * for everything.  Meant for callers that sync
+ * often and usually find little to write, such as opportunistic suspend.
+ * Returns the number of filesystems that had dirty data to sync.
+ */
+int sync_dirty_filesystems(void)
+{
+	int synced = 0;
+
+	iterate_supers(sync_dirty_one_sb, &synced);
+	if (synced && unlikely(laptop_mode))
+		laptop_sync_completion();
+	return synced;
+}
+
 static void do_sync_work(struct work_struct *work)
 {
 	/*
@@ -0,0 +1,85 @@
+/*
+ * include/linux/cpufreq_powercap.h
+ *
+ * Thermal model based frequency capping for cpufreq drivers.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_CPUFREQ_POWERCAP_H
+#define _LINUX_CPUFREQ_POWERCAP_H
+
+#include <linux/mutex.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/* Estimated power of one operating point, per CPU */
+struct cpufreq_powercap_opp {
+	unsigned int frequency;		/* kHz */
+	unsigned int busy_mw;		/* while running */
+	unsigned int idle_mw;		/* while idle at this frequency */
+};
+
+/*
+ * The die is modelled as a single RC stage: the temperature rise over
+ * ambient settles at power * resistance with time constant tau.  The
+ * cap is chosen so that the estimated power stays within
+ *
+ *	limit / R + gain * (limit - rise) / R
+ *
+ * i.e. the sustainable power plus a share of the remaining headroom,
+ * so short bursts run unthrottled and long ones converge on the limit.
+ */
+struct cpufreq_powercap {
+	unsigned int cpu;
+	struct cpufreq_powercap_opp *opps;	/* ascending */
+	unsigned int nr_opps;
+
+	/* Model parameters, also tunable through sysfs */
+	unsigned int resistance;	/* millidegrees C per mW */
+	unsigned int tau_ms;		/* thermal time constant */
+	unsigned int limit;		/* allowed rise, millidegrees C */
+	unsigned int gain;		/* share of headroom, percent */
+	unsigned int min_freq;		/* never cap below this, kHz */
+	unsigned int period_ms;		/* model update period */
+	bool enabled;
+
+	/* State, protected by lock */
+	struct mutex lock;
+	unsigned int rise;		/* estimated rise, millidegrees C */
+	unsigned int power;		/* last estimated power, mW */
+	unsigned int cap_freq;		/* current ceiling, kHz */
+	u64 last_wall;
+	u64 last_idle;
+	bool registered;
+	struct delayed_work work;
+};
+
+/*
+ * Advance the model by @wall_us of which @idle_us were idle at @cur kHz
+ * and return the new ceiling.  Pure arithmetic; callers serialise.
+ */
+unsigned int cpufreq_powercap_step(struct cpufreq_powercap *pc,
+				   unsigned int cur, u64 wall_us, u64 idle_us);
+
+#ifdef CONFIG_CPU_FREQ_POWERCAP
+int cpufreq_powercap_register(struct cpufreq_powercap *pc);
+void cpufreq_powercap_unregister(struct cpufreq_powercap *pc);
+#else
+static inline int cpufreq_powercap_register(struct cpufreq_powercap *pc)
+{
+	return 0;
+}
+static inline void cpufreq_powercap_unregister(struct cpufreq_powercap *pc)
+{
+}
+#endif
+
+#endif /* _LINUX_CPUFREQ_POWERCAP_H */
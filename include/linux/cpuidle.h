@@ -40,6 +40,8 @@ struct cpuidle_state {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	above; /* woke before target_residency */
+	unsigned long long	below; /* a deeper state would have fit */
 
 	int (*enter)	(struct cpuidle_device *dev,
 			 struct cpuidle_state *state);
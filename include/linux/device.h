@@ -67,6 +67,8 @@ extern void bus_remove_file(struct bus_type *, struct bus_attribute *);
  * @resume:	Called to bring a device on this bus out of sleep mode.
  * @pm:		Power management operations of this bus, callback the specific
  *		device driver's pm-ops.
+ * @async_suspend: Suspend and resume devices on this bus asynchronously.
+ *		Set with bus_enable_async_suspend().
  * @p:		The private data of the driver core, only the driver core can
  *		touch this.
  *
@@ -95,6 +97,7 @@ struct bus_type {
 	int (*resume)(struct device *dev);
 
 	const struct dev_pm_ops *pm;
+	bool async_suspend;
 
 	struct subsys_private *p;
 };
@@ -268,6 +271,8 @@ struct device *driver_find_device(struct device_driver *drv,
  * @ns_type:	Callbacks so sysfs can detemine namespaces.
  * @namespace:	Namespace of the device belongs to this class.
  * @pm:		The default device power management operations of this class.
+ * @async_suspend: Suspend and resume devices of this class asynchronously.
+ *		Set with class_enable_async_suspend().
  * @p:		The private data of the driver core, no one other than the
  *		driver core can touch this.
  *
@@ -299,6 +304,7 @@ struct class {
 	const void *(*namespace)(struct device *dev);
 
 	const struct dev_pm_ops *pm;
+	bool async_suspend;
 
 	struct subsys_private *p;
 };
@@ -668,6 +674,14 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+#ifdef CONFIG_PM_SLEEP
+extern void bus_enable_async_suspend(struct bus_type *bus);
+extern void class_enable_async_suspend(struct class *cls);
+#else
+static inline void bus_enable_async_suspend(struct bus_type *bus) {}
+static inline void class_enable_async_suspend(struct class *cls) {}
+#endif
+
 static inline void device_lock(struct device *dev)
 {
 	mutex_lock(&dev->mutex);
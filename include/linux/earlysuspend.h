@@ -29,6 +29,13 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ *
+ * A handler that does not depend on any other handler of its level (e.g. a
+ * touchscreen that is only powered down) can set async.  Async handlers run
+ * on the async threads, concurrently with the other handlers of their level;
+ * all handlers of a level have finished before the next level starts, so
+ * the level order holds for async handlers too.  The durations of the last
+ * and slowest calls are kept for the debugfs report.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +48,12 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	bool async;
+	/* Filled in by the core, in microseconds */
+	unsigned int suspend_us;
+	unsigned int suspend_max_us;
+	unsigned int resume_us;
+	unsigned int resume_max_us;
 #endif
 };
 
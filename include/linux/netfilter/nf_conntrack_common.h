@@ -127,6 +127,8 @@ struct ip_conntrack_stat {
 	unsigned int expect_create;
 	unsigned int expect_delete;
 	unsigned int search_restart;
+	unsigned int hash_resize;
+	unsigned int fastpath;
 };
 
 /* call to create an explicit dependency on nf_conntrack. */
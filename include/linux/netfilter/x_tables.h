@@ -404,6 +404,12 @@ struct xt_table_info {
 	unsigned int stacksize;
 	unsigned int __percpu *stackptr;
 	void ***jumpstack;
+
+	/* Rule dispatch built at table load, NULL if there is nothing to do */
+	struct xt_dispatch *dispatch;
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+	struct xt_profile *profile;
+#endif
 	/* ipt_entry tables: one per CPU */
 	/* Note : this field MUST be the last one, see XT_TABLE_INFO_SZ */
 	void *entries[1];
@@ -411,6 +417,147 @@ struct xt_table_info {
 
 #define XT_TABLE_INFO_SZ (offsetof(struct xt_table_info, entries) \
 			  + nr_cpu_ids * sizeof(char *))
+
+/*
+ * Rule dispatch.  A run of consecutive rules that differ only in one key
+ * (a single uid owner match, mark match or tcp/udp destination port, or
+ * an exact input or output interface) is looked up by the packet's key
+ * instead of being walked: the walk goes straight to the first rule of
+ * the run that can match, or past the run when none can.  That rule is
+ * still evaluated in full, and all the key matches are stateless, so
+ * the verdict, counters and targets seen are those of a linear walk.
+ */
+enum xt_dispatch_type {
+	XT_DISPATCH_NONE,
+	XT_DISPATCH_UID,
+	XT_DISPATCH_MARK,
+	XT_DISPATCH_DPORT,
+	XT_DISPATCH_IIF,
+	XT_DISPATCH_OIF,
+};
+
+union xt_dispatch_val {
+	u32 val;
+	char ifname[IFNAMSIZ];
+	u32 word[IFNAMSIZ / sizeof(u32)];
+};
+
+/* The key of a rule, filled in by the family's table translation */
+struct xt_dispatch_rule {
+	unsigned int offset;		/* of the rule in the table */
+	unsigned int size;		/* its next_offset */
+	unsigned int run;		/* rules of a run share this */
+	u8 type;			/* enum xt_dispatch_type */
+	u8 proto;			/* XT_DISPATCH_DPORT: IPPROTO_TCP/UDP */
+	u32 mask;			/* XT_DISPATCH_MARK: the mark mask */
+	union xt_dispatch_val key;
+};
+
+struct xt_dispatch_run;
+
+struct xt_dispatch {
+	unsigned int nrules, nruns;
+	unsigned int *offset;		/* dispatched rules, in table order */
+	unsigned int *run;		/* run of each rule */
+	unsigned int *next;		/* next rule of its run with its key */
+	struct xt_dispatch_run *runs;
+	unsigned long *bitmap;		/* dispatched rules by offset */
+};
+
+extern bool xt_dispatch_enabled;
+
+extern bool xt_dispatch_match(const struct xt_entry_match *m,
+			      struct xt_dispatch_rule *rule);
+extern struct xt_dispatch *xt_dispatch_build(unsigned int size,
+					     const struct xt_dispatch_rule *rules,
+					     unsigned int n);
+extern void xt_dispatch_free(struct xt_dispatch *d);
+extern unsigned int xt_dispatch_next(const struct xt_dispatch *d,
+				     unsigned int offset,
+				     const struct sk_buff *skb,
+				     const struct xt_action_param *par,
+				     u8 proto);
+
+/* is the rule at offset part of a run? */
+static inline bool xt_dispatch_test(const struct xt_dispatch *d,
+				    unsigned int offset)
+{
+	return test_bit(offset / XT_ALIGN(1), d->bitmap);
+}
+
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+#include <linux/sched.h>
+#include <linux/percpu.h>
+
+struct xt_rule_prof {
+	u64 evals;			/* times the rule was looked at */
+	u64 hits;			/* times it matched */
+	u64 nsecs;			/* time from it to the next rule */
+};
+
+struct xt_profile {
+	unsigned int nrules;
+	unsigned int *index;		/* rule by offset / XT_ALIGN(1) */
+	const char **chain;		/* chain of each rule */
+	unsigned int *rulenum;		/* its number in the chain */
+	struct xt_rule_prof __percpu *rules;
+};
+
+extern struct xt_profile *xt_profile_alloc(unsigned int size,
+					   unsigned int number);
+extern void xt_profile_free(struct xt_profile *p);
+
+struct xt_profile_state {
+	struct xt_rule_prof *rule;
+	u64 start;
+};
+
+static inline void xt_profile_begin(struct xt_profile_state *ps)
+{
+	ps->rule = NULL;
+}
+
+/* the walk moves on to the rule at offset: charge the time to the last */
+static inline void xt_profile_rule(struct xt_profile_state *ps,
+				   const struct xt_table_info *info,
+				   unsigned int offset)
+{
+	const struct xt_profile *p = info->profile;
+	u64 now;
+
+	if (p == NULL)
+		return;
+	now = sched_clock();
+	if (ps->rule != NULL)
+		ps->rule->nsecs += now - ps->start;
+	ps->rule = this_cpu_ptr(p->rules) + p->index[offset / XT_ALIGN(1)];
+	ps->rule->evals++;
+	ps->start = now;
+}
+
+static inline void xt_profile_hit(struct xt_profile_state *ps)
+{
+	if (ps->rule != NULL)
+		ps->rule->hits++;
+}
+
+static inline void xt_profile_end(struct xt_profile_state *ps)
+{
+	if (ps->rule != NULL)
+		ps->rule->nsecs += sched_clock() - ps->start;
+}
+#else
+struct xt_profile_state {
+};
+
+static inline void xt_profile_begin(struct xt_profile_state *ps) {}
+static inline void xt_profile_rule(struct xt_profile_state *ps,
+				   const struct xt_table_info *info,
+				   unsigned int offset) {}
+static inline void xt_profile_hit(struct xt_profile_state *ps) {}
+static inline void xt_profile_end(struct xt_profile_state *ps) {}
+#endif /* CONFIG_NETFILTER_XTABLES_PROFILE */
+
 extern int xt_register_target(struct xt_target *target);
 extern void xt_unregister_target(struct xt_target *target);
 extern int xt_register_targets(struct xt_target *target, unsigned int n);
@@ -102,4 +102,13 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Get/set the CFS latency nice value of a thread, see sched.h.  arg3 is
+ * a thread id, 0 for the calling thread.  PR_GET stores the value in the
+ * int pointed to by arg2.  The numbers are kept away from the upstream
+ * range so that later upstream prctls can never alias them.
+ */
+#define PR_SET_LATENCY_NICE	0x4c4e4901
+#define PR_GET_LATENCY_NICE	0x4c4e4902
+
 #endif /* _LINUX_PRCTL_H */
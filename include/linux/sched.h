@@ -1231,6 +1231,7 @@ struct task_struct {
 	int on_rq;
 
 	int prio, static_prio, normal_prio;
+	int latency_nice;
 	unsigned int rt_priority;
 	const struct sched_class *sched_class;
 	struct sched_entity se;
@@ -1594,6 +1595,14 @@ struct task_struct {
 #define MAX_PRIO		(MAX_RT_PRIO + 40)
 #define DEFAULT_PRIO		(MAX_RT_PRIO + 20)
 
+/*
+ * Latency nice is a hint for CFS only: negative values ask for earlier
+ * wakeup preemption and shorter slices, positive ones for the opposite.
+ * It never changes the share of CPU time a task gets.
+ */
+#define MIN_LATENCY_NICE	-20
+#define MAX_LATENCY_NICE	19
+
 static inline int rt_prio(int prio)
 {
 	if (unlikely(prio < MAX_RT_PRIO))
@@ -2040,6 +2049,7 @@ extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
 extern int task_nice(const struct task_struct *p);
 extern int can_nice(const struct task_struct *p, const int nice);
+extern int sched_set_latency_nice(struct task_struct *p, int latency_nice);
 extern int task_curr(const struct task_struct *p);
 extern int idle_cpu(int cpu);
 extern int sched_setscheduler(struct task_struct *, int,
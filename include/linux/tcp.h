@@ -207,6 +207,7 @@ struct tcp_cookie_transactions {
 
 #include <linux/skbuff.h>
 #include <linux/dmaengine.h>
+#include <linux/hrtimer.h>
 #include <net/sock.h>
 #include <net/inet_connection_sock.h>
 #include <net/inet_timewait_sock.h>
@@ -316,6 +317,13 @@ struct tcp_sock {
 	u32	rcv_tstamp;	/* timestamp of last received ACK (for keepalives) */
 	u32	lsndtime;	/* timestamp of last sent data packet (for restart window) */
 
+	/* TCP Small Queues and pacing, see tcp_write_xmit() */
+	struct list_head tsq_node; /* anchor in tsq_tasklet.head list */
+	unsigned long	tsq_flags;
+	u32	pacing_rate;	/* bytes per second, 0 until an RTT is known */
+	ktime_t	pacing_next;	/* earliest time to send the next segment */
+	struct hrtimer	pacing_timer;
+
 	/* Data for direct copy to user */
 	struct {
 		struct sk_buff_head	prequeue;
@@ -462,6 +470,12 @@ struct tcp_sock {
 	struct tcp_cookie_values  *cookie_values;
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,	/* waiting for queued segments to leave the host */
+	TSQ_QUEUED,	/* on a tsq_tasklet list */
+	TSQ_OWNED,	/* user held the socket, tcp_release_cb() sends */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
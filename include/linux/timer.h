@@ -229,6 +229,13 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+struct ctl_table;
+
+extern unsigned int sysctl_timer_coalesce_us;
+extern int timer_coalesce_sysctl_handler(struct ctl_table *table, int write,
+					 void __user *buffer, size_t *lenp,
+					 loff_t *ppos);
+
 /*
  * Timer-statistics info:
  */
@@ -237,8 +244,11 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_TICK		0x2
 
 extern void init_timer_stats(void);
+extern void timer_stats_idle_enter(void);
+extern void timer_stats_idle_exit(void);
 
 extern void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 				     void *timerf, char *comm,
@@ -263,6 +273,14 @@ static inline void init_timer_stats(void)
 {
 }
 
+static inline void timer_stats_idle_enter(void)
+{
+}
+
+static inline void timer_stats_idle_exit(void)
+{
+}
+
 static inline void timer_stats_timer_set_start_info(struct timer_list *timer)
 {
 }
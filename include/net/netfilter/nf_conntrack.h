@@ -72,6 +72,7 @@ union nf_conntrack_help {
 #include <linux/types.h>
 #include <linux/skbuff.h>
 #include <linux/timer.h>
+#include <net/net_namespace.h>
 
 #ifdef CONFIG_NETFILTER_DEBUG
 #define NF_CT_ASSERT(x)		WARN_ON(!(x))
@@ -205,6 +206,24 @@ extern void *nf_ct_alloc_hashtable(unsigned int *sizep, int nulls);
 
 extern void nf_ct_free_hashtable(void *hash, unsigned int size);
 
+/*
+ * The hash table is replaced when it is resized.  Lockless readers take
+ * the table and its size together here and must not use them after
+ * leaving their RCU read side section.
+ */
+static inline void nf_conntrack_get_ht(const struct net *net,
+				       struct hlist_nulls_head **hash,
+				       unsigned int *hsize)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&net->ct.generation);
+		*hash = net->ct.hash;
+		*hsize = net->ct.htable_size;
+	} while (read_seqcount_retry(&net->ct.generation, seq));
+}
+
 extern struct nf_conntrack_tuple_hash *
 __nf_conntrack_find(struct net *net, u16 zone,
 		    const struct nf_conntrack_tuple *tuple);
@@ -328,6 +347,23 @@ do {							\
 	local_bh_enable();				\
 } while (0)
 
+/*
+ * Fast path for the filter tables: a packet of a connection already
+ * seen in both directions is accepted without walking the chain, as a
+ * leading "-m state --state ESTABLISHED -j ACCEPT" rule would do.
+ */
+static inline bool nf_ct_fastpath(struct net *net, const struct sk_buff *skb)
+{
+	enum ip_conntrack_info ctinfo;
+	struct nf_conn *ct = nf_ct_get(skb, &ctinfo);
+
+	if (ct == NULL || nf_ct_is_untracked(ct) ||
+	    (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY))
+		return false;
+	NF_CT_STAT_INC(net, fastpath);
+	return true;
+}
+
 #define MODULE_ALIAS_NFCT_HELPER(helper) \
         MODULE_ALIAS("nfct-helper-" helper)
 
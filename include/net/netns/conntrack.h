@@ -3,6 +3,8 @@
 
 #include <linux/list.h>
 #include <linux/list_nulls.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
 #include <asm/atomic.h>
 
 struct ctl_table_header;
@@ -14,6 +16,8 @@ struct netns_ct {
 	unsigned int		htable_size;
 	struct kmem_cache	*nf_conntrack_cachep;
 	struct hlist_nulls_head	*hash;
+	seqcount_t		generation;	/* hash, htable_size change */
+	struct work_struct	resize_work;
 	struct hlist_head	*expect_hash;
 	struct hlist_nulls_head	unconfirmed;
 	struct hlist_nulls_head	dying;
@@ -23,6 +27,7 @@ struct netns_ct {
 	int			sysctl_acct;
 	int			sysctl_tstamp;
 	int			sysctl_checksum;
+	int			sysctl_hash_grow;
 	unsigned int		sysctl_log_invalid; /* Log invalid packets */
 #ifdef CONFIG_SYSCTL
 	struct ctl_table_header	*sysctl_header;
@@ -404,6 +404,62 @@ TRACE_EVENT(ext4_da_writepages_result,
 		  (unsigned long) __entry->writeback_index)
 );
 
+TRACE_EVENT(ext4_io_submit,
+	TP_PROTO(struct inode *inode, sector_t sector, unsigned int size,
+		 int io_op),
+
+	TP_ARGS(inode, sector, size, io_op),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,	dev			)
+		__field(	ino_t,	ino			)
+		__field(	sector_t, sector		)
+		__field(	unsigned int, size		)
+		__field(	int,	io_op			)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= inode->i_sb->s_dev;
+		__entry->ino		= inode->i_ino;
+		__entry->sector		= sector;
+		__entry->size		= size;
+		__entry->io_op		= io_op;
+	),
+
+	TP_printk("dev %d,%d ino %lu sector %llu size %u io_op 0x%x",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  (unsigned long) __entry->ino,
+		  (unsigned long long) __entry->sector,
+		  __entry->size, __entry->io_op)
+);
+
+TRACE_EVENT(ext4_end_io_batch,
+	TP_PROTO(struct inode *inode, int nr_ios, loff_t bytes, int ret),
+
+	TP_ARGS(inode, nr_ios, bytes, ret),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,	dev			)
+		__field(	ino_t,	ino			)
+		__field(	int,	nr_ios			)
+		__field(	loff_t,	bytes			)
+		__field(	int,	ret			)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= inode->i_sb->s_dev;
+		__entry->ino		= inode->i_ino;
+		__entry->nr_ios		= nr_ios;
+		__entry->bytes		= bytes;
+		__entry->ret		= ret;
+	),
+
+	TP_printk("dev %d,%d ino %lu nr_ios %d bytes %lld ret %d",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  (unsigned long) __entry->ino, __entry->nr_ios,
+		  __entry->bytes, __entry->ret)
+);
+
 DECLARE_EVENT_CLASS(ext4__page_op,
 	TP_PROTO(struct page *page),
 
@@ -65,6 +65,45 @@ TRACE_EVENT(machine_suspend,
 	TP_printk("state=%lu", (unsigned long)__entry->state)
 );
 
+/*
+ * Emitted once per device in each system resume phase.  wait_us is the time
+ * spent waiting for the parent before the callbacks could run.
+ */
+TRACE_EVENT(device_pm_resume,
+
+	TP_PROTO(const char *name, const char *driver, const char *phase,
+		 bool async, unsigned int wait_us, unsigned int run_us,
+		 int error),
+
+	TP_ARGS(name, driver, phase, async, wait_us, run_us, error),
+
+	TP_STRUCT__entry(
+		__string(	name,		name		)
+		__string(	driver,		driver		)
+		__string(	phase,		phase		)
+		__field(	bool,		async		)
+		__field(	u32,		wait_us		)
+		__field(	u32,		run_us		)
+		__field(	int,		error		)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__assign_str(driver, driver);
+		__assign_str(phase, phase);
+		__entry->async = async;
+		__entry->wait_us = wait_us;
+		__entry->run_us = run_us;
+		__entry->error = error;
+	),
+
+	TP_printk("%s driver=%s phase=%s async=%d wait_us=%lu run_us=%lu "
+		  "error=%d", __get_str(name), __get_str(driver),
+		  __get_str(phase), __entry->async,
+		  (unsigned long)__entry->wait_us,
+		  (unsigned long)__entry->run_us, __entry->error)
+);
+
 /* This code will be removed after deprecation time exceeded (2.6.41) */
 #ifdef CONFIG_EVENT_POWER_TRACING_DEPRECATED
 
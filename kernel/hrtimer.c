@@ -789,10 +789,17 @@ static inline void timer_stats_hrtimer_clear_start_info(struct hrtimer *timer)
 static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
 {
 #ifdef CONFIG_TIMER_STATS
+	unsigned int flag = 0;
+
 	if (likely(!timer_stats_active))
 		return;
+#ifdef CONFIG_TICK_ONESHOT
+	/* The tick only carries the timer wheel, don't blame it for wakeups */
+	if (timer == &tick_get_tick_sched(smp_processor_id())->sched_timer)
+		flag |= TIMER_STATS_FLAG_TICK;
+#endif
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm, flag);
 #endif
 }
 
@@ -941,6 +948,31 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
 	return 0;
 }
 
+/*
+ * With timer coalescing on (kernel.timer_coalesce_us), pull the hard
+ * expiry of a timer with a slack range back onto the coalescing grid,
+ * as long as the grid point is still inside the range.  Timers whose
+ * ranges cover the same grid point then share one expiry interrupt.
+ */
+static inline void hrtimer_coalesce(struct hrtimer *timer)
+{
+	u32 grid = sysctl_timer_coalesce_us * NSEC_PER_USEC;
+	s64 soft, hard;
+	u32 rem;
+
+	if (likely(!grid))
+		return;
+
+	soft = ktime_to_ns(hrtimer_get_softexpires(timer));
+	hard = ktime_to_ns(hrtimer_get_expires(timer));
+	if (hard <= soft || soft < 0 || hard == KTIME_MAX)
+		return;
+
+	div_u64_rem(hard, grid, &rem);
+	if (hard - rem >= soft)
+		timer->node.expires = ns_to_ktime(hard - rem);
+}
+
 int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 		unsigned long delta_ns, const enum hrtimer_mode mode,
 		int wakeup)
@@ -972,6 +1004,7 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	}
 
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
+	hrtimer_coalesce(timer);
 
 	timer_stats_hrtimer_set_start_info(timer);
 
@@ -13,10 +13,14 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/syscalls.h> /* sys_sync */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
@@ -31,6 +35,11 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* Set to 0 to run async handlers inline, in level order like the rest */
+bool early_suspend_async = true;
+module_param_named(async, early_suspend_async, bool,
+		   S_IRUGO | S_IWUSR | S_IWGRP);
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -45,6 +54,56 @@ enum {
 };
 static int state;
 
+static LIST_HEAD(early_suspend_async_domain);
+unsigned int early_suspend_pass_us;
+unsigned int late_resume_pass_us;
+
+static unsigned int elapsed_us(ktime_t start)
+{
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
+static void call_suspend(struct early_suspend *h)
+{
+	ktime_t start = ktime_get();
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("early_suspend: calling %pf\n", h->suspend);
+	h->suspend(h);
+	h->suspend_us = elapsed_us(start);
+	h->suspend_max_us = max(h->suspend_max_us, h->suspend_us);
+}
+
+static void call_resume(struct early_suspend *h)
+{
+	ktime_t start = ktime_get();
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("late_resume: calling %pf\n", h->resume);
+	h->resume(h);
+	h->resume_us = elapsed_us(start);
+	h->resume_max_us = max(h->resume_max_us, h->resume_us);
+}
+
+static void async_suspend(void *data, async_cookie_t cookie)
+{
+	call_suspend(data);
+}
+
+static void async_resume(void *data, async_cookie_t cookie)
+{
+	call_resume(data);
+}
+
+/* A level's async handlers finish before the next level starts */
+static void sync_level(int *level, struct early_suspend *h)
+{
+	if (h->level == *level)
+		return;
+	async_synchronize_full_domain(&early_suspend_async_domain);
+	*level = h->level;
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -58,7 +117,7 @@ void register_early_suspend(struct early_suspend *handler)
 	}
 	list_add_tail(&handler->link, pos);
 	if ((state & SUSPENDED) && handler->suspend)
-		handler->suspend(handler);
+		call_suspend(handler);
 	mutex_unlock(&early_suspend_lock);
 }
 EXPORT_SYMBOL(register_early_suspend);
@@ -76,6 +135,8 @@ static void early_suspend(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -94,13 +155,22 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-			pos->suspend(pos);
-		}
+		if (pos->suspend == NULL)
+			continue;
+		sync_level(&level, pos);
+		if (pos->async && early_suspend_async)
+			async_schedule_domain(async_suspend, pos,
+					      &early_suspend_async_domain);
+		else
+			call_suspend(pos);
 	}
+	async_synchronize_full_domain(&early_suspend_async_domain);
+	early_suspend_pass_us = elapsed_us(start);
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("early_suspend: handlers took %u us\n",
+			early_suspend_pass_us);
 	mutex_unlock(&early_suspend_lock);
 
 #ifdef CONFIG_SUSPEND_SYNC_WORKQUEUE
@@ -123,6 +193,8 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MAX;
+	ktime_t start;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -139,16 +211,21 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-		}
+		if (pos->resume == NULL)
+			continue;
+		sync_level(&level, pos);
+		if (pos->async && early_suspend_async)
+			async_schedule_domain(async_resume, pos,
+					      &early_suspend_async_domain);
+		else
+			call_resume(pos);
 	}
+	async_synchronize_full_domain(&early_suspend_async_domain);
+	late_resume_pass_us = elapsed_us(start);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %u us\n", late_resume_pass_us);
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
@@ -189,3 +266,53 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_debug_show(struct seq_file *s, void *data)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "last early_suspend %u us, late_resume %u us\n\n",
+		   early_suspend_pass_us, late_resume_pass_us);
+	seq_printf(s, "level async  suspend(us)      max   resume(us)      max"
+		   "  handler\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d %5s %12u %8u %12u %8u  %pf\n",
+			   pos->level, pos->async ? "yes" : "no",
+			   pos->suspend_us, pos->suspend_max_us,
+			   pos->resume_us, pos->resume_max_us,
+			   pos->suspend ? (void *)pos->suspend :
+					  (void *)pos->resume);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_debug_show, NULL);
+}
+
+static const struct file_operations early_suspend_debug_fops = {
+	.open		= early_suspend_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("earlysuspend", 0444, NULL, NULL,
+				&early_suspend_debug_fops);
+	if (!d) {
+		pr_err("Failed to create earlysuspend debug file\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+late_initcall(early_suspend_debug_init);
+#endif
@@ -0,0 +1,237 @@
+/*
+ * kernel/power/earlysuspend_test.c - early suspend ordering test
+ *
+ * Booting with "test_earlysuspend" registers a few synthetic slow
+ * handlers, some of them async, and runs an early suspend / late resume
+ * cycle with the async handlers run inline, then one with them async.
+ * It checks that every level finished before the next one started, that
+ * the synchronous handlers of a level kept their order, and that each
+ * async handler overlapped another handler of its level.  The pass times
+ * of both cycles, real handlers included, are logged side by side.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/delay.h>
+#include <linux/earlysuspend.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/wakelock.h>
+#include <linux/workqueue.h>
+
+#include "power.h"
+
+struct test_handler {
+	struct early_suspend h;
+	unsigned int delay_ms;
+	s64 start[2];		/* ns */
+	s64 end[2];
+};
+
+enum { TEST_SUSPEND, TEST_RESUME };
+
+/* Loosely modelled on the RK29 tablet's slowest handlers */
+static struct test_handler test_handlers[] = {
+	{	/* sensor */
+		.h = { .level = 2, .async = true },
+		.delay_ms = 30,
+	},
+	{	/* compass */
+		.h = { .level = 2, .async = true },
+		.delay_ms = 20,
+	},
+	{	/* backlight */
+		.h = { .level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN - 1 },
+		.delay_ms = 40,
+	},
+	{
+		.h = { .level = EARLY_SUSPEND_LEVEL_STOP_DRAWING },
+		.delay_ms = 20,
+	},
+	{	/* framebuffer */
+		.h = { .level = EARLY_SUSPEND_LEVEL_DISABLE_FB },
+		.delay_ms = 80,
+	},
+	{	/* touchscreen */
+		.h = { .level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+		       .async = true },
+		.delay_ms = 60,
+	},
+	{	/* codec */
+		.h = { .level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+		       .async = true },
+		.delay_ms = 50,
+	},
+};
+
+static bool test_earlysuspend __initdata;
+static struct wake_lock test_wake_lock;
+
+static void test_run(struct early_suspend *h, int pass)
+{
+	struct test_handler *t = container_of(h, struct test_handler, h);
+
+	t->start[pass] = ktime_to_ns(ktime_get());
+	msleep(t->delay_ms);
+	t->end[pass] = ktime_to_ns(ktime_get());
+}
+
+static void test_suspend(struct early_suspend *h)
+{
+	test_run(h, TEST_SUSPEND);
+}
+
+static void test_resume(struct early_suspend *h)
+{
+	test_run(h, TEST_RESUME);
+}
+
+static bool __init test_overlap(struct test_handler *a,
+				struct test_handler *b, int pass)
+{
+	return a->start[pass] < b->end[pass] && b->start[pass] < a->end[pass];
+}
+
+/*
+ * Handlers of a level must all have finished before the next level, in
+ * pass order, starts.  Synchronous handlers of the same level must not
+ * overlap and run in registration order.  When run async, each async
+ * handler must have overlapped another handler of its level.
+ */
+static int __init test_check(int pass, const char *label, bool async)
+{
+	struct test_handler *t, *u;
+	int i, j, n = ARRAY_SIZE(test_handlers), errors = 0;
+	bool overlapped;
+
+	for (i = 0; i < n; i++) {
+		t = &test_handlers[i];
+		if (!t->end[pass]) {
+			pr_err("earlysuspend test: %s handler %d did not run\n",
+			       label, i);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		t = &test_handlers[i];
+		overlapped = false;
+		for (j = 0; j < n; j++) {
+			u = &test_handlers[j];
+			if (j == i)
+				continue;
+			if (u->h.level != t->h.level) {
+				/* i is in an earlier level than j */
+				if ((pass == TEST_SUSPEND) ==
+				    (t->h.level < u->h.level) &&
+				    u->start[pass] < t->end[pass]) {
+					pr_err("earlysuspend test: %s level %d "
+					       "started before level %d "
+					       "finished\n", label, u->h.level,
+					       t->h.level);
+					errors++;
+				}
+				continue;
+			}
+			if (test_overlap(t, u, pass))
+				overlapped = true;
+			/* in pass order, i comes before j */
+			if (!t->h.async && !u->h.async &&
+			    (pass == TEST_SUSPEND) == (i < j) &&
+			    u->start[pass] < t->end[pass]) {
+				pr_err("earlysuspend test: %s handler %d "
+				       "started before handler %d of its "
+				       "level finished\n", label, j, i);
+				errors++;
+			}
+		}
+		if (async && t->h.async && !overlapped) {
+			pr_err("earlysuspend test: %s async handler %d ran "
+			       "alone\n", label, i);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+/* One early suspend / late resume cycle; returns the number of errors */
+static int __init test_cycle(bool async, unsigned int *suspend_us,
+			     unsigned int *resume_us)
+{
+	const char *mode = async ? "async" : "inline";
+	int i, errors;
+
+	for (i = 0; i < ARRAY_SIZE(test_handlers); i++) {
+		memset(test_handlers[i].start, 0,
+		       sizeof(test_handlers[i].start));
+		memset(test_handlers[i].end, 0, sizeof(test_handlers[i].end));
+	}
+
+	early_suspend_async = async;
+	request_suspend_state(PM_SUSPEND_MEM);
+	flush_workqueue(suspend_work_queue);
+	*suspend_us = early_suspend_pass_us;
+	request_suspend_state(PM_SUSPEND_ON);
+	flush_workqueue(suspend_work_queue);
+	*resume_us = late_resume_pass_us;
+
+	errors = test_check(TEST_SUSPEND, "early_suspend", async);
+	errors += test_check(TEST_RESUME, "late_resume", async);
+	if (errors)
+		pr_err("earlysuspend test: %d errors running %s\n",
+		       errors, mode);
+	return errors;
+}
+
+static int __init test_earlysuspend_init(void)
+{
+	unsigned int inline_suspend, inline_resume, async_suspend, async_resume;
+	bool old_async = early_suspend_async;
+	int i, errors;
+
+	if (!test_earlysuspend)
+		return 0;
+
+	/* Keep the early suspend from turning into a real suspend */
+	wake_lock_init(&test_wake_lock, WAKE_LOCK_SUSPEND, "earlysuspend_test");
+	wake_lock(&test_wake_lock);
+
+	for (i = 0; i < ARRAY_SIZE(test_handlers); i++) {
+		test_handlers[i].h.suspend = test_suspend;
+		test_handlers[i].h.resume = test_resume;
+		register_early_suspend(&test_handlers[i].h);
+	}
+
+	errors = test_cycle(false, &inline_suspend, &inline_resume);
+	errors += test_cycle(true, &async_suspend, &async_resume);
+	early_suspend_async = old_async;
+
+	for (i = 0; i < ARRAY_SIZE(test_handlers); i++)
+		unregister_early_suspend(&test_handlers[i].h);
+
+	WARN(errors, "earlysuspend test: %d errors\n", errors);
+
+	pr_info("earlysuspend test: early_suspend %u ms, %u ms inline; "
+		"late_resume %u ms, %u ms inline\n",
+		async_suspend / USEC_PER_MSEC, inline_suspend / USEC_PER_MSEC,
+		async_resume / USEC_PER_MSEC, inline_resume / USEC_PER_MSEC);
+
+	wake_unlock(&test_wake_lock);
+	wake_lock_destroy(&test_wake_lock);
+	return 0;
+}
+late_initcall(test_earlysuspend_init);
+
+static int __init setup_test_earlysuspend(char *str)
+{
+	test_earlysuspend = true;
+	return 1;
+}
+__setup("test_earlysuspend", setup_test_earlysuspend);
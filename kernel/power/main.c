@@ -100,31 +100,45 @@ static ssize_t pm_test_show(struct kobject *kobj, struct kobj_attribute *attr,
 	return (s - buf);
 }
 
+/**
+ * pm_test_find_level - Look up a suspend test level by name.
+ * @buf: Name of the level, not necessarily NUL terminated.
+ * @len: Length of the name.
+ *
+ * Returns the level or -EINVAL if there is no such level.
+ */
+int pm_test_find_level(const char *buf, size_t len)
+{
+	const char * const *s;
+	int level;
+
+	level = TEST_FIRST;
+	for (s = &pm_tests[level]; level <= TEST_MAX; s++, level++)
+		if (*s && len == strlen(*s) && !strncmp(buf, *s, len))
+			return level;
+
+	return -EINVAL;
+}
+
 static ssize_t pm_test_store(struct kobject *kobj, struct kobj_attribute *attr,
 				const char *buf, size_t n)
 {
-	const char * const *s;
 	int level;
 	char *p;
 	int len;
-	int error = -EINVAL;
 
 	p = memchr(buf, '\n', n);
 	len = p ? p - buf : n;
 
-	mutex_lock(&pm_mutex);
-
-	level = TEST_FIRST;
-	for (s = &pm_tests[level]; level <= TEST_MAX; s++, level++)
-		if (*s && len == strlen(*s) && !strncmp(buf, *s, len)) {
-			pm_test_level = level;
-			error = 0;
-			break;
-		}
+	level = pm_test_find_level(buf, len);
+	if (level < 0)
+		return level;
 
+	mutex_lock(&pm_mutex);
+	pm_test_level = level;
 	mutex_unlock(&pm_mutex);
 
-	return error ? error : n;
+	return n;
 }
 
 power_attr(pm_test);
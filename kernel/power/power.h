@@ -224,6 +224,7 @@ enum {
 #define TEST_MAX	(__TEST_AFTER_LAST - 1)
 
 extern int pm_test_level;
+extern int pm_test_find_level(const char *buf, size_t len);
 
 #ifdef CONFIG_SUSPEND_FREEZER
 static inline int suspend_freeze_processes(void)
@@ -273,4 +274,7 @@ ssize_t  wake_unlock_store(struct kobject *kobj, struct kobj_attribute *attr,
 /* kernel/power/earlysuspend.c */
 void request_suspend_state(suspend_state_t state);
 suspend_state_t get_suspend_state(void);
+extern bool early_suspend_async;
+extern unsigned int early_suspend_pass_us;
+extern unsigned int late_resume_pass_us;
 #endif
@@ -129,18 +129,54 @@ static int __init has_wakealarm(struct device *dev, void *name_ptr)
  * Kernel options like "test_suspend=mem" force suspend/resume sanity tests
  * at startup time.  They're normally disabled, for faster boot and because
  * we can't know which states really work on this particular system.
+ *
+ * "test_suspend=mem,platform" (or any other /sys/power/pm_test level) runs
+ * the cycle at that test level instead, which needs no RTC and so works
+ * under emulators too.  The critical path of the device resume is logged
+ * afterwards.
  */
 static suspend_state_t test_state __initdata = PM_SUSPEND_ON;
+static int test_level __initdata = TEST_NONE;
 
 static char warn_bad_state[] __initdata =
 	KERN_WARNING "PM: can't test '%s' suspend state\n";
+static char warn_bad_level[] __initdata =
+	KERN_WARNING "PM: unknown test level '%s'\n";
+
+static void __init test_level_suspend(suspend_state_t state, int level)
+{
+	static char info_test[] __initdata =
+		KERN_INFO "PM: test '%s' suspend at test level %d\n";
+	static char err_suspend[] __initdata =
+		KERN_ERR "PM: suspend test failed, error %d\n";
+	int status;
+
+	printk(info_test, pm_states[state], level);
+	pm_test_level = level;
+	status = pm_suspend(state);
+	pm_test_level = TEST_NONE;
+	if (status < 0)
+		printk(err_suspend, status);
+	else
+		dpm_resume_path_report();
+}
 
 static int __init setup_test_suspend(char *value)
 {
+	char *level;
 	unsigned i;
 
 	/* "=mem" ==> "mem" */
 	value++;
+	level = strchr(value, ',');
+	if (level) {
+		*level++ = '\0';
+		test_level = pm_test_find_level(level, strlen(level));
+		if (test_level < 0) {
+			printk(warn_bad_level, level);
+			test_level = TEST_NONE;
+		}
+	}
 	for (i = 0; i < PM_SUSPEND_MAX; i++) {
 		if (!pm_states[i])
 			continue;
@@ -170,6 +206,11 @@ static int __init test_suspend(void)
 		goto done;
 	}
 
+	if (test_level != TEST_NONE) {
+		test_level_suspend(test_state, test_level);
+		goto done;
+	}
+
 	/* RTCs have initialized by now too ... can we use one? */
 	class_find_device(rtc_class, NULL, &pony, has_wakealarm);
 	if (pony)
@@ -182,6 +223,7 @@ static int __init test_suspend(void)
 	/* go for it */
 	test_wakealarm(rtc, test_state);
 	rtc_class_close(rtc);
+	dpm_resume_path_report();
 done:
 	return 0;
 }
@@ -43,12 +43,35 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+/*
+ * Active locks without a timeout, per type.  While any is held the
+ * answer to has_wake_lock() is known without walking the active list.
+ */
+static int active_untimed_count[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 #ifdef CONFIG_SUSPEND_SYNC_WORKQUEUE
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
 static struct workqueue_struct *suspend_sys_sync_work_queue;
 static DECLARE_COMPLETION(suspend_sys_sync_comp);
+
+/*
+ * Longest a suspend attempt waits for the sync before giving up and backing
+ * off.  The sync itself carries on in the background.
+ */
+static unsigned int sync_timeout_ms = 2000;
+module_param(sync_timeout_ms, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/* Protected by suspend_sys_sync_lock */
+static struct {
+	unsigned int synced;		/* attempts that had data to write */
+	unsigned int skipped;		/* attempts that found nothing dirty */
+	unsigned int timeouts;		/* attempts that gave up waiting */
+	ktime_t start;			/* of the sync running now, or 0 */
+	ktime_t total_time;
+	ktime_t max_time;
+	ktime_t last_time;
+} suspend_sync_stats;
 #endif
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
@@ -126,6 +149,35 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		     ktime_to_ns(lock->stat.last_time));
 }
 
+#ifdef CONFIG_SUSPEND_SYNC_WORKQUEUE
+/*
+ * The suspend sync is shown as one more lock so that existing parsers keep
+ * working: count is the number of syncs that wrote something, expire_count
+ * the attempts that gave up waiting for one, wake_count the syncs skipped
+ * because nothing was dirty.  The times cover the syncs that wrote data.
+ */
+static int print_sync_stat(struct seq_file *m)
+{
+	ktime_t active_time = ktime_set(0, 0);
+	typeof(suspend_sync_stats) stats;
+
+	spin_lock(&suspend_sys_sync_lock);
+	stats = suspend_sync_stats;
+	spin_unlock(&suspend_sys_sync_lock);
+
+	if (stats.start.tv64)
+		active_time = ktime_sub(ktime_get(), stats.start);
+
+	return seq_printf(m,
+		     "\"%s\"\t%u\t%u\t%u\t%lld\t%lld\t%lld\t%lld\t%lld\n",
+		     "suspend_sys_sync", stats.synced, stats.timeouts,
+		     stats.skipped, ktime_to_ns(active_time),
+		     ktime_to_ns(stats.total_time), 0LL,
+		     ktime_to_ns(stats.max_time),
+		     ktime_to_ns(stats.last_time));
+}
+#endif
+
 static int wakelock_stats_show(struct seq_file *m, void *unused)
 {
 	unsigned long irqflags;
@@ -144,42 +196,44 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 			ret = print_lock_stat(m, lock);
 	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
+#ifdef CONFIG_SUSPEND_SYNC_WORKQUEUE
+	print_sync_stat(m);
+#endif
 	return 0;
 }
 
-static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
+static void wake_unlock_stat_locked(struct wake_lock *lock, int expired,
+				    ktime_t now)
 {
 	ktime_t duration;
-	ktime_t now;
+	ktime_t end = now;
+
 	if (!(lock->flags & WAKE_LOCK_ACTIVE))
 		return;
-	if (get_expired_time(lock, &now))
+	if (get_expired_time(lock, &end))
 		expired = 1;
-	else
-		now = ktime_get();
 	lock->stat.count++;
 	if (expired)
 		lock->stat.expire_count++;
-	duration = ktime_sub(now, lock->stat.last_time);
+	duration = ktime_sub(end, lock->stat.last_time);
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
-	lock->stat.last_time = ktime_get();
+	lock->stat.last_time = now;
 	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
+		duration = ktime_sub(end, last_sleep_time_update);
 		lock->stat.prevent_suspend_time = ktime_add(
 			lock->stat.prevent_suspend_time, duration);
 		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
 	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+static void update_sleep_wait_stats_locked(int done, ktime_t now)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
+	ktime_t etime, elapsed, add;
 	int expired;
 
-	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
 	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
 		expired = get_expired_time(lock, &etime);
@@ -200,11 +254,16 @@ static void update_sleep_wait_stats_locked(int done)
 }
 #endif
 
+static inline bool wake_lock_untimed_locked(struct wake_lock *lock)
+{
+	return (lock->flags & (WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE)) ==
+		WAKE_LOCK_ACTIVE;
+}
 
 static void expire_wake_lock(struct wake_lock *lock)
 {
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
+	wake_unlock_stat_locked(lock, 1, ktime_get());
 #endif
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
@@ -247,6 +306,9 @@ static long has_wake_lock_locked(int type)
 	long max_timeout = 0;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	if (active_untimed_count[type])
+		return -1;
+	/* Only locks with a timeout are left on the list */
 	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
@@ -273,17 +335,48 @@ long has_wake_lock(int type)
 }
 
 #ifdef CONFIG_SUSPEND_SYNC_WORKQUEUE
+#define SUSPEND_SYNC_BACKOFF_MIN	1000	/* ms */
+
+static unsigned int suspend_sync_backoff_ms = SUSPEND_SYNC_BACKOFF_MIN;
+
+/*
+ * Only filesystems with dirty data are synced in full.  The others just
+ * commit their journal, so when nothing was dirtied since the last sync
+ * this costs little more than a walk of the superblocks.
+ */
 static void suspend_sys_sync(struct work_struct *work)
 {
+	ktime_t start, duration;
+	int synced;
+
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("PM: Syncing filesystems...\n");
 
-	sys_sync();
+	start = ktime_get();
+	spin_lock(&suspend_sys_sync_lock);
+	suspend_sync_stats.start = start;
+	spin_unlock(&suspend_sys_sync_lock);
 
+	synced = sync_dirty_filesystems();
+
+	duration = ktime_sub(ktime_get(), start);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("sync done.\n");
+		pr_info("sync done, %d filesystems in %lld us.\n", synced,
+			ktime_to_us(duration));
 
 	spin_lock(&suspend_sys_sync_lock);
+	if (synced) {
+		suspend_sync_stats.synced++;
+		suspend_sync_stats.total_time =
+			ktime_add(suspend_sync_stats.total_time, duration);
+		if (duration.tv64 > suspend_sync_stats.max_time.tv64)
+			suspend_sync_stats.max_time = duration;
+	} else {
+		suspend_sync_stats.skipped++;
+	}
+	suspend_sync_stats.start = ktime_set(0, 0);
+	suspend_sync_stats.last_time = ktime_add(start, duration);
+	suspend_sync_backoff_ms = SUSPEND_SYNC_BACKOFF_MIN;
 	suspend_sys_sync_count--;
 	spin_unlock(&suspend_sys_sync_lock);
 }
@@ -301,6 +394,8 @@ void suspend_sys_sync_queue(void)
 }
 
 static bool suspend_sys_sync_abort;
+static bool suspend_sys_sync_timed_out;
+static unsigned long suspend_sys_sync_deadline;
 static void suspend_sys_sync_handler(unsigned long);
 static DEFINE_TIMER(suspend_sys_sync_timer, suspend_sys_sync_handler, 0, 0);
 /* value should be less then half of input event wake lock timeout value
@@ -314,21 +409,53 @@ static void suspend_sys_sync_handler(unsigned long arg)
 	} else if (has_wake_lock(WAKE_LOCK_SUSPEND)) {
 		suspend_sys_sync_abort = true;
 		complete(&suspend_sys_sync_comp);
+	} else if (time_after_eq(jiffies, suspend_sys_sync_deadline)) {
+		suspend_sys_sync_abort = true;
+		suspend_sys_sync_timed_out = true;
+		complete(&suspend_sys_sync_comp);
 	} else {
 		mod_timer(&suspend_sys_sync_timer, jiffies +
 				SUSPEND_SYS_SYNC_TIMEOUT);
 	}
 }
 
+/*
+ * A sync that runs past sync_timeout_ms aborts the attempt and holds off
+ * suspend for a while, doubling each time up to SUSPEND_BACKOFF_INTERVAL,
+ * rather than retrying straight into the same wait.
+ */
+static void suspend_sys_sync_backoff(void)
+{
+	unsigned int backoff_ms;
+
+	spin_lock(&suspend_sys_sync_lock);
+	suspend_sync_stats.timeouts++;
+	backoff_ms = suspend_sync_backoff_ms;
+	suspend_sync_backoff_ms = min(2 * backoff_ms,
+				      (unsigned int)SUSPEND_BACKOFF_INTERVAL);
+	spin_unlock(&suspend_sys_sync_lock);
+
+	pr_info("suspend: sync still running after %u ms, back off %u ms\n",
+		sync_timeout_ms, backoff_ms);
+	wake_lock_timeout(&suspend_backoff_lock, msecs_to_jiffies(backoff_ms));
+}
+
 int suspend_sys_sync_wait(void)
 {
 	suspend_sys_sync_abort = false;
+	suspend_sys_sync_timed_out = false;
 
 	if (suspend_sys_sync_count != 0) {
+		suspend_sys_sync_deadline = jiffies +
+			msecs_to_jiffies(sync_timeout_ms);
 		mod_timer(&suspend_sys_sync_timer, jiffies +
 				SUSPEND_SYS_SYNC_TIMEOUT);
 		wait_for_completion(&suspend_sys_sync_comp);
 	}
+	if (suspend_sys_sync_timed_out) {
+		suspend_sys_sync_backoff();
+		return -EBUSY;
+	}
 	if (suspend_sys_sync_abort) {
 		pr_info("suspend aborted....while waiting for sys_sync\n");
 		return -EAGAIN;
@@ -473,6 +600,8 @@ void wake_lock_destroy(struct wake_lock *lock)
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
+	if (wake_lock_untimed_locked(lock))
+		active_untimed_count[lock->flags & WAKE_LOCK_TYPE_MASK]--;
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
@@ -500,8 +629,16 @@ static void wake_lock_internal(
 	int type;
 	unsigned long irqflags;
 	long expire_in;
+	bool was_untimed;
+#ifdef CONFIG_WAKELOCK_STAT
+	ktime_t now;
+#endif
 
 	spin_lock_irqsave(&list_lock, irqflags);
+#ifdef CONFIG_WAKELOCK_STAT
+	/* under list_lock, so stat times never go backwards */
+	now = ktime_get();
+#endif
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
@@ -513,17 +650,19 @@ static void wake_lock_internal(
 		lock->stat.wakeup_count++;
 	}
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
-	    (long)(lock->expires - jiffies) <= 0) {
-		wake_unlock_stat_locked(lock, 0);
-		lock->stat.last_time = ktime_get();
-	}
+	    (long)(lock->expires - jiffies) <= 0)
+		wake_unlock_stat_locked(lock, 0, now);
 #endif
+	/* Before WAKE_LOCK_ACTIVE is set, or a new lock would count */
+	was_untimed = wake_lock_untimed_locked(lock);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
 #ifdef CONFIG_WAKELOCK_STAT
-		lock->stat.last_time = ktime_get();
+		lock->stat.last_time = now;
 #endif
 	}
+	if (was_untimed)
+		active_untimed_count[type]--;
 	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
@@ -539,14 +678,15 @@ static void wake_lock_internal(
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
 		list_add(&lock->link, &active_wake_locks[type]);
+		active_untimed_count[type]++;
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
 		current_event_num++;
 #ifdef CONFIG_WAKELOCK_STAT
 		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
+			update_sleep_wait_stats_locked(1, now);
 		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_stats_locked(0, now);
 #endif
 		if (has_timeout)
 			expire_in = has_wake_lock_locked(type);
@@ -585,13 +725,20 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
+#ifdef CONFIG_WAKELOCK_STAT
+	ktime_t now;
+#endif
+
 	spin_lock_irqsave(&list_lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 0);
+	now = ktime_get();
+	wake_unlock_stat_locked(lock, 0, now);
 #endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
+	if (wake_lock_untimed_locked(lock))
+		active_untimed_count[type]--;
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
 	list_del(&lock->link);
 	list_add(&lock->link, &inactive_locks);
@@ -614,7 +761,7 @@ void wake_unlock(struct wake_lock *lock)
 			if (debug_mask & DEBUG_SUSPEND)
 				print_active_locks_locked(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+			update_sleep_wait_stats_locked(0, now);
 #endif
 		}
 	}
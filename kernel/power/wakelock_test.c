@@ -0,0 +1,93 @@
+/*
+ * kernel/power/wakelock_test.c - wake lock accounting test
+ *
+ * Booting with "test_wakelock" takes and releases a test wake lock in
+ * the ways the core counts differently (untimed, with a timeout, taken
+ * again while active) and checks that has_wake_lock() reports the lock
+ * while it is held and nothing once it is released.  A count that is
+ * off by one would keep the device from ever suspending.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/wakelock.h>
+
+/* Idle wake locks are seldom held at boot, which the test needs */
+#define TEST_TYPE	WAKE_LOCK_IDLE
+
+static bool test_wakelock __initdata;
+
+static int __init test_expect(const char *step, long held)
+{
+	long ret = has_wake_lock(TEST_TYPE);
+
+	if (held ? ret != 0 : ret == 0)
+		return 0;
+	pr_err("wakelock test: %s: has_wake_lock() %ld, expected %s\n",
+	       step, ret, held ? "non zero" : "0");
+	return 1;
+}
+
+static int __init test_wakelock_init(void)
+{
+	struct wake_lock lock;
+	int errors = 0;
+
+	if (!test_wakelock)
+		return 0;
+
+	if (has_wake_lock(TEST_TYPE)) {
+		pr_info("wakelock test: idle wake locks held, skipped\n");
+		return 0;
+	}
+
+	wake_lock_init(&lock, TEST_TYPE, "wakelock_test");
+
+	wake_lock(&lock);
+	errors += test_expect("lock", 1);
+	wake_unlock(&lock);
+	errors += test_expect("lock, unlock", 0);
+
+	wake_lock(&lock);
+	wake_lock(&lock);
+	wake_unlock(&lock);
+	errors += test_expect("lock twice, unlock", 0);
+
+	wake_lock_timeout(&lock, HZ);
+	errors += test_expect("lock with timeout", 1);
+	wake_lock(&lock);
+	errors += test_expect("timeout, then lock", 1);
+	wake_unlock(&lock);
+	errors += test_expect("timeout, lock, unlock", 0);
+
+	wake_lock(&lock);
+	wake_lock_timeout(&lock, HZ);
+	wake_unlock(&lock);
+	errors += test_expect("lock, timeout, unlock", 0);
+
+	wake_lock(&lock);
+	wake_lock_destroy(&lock);
+	errors += test_expect("lock, destroy", 0);
+
+	WARN(errors, "wakelock test: %d errors\n", errors);
+	if (!errors)
+		pr_info("wakelock test: passed\n");
+	return 0;
+}
+late_initcall(test_wakelock_init);
+
+static int __init setup_test_wakelock(char *str)
+{
+	test_wakelock = true;
+	return 1;
+}
+__setup("test_wakelock", setup_test_wakelock);
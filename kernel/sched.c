@@ -2851,6 +2851,9 @@ void sched_fork(struct task_struct *p)
 			set_load_weight(p);
 		}
 
+		if (p->latency_nice < 0)
+			p->latency_nice = 0;
+
 		/*
 		 * We don't need the reset flag anymore after the fork. It has
 		 * fulfilled its duty:
@@ -4925,6 +4928,31 @@ int can_nice(const struct task_struct *p, const int nice)
 		capable(CAP_SYS_NICE));
 }
 
+/**
+ * sched_set_latency_nice - set the latency nice value of a task
+ * @p: the task
+ * @latency_nice: new value, MIN_LATENCY_NICE to MAX_LATENCY_NICE
+ *
+ * Lowering the value needs CAP_SYS_NICE, as with nice.  The caller is
+ * responsible for checking that it may change @p at all.
+ */
+int sched_set_latency_nice(struct task_struct *p, int latency_nice)
+{
+	unsigned long flags;
+	struct rq *rq;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -EINVAL;
+	if (latency_nice < p->latency_nice && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	rq = task_rq_lock(p, &flags);
+	p->latency_nice = latency_nice;
+	task_rq_unlock(rq, p, &flags);
+
+	return 0;
+}
+
 #ifdef __ARCH_WANT_SYS_NICE
 
 /*
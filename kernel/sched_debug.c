@@ -484,6 +484,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.load.weight);
 	P(policy);
 	P(prio);
+	P(latency_nice);
 #undef PN
 #undef __PN
 #undef P
@@ -536,6 +536,37 @@ static u64 sched_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	return slice;
 }
 
+/*
+ * Latency nice: a task's position for wakeup preemption is shifted by
+ * latency_nice/20 of a period, and a latency sensitive task's slice is
+ * cut down in the same proportion, to no less than min_granularity.
+ * Neither changes vruntime accounting, so the CPU share stays the same:
+ * a task that keeps cutting in line simply gets to do so less often.
+ * Group entities have no latency nice of their own.
+ */
+static inline long latency_offset(struct sched_entity *se)
+{
+	if (!entity_is_task(se))
+		return 0;
+
+	return (long)(sysctl_sched_latency / 20) * task_of(se)->latency_nice;
+}
+
+static u64 latency_slice(struct sched_entity *se, u64 slice)
+{
+	int latency_nice;
+
+	if (!entity_is_task(se))
+		return slice;
+
+	latency_nice = task_of(se)->latency_nice;
+	if (latency_nice >= 0)
+		return slice;
+
+	slice = div_u64(slice * (20 + latency_nice), 20);
+	return max_t(u64, slice, sysctl_sched_min_granularity);
+}
+
 /*
  * We calculate the vruntime slice of a to be inserted task
  *
@@ -1097,7 +1128,7 @@ check_preempt_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr)
 {
 	unsigned long ideal_runtime, delta_exec;
 
-	ideal_runtime = sched_slice(cfs_rq, curr);
+	ideal_runtime = latency_slice(curr, sched_slice(cfs_rq, curr));
 	delta_exec = curr->sum_exec_runtime - curr->prev_sum_exec_runtime;
 	if (delta_exec > ideal_runtime) {
 		resched_task(rq_of(cfs_rq)->curr);
@@ -1845,6 +1876,7 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	vdiff += latency_offset(curr) - latency_offset(se);
 	if (vdiff <= 0)
 		return -1;
 
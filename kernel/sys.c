@@ -1683,6 +1683,34 @@ SYSCALL_DEFINE1(umask, int, mask)
 	return mask;
 }
 
+static int prctl_latency_nice(bool set, unsigned long arg2, pid_t pid)
+{
+	struct task_struct *p;
+	int error;
+
+	rcu_read_lock();
+	p = pid ? find_task_by_vpid(pid) : current;
+	if (!p) {
+		rcu_read_unlock();
+		return -ESRCH;
+	}
+	get_task_struct(p);
+	if (set && !set_one_prio_perm(p)) {
+		rcu_read_unlock();
+		error = -EPERM;
+		goto out;
+	}
+	rcu_read_unlock();
+
+	if (set)
+		error = sched_set_latency_nice(p, (int)arg2);
+	else
+		error = put_user(p->latency_nice, (int __user *)arg2);
+out:
+	put_task_struct(p);
+	return error;
+}
+
 SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 		unsigned long, arg4, unsigned long, arg5)
 {
@@ -1788,6 +1816,13 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 		case PR_GET_TIMERSLACK:
 			error = current->timer_slack_ns;
 			break;
+		case PR_SET_LATENCY_NICE:
+		case PR_GET_LATENCY_NICE:
+			if (arg4 | arg5)
+				return -EINVAL;
+			error = prctl_latency_nice(option == PR_SET_LATENCY_NICE,
+						   arg2, (pid_t)arg3);
+			break;
 		case PR_SET_TIMERSLACK:
 			if (arg2 <= 0)
 				current->timer_slack_ns =
@@ -125,6 +125,7 @@ static int one_hundred = 100;
 #ifdef CONFIG_PRINTK
 static int ten_thousand = 10000;
 #endif
+static int one_million = 1000000;
 
 /* this is needed for the proc_doulongvec_minmax of vm_dirty_bytes */
 static unsigned long dirty_bytes_min = 2 * PAGE_SIZE;
@@ -355,6 +356,15 @@ static struct ctl_table kern_table[] = {
 		.extra2		= &one,
 	},
 #endif
+	{
+		.procname	= "timer_coalesce_us",
+		.data		= &sysctl_timer_coalesce_us,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= timer_coalesce_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &one_million,
+	},
 	{
 		.procname	= "sched_rt_period_us",
 		.data		= &sysctl_sched_rt_period,
@@ -413,6 +413,7 @@ void tick_nohz_stop_sched_tick(int inidle)
 		}
 
 		ts->idle_sleeps++;
+		timer_stats_idle_enter();
 
 		/* Mark expires */
 		ts->idle_expires = expires;
@@ -505,6 +506,7 @@ void tick_nohz_restart_sched_tick(void)
 	ktime_t now;
 
 	local_irq_disable();
+	timer_stats_idle_exit();
 	if (ts->idle_active || (ts->inidle && ts->tick_stopped))
 		now = ktime_get();
 
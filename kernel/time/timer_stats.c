@@ -31,6 +31,9 @@
  * Display the information collected so far:
  * # cat /proc/timer_stats
  *
+ * Display which timers woke the CPUs up from idle:
+ * # cat /proc/timer_wakeups
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
@@ -70,6 +73,11 @@ struct entry {
 	unsigned long		count;
 	unsigned int		timer_flag;
 
+	/*
+	 * Number of expiries that ended an idle period:
+	 */
+	unsigned long		wakeups;
+
 	/*
 	 * We save the command-line string to preserve
 	 * this information past task exit:
@@ -88,6 +96,12 @@ static DEFINE_SPINLOCK(table_lock);
  */
 static DEFINE_PER_CPU(raw_spinlock_t, tstats_lookup_lock);
 
+/*
+ * Set while a CPU sleeps with its tick stopped, cleared by the first
+ * timer that expires after that, which gets charged with the wakeup:
+ */
+static DEFINE_PER_CPU(int, tstats_idle);
+
 /*
  * Mutex to serialize state changes with show-stats activities:
  */
@@ -204,6 +218,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->wakeups = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -263,10 +278,37 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	else
 		atomic_inc(&overflow_count);
 
+	if (!(timer_flag & TIMER_STATS_FLAG_TICK) &&
+	    __get_cpu_var(tstats_idle)) {
+		__get_cpu_var(tstats_idle) = 0;
+		if (likely(entry))
+			entry->wakeups++;
+	}
+
  out_unlock:
 	raw_spin_unlock_irqrestore(lock, flags);
 }
 
+/**
+ * timer_stats_idle_enter - Note that this CPU stopped its tick in idle.
+ */
+void timer_stats_idle_enter(void)
+{
+	if (timer_stats_active)
+		__get_cpu_var(tstats_idle) = 1;
+}
+
+/**
+ * timer_stats_idle_exit - Note that this CPU left idle.
+ *
+ * An idle period that ends without a timer expiring was ended by some
+ * other interrupt and is not charged to anyone.
+ */
+void timer_stats_idle_exit(void)
+{
+	__get_cpu_var(tstats_idle) = 0;
+}
+
 static void print_name_offset(struct seq_file *m, unsigned long addr)
 {
 	char symname[KSYM_NAME_LEN];
@@ -338,6 +380,61 @@ static int tstats_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+static int twakeups_show(struct seq_file *m, void *v)
+{
+	struct timespec period;
+	struct entry *entry;
+	unsigned long ms;
+	long wakeups = 0;
+	ktime_t time;
+	int i;
+
+	mutex_lock(&show_mutex);
+	if (timer_stats_active)
+		time_stop = ktime_get();
+
+	time = ktime_sub(time_stop, time_start);
+
+	period = ktime_to_timespec(time);
+	ms = period.tv_nsec / 1000000;
+
+	seq_puts(m, "Timer Wakeups Version: v0.1\n");
+	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
+	seq_printf(m, "Coalescing: %u us\n", sysctl_timer_coalesce_us);
+
+	for (i = 0; i < nr_entries; i++) {
+		entry = entries + i;
+		if (!entry->wakeups)
+			continue;
+
+		seq_printf(m, " %4lu/%-4lu %c %5d %-16s ", entry->wakeups,
+			   entry->count,
+			   entry->timer_flag & TIMER_STATS_FLAG_DEFERRABLE ?
+			   'D' : ' ', entry->pid, entry->comm);
+		print_name_offset(m, (unsigned long)entry->start_func);
+		seq_puts(m, " (");
+		print_name_offset(m, (unsigned long)entry->expire_func);
+		seq_puts(m, ")\n");
+
+		wakeups += entry->wakeups;
+	}
+
+	ms += period.tv_sec * 1000;
+	if (!ms)
+		ms = 1;
+
+	if (wakeups && period.tv_sec)
+		seq_printf(m, "%ld total wakeups, %ld.%03ld wakeups/sec\n",
+			   wakeups, wakeups * 1000 / ms,
+			   (wakeups * 1000000 / ms) % 1000);
+	else
+		seq_printf(m, "%ld total wakeups\n", wakeups);
+
+	mutex_unlock(&show_mutex);
+
+	return 0;
+}
+
 /*
  * After a state change, make sure all concurrent lookup/update
  * activities have stopped:
@@ -405,6 +502,18 @@ static const struct file_operations tstats_fops = {
 	.release	= single_release,
 };
 
+static int twakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, twakeups_show, NULL);
+}
+
+static const struct file_operations twakeups_fops = {
+	.open		= twakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void __init init_timer_stats(void)
 {
 	int cpu;
@@ -420,6 +529,11 @@ static int __init init_tstats_procfs(void)
 	pe = proc_create("timer_stats", 0644, NULL, &tstats_fops);
 	if (!pe)
 		return -ENOMEM;
+	pe = proc_create("timer_wakeups", 0444, NULL, &twakeups_fops);
+	if (!pe) {
+		remove_proc_entry("timer_stats", NULL);
+		return -ENOMEM;
+	}
 	return 0;
 }
 __initcall(init_tstats_procfs);
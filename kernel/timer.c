@@ -40,6 +40,7 @@
 #include <linux/irq_work.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/sysctl.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -733,6 +734,63 @@ int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
+/*
+ * Timer coalescing: when kernel.timer_coalesce_us is set, timers that can
+ * afford it are moved onto a common grid of that period, so that they
+ * expire together and the CPU wakes from idle once for all of them.
+ */
+unsigned int sysctl_timer_coalesce_us __read_mostly;
+static unsigned long timer_coalesce_jiffies __read_mostly;
+
+int timer_coalesce_sysctl_handler(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *lenp,
+				  loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write)
+		timer_coalesce_jiffies = sysctl_timer_coalesce_us ?
+			usecs_to_jiffies(sysctl_timer_coalesce_us) : 0;
+	return ret;
+}
+
+/*
+ * Round @expires up to the coalescing grid if the timer allows it.
+ * Deferrable timers never wake an idle CPU anyway, so they may always
+ * wait for the next grid point.  Timers with an explicit slack may move
+ * within it, and timers with the default slack by up to 1/8 of their
+ * timeout.  Returns 0 when the timer has to stay where it is.
+ */
+static unsigned long coalesce_timer(struct timer_list *timer,
+				    unsigned long expires)
+{
+	unsigned long grid = timer_coalesce_jiffies;
+	unsigned long expires_limit, aligned;
+
+	if (grid < 2)
+		return 0;
+
+	aligned = expires + (grid - expires % grid) % grid;
+
+	if (tbase_get_deferrable(timer->base))
+		return aligned;
+
+	if (timer->slack > 0) {
+		expires_limit = expires + timer->slack;
+	} else if (timer->slack < 0) {
+		long delta = expires - jiffies;
+
+		if (delta < 8)
+			return 0;
+		expires_limit = expires + delta / 8;
+	} else {
+		return 0;
+	}
+
+	return time_after(aligned, expires_limit) ? 0 : aligned;
+}
+
 /*
  * Decide where to put the timer while taking the slack into account
  *
@@ -749,6 +807,12 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	unsigned long expires_limit, mask;
 	int bit;
 
+	if (unlikely(timer_coalesce_jiffies)) {
+		expires_limit = coalesce_timer(timer, expires);
+		if (expires_limit)
+			return expires_limit;
+	}
+
 	if (timer->slack >= 0) {
 		expires_limit = expires + timer->slack;
 	} else {
@@ -2009,22 +2009,17 @@ static int dev_gso_segment(struct sk_buff *skb, int features)
 }
 
 /*
- * Try to orphan skb early, right before transmission by the device.
- * We cannot orphan skb if tx timestamp is requested or the sk-reference
- * is needed on driver level for other reasons, e.g. see net/can/raw.c
+ * GSO segments don't carry the socket, so skb_tx_hash() won't be able
+ * to get sk: copy sk_hash into skb->rxhash.  The skb is no longer
+ * orphaned here, TCP small queues account it to its socket until the
+ * driver frees it.
  */
-static inline void skb_orphan_try(struct sk_buff *skb)
+static inline void skb_copy_sk_hash(struct sk_buff *skb)
 {
 	struct sock *sk = skb->sk;
 
-	if (sk && !skb_shinfo(skb)->tx_flags) {
-		/* skb_tx_hash() wont be able to get sk.
-		 * We copy sk_hash into skb->rxhash
-		 */
-		if (!skb->rxhash)
-			skb->rxhash = sk->sk_hash;
-		skb_orphan(skb);
-	}
+	if (sk && !skb->rxhash)
+		skb->rxhash = sk->sk_hash;
 }
 
 static bool can_checksum_protocol(unsigned long features, __be16 protocol)
@@ -2111,7 +2106,7 @@ int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
 		if (!list_empty(&ptype_all))
 			dev_queue_xmit_nit(skb, dev);
 
-		skb_orphan_try(skb);
+		skb_copy_sk_hash(skb);
 
 		features = netif_skb_features(skb);
 
@@ -184,7 +184,8 @@ ipt_get_target_c(const struct ipt_entry *e)
 }
 
 #if defined(CONFIG_NETFILTER_XT_TARGET_TRACE) || \
-    defined(CONFIG_NETFILTER_XT_TARGET_TRACE_MODULE)
+    defined(CONFIG_NETFILTER_XT_TARGET_TRACE_MODULE) || \
+    defined(CONFIG_NETFILTER_XTABLES_PROFILE)
 static const char *const hooknames[] = {
 	[NF_INET_PRE_ROUTING]		= "PREROUTING",
 	[NF_INET_LOCAL_IN]		= "INPUT",
@@ -192,7 +193,10 @@ static const char *const hooknames[] = {
 	[NF_INET_LOCAL_OUT]		= "OUTPUT",
 	[NF_INET_POST_ROUTING]		= "POSTROUTING",
 };
+#endif
 
+#if defined(CONFIG_NETFILTER_XT_TARGET_TRACE) || \
+    defined(CONFIG_NETFILTER_XT_TARGET_TRACE_MODULE)
 enum nf_ip_trace_comments {
 	NF_IP_TRACE_COMMENT_RULE,
 	NF_IP_TRACE_COMMENT_RETURN,
@@ -301,6 +305,9 @@ ipt_do_table(struct sk_buff *skb,
 	struct ipt_entry *e, **jumpstack;
 	unsigned int *stackptr, origptr, cpu;
 	const struct xt_table_info *private;
+	const struct xt_dispatch *dispatch;
+	const struct ipt_entry *dispatched = NULL;
+	struct xt_profile_state prof;
 	struct xt_action_param acpar;
 	unsigned int addend;
 
@@ -331,6 +338,7 @@ ipt_do_table(struct sk_buff *skb,
 	jumpstack  = (struct ipt_entry **)private->jumpstack[cpu];
 	stackptr   = per_cpu_ptr(private->stackptr, cpu);
 	origptr    = *stackptr;
+	dispatch   = xt_dispatch_enabled ? private->dispatch : NULL;
 
 	e = get_entry(table_base, private->hook_entry[hook]);
 
@@ -338,11 +346,23 @@ ipt_do_table(struct sk_buff *skb,
 		 table->name, hook, origptr,
 		 get_entry(table_base, private->underflow[hook]));
 
+	xt_profile_begin(&prof);
 	do {
 		const struct xt_entry_target *t;
 		const struct xt_entry_match *ematch;
 
 		IP_NF_ASSERT(e);
+		/* Entering a run of rules: go to the one that can match */
+		if (dispatch != NULL && e != dispatched &&
+		    xt_dispatch_test(dispatch, (void *)e - table_base)) {
+			e = get_entry(table_base,
+				      xt_dispatch_next(dispatch,
+						       (void *)e - table_base,
+						       skb, &acpar,
+						       ip->protocol));
+			dispatched = e;
+		}
+		xt_profile_rule(&prof, private, (void *)e - table_base);
 		if (!ip_packet_match(ip, indev, outdev,
 		    &e->ip, acpar.fragoff)) {
  no_match:
@@ -358,6 +378,7 @@ ipt_do_table(struct sk_buff *skb,
 		}
 
 		ADD_COUNTER(e->counters, skb->len, 1);
+		xt_profile_hit(&prof);
 
 		t = ipt_get_target(e);
 		IP_NF_ASSERT(t->u.kernel.target);
@@ -420,6 +441,7 @@ ipt_do_table(struct sk_buff *skb,
 			/* Verdict */
 			break;
 	} while (!acpar.hotdrop);
+	xt_profile_end(&prof);
 	pr_debug("Exiting %s; resetting sp from %u to %u\n",
 		 __func__, *stackptr, origptr);
 	*stackptr = origptr;
@@ -783,6 +805,137 @@ cleanup_entry(struct ipt_entry *e, struct net *net)
 	module_put(par.target->me);
 }
 
+/* Is the interface matched by its exact name, without a '+' wildcard? */
+static bool exact_iface(const char *name, const unsigned char *mask)
+{
+	unsigned int i, len = strnlen(name, IFNAMSIZ);
+
+	if (len == 0 || len == IFNAMSIZ)
+		return false;
+	for (i = 0; i < IFNAMSIZ; i++)
+		if (mask[i] != (i <= len ? 0xFF : 0))
+			return false;
+	return true;
+}
+
+/*
+ * The dispatch key of a rule: its only match, or with no match at all an
+ * exact input or output interface.  What is left of its ipt_ip goes into
+ * ip; consecutive rules whose keys are of the same kind and whose ip is
+ * the same form a run.
+ */
+static bool
+dispatch_key(const struct ipt_entry *e, struct xt_dispatch_rule *rule,
+	     struct ipt_ip *ip)
+{
+	const struct xt_entry_match *ematch, *m = NULL;
+
+	*ip = e->ip;
+	ip->flags &= ~IPT_F_GOTO;
+
+	xt_ematch_foreach(ematch, e) {
+		if (m != NULL)
+			return false;
+		m = ematch;
+	}
+	if (m != NULL)
+		return xt_dispatch_match(m, rule);
+
+	memset(&rule->key, 0, sizeof(rule->key));
+	rule->proto = 0;
+	rule->mask = 0;
+	if (!(e->ip.invflags & IPT_INV_VIA_IN) &&
+	    exact_iface(e->ip.iniface, e->ip.iniface_mask)) {
+		rule->type = XT_DISPATCH_IIF;
+		strncpy(rule->key.ifname, e->ip.iniface, IFNAMSIZ);
+		memset(ip->iniface, 0, IFNAMSIZ);
+		memset(ip->iniface_mask, 0, IFNAMSIZ);
+		return true;
+	}
+	if (!(e->ip.invflags & IPT_INV_VIA_OUT) &&
+	    exact_iface(e->ip.outiface, e->ip.outiface_mask)) {
+		rule->type = XT_DISPATCH_OIF;
+		strncpy(rule->key.ifname, e->ip.outiface, IFNAMSIZ);
+		memset(ip->outiface, 0, IFNAMSIZ);
+		memset(ip->outiface_mask, 0, IFNAMSIZ);
+		return true;
+	}
+	return false;
+}
+
+/* Find the runs of rules that ipt_do_table can dispatch on */
+static void build_dispatch(struct xt_table_info *newinfo, void *entry0)
+{
+	struct xt_dispatch_rule *rules;
+	const struct ipt_entry *iter;
+	struct ipt_ip ip, prev_ip;
+	unsigned int n = 0, run = 0;
+	bool prev = false;
+
+	rules = vmalloc(newinfo->number * sizeof(*rules));
+	if (rules == NULL)
+		return;
+
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		struct xt_dispatch_rule *r = &rules[n];
+
+		if (!dispatch_key(iter, r, &ip)) {
+			prev = false;
+			continue;
+		}
+		if (!prev || r->type != r[-1].type ||
+		    r->proto != r[-1].proto || r->mask != r[-1].mask ||
+		    memcmp(&ip, &prev_ip, sizeof(ip)) != 0)
+			++run;
+		r->offset = (void *)iter - entry0;
+		r->size = iter->next_offset;
+		r->run = run;
+		prev_ip = ip;
+		prev = true;
+		++n;
+	}
+
+	newinfo->dispatch = xt_dispatch_build(newinfo->size, rules, n);
+	vfree(rules);
+}
+
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+/* Name every rule by its chain and number, as TRACE does */
+static void build_profile(struct xt_table_info *newinfo, void *entry0)
+{
+	const struct ipt_entry *iter;
+	const char *chain = NULL;
+	unsigned int i = 0, h, off, rulenum = 0;
+	struct xt_profile *p;
+
+	p = xt_profile_alloc(newinfo->size, newinfo->number);
+	if (p == NULL)
+		return;
+
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		const struct xt_entry_target *t = ipt_get_target_c(iter);
+
+		off = (void *)iter - entry0;
+		if (strcmp(t->u.kernel.target->name, XT_ERROR_TARGET) == 0) {
+			/* Head of user chain: ERROR target with chainname */
+			chain = (const char *)t->data;
+			rulenum = 0;
+		} else {
+			for (h = 0; h < NF_INET_NUMHOOKS; h++)
+				if (newinfo->hook_entry[h] == off) {
+					chain = hooknames[h];
+					rulenum = 1;
+				}
+		}
+		p->index[off / XT_ALIGN(1)] = i;
+		p->chain[i] = chain;
+		p->rulenum[i] = rulenum++;
+		++i;
+	}
+	newinfo->profile = p;
+}
+#endif
+
 /* Checks and translates the user-supplied table segment (held in
    newinfo) */
 static int
@@ -869,6 +1022,10 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 			memcpy(newinfo->entries[i], entry0, newinfo->size);
 	}
 
+	build_dispatch(newinfo, entry0);
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+	build_profile(newinfo, entry0);
+#endif
 	return ret;
 }
 
@@ -15,6 +15,9 @@
 #include <linux/netfilter_ipv4/ip_tables.h>
 #include <linux/slab.h>
 #include <net/ip.h>
+#if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
+#include <net/netfilter/nf_conntrack.h>
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Netfilter Core Team <coreteam@netfilter.org>");
@@ -32,12 +35,16 @@ static const struct xt_table packet_filter = {
 	.priority	= NF_IP_PRI_FILTER,
 };
 
+/* Accept forwarded packets of established connections without the rules. */
+static bool ct_fastpath;
+module_param(ct_fastpath, bool, 0644);
+
 static unsigned int
 iptable_filter_hook(unsigned int hook, struct sk_buff *skb,
 		    const struct net_device *in, const struct net_device *out,
 		    int (*okfn)(struct sk_buff *))
 {
-	const struct net *net;
+	struct net *net;
 
 	if (hook == NF_INET_LOCAL_OUT &&
 	    (skb->len < sizeof(struct iphdr) ||
@@ -46,6 +53,10 @@ iptable_filter_hook(unsigned int hook, struct sk_buff *skb,
 		return NF_ACCEPT;
 
 	net = dev_net((in != NULL) ? in : out);
+#if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
+	if (hook == NF_INET_FORWARD && ct_fastpath && nf_ct_fastpath(net, skb))
+		return NF_ACCEPT;
+#endif
 	return ipt_do_table(skb, hook, in, out, net->ipv4.iptable_filter);
 }
 
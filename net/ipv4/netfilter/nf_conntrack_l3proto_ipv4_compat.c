@@ -32,12 +32,15 @@ static struct hlist_nulls_node *ct_get_first(struct seq_file *seq)
 	struct net *net = seq_file_net(seq);
 	struct ct_iter_state *st = seq->private;
 	struct hlist_nulls_node *n;
+	struct hlist_nulls_head *ct_hash;
+	unsigned int hsize;
 
+	nf_conntrack_get_ht(net, &ct_hash, &hsize);
 	for (st->bucket = 0;
-	     st->bucket < net->ct.htable_size;
+	     st->bucket < hsize;
 	     st->bucket++) {
 		n = rcu_dereference(
-			hlist_nulls_first_rcu(&net->ct.hash[st->bucket]));
+			hlist_nulls_first_rcu(&ct_hash[st->bucket]));
 		if (!is_a_nulls(n))
 			return n;
 	}
@@ -49,15 +52,19 @@ static struct hlist_nulls_node *ct_get_next(struct seq_file *seq,
 {
 	struct net *net = seq_file_net(seq);
 	struct ct_iter_state *st = seq->private;
+	struct hlist_nulls_head *ct_hash;
+	unsigned int hsize;
 
+	nf_conntrack_get_ht(net, &ct_hash, &hsize);
 	head = rcu_dereference(hlist_nulls_next_rcu(head));
 	while (is_a_nulls(head)) {
-		if (likely(get_nulls_value(head) == st->bucket)) {
-			if (++st->bucket >= net->ct.htable_size)
-				return NULL;
-		}
+		if (likely(get_nulls_value(head) == st->bucket))
+			st->bucket++;
+		/* st->bucket may be from before the table shrank */
+		if (st->bucket >= hsize)
+			return NULL;
 		head = rcu_dereference(
-			hlist_nulls_first_rcu(&net->ct.hash[st->bucket]));
+			hlist_nulls_first_rcu(&ct_hash[st->bucket]));
 	}
 	return head;
 }
@@ -363,12 +370,12 @@ static int ct_cpu_seq_show(struct seq_file *seq, void *v)
 	const struct ip_conntrack_stat *st = v;
 
 	if (v == SEQ_START_TOKEN) {
-		seq_printf(seq, "entries  searched found new invalid ignore delete delete_list insert insert_failed drop early_drop icmp_error  expect_new expect_create expect_delete search_restart\n");
+		seq_printf(seq, "entries  searched found new invalid ignore delete delete_list insert insert_failed drop early_drop icmp_error  expect_new expect_create expect_delete search_restart hash_resize fastpath\n");
 		return 0;
 	}
 
 	seq_printf(seq, "%08x  %08x %08x %08x %08x %08x %08x %08x "
-			"%08x %08x %08x %08x %08x  %08x %08x %08x %08x\n",
+			"%08x %08x %08x %08x %08x  %08x %08x %08x %08x %08x %08x\n",
 		   nr_conntracks,
 		   st->searched,
 		   st->found,
@@ -386,7 +393,9 @@ static int ct_cpu_seq_show(struct seq_file *seq, void *v)
 		   st->expect_new,
 		   st->expect_create,
 		   st->expect_delete,
-		   st->search_restart
+		   st->search_restart,
+		   st->hash_resize,
+		   st->fastpath
 		);
 	return 0;
 }
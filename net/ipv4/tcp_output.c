@@ -63,6 +63,12 @@ int sysctl_tcp_slow_start_after_idle __read_mostly = 1;
 int sysctl_tcp_cookie_size __read_mostly = 0; /* TCP_COOKIE_MAX */
 EXPORT_SYMBOL_GPL(sysctl_tcp_cookie_size);
 
+/* Default TSQ limit: bytes of a flow allowed in qdisc and device queues */
+int sysctl_tcp_limit_output_bytes __read_mostly = 131072;
+
+/* Spread segments over the RTT at twice the rate cwnd/srtt would send */
+int sysctl_tcp_pacing __read_mostly = 0;
+
 
 /* Account for new data that has been sent to the network. */
 static void tcp_event_new_data_sent(struct sock *sk, struct sk_buff *skb)
@@ -841,7 +847,11 @@ static int tcp_transmit_skb(struct sock *sk, struct sk_buff *skb, int clone_it,
 
 	skb_push(skb, tcp_header_size);
 	skb_reset_transport_header(skb);
-	skb_set_owner_w(skb, sk);
+	skb_orphan(skb);
+	skb->sk = sk;
+	skb->destructor = (sysctl_tcp_limit_output_bytes > 0) ?
+			  tcp_wfree : sock_wfree;
+	atomic_add(skb->truesize, &sk->sk_wmem_alloc);
 
 	/* Build TCP header and checksum it. */
 	th = tcp_hdr(skb);
@@ -1721,6 +1731,222 @@ static int tcp_mtu_probe(struct sock *sk)
 	return -1;
 }
 
+/* TCP SMALL QUEUES (TSQ)
+ *
+ * TSQ goal is to keep small amount of skbs per tcp flow in tx queues (qdisc+dev)
+ * to reduce RTT and bufferbloat.
+ * We do this using a special skb destructor (tcp_wfree).
+ *
+ * Its important tcp_wfree() can be replaced by sock_wfree() in the event skb
+ * needs to be reallocated in a driver.
+ * The invariant being skb->truesize substracted from sk->sk_wmem_alloc
+ *
+ * Since transmit from skb destructor is forbidden, we use a tasklet
+ * to process all sockets that eventually need to send more skbs.
+ * We use one tasklet per cpu, with its own queue of sockets.
+ */
+struct tsq_tasklet {
+	struct tasklet_struct	tasklet;
+	struct list_head	head; /* queue of tcp sockets */
+};
+static DEFINE_PER_CPU(struct tsq_tasklet, tsq_tasklet);
+
+static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
+			  int push_one, gfp_t gfp);
+
+static void tcp_tsq_handler(struct sock *sk)
+{
+	if ((1 << sk->sk_state) &
+	    (TCPF_ESTABLISHED | TCPF_FIN_WAIT1 | TCPF_CLOSING |
+	     TCPF_CLOSE_WAIT  | TCPF_LAST_ACK))
+		tcp_write_xmit(sk, tcp_current_mss(sk), 0, 0, GFP_ATOMIC);
+}
+
+/*
+ * One tasklet per cpu tries to send more skbs.
+ * We run in tasklet context but need to take care of BH being disabled
+ * or not for each socket.
+ */
+static void tcp_tasklet_func(unsigned long data)
+{
+	struct tsq_tasklet *tsq = (struct tsq_tasklet *)data;
+	LIST_HEAD(list);
+	unsigned long flags;
+	struct list_head *q, *n;
+	struct tcp_sock *tp;
+	struct sock *sk;
+
+	local_irq_save(flags);
+	list_splice_init(&tsq->head, &list);
+	local_irq_restore(flags);
+
+	list_for_each_safe(q, n, &list) {
+		tp = list_entry(q, struct tcp_sock, tsq_node);
+		list_del(&tp->tsq_node);
+
+		/* cleared first, so that a completion or pacing timer
+		 * firing while we send queues the socket again
+		 */
+		sk = (struct sock *)tp;
+		smp_mb__before_clear_bit();
+		clear_bit(TSQ_QUEUED, &tp->tsq_flags);
+
+		bh_lock_sock(sk);
+
+		if (!sock_owned_by_user(sk)) {
+			tcp_tsq_handler(sk);
+		} else {
+			/* defer the work to tcp_release_cb() */
+			set_bit(TSQ_OWNED, &tp->tsq_flags);
+		}
+		bh_unlock_sock(sk);
+
+		sk_free(sk);
+	}
+}
+
+/* queue a socket with TSQ_QUEUED set and a sk_wmem_alloc reference taken */
+static void tcp_tsq_queue(struct tcp_sock *tp)
+{
+	struct tsq_tasklet *tsq;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	tsq = &__get_cpu_var(tsq_tasklet);
+	list_add(&tp->tsq_node, &tsq->head);
+	tasklet_schedule(&tsq->tasklet);
+	local_irq_restore(flags);
+}
+
+/**
+ * tcp_release_cb - tcp release_sock() callback
+ * @sk: socket
+ *
+ * called from release_sock() to perform protocol dependent
+ * actions before socket release.
+ */
+void tcp_release_cb(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (test_and_clear_bit(TSQ_OWNED, &tp->tsq_flags))
+		tcp_tsq_handler(sk);
+}
+EXPORT_SYMBOL(tcp_release_cb);
+
+void __init tcp_tasklet_init(void)
+{
+	int i;
+
+	for_each_possible_cpu(i) {
+		struct tsq_tasklet *tsq = &per_cpu(tsq_tasklet, i);
+
+		INIT_LIST_HEAD(&tsq->head);
+		tasklet_init(&tsq->tasklet,
+			     tcp_tasklet_func,
+			     (unsigned long)tsq);
+	}
+}
+
+/*
+ * Write buffer destructor automatically called from kfree_skb.
+ * We cant xmit new skbs from this context, as we might already
+ * hold qdisc lock.
+ */
+void tcp_wfree(struct sk_buff *skb)
+{
+	struct sock *sk = skb->sk;
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (test_and_clear_bit(TSQ_THROTTLED, &tp->tsq_flags) &&
+	    !test_and_set_bit(TSQ_QUEUED, &tp->tsq_flags)) {
+		/* Keep a ref on socket.
+		 * This last ref will be released in tcp_tasklet_func()
+		 */
+		atomic_sub(skb->truesize - 1, &sk->sk_wmem_alloc);
+		tcp_tsq_queue(tp);
+	} else {
+		sock_wfree(skb);
+	}
+}
+
+/* Is this flow over its share of the qdisc and device queues?  The
+ * limit is about a millisecond at the pacing rate, but at least two
+ * skbs, and no more than tcp_limit_output_bytes.  sk_wmem_alloc
+ * accounts skb truesize, including skb overhead; that's OK.
+ */
+static bool tcp_small_queue_check(struct sock *sk, const struct sk_buff *skb)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	unsigned int limit;
+
+	if (sysctl_tcp_limit_output_bytes <= 0)
+		return false;
+
+	limit = max_t(unsigned int, 2 * skb->truesize, tp->pacing_rate >> 10);
+	limit = min_t(unsigned int, limit, sysctl_tcp_limit_output_bytes);
+	if (atomic_read(&sk->sk_wmem_alloc) > limit) {
+		set_bit(TSQ_THROTTLED, &tp->tsq_flags);
+		return true;
+	}
+	return false;
+}
+
+/* Pacing: with tcp_pacing set, segments leave no faster than
+ * tp->pacing_rate.  One sent too early waits for the pacing timer, which
+ * holds a sk_wmem_alloc reference and resumes tcp_write_xmit() through
+ * the TSQ tasklet.
+ */
+static bool tcp_pacing_check(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (!sysctl_tcp_pacing || !tp->pacing_rate)
+		return false;
+	if (hrtimer_active(&tp->pacing_timer))
+		return true;
+	if (ktime_to_ns(ktime_sub(tp->pacing_next, ktime_get())) <= 0)
+		return false;
+
+	atomic_inc(&sk->sk_wmem_alloc);
+	hrtimer_start(&tp->pacing_timer, tp->pacing_next,
+		      HRTIMER_MODE_ABS_PINNED);
+	return true;
+}
+
+static void tcp_pacing_sent(struct sock *sk, unsigned int len)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	ktime_t now;
+	u64 ns;
+
+	if (!sysctl_tcp_pacing || !tp->pacing_rate)
+		return;
+
+	ns = (u64)len * NSEC_PER_SEC;
+	do_div(ns, tp->pacing_rate);
+
+	/* an idle period doesn't earn credit for a burst */
+	now = ktime_get();
+	if (ktime_to_ns(ktime_sub(tp->pacing_next, now)) < 0)
+		tp->pacing_next = now;
+	tp->pacing_next = ktime_add_ns(tp->pacing_next, ns);
+}
+
+enum hrtimer_restart tcp_pace_kick(struct hrtimer *timer)
+{
+	struct tcp_sock *tp = container_of(timer, struct tcp_sock,
+					   pacing_timer);
+	struct sock *sk = (struct sock *)tp;
+
+	/* our reference goes to the tasklet, unless it has one already */
+	if (!test_and_set_bit(TSQ_QUEUED, &tp->tsq_flags))
+		tcp_tsq_queue(tp);
+	else
+		atomic_dec(&sk->sk_wmem_alloc);
+	return HRTIMER_NORESTART;
+}
+
 /* This routine writes packets to the network.  It advances the
  * send_head.  This happens as incoming acks open up the remote
  * window for us.
@@ -1776,6 +2002,12 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 				break;
 		}
 
+		if (tcp_small_queue_check(sk, skb))
+			break;
+
+		if (tcp_pacing_check(sk))
+			break;
+
 		limit = mss_now;
 		if (tso_segs > 1 && !tcp_urg_mode(tp))
 			limit = tcp_mss_split_point(sk, skb, mss_now,
@@ -1790,6 +2022,8 @@ static int tcp_write_xmit(struct sock *sk, unsigned int mss_now, int nonagle,
 		if (unlikely(tcp_transmit_skb(sk, skb, 1, gfp)))
 			break;
 
+		tcp_pacing_sent(sk, skb->len);
+
 		/* Advance the send_head.  This one is sent out.
 		 * This call will increment packets_out.
 		 */
@@ -38,8 +38,16 @@ static void tcp_keepalive_timer (unsigned long data);
 
 void tcp_init_xmit_timers(struct sock *sk)
 {
+	struct tcp_sock *tp = tcp_sk(sk);
+
 	inet_csk_init_xmit_timers(sk, &tcp_write_timer, &tcp_delack_timer,
 				  &tcp_keepalive_timer);
+
+	hrtimer_init(&tp->pacing_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	tp->pacing_timer.function = tcp_pace_kick;
+	tp->pacing_rate = 0;
+	tp->pacing_next = ktime_set(0, 0);
+	tp->tsq_flags = 0;
 }
 EXPORT_SYMBOL(tcp_init_xmit_timers);
 
@@ -13,6 +13,9 @@
 #include <linux/moduleparam.h>
 #include <linux/netfilter_ipv6/ip6_tables.h>
 #include <linux/slab.h>
+#if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
+#include <net/netfilter/nf_conntrack.h>
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Netfilter Core Team <coreteam@netfilter.org>");
@@ -30,14 +33,22 @@ static const struct xt_table packet_filter = {
 	.priority	= NF_IP6_PRI_FILTER,
 };
 
+/* Accept forwarded packets of established connections without the rules. */
+static bool ct_fastpath;
+module_param(ct_fastpath, bool, 0644);
+
 /* The work comes in here from netfilter.c. */
 static unsigned int
 ip6table_filter_hook(unsigned int hook, struct sk_buff *skb,
 		     const struct net_device *in, const struct net_device *out,
 		     int (*okfn)(struct sk_buff *))
 {
-	const struct net *net = dev_net((in != NULL) ? in : out);
+	struct net *net = dev_net((in != NULL) ? in : out);
 
+#if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
+	if (hook == NF_INET_FORWARD && ct_fastpath && nf_ct_fastpath(net, skb))
+		return NF_ACCEPT;
+#endif
 	return ip6t_do_table(skb, hook, in, out, net->ipv6.ip6table_filter);
 }
 
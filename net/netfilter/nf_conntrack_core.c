@@ -313,15 +313,23 @@ ____nf_conntrack_find(struct net *net, u16 zone,
 		      const struct nf_conntrack_tuple *tuple, u32 hash)
 {
 	struct nf_conntrack_tuple_hash *h;
+	struct hlist_nulls_head *ct_hash;
 	struct hlist_nulls_node *n;
-	unsigned int bucket = hash_bucket(hash, net);
+	unsigned int bucket, hsize, seq;
 
 	/* Disable BHs the entire time since we normally need to disable them
 	 * at least once for the stats anyway.
 	 */
 	local_bh_disable();
 begin:
-	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[bucket], hnnode) {
+	do {
+		seq = read_seqcount_begin(&net->ct.generation);
+		ct_hash = net->ct.hash;
+		hsize = net->ct.htable_size;
+	} while (read_seqcount_retry(&net->ct.generation, seq));
+
+	bucket = __hash_bucket(hash, hsize);
+	hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[bucket], hnnode) {
 		if (nf_ct_tuple_equal(tuple, &h->tuple) &&
 		    nf_ct_zone(nf_ct_tuplehash_to_ctrack(h)) == zone) {
 			NF_CT_STAT_INC(net, found);
@@ -333,9 +341,11 @@ begin:
 	/*
 	 * if the nulls value we got at the end of this lookup is
 	 * not the expected one, we must restart lookup.
-	 * We probably met an item that was moved to another chain.
+	 * We probably met an item that was moved to another chain,
+	 * or the whole table was rehashed under us.
 	 */
-	if (get_nulls_value(n) != bucket) {
+	if (get_nulls_value(n) != bucket ||
+	    read_seqcount_retry(&net->ct.generation, seq)) {
 		NF_CT_STAT_INC(net, search_restart);
 		goto begin;
 	}
@@ -444,9 +454,6 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	zone = nf_ct_zone(ct);
 	/* reuse the hash saved before */
 	hash = *(unsigned long *)&ct->tuplehash[IP_CT_DIR_REPLY].hnnode.pprev;
-	hash = hash_bucket(hash, net);
-	repl_hash = hash_conntrack(net, zone,
-				   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
 
 	/* We're not in hash table, and we refuse to set up related
 	   connections for unconfirmed conns.  But packet copies and
@@ -460,6 +467,11 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 
 	spin_lock_bh(&nf_conntrack_lock);
 
+	/* The table can only be resized with the lock held */
+	hash = hash_bucket(hash, net);
+	repl_hash = hash_conntrack(net, zone,
+				   &ct->tuplehash[IP_CT_DIR_REPLY].tuple);
+
 	/* We have to check the DYING flag inside the lock to prevent
 	   a race against nf_ct_get_next_corpse() possibly called from
 	   user context, else we insert an already 'dead' hash, blocking
@@ -510,6 +522,9 @@ __nf_conntrack_confirm(struct sk_buff *skb)
 	 */
 	__nf_conntrack_hash_insert(ct, hash, repl_hash);
 	NF_CT_STAT_INC(net, insert);
+	if (unlikely(atomic_read(&net->ct.count) > net->ct.htable_size) &&
+	    net->ct.sysctl_hash_grow)
+		schedule_work(&net->ct.resize_work);
 	spin_unlock_bh(&nf_conntrack_lock);
 
 	help = nfct_help(ct);
@@ -535,27 +550,34 @@ nf_conntrack_tuple_taken(const struct nf_conntrack_tuple *tuple,
 {
 	struct net *net = nf_ct_net(ignored_conntrack);
 	struct nf_conntrack_tuple_hash *h;
+	struct hlist_nulls_head *ct_hash;
 	struct hlist_nulls_node *n;
 	struct nf_conn *ct;
 	u16 zone = nf_ct_zone(ignored_conntrack);
-	unsigned int hash = hash_conntrack(net, zone, tuple);
+	unsigned int hash, hsize;
 
 	/* Disable BHs the entire time since we need to disable them at
-	 * least once for the stats anyway.
+	 * least once for the stats anyway.  The RCU read lock is what
+	 * keeps a table being resized from being freed under us.
 	 */
-	rcu_read_lock_bh();
-	hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash], hnnode) {
+	rcu_read_lock();
+	local_bh_disable();
+	nf_conntrack_get_ht(net, &ct_hash, &hsize);
+	hash = __hash_conntrack(tuple, zone, hsize);
+	hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[hash], hnnode) {
 		ct = nf_ct_tuplehash_to_ctrack(h);
 		if (ct != ignored_conntrack &&
 		    nf_ct_tuple_equal(tuple, &h->tuple) &&
 		    nf_ct_zone(ct) == zone) {
 			NF_CT_STAT_INC(net, found);
-			rcu_read_unlock_bh();
+			local_bh_enable();
+			rcu_read_unlock();
 			return 1;
 		}
 		NF_CT_STAT_INC(net, searched);
 	}
-	rcu_read_unlock_bh();
+	local_bh_enable();
+	rcu_read_unlock();
 
 	return 0;
 }
@@ -565,18 +587,21 @@ EXPORT_SYMBOL_GPL(nf_conntrack_tuple_taken);
 
 /* There's a small race here where we may free a just-assured
    connection.  Too bad: we're in trouble anyway. */
-static noinline int early_drop(struct net *net, unsigned int hash)
+static noinline int early_drop(struct net *net, u32 hash)
 {
 	/* Use oldest entry, which is roughly LRU */
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct = NULL, *tmp;
+	struct hlist_nulls_head *ct_hash;
 	struct hlist_nulls_node *n;
-	unsigned int i, cnt = 0;
+	unsigned int i, cnt = 0, bucket, hsize;
 	int dropped = 0;
 
 	rcu_read_lock();
-	for (i = 0; i < net->ct.htable_size; i++) {
-		hlist_nulls_for_each_entry_rcu(h, n, &net->ct.hash[hash],
+	nf_conntrack_get_ht(net, &ct_hash, &hsize);
+	bucket = __hash_bucket(hash, hsize);
+	for (i = 0; i < hsize; i++) {
+		hlist_nulls_for_each_entry_rcu(h, n, &ct_hash[bucket],
 					 hnnode) {
 			tmp = nf_ct_tuplehash_to_ctrack(h);
 			if (!test_bit(IPS_ASSURED_BIT, &tmp->status))
@@ -595,7 +620,7 @@ static noinline int early_drop(struct net *net, unsigned int hash)
 		if (cnt >= NF_CT_EVICTION_RANGE)
 			break;
 
-		hash = (hash + 1) % net->ct.htable_size;
+		bucket = (bucket + 1) % hsize;
 	}
 	rcu_read_unlock();
 
@@ -645,7 +670,7 @@ __nf_conntrack_alloc(struct net *net, u16 zone,
 
 	if (nf_conntrack_max &&
 	    unlikely(atomic_read(&net->ct.count) > nf_conntrack_max)) {
-		if (!early_drop(net, hash_bucket(hash, net))) {
+		if (!early_drop(net, hash)) {
 			atomic_dec(&net->ct.count);
 			if (net_ratelimit())
 				printk(KERN_WARNING
@@ -1302,6 +1327,7 @@ static void nf_conntrack_cleanup_net(struct net *net)
 		goto i_see_dead_people;
 	}
 
+	cancel_work_sync(&net->ct.resize_work);
 	nf_ct_free_hashtable(net->ct.hash, net->ct.htable_size);
 	nf_conntrack_ecache_fini(net);
 	nf_conntrack_tstamp_fini(net);
@@ -1357,38 +1383,33 @@ void *nf_ct_alloc_hashtable(unsigned int *sizep, int nulls)
 }
 EXPORT_SYMBOL_GPL(nf_ct_alloc_hashtable);
 
-int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
+/* serializes hash table resizes */
+static DEFINE_MUTEX(nf_conntrack_resize_mutex);
+
+/*
+ * Move every conntrack of the namespace into a new table of hashsize
+ * buckets.  Lookups go on in parallel: they sample the generation count
+ * with the table, and restart when a rehash overlapped their walk, so
+ * they see neither a false negative nor a table and size that don't
+ * match.  Insertions take nf_conntrack_lock and so wait for the rehash.
+ */
+static int nf_conntrack_hash_resize(struct net *net, unsigned int hashsize)
 {
 	int i, bucket;
-	unsigned int hashsize, old_size;
+	unsigned int old_size;
 	struct hlist_nulls_head *hash, *old_hash;
 	struct nf_conntrack_tuple_hash *h;
 	struct nf_conn *ct;
 
-	if (current->nsproxy->net_ns != &init_net)
-		return -EOPNOTSUPP;
-
-	/* On boot, we can set this without any fancy locking. */
-	if (!nf_conntrack_htable_size)
-		return param_set_uint(val, kp);
-
-	hashsize = simple_strtoul(val, NULL, 0);
-	if (!hashsize)
-		return -EINVAL;
-
 	hash = nf_ct_alloc_hashtable(&hashsize, 1);
 	if (!hash)
 		return -ENOMEM;
 
-	/* Lookups in the old hash might happen in parallel, which means we
-	 * might get false negatives during connection lookup. New connections
-	 * created because of a false negative won't make it into the hash
-	 * though since that required taking the lock.
-	 */
 	spin_lock_bh(&nf_conntrack_lock);
-	for (i = 0; i < init_net.ct.htable_size; i++) {
-		while (!hlist_nulls_empty(&init_net.ct.hash[i])) {
-			h = hlist_nulls_entry(init_net.ct.hash[i].first,
+	write_seqcount_begin(&net->ct.generation);
+	for (i = 0; i < net->ct.htable_size; i++) {
+		while (!hlist_nulls_empty(&net->ct.hash[i])) {
+			h = hlist_nulls_entry(net->ct.hash[i].first,
 					struct nf_conntrack_tuple_hash, hnnode);
 			ct = nf_ct_tuplehash_to_ctrack(h);
 			hlist_nulls_del_rcu(&h->hnnode);
@@ -1397,16 +1418,68 @@ int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
 			hlist_nulls_add_head_rcu(&h->hnnode, &hash[bucket]);
 		}
 	}
-	old_size = init_net.ct.htable_size;
-	old_hash = init_net.ct.hash;
+	old_size = net->ct.htable_size;
+	old_hash = net->ct.hash;
 
-	init_net.ct.htable_size = nf_conntrack_htable_size = hashsize;
-	init_net.ct.hash = hash;
+	net->ct.htable_size = hashsize;
+	net->ct.hash = hash;
+	write_seqcount_end(&net->ct.generation);
 	spin_unlock_bh(&nf_conntrack_lock);
 
+	/* readers may still be walking the old table */
+	synchronize_net();
 	nf_ct_free_hashtable(old_hash, old_size);
+	NF_CT_STAT_INC_ATOMIC(net, hash_resize);
 	return 0;
 }
+
+/*
+ * Double the table once it holds more conntracks than buckets, which
+ * keeps the chains short when a tethered client opens thousands of
+ * flows.  It doesn't grow past nf_conntrack_max buckets.
+ */
+static void nf_conntrack_hash_grow(struct work_struct *work)
+{
+	struct net *net = container_of(work, struct net, ct.resize_work);
+	unsigned int hashsize;
+
+	mutex_lock(&nf_conntrack_resize_mutex);
+	hashsize = net->ct.htable_size;
+	if (atomic_read(&net->ct.count) > hashsize &&
+	    (!nf_conntrack_max || hashsize < nf_conntrack_max)) {
+		hashsize *= 2;
+		if (nf_conntrack_max && hashsize > nf_conntrack_max)
+			hashsize = nf_conntrack_max;
+		if (nf_conntrack_hash_resize(net, hashsize) == 0)
+			pr_debug("nf_conntrack: %u buckets\n",
+				 net->ct.htable_size);
+	}
+	mutex_unlock(&nf_conntrack_resize_mutex);
+}
+
+int nf_conntrack_set_hashsize(const char *val, struct kernel_param *kp)
+{
+	unsigned int hashsize;
+	int ret;
+
+	if (current->nsproxy->net_ns != &init_net)
+		return -EOPNOTSUPP;
+
+	/* On boot, we can set this without any fancy locking. */
+	if (!nf_conntrack_htable_size)
+		return param_set_uint(val, kp);
+
+	hashsize = simple_strtoul(val, NULL, 0);
+	if (!hashsize)
+		return -EINVAL;
+
+	mutex_lock(&nf_conntrack_resize_mutex);
+	ret = nf_conntrack_hash_resize(&init_net, hashsize);
+	if (ret == 0)
+		nf_conntrack_htable_size = init_net.ct.htable_size;
+	mutex_unlock(&nf_conntrack_resize_mutex);
+	return ret;
+}
 EXPORT_SYMBOL_GPL(nf_conntrack_set_hashsize);
 
 module_param_call(hashsize, nf_conntrack_set_hashsize, param_get_uint,
@@ -1518,6 +1591,9 @@ static int nf_conntrack_init_net(struct net *net)
 
 	net->ct.htable_size = nf_conntrack_htable_size;
 	net->ct.hash = nf_ct_alloc_hashtable(&net->ct.htable_size, 1);
+	seqcount_init(&net->ct.generation);
+	INIT_WORK(&net->ct.resize_work, nf_conntrack_hash_grow);
+	net->ct.sysctl_hash_grow = 1;
 	if (!net->ct.hash) {
 		ret = -ENOMEM;
 		printk(KERN_ERR "Unable to create nf_conntrack_hash\n");
@@ -24,13 +24,23 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/audit.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/cred.h>
+#include <linux/fs.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
 #include <net/net_namespace.h>
+#include <net/sock.h>
 
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter_arp.h>
 #include <linux/netfilter_ipv4/ip_tables.h>
 #include <linux/netfilter_ipv6/ip6_tables.h>
 #include <linux/netfilter_arp/arp_tables.h>
+#include <linux/netfilter/xt_mark.h>
+#include <linux/netfilter/xt_owner.h>
+#include <linux/netfilter/xt_tcpudp.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Harald Welte <laforge@netfilter.org>");
@@ -721,10 +731,382 @@ void xt_free_table_info(struct xt_table_info *info)
 
 	free_percpu(info->stackptr);
 
+	xt_dispatch_free(info->dispatch);
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+	xt_profile_free(info->profile);
+#endif
 	kfree(info);
 }
 EXPORT_SYMBOL(xt_free_table_info);
 
+/* Runs shorter than this are walked as they are */
+#define XT_DISPATCH_MIN_RUN	4
+
+bool xt_dispatch_enabled __read_mostly = true;
+EXPORT_SYMBOL_GPL(xt_dispatch_enabled);
+module_param_named(dispatch, xt_dispatch_enabled, bool, 0644);
+MODULE_PARM_DESC(dispatch, "Look up runs of rules by key instead of walking them");
+
+struct xt_dispatch_slot {
+	union xt_dispatch_val key;
+	unsigned int first;		/* first rule with the key */
+};
+
+struct xt_dispatch_run {
+	u8 type;
+	u8 proto;
+	u32 mask;
+	unsigned int first, last;	/* its rules are [first, last) */
+	unsigned int end;		/* offset of the rule after it */
+	unsigned int hmask;
+	struct xt_dispatch_slot *slots;
+};
+
+static void *xt_dispatch_zalloc(size_t size)
+{
+	if (size <= PAGE_SIZE)
+		return kzalloc(size, GFP_KERNEL);
+	return vzalloc(size);
+}
+
+static void xt_dispatch_kvfree(const void *p)
+{
+	if (is_vmalloc_addr(p))
+		vfree(p);
+	else
+		kfree(p);
+}
+
+/**
+ * xt_dispatch_match - get the dispatch key of a match
+ * @m:		the only match of a rule
+ * @rule:	its key, filled in when the match has one
+ *
+ * Only matches that test a single value of the packet, without side
+ * effects, have a key: owner --uid-owner of one uid, mark, and tcp or
+ * udp --dport of one port with nothing else asked.
+ */
+bool xt_dispatch_match(const struct xt_entry_match *m,
+		       struct xt_dispatch_rule *rule)
+{
+	const struct xt_match *match = m->u.kernel.match;
+
+	memset(&rule->key, 0, sizeof(rule->key));
+	rule->proto = 0;
+	rule->mask = 0;
+
+	if (strcmp(match->name, "owner") == 0 && match->revision == 1) {
+		const struct xt_owner_match_info *info = (const void *)m->data;
+
+		if (info->match != XT_OWNER_UID || info->invert != 0 ||
+		    info->uid_min != info->uid_max)
+			return false;
+		rule->type = XT_DISPATCH_UID;
+		rule->key.val = info->uid_min;
+		return true;
+	}
+	if (strcmp(match->name, "mark") == 0 && match->revision == 1) {
+		const struct xt_mark_mtinfo1 *info = (const void *)m->data;
+
+		if (info->invert)
+			return false;
+		rule->type = XT_DISPATCH_MARK;
+		rule->mask = info->mask;
+		rule->key.val = info->mark;
+		return true;
+	}
+	if (strcmp(match->name, "tcp") == 0 && match->revision == 0) {
+		const struct xt_tcp *info = (const void *)m->data;
+
+		if (info->spts[0] != 0 || info->spts[1] != 0xFFFF ||
+		    info->dpts[0] != info->dpts[1] || info->option ||
+		    info->flg_mask || info->flg_cmp || info->invflags)
+			return false;
+		rule->type = XT_DISPATCH_DPORT;
+		rule->proto = IPPROTO_TCP;
+		rule->key.val = info->dpts[0];
+		return true;
+	}
+	if (strcmp(match->name, "udp") == 0 && match->revision == 0) {
+		const struct xt_udp *info = (const void *)m->data;
+
+		if (info->spts[0] != 0 || info->spts[1] != 0xFFFF ||
+		    info->dpts[0] != info->dpts[1] || info->invflags)
+			return false;
+		rule->type = XT_DISPATCH_DPORT;
+		rule->proto = IPPROTO_UDP;
+		rule->key.val = info->dpts[0];
+		return true;
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(xt_dispatch_match);
+
+static struct xt_dispatch_slot *
+xt_dispatch_slot(const struct xt_dispatch_run *run,
+		 const union xt_dispatch_val *key)
+{
+	unsigned int h = jhash2(key->word, ARRAY_SIZE(key->word), 0);
+	struct xt_dispatch_slot *slot;
+
+	/* at most half the slots are used, there is always an empty one */
+	for (;; h++) {
+		slot = &run->slots[h & run->hmask];
+		if (slot->first == UINT_MAX ||
+		    memcmp(&slot->key, key, sizeof(*key)) == 0)
+			return slot;
+	}
+}
+
+void xt_dispatch_free(struct xt_dispatch *d)
+{
+	if (d == NULL)
+		return;
+	if (d->runs != NULL)
+		xt_dispatch_kvfree(d->runs[0].slots);
+	xt_dispatch_kvfree(d->runs);
+	xt_dispatch_kvfree(d->offset);
+	xt_dispatch_kvfree(d->run);
+	xt_dispatch_kvfree(d->next);
+	xt_dispatch_kvfree(d->bitmap);
+	kfree(d);
+}
+EXPORT_SYMBOL_GPL(xt_dispatch_free);
+
+/**
+ * xt_dispatch_build - build the dispatch of a table
+ * @size:	size of the table
+ * @rules:	keys of its rules that have one, in table order
+ * @n:		number of them
+ *
+ * Returns NULL when no run is long enough to be worth it, or when
+ * memory is short: the table is then walked as it is.
+ */
+struct xt_dispatch *xt_dispatch_build(unsigned int size,
+				      const struct xt_dispatch_rule *rules,
+				      unsigned int n)
+{
+	struct xt_dispatch_slot *slots;
+	struct xt_dispatch_run *run;
+	struct xt_dispatch *d;
+	unsigned int i, j, k, len, nslots = 0;
+
+	d = kzalloc(sizeof(*d), GFP_KERNEL);
+	if (d == NULL)
+		return NULL;
+
+	for (i = 0; i < n; i += len) {
+		for (len = 1; i + len < n; len++)
+			if (rules[i + len].run != rules[i].run)
+				break;
+		if (len < XT_DISPATCH_MIN_RUN)
+			continue;
+		d->nruns++;
+		d->nrules += len;
+		nslots += roundup_pow_of_two(2 * len);
+	}
+	if (d->nruns == 0)
+		goto fail;
+
+	d->runs = xt_dispatch_zalloc(d->nruns * sizeof(*d->runs));
+	d->offset = xt_dispatch_zalloc(d->nrules * sizeof(*d->offset));
+	d->run = xt_dispatch_zalloc(d->nrules * sizeof(*d->run));
+	d->next = xt_dispatch_zalloc(d->nrules * sizeof(*d->next));
+	d->bitmap = xt_dispatch_zalloc(BITS_TO_LONGS(size / XT_ALIGN(1)) *
+				       sizeof(long));
+	if (d->runs == NULL || d->offset == NULL || d->run == NULL ||
+	    d->next == NULL || d->bitmap == NULL)
+		goto fail;
+	slots = xt_dispatch_zalloc(nslots * sizeof(*slots));
+	if (slots == NULL)
+		goto fail;
+	d->runs[0].slots = slots;
+
+	for (i = 0, j = 0, k = 0; i < n; i += len) {
+		for (len = 1; i + len < n; len++)
+			if (rules[i + len].run != rules[i].run)
+				break;
+		if (len < XT_DISPATCH_MIN_RUN)
+			continue;
+
+		run = &d->runs[k];
+		run->type = rules[i].type;
+		run->proto = rules[i].proto;
+		run->mask = rules[i].mask;
+		run->first = j;
+		run->last = j + len;
+		run->end = rules[i + len - 1].offset + rules[i + len - 1].size;
+		run->hmask = roundup_pow_of_two(2 * len) - 1;
+		run->slots = slots;
+		slots += run->hmask + 1;
+		memset(run->slots, 0xFF, (run->hmask + 1) * sizeof(*slots));
+
+		/* backwards, so that every key's chain is in table order */
+		while (len-- > 0) {
+			const struct xt_dispatch_rule *r = &rules[i + len];
+			struct xt_dispatch_slot *slot;
+			unsigned int idx = run->first + len;
+
+			slot = xt_dispatch_slot(run, &r->key);
+			if (slot->first == UINT_MAX) {
+				slot->key = r->key;
+				d->next[idx] = run->last;
+			} else {
+				d->next[idx] = slot->first;
+			}
+			slot->first = idx;
+			d->offset[idx] = r->offset;
+			d->run[idx] = k;
+			set_bit(r->offset / XT_ALIGN(1), d->bitmap);
+		}
+		len = run->last - run->first;
+		j += len;
+		k++;
+	}
+	return d;
+
+fail:
+	xt_dispatch_free(d);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(xt_dispatch_build);
+
+/*
+ * The packet's key for a run: 1 when found, 0 when no rule of the run
+ * can match, -1 when the run must be walked, so that the matches see
+ * the fragment or truncated header they drop the packet for.
+ */
+static int xt_dispatch_key(const struct xt_dispatch_run *run,
+			   const struct sk_buff *skb,
+			   const struct xt_action_param *par, u8 proto,
+			   union xt_dispatch_val *key)
+{
+	const struct net_device *dev;
+	const struct file *filp;
+	const __be16 *ports;
+	union {
+		struct tcphdr tcp;
+		struct udphdr udp;
+	} buf;
+
+	memset(key, 0, sizeof(*key));
+	switch (run->type) {
+	case XT_DISPATCH_UID:
+		if (skb->sk == NULL || skb->sk->sk_socket == NULL)
+			return 0;
+		filp = skb->sk->sk_socket->file;
+		if (filp == NULL)
+			return 0;
+		key->val = filp->f_cred->fsuid;
+		return 1;
+	case XT_DISPATCH_MARK:
+		key->val = skb->mark & run->mask;
+		return 1;
+	case XT_DISPATCH_DPORT:
+		if (proto != run->proto)
+			return 0;
+		if (par->fragoff != 0)
+			return -1;
+		ports = skb_header_pointer(skb, par->thoff,
+					   proto == IPPROTO_TCP ?
+					   sizeof(buf.tcp) : sizeof(buf.udp),
+					   &buf);
+		if (ports == NULL)
+			return -1;
+		key->val = ntohs(ports[1]);
+		return 1;
+	case XT_DISPATCH_IIF:
+	case XT_DISPATCH_OIF:
+		dev = run->type == XT_DISPATCH_IIF ? par->in : par->out;
+		if (dev != NULL)
+			strncpy(key->ifname, dev->name, IFNAMSIZ);
+		return 1;
+	}
+	return -1;
+}
+
+/**
+ * xt_dispatch_next - where to go from a rule of a run
+ * @d:		the table's dispatch
+ * @offset:	the rule, for which xt_dispatch_test() is true
+ * @skb:	the packet
+ * @par:	its match parameters: fragment, header offset and devices
+ * @proto:	its layer 4 protocol
+ *
+ * Returns the offset of the first rule from @offset on that can match
+ * the packet, or of the rule after the run when none can.
+ */
+unsigned int xt_dispatch_next(const struct xt_dispatch *d, unsigned int offset,
+			      const struct sk_buff *skb,
+			      const struct xt_action_param *par, u8 proto)
+{
+	const struct xt_dispatch_run *run;
+	const struct xt_dispatch_slot *slot;
+	union xt_dispatch_val key;
+	unsigned int lo = 0, hi = d->nrules, idx, i;
+
+	while (hi - lo > 1) {
+		idx = (lo + hi) / 2;
+		if (d->offset[idx] > offset)
+			hi = idx;
+		else
+			lo = idx;
+	}
+	idx = lo;
+	run = &d->runs[d->run[idx]];
+
+	switch (xt_dispatch_key(run, skb, par, proto, &key)) {
+	case 0:
+		return run->end;
+	case 1:
+		break;
+	default:
+		return offset;
+	}
+
+	slot = xt_dispatch_slot(run, &key);
+	for (i = slot->first; i < idx; i = d->next[i])
+		;
+	return i < run->last ? d->offset[i] : run->end;
+}
+EXPORT_SYMBOL_GPL(xt_dispatch_next);
+
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+struct xt_profile *xt_profile_alloc(unsigned int size, unsigned int number)
+{
+	struct xt_profile *p;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (p == NULL)
+		return NULL;
+	p->nrules = number;
+	p->index = xt_dispatch_zalloc(size / XT_ALIGN(1) * sizeof(*p->index));
+	p->chain = xt_dispatch_zalloc(number * sizeof(*p->chain));
+	p->rulenum = xt_dispatch_zalloc(number * sizeof(*p->rulenum));
+	p->rules = __alloc_percpu(number * sizeof(struct xt_rule_prof),
+				  __alignof__(struct xt_rule_prof));
+	if (p->index == NULL || p->chain == NULL || p->rulenum == NULL ||
+	    p->rules == NULL) {
+		xt_profile_free(p);
+		return NULL;
+	}
+	return p;
+}
+EXPORT_SYMBOL_GPL(xt_profile_alloc);
+
+void xt_profile_free(struct xt_profile *p)
+{
+	if (p == NULL)
+		return;
+	xt_dispatch_kvfree(p->index);
+	xt_dispatch_kvfree(p->chain);
+	xt_dispatch_kvfree(p->rulenum);
+	free_percpu(p->rules);
+	kfree(p);
+}
+EXPORT_SYMBOL_GPL(xt_profile_free);
+#endif
+
 /* Find table by name, grabs mutex & ref.  Returns ERR_PTR() on error. */
 struct xt_table *xt_find_table_lock(struct net *net, u_int8_t af,
 				    const char *name)
@@ -1000,6 +1382,95 @@ static const struct file_operations xt_table_ops = {
 	.release = seq_release_net,
 };
 
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+static int xt_profile_seq_show(struct seq_file *seq, void *v)
+{
+	const struct xt_table *table = list_entry(v, struct xt_table, list);
+	const struct xt_profile *p = table->private->profile;
+	struct xt_rule_prof sum, *r;
+	unsigned int i;
+	int cpu;
+
+	if (p == NULL)
+		return 0;
+	if (&table->list == seq_file_net(seq)->xt.tables[table->af].next)
+		seq_printf(seq, "%-12s %-24s %5s %12s %12s %14s\n", "table",
+			   "chain", "rule", "evals", "hits", "nsecs");
+	for (i = 0; i < p->nrules; i++) {
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			r = per_cpu_ptr(p->rules, cpu) + i;
+			sum.evals += r->evals;
+			sum.hits += r->hits;
+			sum.nsecs += r->nsecs;
+		}
+		if (sum.evals == 0)
+			continue;
+		seq_printf(seq, "%-12s %-24s %5u %12llu %12llu %14llu\n",
+			   table->name, p->chain[i], p->rulenum[i],
+			   (unsigned long long)sum.evals,
+			   (unsigned long long)sum.hits,
+			   (unsigned long long)sum.nsecs);
+	}
+	return 0;
+}
+
+static const struct seq_operations xt_profile_seq_ops = {
+	.start	= xt_table_seq_start,
+	.next	= xt_table_seq_next,
+	.stop	= xt_table_seq_stop,
+	.show	= xt_profile_seq_show,
+};
+
+static int xt_profile_open(struct inode *inode, struct file *file)
+{
+	int ret;
+	struct xt_names_priv *priv;
+
+	ret = seq_open_net(inode, file, &xt_profile_seq_ops,
+			   sizeof(struct xt_names_priv));
+	if (!ret) {
+		priv = ((struct seq_file *)file->private_data)->private;
+		priv->af = (unsigned long)PDE(inode)->data;
+	}
+	return ret;
+}
+
+/* any write clears the counts of all the tables of the family */
+static ssize_t xt_profile_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct xt_names_priv *priv = seq->private;
+	struct net *net = seq_file_net(seq);
+	const struct xt_profile *p;
+	struct xt_table *table;
+	int cpu;
+
+	if (mutex_lock_interruptible(&xt[priv->af].mutex) != 0)
+		return -EINTR;
+	list_for_each_entry(table, &net->xt.tables[priv->af], list) {
+		p = table->private->profile;
+		if (p == NULL)
+			continue;
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(p->rules, cpu), 0,
+			       p->nrules * sizeof(struct xt_rule_prof));
+	}
+	mutex_unlock(&xt[priv->af].mutex);
+	return count;
+}
+
+static const struct file_operations xt_profile_ops = {
+	.owner	 = THIS_MODULE,
+	.open	 = xt_profile_open,
+	.read	 = seq_read,
+	.write	 = xt_profile_write,
+	.llseek	 = seq_lseek,
+	.release = seq_release_net,
+};
+#endif
+
 /*
  * Traverse state for ip{,6}_{tables,matches} for helping crossing
  * the multi-AF mutexes.
@@ -1214,6 +1685,7 @@ static const struct file_operations xt_target_ops = {
 #define FORMAT_TABLES	"_tables_names"
 #define	FORMAT_MATCHES	"_tables_matches"
 #define FORMAT_TARGETS 	"_tables_targets"
+#define FORMAT_PROFILE	"_tables_profile"
 
 #endif /* CONFIG_PROC_FS */
 
@@ -1303,11 +1775,26 @@ int xt_proto_init(struct net *net, u_int8_t af)
 				(void *)(unsigned long)af);
 	if (!proc)
 		goto out_remove_matches;
+
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+	strlcpy(buf, xt_prefix[af], sizeof(buf));
+	strlcat(buf, FORMAT_PROFILE, sizeof(buf));
+	proc = proc_create_data(buf, 0640, net->proc_net, &xt_profile_ops,
+				(void *)(unsigned long)af);
+	if (!proc)
+		goto out_remove_targets;
+#endif
 #endif
 
 	return 0;
 
 #ifdef CONFIG_PROC_FS
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+out_remove_targets:
+	strlcpy(buf, xt_prefix[af], sizeof(buf));
+	strlcat(buf, FORMAT_TARGETS, sizeof(buf));
+	proc_net_remove(net, buf);
+#endif
 out_remove_matches:
 	strlcpy(buf, xt_prefix[af], sizeof(buf));
 	strlcat(buf, FORMAT_MATCHES, sizeof(buf));
@@ -1339,6 +1826,12 @@ void xt_proto_fini(struct net *net, u_int8_t af)
 	strlcpy(buf, xt_prefix[af], sizeof(buf));
 	strlcat(buf, FORMAT_MATCHES, sizeof(buf));
 	proc_net_remove(net, buf);
+
+#ifdef CONFIG_NETFILTER_XTABLES_PROFILE
+	strlcpy(buf, xt_prefix[af], sizeof(buf));
+	strlcat(buf, FORMAT_PROFILE, sizeof(buf));
+	proc_net_remove(net, buf);
+#endif
 #endif /*CONFIG_PROC_FS*/
 }
 EXPORT_SYMBOL_GPL(xt_proto_fini);
@@ -0,0 +1,1501 @@
+/*
+ * govsim - replay load traces through the in-tree cpufreq governors
+ *
+ * The governor sources in drivers/cpufreq are linked in unmodified and
+ * driven by a simulated clock: a fake cpufreq driver applies their
+ * frequency requests, synthetic idle accounting reflects the replayed
+ * load, and the idle notifier, timers, workqueues and the interactive
+ * governor's speed-up thread are all emulated on a single host thread.
+ * Runs are therefore fully deterministic and can be repeated with
+ * different tunables to compare policies without a device.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include "kshim.h"
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <ucontext.h>
+
+#include <linux/cpufreq_powercap.h>
+
+#define TICK_US		(USEC_PER_SEC / HZ)
+#define QUANTUM_US	1000
+#define MAX_FREQS	32
+#define MAX_TIMERS	64
+#define MAX_WORKS	64
+#define MAX_TASKS	4
+#define MAX_NOTIFIERS	4
+#define MAX_GROUPS	4
+#define MAX_STEPS	1024
+#define TASK_STACK	(256 * 1024)
+
+/* Default table follows the RK29 operating points */
+static unsigned int default_freqs[] = {
+	408000, 624000, 816000, 1008000, 1200000,
+};
+
+char *progname;
+static int verbose;
+
+/*
+ * Simulated clock.  It starts as if the system had been up for a second,
+ * since the governors treat a zero timestamp as "never".
+ */
+#define START_US	USEC_PER_SEC
+static u64 now_us = START_US;
+volatile unsigned long jiffies = START_US / (USEC_PER_SEC / HZ);
+int govsim_ncpus = 1;
+int govsim_this_cpu;
+struct kernel_stat govsim_kstat[NR_CPUS];
+static struct kobject global_kobject = { .name = "cpufreq" };
+struct kobject *cpufreq_global_kobject = &global_kobject;
+
+/* Fake driver state */
+static struct cpufreq_frequency_table freq_table[MAX_FREQS + 1];
+static unsigned int nr_freqs;
+static struct cpufreq_policy policy;
+static struct cpufreq_governor *governors;
+static unsigned int limit_freq;		/* 0 means no driver ceiling */
+static unsigned int request_freq;	/* governor's choice before limits */
+static u64 capped_since = START_US;
+static u64 capped_us;
+
+static void account_capped(void);
+
+/* Power model, mW per CPU at each table entry */
+static unsigned int busy_mw[MAX_FREQS];
+static unsigned int idle_mw[MAX_FREQS];
+static int have_power;
+
+struct sim_cpu {
+	unsigned int util;		/* demand, % of max capacity */
+	double backlog;			/* outstanding work, kHz * us */
+	int busy;
+	u64 since;			/* start of current busy/idle period */
+	u64 busy_us;
+	u64 idle_us;
+};
+static struct sim_cpu cpus[NR_CPUS];
+
+/* Results */
+static u64 freq_since = START_US;
+static u64 res_us[MAX_FREQS];
+static u64 res_busy_us[MAX_FREQS];
+static double energy_nj[MAX_FREQS];
+static unsigned int transitions;
+static double max_backlog_us;
+
+struct load_step {
+	u64 start;
+	unsigned int need;
+	u64 latency;
+	int resolved;
+};
+static struct load_step steps[MAX_STEPS];
+static unsigned int nr_steps;
+static unsigned int step_thresh = 20;
+
+/*
+ * RK29 driver limits, modelled on rk29_cpufreq_limit_by_temp() in
+ * arch/arm/mach-rk29/cpufreq.c: a thermal budget is charged at a per
+ * frequency rate while running and drained while idle, and the driver
+ * caps requests to 1008 or 816 MHz once it is exhausted.  A re-check
+ * runs once a second like the driver's delayed work.
+ */
+#define TEMP_COEFF_IDLE	-1000
+#define TEMP_COEFF_408	-325
+#define TEMP_COEFF_624	-202
+#define TEMP_COEFF_816	-78
+#define TEMP_COEFF_1008	325
+#define TEMP_COEFF_1200	1300
+
+static int rk29_limit;
+static int rk29_limit_secs = 30;
+static int rk29_limit_secs_1200 = 6;
+static int rk29_temp;
+static u64 rk29_last_us;
+static u64 rk29_last_idle_us;
+static int rk29_started;
+static struct delayed_work rk29_temp_work;
+
+/*
+ * The generic power cap from drivers/cpufreq/cpufreq_powercap.c, with
+ * the RK29 board's model parameters and OPP powers from the power table.
+ */
+static int powercap_on;
+static struct cpufreq_powercap_opp powercap_opps[MAX_FREQS];
+static struct cpufreq_powercap powercap = {
+	.opps		= powercap_opps,
+	.resistance	= 20,
+	.tau_ms		= 20000,
+	.limit		= 12000,
+	.gain		= 100,
+	.period_ms	= 250,
+	.enabled	= true,
+};
+
+static void usage(void)
+{
+	fprintf(stderr,
+"Usage: %s [-g governor] [-n cpus] [-f khz,khz,...] [-p power_table]\n"
+"       [-s step%%] [-r] [-c] [-o knob=value]... [-v] trace\n"
+"\n"
+"  -g  governor to run: interactive (default) or ondemand\n"
+"  -n  number of CPUs sharing the policy (default 1)\n"
+"  -f  frequency table in kHz (default RK29 table or power table)\n"
+"  -p  power table, one '<khz> <busy_mw> <idle_mw>' line per frequency\n"
+"  -s  demand increase treated as a load step (default 20%%)\n"
+"  -r  apply the old RK29 driver's temperature limit\n"
+"  -c  run the thermal model power cap (needs -p)\n"
+"  -o  set a tunable, powercap.<knob> for the power cap;\n"
+"      rk29.limit_secs and rk29.limit_secs_1200 tune -r\n"
+"  -v  log governor trace events and frequency changes\n",
+		progname);
+	exit(1);
+}
+
+static void __attribute__((noreturn, format(printf, 1, 2)))
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "%s: ", progname);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(1);
+}
+
+static void simlog(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (!verbose)
+		return;
+	printf("%10.3f ", (now_us - START_US) / 1000.0);
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+/* Kernel library bits */
+
+int strict_strtoul(const char *cp, unsigned int base, unsigned long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoul(cp, &end, base);
+	if (errno || end == cp || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+int strict_strtoull(const char *cp, unsigned int base, unsigned long long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoull(cp, &end, base);
+	if (errno || end == cp || (*end && *end != '\n'))
+		return -EINVAL;
+	return 0;
+}
+
+u64 ktime_get(void)
+{
+	return now_us * NSEC_PER_USEC;
+}
+
+u64 ktime_to_us(u64 kt)
+{
+	return kt / NSEC_PER_USEC;
+}
+
+/* Idle accounting */
+
+static void cpu_account(int cpu)
+{
+	struct sim_cpu *c = &cpus[cpu];
+
+	if (c->busy)
+		c->busy_us += now_us - c->since;
+	else
+		c->idle_us += now_us - c->since;
+	c->since = now_us;
+}
+
+u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time)
+{
+	cpu_account(cpu);
+	if (last_update_time)
+		*last_update_time = now_us;
+	return cpus[cpu].idle_us;
+}
+
+u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time)
+{
+	if (last_update_time)
+		*last_update_time = now_us;
+	return 0;
+}
+
+/* Timers */
+
+static struct timer_list *timers[MAX_TIMERS];
+static int nr_timers;
+
+int del_timer(struct timer_list *timer)
+{
+	int i;
+
+	if (!timer->pending)
+		return 0;
+	for (i = 0; i < nr_timers; i++) {
+		if (timers[i] == timer) {
+			timers[i] = timers[--nr_timers];
+			break;
+		}
+	}
+	timer->pending = 0;
+	return 1;
+}
+
+int mod_timer(struct timer_list *timer, unsigned long expires)
+{
+	int ret = del_timer(timer);
+
+	if (nr_timers == MAX_TIMERS)
+		die("too many timers\n");
+	timer->expires = expires;
+	timer->cpu = govsim_this_cpu;
+	timer->pending = 1;
+	timers[nr_timers++] = timer;
+	return ret;
+}
+
+void add_timer_on(struct timer_list *timer, int cpu)
+{
+	mod_timer(timer, timer->expires);
+	timer->cpu = cpu;
+}
+
+static struct timer_list *next_expired_timer(void)
+{
+	struct timer_list *t = NULL;
+	int i;
+
+	for (i = 0; i < nr_timers; i++) {
+		if (time_after(timers[i]->expires, jiffies))
+			continue;
+		if (!t || time_before(timers[i]->expires, t->expires))
+			t = timers[i];
+	}
+	return t;
+}
+
+/* Workqueues */
+
+static struct work_struct *works[MAX_WORKS];
+static int work_cpu[MAX_WORKS];
+static int nr_works;
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags,
+					 int max_active)
+{
+	struct workqueue_struct *wq = calloc(1, sizeof(*wq));
+
+	if (wq)
+		wq->name = name;
+	return wq;
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+	free(wq);
+}
+
+static int queue_work_on(int cpu, struct work_struct *work)
+{
+	if (work->pending)
+		return 0;
+	if (nr_works == MAX_WORKS)
+		die("too many queued works\n");
+	work->pending = 1;
+	work_cpu[nr_works] = cpu;
+	works[nr_works++] = work;
+	return 1;
+}
+
+int queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+	return queue_work_on(govsim_this_cpu, work);
+}
+
+static int dequeue_work(struct work_struct *work)
+{
+	int i;
+
+	for (i = 0; i < nr_works; i++) {
+		if (works[i] == work) {
+			memmove(&works[i], &works[i + 1],
+				(nr_works - i - 1) * sizeof(works[0]));
+			memmove(&work_cpu[i], &work_cpu[i + 1],
+				(nr_works - i - 1) * sizeof(work_cpu[0]));
+			nr_works--;
+			work->pending = 0;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void run_one_work(void)
+{
+	struct work_struct *work = works[0];
+	int cpu = work_cpu[0];
+
+	dequeue_work(work);
+	govsim_this_cpu = cpu;
+	work->func(work);
+}
+
+bool flush_work(struct work_struct *work)
+{
+	int saved = govsim_this_cpu;
+
+	if (!dequeue_work(work))
+		return false;
+	work->func(work);
+	govsim_this_cpu = saved;
+	return true;
+}
+
+static void delayed_work_timer_fn(unsigned long data)
+{
+	struct delayed_work *dwork = (struct delayed_work *)data;
+
+	queue_work_on(dwork->timer.cpu, &dwork->work);
+}
+
+int schedule_delayed_work_on(int cpu, struct delayed_work *dwork,
+			     unsigned long delay)
+{
+	if (dwork->work.pending || dwork->timer.pending)
+		return 0;
+	if (!delay)
+		return queue_work_on(cpu, &dwork->work);
+	dwork->timer.function = delayed_work_timer_fn;
+	dwork->timer.data = (unsigned long)dwork;
+	mod_timer(&dwork->timer, jiffies + delay);
+	dwork->timer.cpu = cpu;
+	return 1;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+	int ret = del_timer(&dwork->timer);
+
+	return dequeue_work(&dwork->work) || ret;
+}
+
+/*
+ * Kernel threads.  Each runs on its own stack and is switched to from
+ * the simulator loop whenever it has been woken; it switches back when
+ * it calls schedule() in a non-running state.  Threads are treated as
+ * the highest priority work, so they always run before time advances.
+ */
+
+struct task_struct {
+	ucontext_t ctx;
+	int (*fn)(void *data);
+	void *data;
+	char name[32];
+	long state;
+	int runnable;
+	int should_stop;
+	int exited;
+	void *stack;
+};
+
+static ucontext_t sim_ctx;
+static struct task_struct *tasks[MAX_TASKS];
+static int nr_tasks;
+struct task_struct *govsim_current;
+
+static void task_entry(void)
+{
+	struct task_struct *t = govsim_current;
+
+	t->fn(t->data);
+	t->exited = 1;
+}
+
+struct task_struct *kthread_create(int (*fn)(void *data), void *data,
+				   const char *name, ...)
+{
+	struct task_struct *t;
+	va_list ap;
+
+	if (nr_tasks == MAX_TASKS)
+		return ERR_PTR(-ENOMEM);
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return ERR_PTR(-ENOMEM);
+	t->stack = malloc(TASK_STACK);
+	if (!t->stack) {
+		free(t);
+		return ERR_PTR(-ENOMEM);
+	}
+	t->fn = fn;
+	t->data = data;
+	t->state = TASK_INTERRUPTIBLE;
+	va_start(ap, name);
+	vsnprintf(t->name, sizeof(t->name), name, ap);
+	va_end(ap);
+
+	getcontext(&t->ctx);
+	t->ctx.uc_stack.ss_sp = t->stack;
+	t->ctx.uc_stack.ss_size = TASK_STACK;
+	t->ctx.uc_link = &sim_ctx;
+	makecontext(&t->ctx, task_entry, 0);
+	tasks[nr_tasks++] = t;
+	return t;
+}
+
+int wake_up_process(struct task_struct *t)
+{
+	if (t->exited || t->state == TASK_RUNNING)
+		return 0;
+	t->state = TASK_RUNNING;
+	t->runnable = 1;
+	return 1;
+}
+
+void __set_current_state(long state)
+{
+	if (govsim_current)
+		govsim_current->state = state;
+}
+
+void schedule(void)
+{
+	struct task_struct *t = govsim_current;
+
+	if (!t || t->state == TASK_RUNNING)
+		return;
+	swapcontext(&t->ctx, &sim_ctx);
+}
+
+bool kthread_should_stop(void)
+{
+	return govsim_current && govsim_current->should_stop;
+}
+
+static int run_tasks(void)
+{
+	int i, ran = 0;
+
+	for (i = 0; i < nr_tasks; i++) {
+		struct task_struct *t = tasks[i];
+
+		if (!t->runnable)
+			continue;
+		t->runnable = 0;
+		govsim_current = t;
+		swapcontext(&sim_ctx, &t->ctx);
+		govsim_current = NULL;
+		ran = 1;
+	}
+	return ran;
+}
+
+int kthread_stop(struct task_struct *t)
+{
+	int i;
+
+	t->should_stop = 1;
+	t->state = TASK_INTERRUPTIBLE;
+	wake_up_process(t);
+	run_tasks();
+	for (i = 0; i < nr_tasks; i++) {
+		if (tasks[i] == t) {
+			tasks[i] = tasks[--nr_tasks];
+			break;
+		}
+	}
+	free(t->stack);
+	free(t);
+	return 0;
+}
+
+/* Run everything that became ready at the current instant */
+static void run_pending(void)
+{
+	int saved = govsim_this_cpu;
+
+	do {
+		while (nr_works)
+			run_one_work();
+	} while (run_tasks() || nr_works);
+	govsim_this_cpu = saved;
+}
+
+static void run_timers(void)
+{
+	struct timer_list *t;
+
+	while ((t = next_expired_timer())) {
+		del_timer(t);
+		govsim_this_cpu = t->cpu;
+		t->function(t->data);
+		run_pending();
+	}
+}
+
+/* Idle notifier */
+
+static struct notifier_block *idle_notifiers[MAX_NOTIFIERS];
+static int nr_idle_notifiers;
+
+void idle_notifier_register(struct notifier_block *n)
+{
+	if (nr_idle_notifiers < MAX_NOTIFIERS)
+		idle_notifiers[nr_idle_notifiers++] = n;
+}
+
+void idle_notifier_unregister(struct notifier_block *n)
+{
+	int i;
+
+	for (i = 0; i < nr_idle_notifiers; i++)
+		if (idle_notifiers[i] == n)
+			idle_notifiers[i] = idle_notifiers[--nr_idle_notifiers];
+}
+
+static void idle_notify(int cpu, unsigned long val)
+{
+	int i;
+
+	govsim_this_cpu = cpu;
+	for (i = 0; i < nr_idle_notifiers; i++)
+		idle_notifiers[i]->notifier_call(idle_notifiers[i], val, NULL);
+	run_pending();
+}
+
+/* sysfs: remember groups so tunables can be set through their store() */
+
+static const struct attribute_group *groups[MAX_GROUPS];
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp)
+{
+	int i;
+
+	for (i = 0; i < MAX_GROUPS; i++) {
+		if (!groups[i]) {
+			groups[i] = grp;
+			return 0;
+		}
+	}
+	return -ENOMEM;
+}
+
+void sysfs_remove_group(struct kobject *kobj,
+			const struct attribute_group *grp)
+{
+	int i;
+
+	for (i = 0; i < MAX_GROUPS; i++)
+		if (groups[i] == grp)
+			groups[i] = NULL;
+}
+
+/* Tunables are found by name, optionally qualified as "group.name" */
+static struct global_attr *find_attr(const char *name)
+{
+	struct attribute **a;
+	const char *attr;
+	size_t len;
+	int i;
+
+	for (i = 0; i < MAX_GROUPS; i++) {
+		if (!groups[i])
+			continue;
+		attr = name;
+		if (groups[i]->name) {
+			len = strlen(groups[i]->name);
+			if (!strncmp(name, groups[i]->name, len) &&
+			    name[len] == '.')
+				attr = name + len + 1;
+		}
+		for (a = groups[i]->attrs; *a; a++)
+			if (!strcmp((*a)->name, attr))
+				return container_of(*a, struct global_attr,
+						    attr);
+	}
+	return NULL;
+}
+
+/* Input: a single touchscreen whose presses come from the trace */
+
+static struct input_dev touch_dev = { .name = "govsim-touchscreen" };
+static struct input_handler *input_handler;
+static struct input_handle *input_handle;
+
+int input_register_handler(struct input_handler *handler)
+{
+	input_handler = handler;
+	if (handler->connect)
+		handler->connect(handler, &touch_dev, handler->id_table);
+	return 0;
+}
+
+void input_unregister_handler(struct input_handler *handler)
+{
+	if (input_handle && handler->disconnect)
+		handler->disconnect(input_handle);
+	input_handler = NULL;
+}
+
+int input_register_handle(struct input_handle *handle)
+{
+	input_handle = handle;
+	return 0;
+}
+
+void input_unregister_handle(struct input_handle *handle)
+{
+	if (input_handle == handle)
+		input_handle = NULL;
+}
+
+int input_open_device(struct input_handle *handle)
+{
+	return 0;
+}
+
+void input_close_device(struct input_handle *handle)
+{
+}
+
+static void inject_touch(void)
+{
+	if (!input_handle || !input_handler->event)
+		return;
+	simlog("touch\n");
+	govsim_this_cpu = 0;
+	input_handler->event(input_handle, EV_KEY, BTN_TOUCH, 1);
+	input_handler->event(input_handle, EV_SYN, 0, 0);
+	run_pending();
+}
+
+/* Tracepoints */
+
+void govsim_trace_loadeval(const char *event, unsigned long cpu,
+			   unsigned long load, unsigned long curtarg,
+			   unsigned long curactual, unsigned long newtarg)
+{
+	simlog("%-8s cpu=%lu load=%lu cur=%lu actual=%lu targ=%lu\n",
+	     event, cpu, load, curtarg, curactual, newtarg);
+}
+
+void govsim_trace_setspeed(u32 cpu, unsigned long targfreq,
+			   unsigned long actualfreq)
+{
+	simlog("setspeed cpu=%u targ=%lu actual=%lu\n",
+	     cpu, targfreq, actualfreq);
+}
+
+void govsim_trace_boost(const char *s)
+{
+	simlog("boost    %s\n", s);
+}
+
+/* cpufreq core and the fake driver */
+
+int cpufreq_register_governor(struct cpufreq_governor *governor)
+{
+	governor->next = governors;
+	governors = governor;
+	return 0;
+}
+
+void cpufreq_unregister_governor(struct cpufreq_governor *governor)
+{
+	struct cpufreq_governor **p;
+
+	for (p = &governors; *p; p = &(*p)->next) {
+		if (*p == governor) {
+			*p = governor->next;
+			break;
+		}
+	}
+}
+
+struct cpufreq_frequency_table *cpufreq_frequency_get_table(unsigned int cpu)
+{
+	return freq_table;
+}
+
+void cpufreq_frequency_table_put_attr(unsigned int cpu)
+{
+}
+
+struct cpufreq_policy *cpufreq_cpu_get(unsigned int cpu)
+{
+	return cpu < govsim_ncpus ? &policy : NULL;
+}
+
+void cpufreq_cpu_put(struct cpufreq_policy *p)
+{
+}
+
+static struct notifier_block *policy_notifiers[MAX_NOTIFIERS];
+static int nr_policy_notifiers;
+
+int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list)
+{
+	if (list != CPUFREQ_POLICY_NOTIFIER ||
+	    nr_policy_notifiers == MAX_NOTIFIERS)
+		return -EINVAL;
+	policy_notifiers[nr_policy_notifiers++] = nb;
+	return 0;
+}
+
+int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
+{
+	int i;
+
+	for (i = 0; i < nr_policy_notifiers; i++)
+		if (policy_notifiers[i] == nb)
+			policy_notifiers[i] =
+				policy_notifiers[--nr_policy_notifiers];
+	return 0;
+}
+
+/*
+ * As __cpufreq_set_policy(): start from the hardware limits, let the
+ * policy notifiers narrow them and tell the governor about the result.
+ */
+int cpufreq_update_policy(unsigned int cpu)
+{
+	struct cpufreq_policy new = policy;
+	int i;
+
+	new.min = policy.cpuinfo.min_freq;
+	new.max = policy.cpuinfo.max_freq;
+	for (i = 0; i < nr_policy_notifiers; i++)
+		policy_notifiers[i]->notifier_call(policy_notifiers[i],
+						   CPUFREQ_ADJUST, &new);
+	for (i = 0; i < nr_policy_notifiers; i++)
+		policy_notifiers[i]->notifier_call(policy_notifiers[i],
+						   CPUFREQ_INCOMPATIBLE, &new);
+	if (new.min > new.max)
+		return -EINVAL;
+	for (i = 0; i < nr_policy_notifiers; i++)
+		policy_notifiers[i]->notifier_call(policy_notifiers[i],
+						   CPUFREQ_NOTIFY, &new);
+	if (new.min == policy.min && new.max == policy.max)
+		return 0;
+	simlog("policy   %u-%u kHz\n", new.min, new.max);
+	account_capped();
+	policy.min = new.min;
+	policy.max = new.max;
+	if (policy.governor)
+		policy.governor->governor(&policy, CPUFREQ_GOV_LIMITS);
+	return 0;
+}
+
+int __cpufreq_driver_getavg(struct cpufreq_policy *policy, unsigned int cpu)
+{
+	return 0;
+}
+
+/* Same selection rules as drivers/cpufreq/freq_table.c */
+int cpufreq_frequency_table_target(struct cpufreq_policy *policy,
+				   struct cpufreq_frequency_table *table,
+				   unsigned int target_freq,
+				   unsigned int relation, unsigned int *index)
+{
+	struct cpufreq_frequency_table optimal = { .index = ~0, .frequency = 0 };
+	struct cpufreq_frequency_table suboptimal = { .index = ~0, .frequency = 0 };
+	unsigned int i;
+
+	if (relation == CPUFREQ_RELATION_H)
+		suboptimal.frequency = ~0;
+	else
+		optimal.frequency = ~0;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
+
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		if (freq < policy->min || freq > policy->max)
+			continue;
+		if (relation == CPUFREQ_RELATION_H) {
+			if (freq <= target_freq) {
+				if (freq >= optimal.frequency) {
+					optimal.frequency = freq;
+					optimal.index = i;
+				}
+			} else if (freq <= suboptimal.frequency) {
+				suboptimal.frequency = freq;
+				suboptimal.index = i;
+			}
+		} else {
+			if (freq >= target_freq) {
+				if (freq <= optimal.frequency) {
+					optimal.frequency = freq;
+					optimal.index = i;
+				}
+			} else if (freq >= suboptimal.frequency) {
+				suboptimal.frequency = freq;
+				suboptimal.index = i;
+			}
+		}
+	}
+	if (optimal.index > i) {
+		if (suboptimal.index > i)
+			return -EINVAL;
+		*index = suboptimal.index;
+	} else {
+		*index = optimal.index;
+	}
+	return 0;
+}
+
+static int freq_index(unsigned int freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_freqs; i++)
+		if (freq_table[i].frequency == freq)
+			return i;
+	return -1;
+}
+
+/* Lowest table entry not below @freq, or the highest entry */
+static int index_at_least(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < nr_freqs - 1; i++)
+		if (freq_table[i].frequency >= freq)
+			break;
+	return i;
+}
+
+/* Highest table entry not above @freq, or the lowest entry */
+static int index_at_most(unsigned int freq)
+{
+	int i;
+
+	for (i = nr_freqs - 1; i > 0; i--)
+		if (freq_table[i].frequency <= freq)
+			break;
+	return i;
+}
+
+static void rk29_limit_by_temp(int *index)
+{
+	u64 idle_us, wall;
+	unsigned int cur = policy.cur;
+	int c, ms, temp, overheat_temp, overheat_temp_1200;
+	unsigned int target = freq_table[*index].frequency;
+
+	idle_us = get_cpu_idle_time_us(0, &wall);
+	if (!rk29_started) {
+		rk29_started = 1;
+		rk29_last_us = now_us;
+		rk29_last_idle_us = idle_us;
+		return;
+	}
+
+	temp = rk29_temp;
+	temp -= idle_us - rk29_last_idle_us;
+	rk29_last_idle_us = idle_us;
+	ms = (now_us - rk29_last_us) / USEC_PER_MSEC;
+	rk29_last_us = now_us;
+
+	if (cur <= 408000)
+		c = TEMP_COEFF_408;
+	else if (cur <= 624000)
+		c = TEMP_COEFF_624;
+	else if (cur <= 816000)
+		c = TEMP_COEFF_816;
+	else if (cur <= 1008000)
+		c = TEMP_COEFF_1008;
+	else
+		c = TEMP_COEFF_1200;
+	temp += c * ms;
+	if (temp < 0)
+		temp = 0;
+
+	overheat_temp = TEMP_COEFF_1008 * rk29_limit_secs * MSEC_PER_SEC;
+	overheat_temp_1200 = TEMP_COEFF_1200 * rk29_limit_secs_1200 *
+			     MSEC_PER_SEC;
+
+	if (temp >= overheat_temp && target > 816000)
+		*index = index_at_most(816000);
+	else if (target > 1008000 && temp >= overheat_temp_1200 &&
+		 temp < overheat_temp)
+		*index = index_at_most(1008000);
+
+	if (freq_table[*index].frequency < target)
+		simlog("rk29     temp %d limits %u to %u kHz\n", temp, target,
+		       freq_table[*index].frequency);
+	rk29_temp = temp;
+}
+
+static void resolve_steps(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_steps; i++) {
+		struct load_step *s = &steps[i];
+
+		if (s->resolved || policy.cur < s->need)
+			continue;
+		s->resolved = 1;
+		s->latency = now_us - s->start;
+	}
+}
+
+/*
+ * Time spent below the governor's request because of driver limits, or
+ * held at a policy ceiling below the top frequency by the power cap.
+ */
+static void account_capped(void)
+{
+	if (policy.cur < request_freq ||
+	    (policy.max < policy.cpuinfo.max_freq && policy.cur == policy.max))
+		capped_us += now_us - capped_since;
+	capped_since = now_us;
+}
+
+static void set_freq(unsigned int freq)
+{
+	int old = freq_index(policy.cur);
+
+	res_us[old] += now_us - freq_since;
+	freq_since = now_us;
+	simlog("freq     %u -> %u kHz\n", policy.cur, freq);
+	policy.cur = freq;
+	transitions++;
+	resolve_steps();
+}
+
+int __cpufreq_driver_target(struct cpufreq_policy *p, unsigned int target_freq,
+			    unsigned int relation)
+{
+	unsigned int index;
+
+	if (cpufreq_frequency_table_target(p, freq_table, target_freq,
+					   relation, &index))
+		return -EINVAL;
+	account_capped();
+	request_freq = freq_table[index].frequency;
+	if (limit_freq && freq_table[index].frequency > limit_freq)
+		index = index_at_most(limit_freq);
+	if (rk29_limit)
+		rk29_limit_by_temp((int *)&index);
+	if (freq_table[index].frequency != p->cur)
+		set_freq(freq_table[index].frequency);
+	return 0;
+}
+
+/* Re-apply limits without replacing the governor's last request */
+static void driver_recheck(unsigned int freq)
+{
+	unsigned int request = request_freq;
+
+	__cpufreq_driver_target(&policy, freq, CPUFREQ_RELATION_L);
+	request_freq = request;
+}
+
+static void rk29_temp_work_fn(struct work_struct *work)
+{
+	driver_recheck(policy.cur);
+	schedule_delayed_work_on(0, &rk29_temp_work, HZ);
+}
+
+/* Simulation */
+
+static void cpu_set_busy(int cpu, int busy)
+{
+	cpu_account(cpu);
+	cpus[cpu].busy = busy;
+	idle_notify(cpu, busy ? IDLE_END : IDLE_START);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Advance one quantum.  Work for the quantum arrives at its start and
+ * is served at the current frequency; a CPU that runs out of work goes
+ * idle for the rest of the quantum.  Timers fire on jiffy boundaries.
+ */
+static void sim_quantum(void)
+{
+	unsigned int fmax = freq_table[nr_freqs - 1].frequency;
+	u64 t0 = now_us, ends[NR_CPUS];
+	int cpu, i, idx;
+
+	for (cpu = 0; cpu < govsim_ncpus; cpu++) {
+		struct sim_cpu *c = &cpus[cpu];
+
+		c->backlog += (double)c->util * fmax * QUANTUM_US / 100;
+		if (c->backlog > 0 && !c->busy)
+			cpu_set_busy(cpu, 1);
+	}
+
+	/* Frequency is constant within the quantum */
+	idx = freq_index(policy.cur);
+	for (cpu = 0; cpu < govsim_ncpus; cpu++) {
+		struct sim_cpu *c = &cpus[cpu];
+		double run = c->backlog / policy.cur;
+		u64 busy = run >= QUANTUM_US ? QUANTUM_US : (u64)run;
+
+		if (busy >= QUANTUM_US)
+			c->backlog -= (double)policy.cur * QUANTUM_US;
+		else
+			c->backlog = 0;
+		if (c->backlog / fmax > max_backlog_us)
+			max_backlog_us = c->backlog / fmax;
+
+		res_busy_us[idx] += c->busy ? busy : 0;
+		if (have_power)
+			energy_nj[idx] += (double)busy * busy_mw[idx] +
+				(double)(QUANTUM_US - busy) * idle_mw[idx];
+		ends[cpu] = (c->busy && busy < QUANTUM_US) ?
+			    (busy << 8) | cpu : ~0ULL;
+	}
+
+	/* Idle entries in time order */
+	qsort(ends, govsim_ncpus, sizeof(ends[0]), cmp_u64);
+	for (i = 0; i < govsim_ncpus && ends[i] != ~0ULL; i++) {
+		now_us = t0 + (ends[i] >> 8);
+		cpu_set_busy(ends[i] & 0xff, 0);
+	}
+
+	now_us = t0 + QUANTUM_US;
+	jiffies = now_us / TICK_US;
+	run_timers();
+}
+
+static void set_load(char *spec)
+{
+	unsigned int fmax = freq_table[nr_freqs - 1].frequency;
+	unsigned int util = 0;
+	char *tok;
+	int cpu;
+
+	for (cpu = 0; cpu < govsim_ncpus; cpu++) {
+		struct sim_cpu *c = &cpus[cpu];
+
+		tok = strsep(&spec, ",");
+		if (tok)
+			util = strtoul(tok, NULL, 0);
+		if (util >= c->util + step_thresh && nr_steps < MAX_STEPS) {
+			struct load_step *s = &steps[nr_steps++];
+			u64 need = (u64)fmax * min(util, 100U) / 100;
+
+			s->start = now_us;
+			s->need = freq_table[index_at_least(need)].frequency;
+		}
+		c->util = util;
+	}
+	resolve_steps();
+}
+
+static void finish_steps(void)
+{
+	unsigned int i;
+
+	/* A step that was not met before the load changed again is missed */
+	for (i = 0; i < nr_steps; i++)
+		if (!steps[i].resolved)
+			steps[i].resolved = -1;
+}
+
+static char *trim(char *s)
+{
+	char *e;
+
+	while (isspace(*s))
+		s++;
+	e = s + strlen(s);
+	while (e > s && isspace(e[-1]))
+		*--e = '\0';
+	return s;
+}
+
+static void replay(FILE *f)
+{
+	char line[1024];
+	int lineno = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *s, *arg;
+		unsigned long ms, q;
+
+		lineno++;
+		if ((s = strchr(line, '#')))
+			*s = '\0';
+		s = trim(line);
+		if (!*s)
+			continue;
+
+		if (!strcmp(s, "touch")) {
+			inject_touch();
+			continue;
+		}
+		if (!strncmp(s, "limit", 5) && isspace(s[5])) {
+			arg = trim(s + 5);
+			limit_freq = strcmp(arg, "off") ?
+				     strtoul(arg, NULL, 0) : 0;
+			simlog("limit    %s\n", arg);
+			govsim_this_cpu = 0;
+			driver_recheck(request_freq);
+			run_pending();
+			continue;
+		}
+
+		ms = strtoul(s, &arg, 0);
+		if (arg == s || !isspace(*arg))
+			die("line %d: expected '<ms> <util>[,<util>...]'\n",
+			    lineno);
+		finish_steps();
+		set_load(trim(arg));
+		for (q = ms * USEC_PER_MSEC / QUANTUM_US; q; q--)
+			sim_quantum();
+	}
+	finish_steps();
+}
+
+/* Setup and reporting */
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void set_freqs(unsigned int *freqs, unsigned int n)
+{
+	unsigned int i;
+
+	if (!n || n > MAX_FREQS)
+		die("need 1 to %d frequencies\n", MAX_FREQS);
+	qsort(freqs, n, sizeof(freqs[0]), cmp_uint);
+	for (i = 0; i < n; i++) {
+		freq_table[i].index = i;
+		freq_table[i].frequency = freqs[i];
+	}
+	freq_table[n].frequency = CPUFREQ_TABLE_END;
+	nr_freqs = n;
+}
+
+static void parse_freqs(char *arg)
+{
+	unsigned int freqs[MAX_FREQS], n = 0;
+	char *tok;
+
+	while ((tok = strsep(&arg, ",")) && n < MAX_FREQS)
+		freqs[n++] = strtoul(tok, NULL, 0);
+	set_freqs(freqs, n);
+}
+
+static void read_power_table(const char *path, int set_table)
+{
+	unsigned int freqs[MAX_FREQS], busy[MAX_FREQS], idle[MAX_FREQS];
+	unsigned int n = 0, i, j;
+	char line[256];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		die("%s: %s\n", path, strerror(errno));
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || !*trim(line))
+			continue;
+		if (n == MAX_FREQS ||
+		    sscanf(line, "%u %u %u", &freqs[n], &busy[n], &idle[n]) != 3)
+			die("%s: bad line '%s'\n", path, line);
+		n++;
+	}
+	fclose(f);
+
+	if (set_table) {
+		unsigned int tmp[MAX_FREQS];
+
+		memcpy(tmp, freqs, n * sizeof(tmp[0]));
+		set_freqs(tmp, n);
+	}
+	for (i = 0; i < nr_freqs; i++) {
+		for (j = 0; j < n; j++)
+			if (freqs[j] == freq_table[i].frequency)
+				break;
+		if (j == n)
+			die("%s: no entry for %u kHz\n", path,
+			    freq_table[i].frequency);
+		busy_mw[i] = busy[j];
+		idle_mw[i] = idle[j];
+	}
+	have_power = 1;
+}
+
+static void set_knob(char *arg)
+{
+	struct global_attr *ga;
+	char *val = strchr(arg, '=');
+	char buf[128];
+	ssize_t ret;
+
+	if (!val)
+		die("tunable '%s' is not knob=value\n", arg);
+	*val++ = '\0';
+
+	if (!strcmp(arg, "rk29.limit_secs")) {
+		rk29_limit_secs = atoi(val);
+		return;
+	}
+	if (!strcmp(arg, "rk29.limit_secs_1200")) {
+		rk29_limit_secs_1200 = atoi(val);
+		return;
+	}
+
+	ga = find_attr(arg);
+	if (!ga || !ga->store)
+		die("no writable tunable '%s'\n", arg);
+	snprintf(buf, sizeof(buf), "%s\n", val);
+	ret = ga->store(cpufreq_global_kobject, &ga->attr, buf, strlen(buf));
+	if (ret < 0)
+		die("%s: cannot set '%s': %s\n", arg, val, strerror(-ret));
+}
+
+static void report(const char *gov)
+{
+	unsigned int i, met = 0, missed = 0;
+	u64 total = now_us - START_US, sum_lat = 0, max_lat = 0;
+	double energy = 0;
+
+	res_us[freq_index(policy.cur)] += now_us - freq_since;
+	freq_since = now_us;
+	account_capped();
+
+	printf("governor     %s\n", gov);
+	printf("cpus         %d\n", govsim_ncpus);
+	printf("duration     %.1f ms\n", total / 1000.0);
+	printf("transitions  %u\n", transitions);
+	printf("\n%10s %12s %7s %12s", "kHz", "time(ms)", "time%", "busy(ms)");
+	if (have_power)
+		printf(" %12s", "energy(mJ)");
+	printf("\n");
+	for (i = 0; i < nr_freqs; i++) {
+		printf("%10u %12.1f %6.1f%% %12.1f", freq_table[i].frequency,
+		       res_us[i] / 1000.0,
+		       total ? 100.0 * res_us[i] / total : 0.0,
+		       res_busy_us[i] / 1000.0);
+		if (have_power)
+			printf(" %12.1f", energy_nj[i] / 1e6);
+		printf("\n");
+		energy += energy_nj[i];
+	}
+	if (have_power)
+		printf("energy       %.1f mJ, average %.1f mW\n", energy / 1e6,
+		       total ? energy / total : 0.0);
+
+	for (i = 0; i < nr_steps; i++) {
+		if (steps[i].resolved < 0) {
+			missed++;
+			continue;
+		}
+		met++;
+		sum_lat += steps[i].latency;
+		if (steps[i].latency > max_lat)
+			max_lat = steps[i].latency;
+	}
+	printf("\nload steps   %u (demand up by %u%% or more)\n",
+	       nr_steps, step_thresh);
+	if (met)
+		printf("latency      mean %.1f ms, max %.1f ms\n",
+		       sum_lat / 1000.0 / met, max_lat / 1000.0);
+	printf("missed       %u (load changed before the frequency caught up)\n",
+	       missed);
+	printf("max backlog  %.1f ms of work at max frequency\n",
+	       max_backlog_us / 1000.0);
+	printf("capped       %.1f ms below the governor's request or at a "
+	       "lowered ceiling\n", capped_us / 1000.0);
+	if (rk29_limit)
+		printf("rk29 temp    %d at end of trace\n", rk29_temp);
+	if (powercap_on)
+		printf("powercap     rise %u.%03u C, %u mW, ceiling %u kHz at end "
+		       "of trace\n", powercap.rise / 1000, powercap.rise % 1000,
+		       powercap.power, powercap.cap_freq);
+
+	printf("\ntunables\n");
+	for (i = 0; i < MAX_GROUPS; i++) {
+		struct attribute **a;
+
+		if (!groups[i])
+			continue;
+		for (a = groups[i]->attrs; *a; a++) {
+			struct global_attr *ga =
+				container_of(*a, struct global_attr, attr);
+			char buf[256], name[64];
+
+			if (!ga->show || ga->show(cpufreq_global_kobject,
+						  &ga->attr, buf) < 0)
+				continue;
+			if (groups[i]->name)
+				snprintf(name, sizeof(name), "%s.%s",
+					 groups[i]->name, (*a)->name);
+			else
+				snprintf(name, sizeof(name), "%s", (*a)->name);
+			printf("  %-24s %s", name, buf);
+		}
+	}
+}
+
+extern int (*govsim_initcall_cpufreq_interactive_init)(void);
+extern void (*govsim_exitcall_cpufreq_interactive_exit)(void);
+extern int (*govsim_initcall_cpufreq_gov_dbs_init)(void);
+extern void (*govsim_exitcall_cpufreq_gov_dbs_exit)(void);
+
+static struct {
+	const char *name;
+	int (**init)(void);
+	void (**exit)(void);
+} govs[] = {
+	{ "interactive", &govsim_initcall_cpufreq_interactive_init,
+	  &govsim_exitcall_cpufreq_interactive_exit },
+	{ "ondemand", &govsim_initcall_cpufreq_gov_dbs_init,
+	  &govsim_exitcall_cpufreq_gov_dbs_exit },
+};
+
+int main(int argc, char **argv)
+{
+	const char *gov = "interactive", *power = NULL;
+	char *knobs[64];
+	int nr_knobs = 0, opt, cpu, g;
+	unsigned int i;
+	struct cpufreq_governor *governor;
+	FILE *trace;
+
+	progname = argv[0];
+	set_freqs(default_freqs, ARRAY_SIZE(default_freqs));
+
+	while ((opt = getopt(argc, argv, "g:n:f:p:s:rco:v")) != -1) {
+		switch (opt) {
+		case 'g':
+			gov = optarg;
+			break;
+		case 'n':
+			govsim_ncpus = atoi(optarg);
+			if (govsim_ncpus < 1 || govsim_ncpus > NR_CPUS)
+				die("1 to %d CPUs\n", NR_CPUS);
+			break;
+		case 'f':
+			parse_freqs(optarg);
+			break;
+		case 'p':
+			power = optarg;
+			break;
+		case 's':
+			step_thresh = atoi(optarg);
+			break;
+		case 'r':
+			rk29_limit = 1;
+			break;
+		case 'c':
+			powercap_on = 1;
+			break;
+		case 'o':
+			if (nr_knobs < ARRAY_SIZE(knobs))
+				knobs[nr_knobs++] = optarg;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+	trace = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+	if (!trace)
+		die("%s: %s\n", argv[optind], strerror(errno));
+	if (power)
+		read_power_table(power, freq_table[0].frequency ==
+				 default_freqs[0] && nr_freqs ==
+				 ARRAY_SIZE(default_freqs));
+	if (powercap_on && !have_power)
+		die("-c needs a power table\n");
+
+	for (g = 0; g < ARRAY_SIZE(govs); g++)
+		if (!strcmp(govs[g].name, gov))
+			break;
+	if (g == ARRAY_SIZE(govs))
+		die("unknown governor '%s'\n", gov);
+	if ((*govs[g].init)())
+		die("%s: init failed\n", gov);
+	for (governor = governors; governor; governor = governor->next)
+		if (!strcmp(governor->name, gov))
+			break;
+	if (!governor)
+		die("%s did not register\n", gov);
+
+	for (cpu = 0; cpu < govsim_ncpus; cpu++)
+		cpumask_set_cpu(cpu, policy.cpus);
+	cpumask_copy(policy.related_cpus, policy.cpus);
+	policy.cpuinfo.min_freq = policy.min = freq_table[0].frequency;
+	policy.cpuinfo.max_freq = policy.max =
+		freq_table[nr_freqs - 1].frequency;
+	policy.cpuinfo.transition_latency = 40 * NSEC_PER_USEC;
+	policy.cur = request_freq = policy.min;
+	policy.governor = governor;
+
+	if (governor->governor(&policy, CPUFREQ_GOV_START))
+		die("%s: start failed\n", gov);
+	run_pending();
+	if (powercap_on) {
+		for (i = 0; i < nr_freqs; i++) {
+			powercap_opps[i].frequency = freq_table[i].frequency;
+			powercap_opps[i].busy_mw = busy_mw[i];
+			powercap_opps[i].idle_mw = idle_mw[i];
+		}
+		powercap.nr_opps = nr_freqs;
+		if (cpufreq_powercap_register(&powercap))
+			die("powercap: register failed\n");
+		run_pending();
+	}
+	for (i = 0; i < nr_knobs; i++)
+		set_knob(knobs[i]);
+	if (rk29_limit) {
+		INIT_DELAYED_WORK(&rk29_temp_work, rk29_temp_work_fn);
+		schedule_delayed_work_on(0, &rk29_temp_work, HZ);
+	}
+
+	replay(trace);
+
+	report(gov);
+	if (powercap_on)
+		cpufreq_powercap_unregister(&powercap);
+	governor->governor(&policy, CPUFREQ_GOV_STOP);
+	(*govs[g].exit)();
+	return 0;
+}
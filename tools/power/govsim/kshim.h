@@ -0,0 +1,540 @@
+/*
+ * kshim.h - minimal kernel API for building cpufreq governors in userspace
+ *
+ * This header is force-included (gcc -include) ahead of the governor
+ * sources from drivers/cpufreq.  The kernel headers those sources name
+ * are replaced by empty files, so everything they need must be declared
+ * here.  Only what cpufreq_interactive.c and cpufreq_ondemand.c actually
+ * use is provided; the backing implementation is in govsim.c.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#ifndef _GOVSIM_KSHIM_H
+#define _GOVSIM_KSHIM_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Types */
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef long long s64;
+typedef u64 cputime64_t;
+typedef unsigned int gfp_t;
+
+#define NR_CPUS			4
+#define BITS_PER_LONG		(8 * (int)sizeof(long))
+#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr)		(1UL << ((nr) % BITS_PER_LONG))
+#define BITS_TO_LONGS(nr)	(((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+/* Compiler and module glue */
+
+#define __init
+#define __exit
+#define __read_mostly
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define min(x, y)		((x) < (y) ? (x) : (y))
+#define max(x, y)		((x) > (y) ? (x) : (y))
+#define min_t(t, x, y)		((t)(x) < (t)(y) ? (t)(x) : (t)(y))
+#define max_t(t, x, y)		((t)(x) > (t)(y) ? (t)(x) : (t)(y))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define do_div(n, base)		({ u32 __rem = (n) % (base); (n) /= (base); __rem; })
+#define div_u64(n, d)		((u64)(n) / (d))
+#define div64_u64(n, d)		((u64)(n) / (d))
+#define div64_s64(n, d)		((s64)(n) / (s64)(d))
+
+struct module;
+#define THIS_MODULE		((struct module *)0)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+
+/*
+ * Initcalls become named globals so the simulator can pick the governor
+ * it wants to run and leave the others unregistered.
+ */
+#define module_init(fn)		int (*govsim_initcall_##fn)(void) = fn
+#define fs_initcall(fn)		module_init(fn)
+#define late_initcall(fn)	module_init(fn)
+#define module_exit(fn)		void (*govsim_exitcall_##fn)(void) = fn
+
+#define KERN_ERR		""
+#define KERN_WARNING		""
+#define KERN_INFO		""
+#define KERN_DEBUG		""
+#define printk(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_err(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_warning(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define pr_warn_once(fmt, ...)	({ static bool __w; if (!__w) { __w = true; pr_warn(fmt, ##__VA_ARGS__); } })
+#define pr_debug(fmt, ...)	do { } while (0)
+#define WARN_ON(x)		({ int __c = !!(x); if (__c) fprintf(stderr, "WARN_ON %s:%d\n", __FILE__, __LINE__); __c; })
+#define BUG_ON(x)		do { if (x) abort(); } while (0)
+#define IS_ERR(p)		((unsigned long)(p) >= (unsigned long)-4095)
+#define PTR_ERR(p)		((long)(p))
+#define ERR_PTR(e)		((void *)(long)(e))
+
+#define GFP_KERNEL		0
+#define kmalloc(s, f)		malloc(s)
+#define kzalloc(s, f)		calloc(1, s)
+#define kfree(p)		free(p)
+
+int strict_strtoul(const char *cp, unsigned int base, unsigned long *res);
+int strict_strtoull(const char *cp, unsigned int base, unsigned long long *res);
+
+/* Time */
+
+#define HZ			100
+#define MSEC_PER_SEC		1000L
+#define USEC_PER_MSEC		1000L
+#define USEC_PER_SEC		1000000L
+#define NSEC_PER_USEC		1000L
+
+extern volatile unsigned long jiffies;
+
+static inline u64 get_jiffies_64(void)
+{
+	return jiffies;
+}
+
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define time_after_eq(a, b)	((long)((a) - (b)) >= 0)
+#define time_before_eq(a, b)	time_after_eq(b, a)
+
+static inline unsigned long usecs_to_jiffies(unsigned int u)
+{
+	return (u + (USEC_PER_SEC / HZ) - 1) / (USEC_PER_SEC / HZ);
+}
+
+static inline unsigned long msecs_to_jiffies(unsigned int m)
+{
+	return usecs_to_jiffies(m * USEC_PER_MSEC);
+}
+
+static inline unsigned int jiffies_to_usecs(unsigned long j)
+{
+	return j * (USEC_PER_SEC / HZ);
+}
+
+#define jiffies64_to_cputime64(j)	((cputime64_t)(j))
+#define cputime64_to_jiffies64(c)	((u64)(c))
+#define cputime64_add(a, b)		((a) + (b))
+#define cputime64_sub(a, b)		((a) - (b))
+#define cputime_to_usecs(c)		jiffies_to_usecs(c)
+
+u64 ktime_to_us(u64 kt);
+u64 ktime_get(void);
+
+/* CPUs */
+
+typedef struct cpumask { unsigned long bits[1]; } cpumask_t;
+typedef struct cpumask cpumask_var_t[1];
+
+extern int govsim_ncpus;
+extern int govsim_this_cpu;
+
+#define cpumask_set_cpu(c, m)	((m)->bits[0] |= 1UL << (c))
+#define cpumask_clear_cpu(c, m)	((m)->bits[0] &= ~(1UL << (c)))
+#define cpumask_test_cpu(c, m)	(((m)->bits[0] >> (c)) & 1)
+#define cpumask_clear(m)	((m)->bits[0] = 0)
+#define cpumask_empty(m)	((m)->bits[0] == 0)
+#define cpumask_copy(d, s)	(*(d) = *(s))
+#define cpumask_first(m)	__builtin_ctzl((m)->bits[0])
+#define for_each_cpu(c, m) \
+	for ((c) = 0; (c) < NR_CPUS; (c)++) if (cpumask_test_cpu(c, m))
+#define for_each_online_cpu(c)	for ((c) = 0; (c) < govsim_ncpus; (c)++)
+#define for_each_possible_cpu(c) for_each_online_cpu(c)
+#define cpu_online(c)		((c) < govsim_ncpus)
+#define num_online_cpus()	govsim_ncpus
+#define smp_processor_id()	govsim_this_cpu
+#define get_cpu()		govsim_this_cpu
+#define put_cpu()		do { } while (0)
+
+#define DEFINE_PER_CPU(type, name)	__typeof__(type) name[NR_CPUS]
+#define per_cpu(var, cpu)		((var)[cpu])
+
+/* Locking; the simulator is single threaded */
+
+typedef struct { int v; } spinlock_t;
+typedef struct { int counter; } atomic_t;
+struct mutex { int v; };
+
+#define DEFINE_SPINLOCK(x)	spinlock_t x
+#define DEFINE_MUTEX(x)		struct mutex x
+#define ATOMIC_INIT(i)		{ (i) }
+#define spin_lock_init(l)	((void)(l))
+#define spin_lock(l)		((void)(l))
+#define spin_unlock(l)		((void)(l))
+#define spin_lock_irqsave(l, f)	((void)(l), (f) = 0)
+#define spin_unlock_irqrestore(l, f) ((void)(l), (void)(f))
+#define mutex_init(m)		((void)(m))
+#define mutex_destroy(m)	((void)(m))
+#define mutex_lock(m)		((void)(m))
+#define mutex_unlock(m)		((void)(m))
+#define smp_rmb()		do { } while (0)
+#define smp_wmb()		do { } while (0)
+#define smp_mb()		do { } while (0)
+#define atomic_read(a)		((a)->counter)
+#define atomic_set(a, i)	((a)->counter = (i))
+#define atomic_inc(a)		((a)->counter++)
+#define atomic_dec(a)		((a)->counter--)
+#define atomic_inc_return(a)	(++(a)->counter)
+#define atomic_dec_return(a)	(--(a)->counter)
+
+/* Timers */
+
+struct timer_list {
+	unsigned long expires;
+	void (*function)(unsigned long);
+	unsigned long data;
+	int cpu;
+	int pending;
+};
+
+#define init_timer(t)		((t)->pending = 0)
+#define init_timer_deferrable(t) init_timer(t)
+#define setup_timer(t, fn, d) \
+	do { init_timer(t); (t)->function = (fn); (t)->data = (d); } while (0)
+#define timer_pending(t)	((t)->pending)
+int mod_timer(struct timer_list *timer, unsigned long expires);
+void add_timer_on(struct timer_list *timer, int cpu);
+int del_timer(struct timer_list *timer);
+#define del_timer_sync(t)	del_timer(t)
+
+/* Workqueues */
+
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+	int pending;
+};
+
+struct delayed_work {
+	struct work_struct work;
+	struct timer_list timer;
+};
+
+struct workqueue_struct { const char *name; };
+
+#define INIT_WORK(w, f)		do { (w)->func = (f); (w)->pending = 0; } while (0)
+#define INIT_DELAYED_WORK(w, f) \
+	do { INIT_WORK(&(w)->work, f); init_timer(&(w)->timer); } while (0)
+#define INIT_DELAYED_WORK_DEFERRABLE(w, f) INIT_DELAYED_WORK(w, f)
+#define WQ_HIGHPRI		0
+#define WQ_UNBOUND		0
+#define WQ_NON_REENTRANT	0
+#define WQ_FREEZABLE		0
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags,
+					 int max_active);
+#define create_workqueue(n)	alloc_workqueue(n, 0, 0)
+#define create_singlethread_workqueue(n) alloc_workqueue(n, 0, 1)
+void destroy_workqueue(struct workqueue_struct *wq);
+int queue_work(struct workqueue_struct *wq, struct work_struct *work);
+#define schedule_work(w)	queue_work(NULL, w)
+bool flush_work(struct work_struct *work);
+int schedule_delayed_work_on(int cpu, struct delayed_work *dwork,
+			     unsigned long delay);
+#define queue_delayed_work(wq, dw, d) \
+	schedule_delayed_work_on(govsim_this_cpu, dw, d)
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+#define cancel_delayed_work(dw)	cancel_delayed_work_sync(dw)
+
+/* Tasks; kernel threads run as coroutines inside the simulator */
+
+#define TASK_RUNNING		0
+#define TASK_INTERRUPTIBLE	1
+#define SCHED_FIFO		1
+#define MAX_RT_PRIO		100
+
+struct task_struct;
+struct sched_param { int sched_priority; };
+
+extern struct task_struct *govsim_current;
+
+struct task_struct *kthread_create(int (*fn)(void *data), void *data,
+				   const char *name, ...);
+int kthread_stop(struct task_struct *task);
+bool kthread_should_stop(void);
+int wake_up_process(struct task_struct *task);
+void schedule(void);
+void __set_current_state(long state);
+#define set_current_state(s)	__set_current_state(s)
+#define get_task_struct(t)	do { } while (0)
+#define put_task_struct(t)	do { } while (0)
+
+static inline int sched_setscheduler_nocheck(struct task_struct *t, int policy,
+					     const struct sched_param *sp)
+{
+	return 0;
+}
+
+/* Notifiers */
+
+struct notifier_block {
+	int (*notifier_call)(struct notifier_block *nb, unsigned long val,
+			     void *data);
+	struct notifier_block *next;
+	int priority;
+};
+
+#define NOTIFY_DONE		0
+#define NOTIFY_OK		1
+#define IDLE_START		1
+#define IDLE_END		2
+
+void idle_notifier_register(struct notifier_block *n);
+void idle_notifier_unregister(struct notifier_block *n);
+
+/* Idle and busy time accounting, fed by the simulated load */
+
+u64 get_cpu_idle_time_us(int cpu, u64 *last_update_time);
+u64 get_cpu_iowait_time_us(int cpu, u64 *last_update_time);
+
+struct cpu_usage_stat {
+	cputime64_t user;
+	cputime64_t nice;
+	cputime64_t system;
+	cputime64_t softirq;
+	cputime64_t irq;
+	cputime64_t idle;
+	cputime64_t iowait;
+	cputime64_t steal;
+	cputime64_t guest;
+	cputime64_t guest_nice;
+};
+
+struct kernel_stat {
+	struct cpu_usage_stat cpustat;
+};
+
+extern struct kernel_stat govsim_kstat[NR_CPUS];
+#define kstat_cpu(cpu)		(govsim_kstat[cpu])
+
+/* sysfs */
+
+#define S_IRUGO			0444
+#define S_IWUSR			0200
+
+struct kobject { const char *name; };
+
+struct attribute {
+	const char *name;
+	unsigned short mode;
+};
+
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+};
+
+struct global_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct kobject *kobj, struct attribute *attr,
+			char *buf);
+	ssize_t (*store)(struct kobject *a, struct attribute *b,
+			 const char *c, size_t count);
+};
+
+#define __ATTR(_name, _mode, _show, _store) \
+	{ .attr = { .name = #_name, .mode = _mode }, \
+	  .show = _show, .store = _store }
+
+#define define_one_global_ro(_name)		\
+static struct global_attr _name =		\
+__ATTR(_name, 0444, show_##_name, NULL)
+
+#define define_one_global_rw(_name)		\
+static struct global_attr _name =		\
+__ATTR(_name, 0644, show_##_name, store_##_name)
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj,
+			const struct attribute_group *grp);
+
+/* cpufreq core */
+
+#define CPUFREQ_ETERNAL			(-1)
+#define CPUFREQ_NAME_LEN		16
+#define CPUFREQ_ENTRY_INVALID		~0
+#define CPUFREQ_TABLE_END		~1
+#define CPUFREQ_RELATION_L		0
+#define CPUFREQ_RELATION_H		1
+#define CPUFREQ_GOV_START		1
+#define CPUFREQ_GOV_STOP		2
+#define CPUFREQ_GOV_LIMITS		3
+#define CPUFREQ_TRANSITION_NOTIFIER	0
+#define CPUFREQ_POLICY_NOTIFIER		1
+#define CPUFREQ_ADJUST			0
+#define CPUFREQ_INCOMPATIBLE		1
+#define CPUFREQ_NOTIFY			2
+
+struct cpufreq_cpuinfo {
+	unsigned int max_freq;
+	unsigned int min_freq;
+	unsigned int transition_latency;
+};
+
+struct cpufreq_governor;
+
+struct cpufreq_policy {
+	cpumask_var_t cpus;
+	cpumask_var_t related_cpus;
+	unsigned int shared_type;
+	unsigned int cpu;
+	struct cpufreq_cpuinfo cpuinfo;
+	unsigned int min;
+	unsigned int max;
+	unsigned int cur;
+	struct cpufreq_governor *governor;
+	struct kobject kobj;
+};
+
+struct cpufreq_governor {
+	char name[CPUFREQ_NAME_LEN];
+	int (*governor)(struct cpufreq_policy *policy, unsigned int event);
+	unsigned int max_transition_latency;
+	struct module *owner;
+	struct cpufreq_governor *next;
+};
+
+struct cpufreq_frequency_table {
+	unsigned int index;
+	unsigned int frequency;
+};
+
+extern struct kobject *cpufreq_global_kobject;
+
+int cpufreq_register_governor(struct cpufreq_governor *governor);
+void cpufreq_unregister_governor(struct cpufreq_governor *governor);
+int __cpufreq_driver_target(struct cpufreq_policy *policy,
+			    unsigned int target_freq, unsigned int relation);
+int __cpufreq_driver_getavg(struct cpufreq_policy *policy, unsigned int cpu);
+int cpufreq_frequency_table_target(struct cpufreq_policy *policy,
+				   struct cpufreq_frequency_table *table,
+				   unsigned int target_freq,
+				   unsigned int relation, unsigned int *index);
+struct cpufreq_frequency_table *cpufreq_frequency_get_table(unsigned int cpu);
+struct cpufreq_policy *cpufreq_cpu_get(unsigned int cpu);
+void cpufreq_cpu_put(struct cpufreq_policy *policy);
+int cpufreq_update_policy(unsigned int cpu);
+int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list);
+int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list);
+void cpufreq_frequency_table_put_attr(unsigned int cpu);
+
+static inline void cpufreq_verify_within_limits(struct cpufreq_policy *policy,
+						unsigned int min,
+						unsigned int max)
+{
+	if (policy->min < min)
+		policy->min = min;
+	if (policy->max < min)
+		policy->max = min;
+	if (policy->min > max)
+		policy->min = max;
+	if (policy->max > max)
+		policy->max = max;
+	if (policy->min > policy->max)
+		policy->min = policy->max;
+}
+
+/* Input; the simulator injects touch events from the trace */
+
+#define EV_SYN			0x00
+#define EV_KEY			0x01
+#define EV_ABS			0x03
+#define BTN_TOUCH		0x14a
+#define KEY_CNT			0x300
+#define ABS_X			0x00
+#define ABS_Y			0x01
+#define ABS_MT_POSITION_X	0x35
+#define ABS_MT_POSITION_Y	0x36
+#define ABS_CNT			0x40
+#define EV_CNT			0x20
+
+#define INPUT_DEVICE_ID_MATCH_EVBIT	0x0010
+#define INPUT_DEVICE_ID_MATCH_KEYBIT	0x0020
+#define INPUT_DEVICE_ID_MATCH_ABSBIT	0x0080
+
+struct input_device_id {
+	unsigned long flags;
+	unsigned long evbit[BITS_TO_LONGS(EV_CNT)];
+	unsigned long keybit[BITS_TO_LONGS(KEY_CNT)];
+	unsigned long absbit[BITS_TO_LONGS(ABS_CNT)];
+	unsigned long driver_info;
+};
+
+struct input_dev { const char *name; };
+struct input_handler;
+
+struct input_handle {
+	void *private;
+	const char *name;
+	struct input_dev *dev;
+	struct input_handler *handler;
+};
+
+struct input_handler {
+	void (*event)(struct input_handle *handle, unsigned int type,
+		      unsigned int code, int value);
+	int (*connect)(struct input_handler *handler, struct input_dev *dev,
+		       const struct input_device_id *id);
+	void (*disconnect)(struct input_handle *handle);
+	const char *name;
+	const struct input_device_id *id_table;
+};
+
+int input_register_handler(struct input_handler *handler);
+void input_unregister_handler(struct input_handler *handler);
+int input_register_handle(struct input_handle *handle);
+void input_unregister_handle(struct input_handle *handle);
+int input_open_device(struct input_handle *handle);
+void input_close_device(struct input_handle *handle);
+
+/* Tracepoints are routed to the simulator's event log */
+
+void govsim_trace_loadeval(const char *event, unsigned long cpu,
+			   unsigned long load, unsigned long curtarg,
+			   unsigned long curactual, unsigned long newtarg);
+void govsim_trace_setspeed(u32 cpu, unsigned long targfreq,
+			   unsigned long actualfreq);
+void govsim_trace_boost(const char *s);
+
+#define trace_cpufreq_interactive_target(c, l, t, a, n) \
+	govsim_trace_loadeval("target", c, l, t, a, n)
+#define trace_cpufreq_interactive_already(c, l, t, a, n) \
+	govsim_trace_loadeval("already", c, l, t, a, n)
+#define trace_cpufreq_interactive_notyet(c, l, t, a, n) \
+	govsim_trace_loadeval("notyet", c, l, t, a, n)
+#define trace_cpufreq_interactive_boosted(c, l, t, a, n) \
+	govsim_trace_loadeval("boosted", c, l, t, a, n)
+#define trace_cpufreq_interactive_setspeed(c, t, a) \
+	govsim_trace_setspeed(c, t, a)
+#define trace_cpufreq_interactive_boost(s) \
+	govsim_trace_boost(s)
+
+#endif /* _GOVSIM_KSHIM_H */
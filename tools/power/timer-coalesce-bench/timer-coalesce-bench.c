@@ -0,0 +1,267 @@
+/*
+ * timer-coalesce-bench - count idle wakeups caused by periodic timers
+ *
+ * Runs a set of periodic timers, one thread each, with periods chosen so
+ * that they rarely line up by themselves, and reports how often the CPUs
+ * came out of idle while they ran.  The idle wakeups are the idle_sleeps
+ * counters of /proc/timer_list, summed over all CPUs.  With -c the run is
+ * repeated for each given value of /proc/sys/kernel/timer_coalesce_us,
+ * which is restored afterwards, so the effect of coalescing can be read
+ * off one table.  The timers are hrtimers, so they only coalesce within
+ * their slack; -s sets it for all of them.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef PR_SET_TIMERSLACK
+#define PR_SET_TIMERSLACK 29
+#endif
+
+#define MAX_TIMERS	64
+#define MAX_RUNS	16
+
+static const char *progname;
+static const char *coalesce_path = "/proc/sys/kernel/timer_coalesce_us";
+static unsigned int nr_timers = 8;
+static unsigned long base_us = 10000;
+static unsigned long step_us = 3700;
+static unsigned long slack_us;
+static unsigned int seconds = 10;
+
+static volatile int stop;
+
+struct bench_timer {
+	pthread_t thread;
+	unsigned long period_us;
+	unsigned long expiries;
+	unsigned long long late_ns;
+	unsigned long long max_late_ns;
+};
+
+static struct bench_timer timers[MAX_TIMERS];
+
+static void die(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"Usage: %s [-n timers] [-p period_us] [-i step_us] [-s slack_us]\n"
+"       [-t seconds] [-c coalesce_us[,coalesce_us...]]\n"
+"\n"
+"  -n  number of periodic timers (default 8, at most %d)\n"
+"  -p  period of the first timer (default 10000)\n"
+"  -i  each further timer's period is this much longer (default 3700)\n"
+"  -s  timer slack of every timer, in us (default: leave as is)\n"
+"  -t  length of each run (default 10)\n"
+"  -c  run once for each timer_coalesce_us value (default: one run,\n"
+"      current setting)\n",
+		progname, MAX_TIMERS);
+	exit(1);
+}
+
+static unsigned long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void ts_add_us(struct timespec *ts, unsigned long us)
+{
+	ts->tv_nsec += (us % 1000000) * 1000;
+	ts->tv_sec += us / 1000000 + ts->tv_nsec / 1000000000;
+	ts->tv_nsec %= 1000000000;
+}
+
+static void *timer_thread(void *arg)
+{
+	struct bench_timer *t = arg;
+	struct timespec next, now;
+	unsigned long long late;
+
+	if (slack_us && prctl(PR_SET_TIMERSLACK, slack_us * 1000UL, 0, 0, 0))
+		die("PR_SET_TIMERSLACK: %s\n", strerror(errno));
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		ts_add_us(&next, t->period_us);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				       NULL) == EINTR)
+			;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		late = ts_ns(&now) > ts_ns(&next) ?
+			ts_ns(&now) - ts_ns(&next) : 0;
+		t->expiries++;
+		t->late_ns += late;
+		if (late > t->max_late_ns)
+			t->max_late_ns = late;
+	}
+	return NULL;
+}
+
+/* Sum of the idle_sleeps counters of all CPUs */
+static unsigned long long idle_sleeps(void)
+{
+	unsigned long long total = 0, n;
+	char line[256];
+	FILE *f;
+
+	f = fopen("/proc/timer_list", "r");
+	if (!f)
+		die("/proc/timer_list: %s\n", strerror(errno));
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, " .idle_sleeps : %llu", &n) == 1)
+			total += n;
+	fclose(f);
+	return total;
+}
+
+static long read_coalesce(void)
+{
+	long val = -1;
+	FILE *f;
+
+	f = fopen(coalesce_path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static void write_coalesce(long val)
+{
+	FILE *f;
+
+	f = fopen(coalesce_path, "w");
+	if (!f)
+		die("%s: %s\n", coalesce_path, strerror(errno));
+	fprintf(f, "%ld\n", val);
+	if (fclose(f))
+		die("%s: %s\n", coalesce_path, strerror(errno));
+}
+
+static void run(long coalesce)
+{
+	unsigned long long sleeps, expiries = 0, late = 0, max_late = 0;
+	struct timespec start, end;
+	double elapsed;
+	unsigned int i;
+	int err;
+
+	if (coalesce >= 0)
+		write_coalesce(coalesce);
+
+	stop = 0;
+	memset(timers, 0, sizeof(timers));
+	for (i = 0; i < nr_timers; i++)
+		timers[i].period_us = base_us + i * step_us;
+
+	sleeps = idle_sleeps();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nr_timers; i++) {
+		err = pthread_create(&timers[i].thread, NULL, timer_thread,
+				     &timers[i]);
+		if (err)
+			die("pthread_create: %s\n", strerror(err));
+	}
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nr_timers; i++)
+		pthread_join(timers[i].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sleeps = idle_sleeps() - sleeps;
+	elapsed = (ts_ns(&end) - ts_ns(&start)) / 1e9;
+
+	for (i = 0; i < nr_timers; i++) {
+		expiries += timers[i].expiries;
+		late += timers[i].late_ns;
+		if (timers[i].max_late_ns > max_late)
+			max_late = timers[i].max_late_ns;
+	}
+
+	printf("%11ld %12.1f %15.1f %11.1f %11.1f\n",
+	       coalesce >= 0 ? coalesce : read_coalesce(),
+	       expiries / elapsed, sleeps / elapsed,
+	       expiries ? late / 1e3 / expiries : 0.0, max_late / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+	long values[MAX_RUNS], saved;
+	unsigned int nr_values = 0, i;
+	char *p;
+	int opt;
+
+	progname = argv[0];
+	while ((opt = getopt(argc, argv, "n:p:i:s:t:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_timers = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			base_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			step_us = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			slack_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			for (p = strtok(optarg, ","); p && nr_values < MAX_RUNS;
+			     p = strtok(NULL, ","))
+				values[nr_values++] = strtol(p, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || !nr_timers || nr_timers > MAX_TIMERS ||
+	    !base_us || !seconds)
+		usage();
+
+	printf("%u timers, periods %lu us + n * %lu us, slack %s%lu us\n",
+	       nr_timers, base_us, step_us, slack_us ? "" : "default ",
+	       slack_us ? slack_us : 50);
+	printf("%11s %12s %15s %11s %11s\n", "coalesce_us", "expiries/s",
+	       "idle wakeups/s", "avg late us", "max late us");
+
+	if (!nr_values) {
+		run(-1);
+		return 0;
+	}
+
+	saved = read_coalesce();
+	if (saved < 0)
+		die("%s: not available\n", coalesce_path);
+	for (i = 0; i < nr_values; i++)
+		run(values[i]);
+	write_coalesce(saved);
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * wakelock-bench - measure the userspace wake_lock/wake_unlock rate
+ *
+ * Takes and releases a set of wake locks through /sys/power/wake_lock
+ * and /sys/power/wake_unlock as fast as possible, the way chatty
+ * services do, and reports the achieved rate and the time per call.
+ * Several worker processes can hammer the interface at once to show
+ * contention.  The locks are named "wakelock_bench_<n>" and are left
+ * unlocked on exit; user wake locks are never freed by the kernel, so
+ * the same names are reused between runs.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *progname;
+static const char *sysfs = "/sys/power";
+static unsigned int nr_names = 16;
+static unsigned long iterations = 100000;
+static unsigned int nr_workers = 1;
+static unsigned long long timeout_ns;
+
+static void die(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"Usage: %s [-n names] [-i iterations] [-p workers] [-t timeout_ns]\n"
+"       [-d dir]\n"
+"\n"
+"  -n  number of distinct lock names per worker (default 16)\n"
+"  -i  lock/unlock pairs per worker (default 100000)\n"
+"  -p  worker processes running at once (default 1)\n"
+"  -t  take the locks with this timeout, in ns\n"
+"  -d  directory holding wake_lock and wake_unlock (default /sys/power)\n",
+		progname);
+	exit(1);
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int open_attr(const char *name)
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs, name);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		die("%s: %s\n", path, strerror(errno));
+	return fd;
+}
+
+static void put(int fd, const char *buf, size_t len)
+{
+	if (pwrite(fd, buf, len, 0) != (ssize_t)len)
+		die("write '%.*s': %s\n", (int)len, buf, strerror(errno));
+}
+
+static void worker(unsigned int id)
+{
+	char (*lock_cmd)[64], (*unlock_cmd)[64];
+	size_t *lock_len, *unlock_len;
+	int lock_fd, unlock_fd;
+	unsigned long i;
+	unsigned int n;
+
+	lock_cmd = calloc(nr_names, sizeof(*lock_cmd));
+	unlock_cmd = calloc(nr_names, sizeof(*unlock_cmd));
+	lock_len = calloc(nr_names, sizeof(*lock_len));
+	unlock_len = calloc(nr_names, sizeof(*unlock_len));
+	if (!lock_cmd || !unlock_cmd || !lock_len || !unlock_len)
+		die("out of memory\n");
+
+	for (n = 0; n < nr_names; n++) {
+		unsigned int lock = id * nr_names + n;
+
+		unlock_len[n] = snprintf(unlock_cmd[n], sizeof(unlock_cmd[n]),
+					 "wakelock_bench_%u", lock);
+		if (timeout_ns)
+			lock_len[n] = snprintf(lock_cmd[n],
+					       sizeof(lock_cmd[n]),
+					       "wakelock_bench_%u %llu", lock,
+					       timeout_ns);
+		else
+			lock_len[n] = snprintf(lock_cmd[n],
+					       sizeof(lock_cmd[n]),
+					       "wakelock_bench_%u", lock);
+	}
+
+	lock_fd = open_attr("wake_lock");
+	unlock_fd = open_attr("wake_unlock");
+	for (i = 0; i < iterations; i++) {
+		n = i % nr_names;
+		put(lock_fd, lock_cmd[n], lock_len[n]);
+		put(unlock_fd, unlock_cmd[n], unlock_len[n]);
+	}
+	close(lock_fd);
+	close(unlock_fd);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int w, failed = 0;
+	double start, elapsed, ops;
+	int opt, status;
+	pid_t pid;
+
+	progname = argv[0];
+	while ((opt = getopt(argc, argv, "n:i:p:t:d:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_names = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			nr_workers = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout_ns = strtoull(optarg, NULL, 0);
+			break;
+		case 'd':
+			sysfs = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || !nr_names || !iterations || !nr_workers)
+		usage();
+
+	start = now_sec();
+	for (w = 0; w < nr_workers; w++) {
+		pid = fork();
+		if (pid < 0)
+			die("fork: %s\n", strerror(errno));
+		if (!pid) {
+			worker(w);
+			exit(0);
+		}
+	}
+	while (wait(&status) > 0)
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed++;
+	elapsed = now_sec() - start;
+	if (failed)
+		die("%u of %u workers failed\n", failed, nr_workers);
+
+	ops = 2.0 * iterations * nr_workers;
+	printf("workers      %u\n", nr_workers);
+	printf("locks        %u per worker%s\n", nr_names,
+	       timeout_ns ? ", with timeout" : "");
+	printf("calls        %.0f in %.3f s\n", ops, elapsed);
+	printf("rate         %.0f calls/s\n", ops / elapsed);
+	printf("per call     %.2f us (wall time / calls per worker)\n",
+	       elapsed * 1e6 * nr_workers / ops);
+	return 0;
+}
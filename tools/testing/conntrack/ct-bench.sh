@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Forwarding rate through the NAT path as the number of tracked flows
+# grows.  Three network namespaces stand in for a tethered client, the
+# tablet and the upstream network: the client floods UDP over many
+# flows (ct-flood), the router namespace forwards and masquerades it,
+# and the server namespace answers each flow once (ct-flood -e) so that
+# its conntrack entry is established.  The rate is what the router's
+# upstream veth transmitted.  Runs under QEMU as well as on the device.
+#
+#	ct-bench.sh [flows...]
+#
+# The flow counts default to "16 256 4096 16384".  These environment
+# variables set up the runs:
+#
+#	TIME	seconds per run (default 10)
+#	RULES	filler rules in the router's FORWARD chain (default 50),
+#		standing in for netd's per-app chains
+#	FLOOD	path to ct-flood (default ./ct-flood)
+#
+# Each flow count is run with and without the filter table's conntrack
+# fast path; both show the forwarded packets per second, the conntrack
+# buckets at the end of the run, and how many chain entries lookups
+# stepped over per entry found (/proc/net/stat/nf_conntrack).  Run it
+# as root.
+#
+
+TIME=${TIME:-10}
+RULES=${RULES:-50}
+FLOOD=${FLOOD:-./ct-flood}
+FLOWS=${*:-"16 256 4096 16384"}
+
+CLIENT=ct-client
+ROUTER=ct-router
+SERVER=ct-server
+FASTPATH=/sys/module/iptable_filter/parameters/ct_fastpath
+
+[ -x "$FLOOD" ] || { echo "build $FLOOD first" >&2; exit 1; }
+OLD_FASTPATH=$(cat $FASTPATH) || exit 1
+
+cleanup() {
+	echo $OLD_FASTPATH > $FASTPATH
+	ip netns del $CLIENT 2>/dev/null
+	ip netns del $ROUTER 2>/dev/null
+	ip netns del $SERVER 2>/dev/null
+}
+trap cleanup EXIT
+
+for ns in $CLIENT $ROUTER $SERVER; do
+	ip netns add $ns || exit 1
+	ip netns exec $ns ip link set lo up
+done
+
+ip link add ctc0 netns $CLIENT type veth peer name ctr0 netns $ROUTER || exit 1
+ip link add cts0 netns $SERVER type veth peer name ctr1 netns $ROUTER || exit 1
+
+ip netns exec $CLIENT ip addr add 192.168.42.2/24 dev ctc0
+ip netns exec $CLIENT ip link set ctc0 up
+ip netns exec $CLIENT ip route add default via 192.168.42.1
+# the answers have no socket to go to, don't send port unreachables
+ip netns exec $CLIENT iptables -A INPUT -p udp -j DROP
+
+ip netns exec $ROUTER ip addr add 192.168.42.1/24 dev ctr0
+ip netns exec $ROUTER ip addr add 10.45.0.1/24 dev ctr1
+ip netns exec $ROUTER ip link set ctr0 up
+ip netns exec $ROUTER ip link set ctr1 up
+ip netns exec $ROUTER sh -c "echo 1 > /proc/sys/net/ipv4/ip_forward"
+ip netns exec $ROUTER iptables -t nat -A POSTROUTING -o ctr1 -j MASQUERADE ||
+	exit 1
+# rules that never match, walked by every packet without the fast path
+i=0
+while [ $i -lt $RULES ]; do
+	ip netns exec $ROUTER iptables -A FORWARD -i ctr0 -p tcp \
+		--dport $((20000 + i)) -j DROP
+	i=$((i + 1))
+done
+
+ip netns exec $SERVER ip addr add 10.45.0.2/24 dev cts0
+ip netns exec $SERVER ip link set cts0 up
+
+tx_packets() {
+	ip netns exec $ROUTER cat /sys/class/net/ctr1/statistics/tx_packets
+}
+
+# sum one column of /proc/net/stat/nf_conntrack over the CPUs
+ct_stat() {
+	ip netns exec $ROUTER awk -v col=$1 '
+		NR == 1 { for (i = 1; i <= NF; i++) if ($i == col) c = i; next }
+		{
+			n = 0
+			for (i = 1; i <= length($c); i++)
+				n = n * 16 + index("0123456789abcdef",
+						    substr($c, i, 1)) - 1
+			sum += n
+		}
+		END { print sum }' /proc/net/stat/nf_conntrack
+}
+
+# run flows, fast path on or off
+run() {
+	echo $2 > $FASTPATH
+	ip netns exec $ROUTER conntrack -F >/dev/null 2>&1
+	before=$(tx_packets)
+	searched=$(ct_stat searched)
+	found=$(ct_stat found)
+	ip netns exec $SERVER $FLOOD -e -t $((TIME + 2)) >/dev/null &
+	ECHO=$!
+	sleep 1
+	ip netns exec $CLIENT $FLOOD -f $1 -t $TIME 10.45.0.2 >/dev/null
+	wait $ECHO
+	after=$(tx_packets)
+	searched=$(( $(ct_stat searched) - searched ))
+	found=$(( $(ct_stat found) - found ))
+	printf "%6d flows  fastpath %d  %8d pps  %6d buckets  %s searched/found\n" \
+		$1 $2 $(( (after - before) / TIME )) \
+		$(ip netns exec $ROUTER cat /proc/sys/net/netfilter/nf_conntrack_buckets) \
+		$(awk -v s=$searched -v f=$found 'BEGIN { printf "%.2f", f ? s / f : 0 }')
+}
+
+echo "$RULES FORWARD rules, ${TIME}s per run"
+for f in $FLOWS; do
+	run $f 0
+	run $f 1
+done
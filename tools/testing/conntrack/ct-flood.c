@@ -0,0 +1,182 @@
+/*
+ * ct-flood - send small UDP packets spread over many flows
+ *
+ * Every source port is a flow of its own for connection tracking; the
+ * sender cycles through the range so that all flows stay alive, and a
+ * raw socket lets it use any number of ports without a socket each.
+ * With enough flows every packet takes a conntrack lookup in a hash
+ * table holding that many entries, which is what a hotspot sees from
+ * its tethered clients.  Run with -e on the far side, it answers the
+ * first packet of each flow, so conntrack sees the flows established
+ * as it would real ones.  ct-bench.sh counts what got forwarded.
+ *
+ *	ct-flood [-f flows] [-b base_port] [-p port] [-s size] [-t seconds] addr
+ *	ct-flood -e [-p port] [-t seconds]
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *progname;
+static unsigned int nr_flows = 1024;
+static unsigned int base_port = 10000;
+static unsigned int port = 5001;
+static unsigned int seconds = 10;
+static unsigned int size = 64;
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: %s [-f flows] [-b base_port] [-p port] [-s size] [-t seconds] addr\n"
+		"       %s -e [-p port] [-t seconds]\n",
+		progname, progname);
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* answer the first packet from each source port, for a while */
+static int echo(void)
+{
+	static unsigned char seen[65536 / 8];
+	struct sockaddr_in sin;
+	struct timeval tv = { .tv_sec = 1 };
+	socklen_t len;
+	unsigned int sport, replies = 0;
+	double end = now() + seconds;
+	char buf[2048];
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror(progname);
+		return 1;
+	}
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+		perror(progname);
+		return 1;
+	}
+
+	while (now() < end) {
+		len = sizeof(sin);
+		if (recvfrom(fd, buf, sizeof(buf), 0,
+			     (struct sockaddr *)&sin, &len) < 0)
+			continue;
+		sport = ntohs(sin.sin_port);
+		if (seen[sport / 8] & (1 << (sport % 8)))
+			continue;
+		seen[sport / 8] |= 1 << (sport % 8);
+		sendto(fd, buf, 1, 0, (struct sockaddr *)&sin, len);
+		replies++;
+	}
+	printf("%u flows answered\n", replies);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in sin;
+	struct udphdr *uh;
+	unsigned long sent = 0, failed = 0;
+	unsigned int flow = 0;
+	double start, end;
+	int do_echo = 0;
+	char *buf;
+	int fd, c;
+
+	progname = argv[0];
+	while ((c = getopt(argc, argv, "b:ef:p:s:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			base_port = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			do_echo = 1;
+			break;
+		case 'f':
+			nr_flows = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (do_echo)
+		return echo();
+
+	if (optind != argc - 1 || !nr_flows || base_port + nr_flows > 65536 ||
+	    size < sizeof(*uh) || size > 1472)
+		usage();
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	if (inet_pton(AF_INET, argv[optind], &sin.sin_addr) != 1)
+		usage();
+
+	buf = calloc(1, size);
+	fd = socket(AF_INET, SOCK_RAW, IPPROTO_UDP);
+	if (!buf || fd < 0) {
+		perror(progname);
+		return 1;
+	}
+	/* no checksum, which IPv4 allows */
+	uh = (struct udphdr *)buf;
+	uh->dest = htons(port);
+	uh->len = htons(size);
+
+	start = now();
+	end = start + seconds;
+	while (1) {
+		/* check the clock every 1024 packets */
+		if (!(sent & 1023) && now() >= end)
+			break;
+		uh->source = htons(base_port + flow);
+		if (++flow == nr_flows)
+			flow = 0;
+		if (sendto(fd, buf, size, 0, (struct sockaddr *)&sin,
+			   sizeof(sin)) < 0) {
+			if (errno != ENOBUFS && errno != EAGAIN) {
+				perror("sendto");
+				return 1;
+			}
+			failed++;
+		}
+		sent++;
+	}
+	end = now();
+
+	printf("%u flows: %lu packets in %.1fs, %.0f pps sent, %lu failed\n",
+	       nr_flows, sent, end - start, sent / (end - start), failed);
+	return 0;
+}
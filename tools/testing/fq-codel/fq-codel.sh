@@ -0,0 +1,99 @@
+#!/bin/sh
+#
+# Latency under load and throughput fairness of the qdisc in front of a
+# slow uplink.  A veth pair joins this namespace to a peer namespace;
+# htb shapes our side to a Wi-Fi like rate, so the queue builds in the
+# leaf qdisc under test, and netem on the peer's side adds the path
+# delay to the returning ACKs and echo replies.  Runs under QEMU as well
+# as on the device.
+#
+#	fq-codel.sh [qdisc...]
+#
+# The qdiscs default to "pfifo fq_codel"; pfifo gets a limit of
+# tx_queue_len packets like pfifo_fast.  These environment variables set
+# up the link and the runs:
+#
+#	RATE	link rate (default 8mbit)
+#	DELAY	one way delay added by netem (default 20ms)
+#	FLOWS	parallel upload flows (default 4)
+#	TIME	seconds per run (default 20)
+#
+# Each run reports the RTT of pings sent every 100ms while the uploads
+# run, the uploads' total throughput and Jain's fairness index over the
+# per-flow throughputs (1.0 is an even share).
+#
+
+RATE=${RATE:-8mbit}
+DELAY=${DELAY:-20ms}
+FLOWS=${FLOWS:-4}
+TIME=${TIME:-20}
+QDISCS=${*:-"pfifo fq_codel"}
+
+NS=fq-codel
+IF=fqc0
+PEER_IF=fqc1
+IP=10.44.0.1
+PEER_IP=10.44.0.2
+OUT=/tmp/fq-codel.$$
+
+cleanup() {
+	[ -n "$SERVER" ] && kill $SERVER 2>/dev/null
+	rm -f $OUT
+	ip link del $IF 2>/dev/null
+	ip netns del $NS 2>/dev/null
+}
+trap cleanup EXIT
+
+ip netns add $NS || exit 1
+ip link add $IF type veth peer name $PEER_IF || exit 1
+ip link set $PEER_IF netns $NS
+ip addr add $IP/24 dev $IF
+ip link set $IF up
+ip netns exec $NS ip addr add $PEER_IP/24 dev $PEER_IF
+ip netns exec $NS ip link set $PEER_IF up
+ip netns exec $NS tc qdisc add dev $PEER_IF root netem delay $DELAY || exit 1
+
+tc qdisc add dev $IF root handle 1: htb default 1 || exit 1
+tc class add dev $IF parent 1: classid 1:1 htb rate $RATE || exit 1
+
+ip netns exec $NS iperf -s >/dev/null 2>&1 &
+SERVER=$!
+sleep 1
+
+run() {
+	case $1 in
+	pfifo)	tc qdisc replace dev $IF parent 1:1 handle 10: pfifo \
+			limit $(cat /sys/class/net/$IF/tx_queue_len) ;;
+	*)	tc qdisc replace dev $IF parent 1:1 handle 10: $1 ;;
+	esac || return
+	printf "%-10s" "$1"
+
+	iperf -c $PEER_IP -t $TIME -P $FLOWS -f k > $OUT 2>&1 &
+	BULK=$!
+	sleep 2
+	ping -q -i 0.1 -c $(( (TIME - 3) * 10 )) $PEER_IP |
+		awk -F/ '/^rtt|^round-trip/ { printf "  rtt avg %s max %s ms", $5, $7 }'
+	wait $BULK
+
+	# per-flow lines look like "[  3]  0.0-20.0 sec  4736 KBytes  1937 Kbits/sec"
+	awk '/Kbits\/sec/ && !/SUM/ {
+		x = $(NF-1); n++; sum += x; sq += x * x
+	}
+	END {
+		if (n && sq)
+			printf "  upload %d Kbits/sec  fairness %.3f (%d flows)\n",
+				sum, sum * sum / (n * sq), n
+		else
+			printf "  no result\n"
+	}' $OUT
+	tc -s qdisc show dev $IF parent 1:1 | awk '/dropped/ { print "          " $0 }'
+}
+
+echo "rate $RATE, delay $DELAY, $FLOWS flows"
+printf "%-10s" "idle"
+ping -q -i 0.1 -c 20 $PEER_IP |
+	awk -F/ '/^rtt|^round-trip/ { printf "  rtt avg %s max %s ms\n", $5, $7 }'
+
+for q in $QDISCS; do
+	run $q
+done
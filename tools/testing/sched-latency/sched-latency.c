@@ -0,0 +1,260 @@
+/*
+ * sched-latency - wakeup-to-run latency of a periodic task under load
+ *
+ * Emulates a frame-driven thread (a compositor or an audio mixer): it
+ * wakes up every period, burns a fixed amount of CPU and goes back to
+ * sleep, while background processes keep the CPU busy.  Everything is
+ * pinned to one CPU so the run is the same on SMP hosts and in QEMU.
+ * Prints a histogram of the delay between the programmed wakeup and the
+ * moment the thread actually ran, and how many frames finished after the
+ * next period had already begun.  Run it once with and once without
+ * -l to see what a latency nice value buys.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef PR_SET_LATENCY_NICE
+#define PR_SET_LATENCY_NICE	0x4c4e4901
+#endif
+
+#define NR_BUCKETS	20	/* < 1us, < 2us, ... < 256ms, more */
+
+static const char *progname;
+static unsigned int nr_hogs = 2;
+static unsigned long period_us = 16667;
+static unsigned long work_us = 2000;
+static unsigned int seconds = 10;
+static int cpu;
+static int latency_nice, set_latency_nice;
+static int hog_latency_nice, set_hog_latency_nice;
+
+static unsigned long histogram[NR_BUCKETS];
+static unsigned long frames, missed;
+static unsigned long long max_ns;
+
+static void die(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", progname);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"Usage: %s [-b hogs] [-p period_us] [-w work_us] [-t seconds] [-c cpu]\n"
+"       [-l latency_nice] [-L hog_latency_nice]\n"
+"\n"
+"  -b  background processes spinning on the CPU (default 2)\n"
+"  -p  frame period (default 16667)\n"
+"  -w  CPU time burnt per frame (default 2000)\n"
+"  -t  length of the run (default 10)\n"
+"  -c  CPU to run everything on (default 0)\n"
+"  -l  latency nice of the frame thread\n"
+"  -L  latency nice of the background processes\n",
+		progname);
+	exit(1);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void ns_to_ts(unsigned long long ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+static void pin(void)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set))
+		die("sched_setaffinity: %s\n", strerror(errno));
+}
+
+static void set_nice(int value)
+{
+	if (prctl(PR_SET_LATENCY_NICE, value, 0, 0, 0))
+		die("PR_SET_LATENCY_NICE %d: %s\n", value, strerror(errno));
+}
+
+static void spin_until(unsigned long long end)
+{
+	while (now_ns() < end)
+		;
+}
+
+static void hog(void)
+{
+	prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0);
+	if (getppid() == 1)
+		exit(0);
+
+	/* Don't inherit the frame thread's value */
+	if (set_hog_latency_nice || set_latency_nice)
+		set_nice(set_hog_latency_nice ? hog_latency_nice : 0);
+	for (;;)
+		spin_until(now_ns() + 1000000);
+}
+
+static unsigned int bucket(unsigned long long ns)
+{
+	unsigned long long us = ns / 1000;
+	unsigned int b = 0;
+
+	while (us && b < NR_BUCKETS - 1) {
+		us >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static unsigned long long percentile(unsigned int pct)
+{
+	unsigned long want = (frames * pct + 99) / 100, seen = 0;
+	unsigned int b;
+
+	for (b = 0; b < NR_BUCKETS; b++) {
+		seen += histogram[b];
+		if (seen >= want)
+			return 1ULL << b;	/* upper bound, in us */
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long next, end, woke, lat;
+	struct timespec ts;
+	pid_t *hogs;
+	unsigned int i;
+	int opt;
+
+	progname = argv[0];
+	while ((opt = getopt(argc, argv, "b:p:w:t:c:l:L:")) != -1) {
+		switch (opt) {
+		case 'b':
+			nr_hogs = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			work_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cpu = strtol(optarg, NULL, 0);
+			break;
+		case 'l':
+			latency_nice = strtol(optarg, NULL, 0);
+			set_latency_nice = 1;
+			break;
+		case 'L':
+			hog_latency_nice = strtol(optarg, NULL, 0);
+			set_hog_latency_nice = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || !period_us || work_us >= period_us || !seconds)
+		usage();
+
+	pin();
+	if (set_latency_nice)
+		set_nice(latency_nice);
+
+	hogs = calloc(nr_hogs, sizeof(*hogs));
+	if (nr_hogs && !hogs)
+		die("out of memory\n");
+	for (i = 0; i < nr_hogs; i++) {
+		hogs[i] = fork();
+		if (hogs[i] < 0)
+			die("fork: %s\n", strerror(errno));
+		if (!hogs[i])
+			hog();
+	}
+
+	next = now_ns();
+	end = next + seconds * 1000000000ULL;
+	while (next < end) {
+		next += period_us * 1000ULL;
+		ns_to_ts(next, &ts);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				       NULL) == EINTR)
+			;
+		woke = now_ns();
+		lat = woke > next ? woke - next : 0;
+
+		histogram[bucket(lat)]++;
+		if (lat > max_ns)
+			max_ns = lat;
+		frames++;
+
+		/* The frame's work is CPU time, not wall time */
+		spin_until(woke + work_us * 1000ULL);
+		if (now_ns() > next + period_us * 1000ULL)
+			missed++;
+	}
+
+	for (i = 0; i < nr_hogs; i++)
+		kill(hogs[i], SIGKILL);
+	while (wait(NULL) > 0)
+		;
+
+	printf("%lu frames of %lu us, %lu us work, %u hogs", frames,
+	       period_us, work_us, nr_hogs);
+	if (set_latency_nice)
+		printf(", latency nice %d", latency_nice);
+	if (set_hog_latency_nice)
+		printf(", hogs at %d", hog_latency_nice);
+	printf("\n\nwakeup latency     frames\n");
+	for (i = 0; i < NR_BUCKETS; i++) {
+		if (!histogram[i])
+			continue;
+		if (i == NR_BUCKETS - 1)
+			printf("   >= %8llu us %8lu\n", 1ULL << (i - 1),
+			       histogram[i]);
+		else
+			printf("    < %8llu us %8lu\n", 1ULL << i,
+			       histogram[i]);
+	}
+	printf("\np50 < %llu us, p90 < %llu us, p99 < %llu us, max %llu us\n",
+	       percentile(50), percentile(90), percentile(99),
+	       max_ns / 1000);
+	printf("late frames %lu (%.2f%%)\n", missed,
+	       frames ? 100.0 * missed / frames : 0.0);
+	return 0;
+}
@@ -0,0 +1,87 @@
+#!/bin/sh
+#
+# Latency seen by interactive traffic while a bulk TCP upload runs on
+# the same link, for the TCP small queue and pacing settings.  A veth
+# pair joins this namespace to a peer namespace; the sending side is
+# shaped by tbf to a Wi-Fi like rate with netem adding the path delay,
+# so the upload builds its queue in our qdisc as it would in front of
+# the Wi-Fi driver.  Runs under QEMU as well as on the device.
+#
+#	tcp-latency.sh
+#
+# These environment variables set up the link and the runs:
+#
+#	RATE	link rate (default 8mbit)
+#	DELAY	one way delay added by netem (default 20ms)
+#	LIMIT	tbf queue, in ms at RATE (default 2000)
+#	TIME	seconds per run (default 20)
+#
+# Each run reports the upload's throughput and the RTT of pings sent
+# every 100ms meanwhile.  The sysctls are restored afterwards.
+#
+
+RATE=${RATE:-8mbit}
+DELAY=${DELAY:-20ms}
+LIMIT=${LIMIT:-2000}
+TIME=${TIME:-20}
+
+NS=tcp-latency
+IF=tcpl0
+PEER_IF=tcpl1
+IP=10.43.0.1
+PEER_IP=10.43.0.2
+
+SYSCTL=/proc/sys/net/ipv4
+OLD_LIMIT=$(cat $SYSCTL/tcp_limit_output_bytes) || exit 1
+OLD_PACING=$(cat $SYSCTL/tcp_pacing) || exit 1
+
+cleanup() {
+	[ -n "$SERVER" ] && kill $SERVER 2>/dev/null
+	echo $OLD_LIMIT > $SYSCTL/tcp_limit_output_bytes
+	echo $OLD_PACING > $SYSCTL/tcp_pacing
+	ip link del $IF 2>/dev/null
+	ip netns del $NS 2>/dev/null
+}
+trap cleanup EXIT
+
+ip netns add $NS || exit 1
+ip link add $IF type veth peer name $PEER_IF || exit 1
+ip link set $PEER_IF netns $NS
+ip addr add $IP/24 dev $IF
+ip link set $IF up
+ip netns exec $NS ip addr add $PEER_IP/24 dev $PEER_IF
+ip netns exec $NS ip link set $PEER_IF up
+
+tc qdisc add dev $IF root handle 1: tbf rate $RATE burst 4kb \
+	latency ${LIMIT}ms || exit 1
+tc qdisc add dev $IF parent 1:1 handle 10: netem delay $DELAY || exit 1
+
+ip netns exec $NS iperf -s >/dev/null 2>&1 &
+SERVER=$!
+sleep 1
+
+# run name, tcp_limit_output_bytes, tcp_pacing
+run() {
+	echo $2 > $SYSCTL/tcp_limit_output_bytes
+	echo $3 > $SYSCTL/tcp_pacing
+	printf "%-12s" "$1"
+
+	iperf -c $PEER_IP -t $TIME -f k > /tmp/tcp-latency.$$ 2>&1 &
+	BULK=$!
+	sleep 2
+	ping -q -i 0.1 -c $(( (TIME - 3) * 10 )) $PEER_IP |
+		awk -F/ '/^rtt|^round-trip/ { printf "  rtt avg %s max %s ms", $5, $7 }'
+	wait $BULK
+	awk '/bits\/sec/ { printf "  upload %s %s\n", $(NF-1), $NF }' \
+		/tmp/tcp-latency.$$
+	rm -f /tmp/tcp-latency.$$
+}
+
+echo "rate $RATE, delay $DELAY, tbf queue ${LIMIT}ms"
+printf "%-12s" "idle"
+ping -q -i 0.1 -c 20 $PEER_IP |
+	awk -F/ '/^rtt|^round-trip/ { printf "  rtt avg %s max %s ms\n", $5, $7 }'
+
+run "no tsq" 0 0
+run "tsq" 131072 0
+run "tsq+pacing" 131072 1
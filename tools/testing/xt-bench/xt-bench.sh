@@ -0,0 +1,103 @@
+#!/bin/sh
+#
+# Cost of walking long filter chains, with and without x_tables' rule
+# dispatch.  In a network namespace of its own, ct-flood sends UDP over
+# loopback through an OUTPUT chain of RULES rules that all test the same
+# kind of key, the packet matching only the last one: the owner's uid,
+# the mark, the udp destination port or the output interface, as netd's
+# per-app and per-interface chains do.  INPUT drops the packets, so the
+# send rate is mostly bound by the walk.  Runs under QEMU as well as on
+# the device.
+#
+#	xt-bench.sh [kinds...]
+#
+# The kinds default to "uid mark dport oif".  These environment variables
+# set up the runs:
+#
+#	TIME	seconds per run (default 10)
+#	RULES	rules in the chain (default 500)
+#	FLOOD	path to ct-flood (default ../conntrack/ct-flood)
+#
+# Each kind is run with dispatch off and on, and shows the packets per
+# second sent.  On a kernel built with CONFIG_NETFILTER_XTABLES_PROFILE
+# it also shows, from /proc/net/ip_tables_profile, how many rules of the
+# chain each packet was looked at by and the time spent in them.  Run it
+# as root.
+#
+
+TIME=${TIME:-10}
+RULES=${RULES:-500}
+FLOOD=${FLOOD:-../conntrack/ct-flood}
+KINDS=${*:-"uid mark dport oif"}
+
+NS=xt-bench
+PORT=5001
+DISPATCH=/sys/module/x_tables/parameters/dispatch
+PROFILE=/proc/net/ip_tables_profile
+
+[ -x "$FLOOD" ] || { echo "build $FLOOD first" >&2; exit 1; }
+OLD_DISPATCH=$(cat $DISPATCH) || exit 1
+
+cleanup() {
+	echo $OLD_DISPATCH > $DISPATCH
+	ip netns del $NS 2>/dev/null
+}
+trap cleanup EXIT
+
+ip netns add $NS || exit 1
+ip netns exec $NS ip link set lo up
+
+# the rule of a kind that the flood's packets match, and one that they don't
+rule() {
+	case $1 in
+	uid)	[ $2 = last ] && echo "-m owner --uid-owner $(id -u)" ||
+			echo "-m owner --uid-owner $((10000 + $2))" ;;
+	mark)	[ $2 = last ] && echo "-m mark --mark 0" ||
+			echo "-m mark --mark $((1 + $2))" ;;
+	dport)	[ $2 = last ] && echo "-p udp --dport $PORT" ||
+			echo "-p udp --dport $((20000 + $2))" ;;
+	oif)	[ $2 = last ] && echo "-o lo" || echo "-o xtb$2" ;;
+	esac
+}
+
+# a filter table with the chain for a kind, loaded in one go
+load() {
+	{
+		echo "*filter"
+		echo ":bench - [0:0]"
+		echo "-A INPUT -p udp -j DROP"
+		echo "-A OUTPUT -j bench"
+		i=0
+		while [ $i -lt $((RULES - 1)) ]; do
+			echo "-A bench $(rule $1 $i) -j ACCEPT"
+			i=$((i + 1))
+		done
+		echo "-A bench $(rule $1 last) -j ACCEPT"
+		echo "COMMIT"
+	} | ip netns exec $NS iptables-restore || exit 1
+}
+
+# run a kind, dispatch off or on
+run() {
+	echo $2 > $DISPATCH
+	ip netns exec $NS sh -c "[ -w $PROFILE ] && echo > $PROFILE"
+	out=$(ip netns exec $NS $FLOOD -f 1 -p $PORT -t $TIME 127.0.0.1)
+	packets=$(echo "$out" | awk '{ print $3 }')
+	printf "%-6s dispatch %d  %8d pps" $1 $2 \
+		$(echo "$out" | awk '{ printf "%d", $7 }')
+	ip netns exec $NS awk -v p=$packets '
+		$2 == "bench" { evals += $4; nsecs += $6 }
+		END {
+			if (p && evals)
+				printf "  %6.1f rules %8.0f ns per packet",
+					evals / p, nsecs / p
+		}' $PROFILE 2>/dev/null
+	echo
+}
+
+echo "$RULES rules, ${TIME}s per run"
+for k in $KINDS; do
+	load $k
+	run $k 0
+	run $k 1
+done
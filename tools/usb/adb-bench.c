@@ -0,0 +1,453 @@
+/*
+ * adb-bench - ADB push/pull throughput
+ *
+ * Both ends of the transfer are driven by this program, with the framing
+ * adbd uses: every payload is preceded by a 24 byte message header, and
+ * each of them is one read() or write() on /dev/android_adb.  On the host
+ * side the data moves over usbfs with a queue of URBs.  With dummy_hcd
+ * both run on the same machine:
+ *
+ *	pull:	device# adb-bench device send /data/test.bin
+ *		host#   adb-bench host recv /dev/bus/usb/001/002 $(stat -c %s test.bin)
+ *
+ *	push:	host#   adb-bench host send /dev/bus/usb/001/002 268435456
+ *		device# adb-bench device recv /data/out.bin 268435456
+ *
+ * -p sets the payload size (adbd uses 4096), -s makes the device send the
+ * payloads with sendfile(), -a makes the device receive with non-blocking
+ * reads, arming the next read before it writes out the last payload.  The
+ * request sizes of the gadget are module parameters of g_android
+ * (adb_tx_req_len etc.).
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+
+#define URB_SIZE	16384
+#define URB_MAX		64
+#define PAYLOAD_MAX	(256 * 1024)
+
+#define A_WRTE		0x45545257
+
+/* adb message header */
+struct amessage {
+	uint32_t command;
+	uint32_t arg0;
+	uint32_t arg1;
+	uint32_t data_length;
+	uint32_t data_check;
+	uint32_t magic;
+};
+
+static int urbs = 8;
+static int payload = 4096;
+static int use_sendfile;
+static int async;
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	if (errno)
+		fprintf(stderr, ": %s", strerror(errno));
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: adb-bench [-p payload] [-s] device send FILE\n"
+		"       adb-bench [-p payload] [-a] device recv FILE BYTES\n"
+		"       adb-bench [-p payload] [-q urbs] host send USBDEV BYTES\n"
+		"       adb-bench [-p payload] [-q urbs] host recv USBDEV BYTES\n");
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *what, long long bytes, double secs)
+{
+	printf("%s %lld bytes in %.3f s, %.2f MB/s\n", what, bytes, secs,
+	       secs > 0 ? bytes / secs / (1024 * 1024) : 0.0);
+}
+
+static void fill_header(struct amessage *msg, int len)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->command = A_WRTE;
+	msg->data_length = len;
+	msg->magic = A_WRTE ^ 0xffffffff;
+}
+
+/* one adb read: exactly len bytes, polling if the device is non-blocking */
+static void adb_read(int adb, void *buf, int len)
+{
+	struct pollfd pfd = { .fd = adb, .events = POLLIN };
+	int ret;
+
+	while (len > 0) {
+		ret = read(adb, buf, len);
+		if (ret < 0 && errno == EAGAIN) {
+			if (poll(&pfd, 1, -1) < 0)
+				die("poll");
+			continue;
+		}
+		if (ret <= 0)
+			die("reading adb");
+		buf = (char *)buf + ret;
+		len -= ret;
+	}
+}
+
+/* start the next read without waiting for it, returns what it got */
+static int adb_arm(int adb, void *buf, int len)
+{
+	int ret = read(adb, buf, len);
+
+	if (ret < 0 && errno != EAGAIN)
+		die("reading adb");
+	return ret < 0 ? 0 : ret;
+}
+
+static void adb_write(int adb, const void *buf, int len)
+{
+	if (write(adb, buf, len) != len)
+		die("writing adb");
+}
+
+static int device_send(int adb, int fd, long long bytes)
+{
+	static char buf[PAYLOAD_MAX];
+	struct amessage msg;
+	long long left = bytes;
+	int len;
+
+	while (left > 0) {
+		len = left < payload ? left : payload;
+		fill_header(&msg, len);
+		adb_write(adb, &msg, sizeof(msg));
+		if (use_sendfile) {
+			if (sendfile(adb, fd, NULL, len) != len)
+				die("sendfile");
+		} else {
+			if (read(fd, buf, len) != len)
+				die("reading file");
+			adb_write(adb, buf, len);
+		}
+		left -= len;
+	}
+	return 0;
+}
+
+static void check_header(struct amessage *msg, long long left)
+{
+	if (msg->command != A_WRTE || msg->data_length > (uint32_t)payload ||
+	    msg->data_length > left) {
+		errno = 0;
+		die("bad message header");
+	}
+}
+
+static int device_recv(int adb, int fd, long long bytes)
+{
+	static char buf[PAYLOAD_MAX];
+	struct amessage msg;
+	long long left = bytes;
+	int len, got = 0;
+
+	if (async && fcntl(adb, F_SETFL, O_NONBLOCK) < 0)
+		die("O_NONBLOCK");
+
+	while (left > 0) {
+		adb_read(adb, (char *)&msg + got, sizeof(msg) - got);
+		check_header(&msg, left);
+		len = msg.data_length;
+		adb_read(adb, buf, len);
+		left -= len;
+
+		/* the next header is on its way while the payload is written */
+		got = 0;
+		if (async && left > 0)
+			got = adb_arm(adb, &msg, sizeof(msg));
+		if (write(fd, buf, len) != len)
+			die("writing file");
+	}
+	return 0;
+}
+
+static int device(int send, const char *path, long long bytes)
+{
+	struct stat st;
+	double t;
+	int fd, adb;
+
+	adb = open("/dev/android_adb", O_RDWR);
+	if (adb < 0)
+		die("/dev/android_adb");
+
+	if (send) {
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || fstat(fd, &st) < 0)
+			die("%s", path);
+		bytes = st.st_size;
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			die("%s", path);
+	}
+
+	t = now();
+	if (send)
+		device_send(adb, fd, bytes);
+	else
+		device_recv(adb, fd, bytes);
+	if (!send && fsync(fd) < 0)
+		die("fsync");
+	t = now() - t;
+
+	report(send ? "device sent" : "device received", bytes, t);
+	close(fd);
+	close(adb);
+	return 0;
+}
+
+/*
+ * Find the ADB interface: vendor specific class, subclass 0x42, protocol
+ * 1.  usbfs hands out the device descriptor followed by the raw
+ * configuration descriptors.
+ */
+static int find_adb(int fd, int *ep_in, int *ep_out)
+{
+	unsigned char buf[4096], *p, *end;
+	int len, intf = -1, adb = 0, in = 0, out = 0;
+
+	len = read(fd, buf, sizeof(buf));
+	if (len < USB_DT_DEVICE_SIZE)
+		die("reading descriptors");
+
+	end = buf + len;
+	for (p = buf + USB_DT_DEVICE_SIZE; p + 2 <= end && p[0]; p += p[0]) {
+		if (p[1] == USB_DT_INTERFACE) {
+			if (adb && in && out)
+				break;
+			intf = p[2];
+			adb = p[5] == 0xff && p[6] == 0x42 && p[7] == 1;
+			in = out = 0;
+		} else if (p[1] == USB_DT_ENDPOINT && adb) {
+			if ((p[3] & USB_ENDPOINT_XFERTYPE_MASK) !=
+			    USB_ENDPOINT_XFER_BULK)
+				continue;
+			if (p[2] & USB_DIR_IN)
+				in = p[2];
+			else
+				out = p[2];
+		}
+	}
+	if (!adb || !in || !out) {
+		errno = 0;
+		die("no ADB interface found");
+	}
+
+	*ep_in = in;
+	*ep_out = out;
+	return intf;
+}
+
+/*
+ * The host's side of the message stream: a header, then the payload in
+ * URB sized pieces.  Each call returns the length of the next URB.
+ */
+struct stream {
+	long long left;		/* payload bytes not yet in a URB */
+	int chunk;		/* bytes of the current payload not yet in a URB */
+	int hdr;		/* the next URB is a header */
+};
+
+static int next_urb(struct stream *s)
+{
+	int len;
+
+	if (s->hdr) {
+		if (s->left <= 0)
+			return 0;
+		s->chunk = s->left < payload ? s->left : payload;
+		s->hdr = 0;
+		return sizeof(struct amessage);
+	}
+	len = s->chunk < URB_SIZE ? s->chunk : URB_SIZE;
+	s->chunk -= len;
+	s->left -= len;
+	if (s->chunk == 0)
+		s->hdr = 1;
+	return len;
+}
+
+struct host_urb {
+	struct usbdevfs_urb urb;
+	int hdr;
+	char buf[URB_SIZE];
+};
+
+/* submit the next URB of the stream, 0 if there is none */
+static int submit(int fd, struct host_urb *u, int ep, int send,
+		  struct stream *s)
+{
+	struct usbdevfs_urb *urb = &u->urb;
+	int len;
+
+	u->hdr = s->hdr;
+	len = next_urb(s);
+	if (!len)
+		return 0;
+	if (u->hdr && send)
+		fill_header((struct amessage *)u->buf, s->chunk);
+
+	memset(urb, 0, sizeof(*urb));
+	urb->type = USBDEVFS_URB_TYPE_BULK;
+	urb->endpoint = ep;
+	urb->usercontext = u;
+	urb->buffer = u->buf;
+	urb->buffer_length = len;
+	if (ioctl(fd, USBDEVFS_SUBMITURB, urb) < 0)
+		die("SUBMITURB");
+	return 1;
+}
+
+static int host(int send, const char *path, long long bytes)
+{
+	static struct host_urb u[URB_MAX];
+	struct usbdevfs_urb *urb;
+	struct host_urb *hu;
+	struct stream s = { .left = bytes, .hdr = 1 };
+	struct amessage *msg;
+	long long done = 0;
+	int fd, intf, ep_in, ep_out, ep, i, inflight = 0;
+	double t;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		die("%s", path);
+	intf = find_adb(fd, &ep_in, &ep_out);
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf) < 0)
+		die("claiming interface %d", intf);
+
+	ep = send ? ep_out : ep_in;
+
+	t = now();
+	for (i = 0; i < urbs && submit(fd, &u[i], ep, send, &s); i++)
+		inflight++;
+
+	while (inflight) {
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb) < 0)
+			die("REAPURB");
+		inflight--;
+		if (urb->status)
+			die("URB status %d", urb->status);
+		hu = urb->usercontext;
+		if (hu->hdr) {
+			msg = (struct amessage *)hu->buf;
+			if (!send && msg->command != A_WRTE) {
+				errno = 0;
+				die("bad message header");
+			}
+		} else {
+			done += urb->actual_length;
+		}
+
+		if (submit(fd, hu, ep, send, &s))
+			inflight++;
+	}
+	t = now() - t;
+
+	report(send ? "host sent" : "host received", done, t);
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long long bytes = 0;
+	int opt, send;
+
+	while ((opt = getopt(argc, argv, "ap:q:s")) != -1) {
+		switch (opt) {
+		case 'a':
+			async = 1;
+			break;
+		case 'p':
+			payload = atoi(optarg);
+			if (payload < 1 || payload > PAYLOAD_MAX)
+				usage();
+			break;
+		case 'q':
+			urbs = atoi(optarg);
+			if (urbs < 1 || urbs > URB_MAX)
+				usage();
+			break;
+		case 's':
+			use_sendfile = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 3)
+		usage();
+	if (!strcmp(argv[1], "send"))
+		send = 1;
+	else if (!strcmp(argv[1], "recv"))
+		send = 0;
+	else
+		usage();
+
+	if (!strcmp(argv[0], "device")) {
+		if (!send) {
+			if (argc < 4)
+				usage();
+			bytes = strtoll(argv[3], NULL, 0);
+		}
+		return device(send, argv[2], bytes);
+	}
+	if (!strcmp(argv[0], "host")) {
+		if (argc < 4)
+			usage();
+		bytes = strtoll(argv[3], NULL, 0);
+		return host(send, argv[2], bytes);
+	}
+	usage();
+	return 0;
+}
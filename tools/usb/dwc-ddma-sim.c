@@ -0,0 +1,843 @@
+/*
+ * dwc-ddma-sim - exercise the dwc_otg descriptor DMA helpers
+ *
+ * A user space model of one device endpoint of the DWC_otg core running
+ * in descriptor DMA mode.  The core side walks the descriptor ring the
+ * way the DMA engine does, moving packets between bus memory and a
+ * scripted host; the driver side builds and retires chains the way
+ * dwc_otg_pcd_start_ddma_chain(), complete_ddma_ep() and
+ * pcd_ddma_dequeue() do, using the
+ * helpers in drivers/usb/dwc_otg/dwc_otg_ddma.h unchanged.
+ *
+ *	dwc-ddma-sim [-v]
+ *
+ * Each scenario checks the data that crossed the bus, the packets the
+ * host saw, the lengths the requests completed with and the number of
+ * chains and interrupts it took.  The exit status is non-zero if any
+ * check failed.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../drivers/usb/dwc_otg/dwc_otg_ddma.h"
+
+#define MEM_SIZE	(32 << 20)
+#define MAX_REQS	64
+#define MAX_SGS		72
+#define MAX_PKTS	65536
+
+/* bus memory: descriptor buffer addresses are offsets into it */
+static uint8_t mem[MEM_SIZE];
+static uint32_t mem_top;
+
+static int verbose;
+static int failed;
+
+struct req {
+	uint32_t buf;
+	uint32_t length;
+	struct {
+		uint32_t addr;
+		uint32_t len;
+	} sg[MAX_SGS];
+	int num_sgs;
+	int zero;
+
+	uint32_t actual;
+	int status;
+	int done;
+
+	int desc_need;
+	dwc_otg_ddma_xfer_t xfer;
+};
+
+struct ep {
+	int is_in;
+	unsigned mps;
+	dwc_otg_dma_desc_t ring[DWC_DDMA_DESC_CNT];
+
+	/* core side */
+	int epena;
+	int cur;		/* DxEPDMAn, as an index into the ring */
+	uint32_t off;		/* bytes of the current OUT descriptor received */
+	int xfercompl;
+	int bna;
+
+	/* driver side */
+	struct req *queue[MAX_REQS];
+	int head;
+	int tail;
+	int desc_cnt;
+
+	int chains;
+	int irqs;
+	int bnas;
+};
+
+struct host {
+	/* IN: what the host received */
+	uint8_t *rx;
+	uint32_t rx_len;
+	uint32_t pkts[MAX_PKTS];
+	int npkts;
+
+	/* OUT: what the host sends */
+	const uint8_t *tx;
+	uint32_t tx_off;
+	const uint32_t *script;
+	int nscript;
+	int next;
+};
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dwc-ddma-sim [-v]\n");
+	exit(2);
+}
+
+static void check(int ok, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (ok)
+		return;
+	va_start(ap, fmt);
+	fprintf(stderr, "FAIL: ");
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	failed++;
+}
+
+static uint32_t bus_alloc(uint32_t len)
+{
+	uint32_t addr = mem_top;
+
+	mem_top += (len + 3) & ~3;
+	if (mem_top > MEM_SIZE)
+		die("out of bus memory");
+	return addr;
+}
+
+static void fill(uint8_t *p, uint32_t len, unsigned seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		p[i] = (uint8_t)(seed * 131 + i * 7 + (i >> 8));
+}
+
+/*------------------------------------------------------------------------*/
+
+/* the core's DMA engine: one descriptor per call, 0 when stuck */
+static int core_step(struct ep *ep, struct host *h)
+{
+	dwc_otg_dma_desc_t *d;
+	dev_dma_desc_sts_t sts;
+	int stop = 0;
+
+	if (!ep->epena)
+		return 0;
+	if (ep->cur >= DWC_DDMA_DESC_CNT)
+		die("core ran off the end of the ring");
+
+	d = &ep->ring[ep->cur];
+	sts = d->status;
+	if (sts.b.bs != BS_HOST_READY && sts.b.bs != BS_DMA_BUSY) {
+		ep->epena = 0;
+		ep->bna++;
+		return 1;
+	}
+
+	if (ep->is_in) {
+		uint32_t left = sts.b.bytes;
+		uint32_t addr = d->buf;
+
+		while (left) {
+			uint32_t n = left > ep->mps ? ep->mps : left;
+
+			memcpy(h->rx + h->rx_len, mem + addr, n);
+			h->rx_len += n;
+			h->pkts[h->npkts++] = n;
+			addr += n;
+			left -= n;
+		}
+		if (sts.b.sp && sts.b.bytes % ep->mps == 0)
+			h->pkts[h->npkts++] = 0;
+		sts.b.bytes = 0;
+	} else {
+		while (sts.b.bytes) {
+			uint32_t n;
+
+			if (h->next == h->nscript) {
+				/* nothing from the host: wait in this descriptor */
+				sts.b.bs = BS_DMA_BUSY;
+				d->status = sts;
+				return 0;
+			}
+			n = h->script[h->next++];
+			if (n > ep->mps || n > sts.b.bytes)
+				die("babble: %u byte packet", n);
+			memcpy(mem + d->buf + ep->off, h->tx + h->tx_off, n);
+			h->tx_off += n;
+			ep->off += n;
+			sts.b.bytes -= n;
+			if (n < ep->mps) {
+				/* MTRF is clear: a short packet ends the chain */
+				sts.b.sp = 1;
+				stop = 1;
+				break;
+			}
+		}
+		ep->off = 0;
+	}
+
+	sts.b.sts = STS_SUCC;
+	sts.b.bs = BS_DMA_DONE;
+	d->status = sts;
+	ep->cur++;
+	if (sts.b.l)
+		stop = 1;
+	if (sts.b.ioc || stop)
+		ep->xfercompl++;
+	if (stop)
+		ep->epena = 0;
+	return 1;
+}
+
+/* EPDis: the core closes the descriptor it is in and stops */
+static void core_disable(struct ep *ep)
+{
+	dwc_otg_dma_desc_t *d;
+
+	if (!ep->epena)
+		return;
+	d = &ep->ring[ep->cur];
+	if (d->status.b.bs == BS_DMA_BUSY) {
+		d->status.b.sts = STS_SUCC;
+		d->status.b.bs = BS_DMA_DONE;
+	}
+	ep->off = 0;
+	ep->epena = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* the driver, as in dwc_otg_pcd.c and dwc_otg_pcd_intr.c */
+
+static void start_chain(struct ep *ep)
+{
+	struct req *last = NULL;
+	int used = 0;
+	int i, j;
+
+	if (ep->desc_cnt)
+		return;
+
+	for (i = ep->head; i < ep->tail; i++) {
+		struct req *req = ep->queue[i];
+
+		if (used + req->desc_need > DWC_DDMA_DESC_CNT)
+			break;
+
+		req->xfer.first = used;
+		req->xfer.cnt = 0;
+		req->xfer.len = 0;
+		if (req->num_sgs) {
+			for (j = 0; j < req->num_sgs; j++)
+				dwc_otg_ddma_add_seg(ep->ring, DWC_DDMA_DESC_CNT,
+					&req->xfer, req->sg[j].addr,
+					req->sg[j].len, ep->mps, ep->is_in,
+					j == req->num_sgs - 1, req->zero);
+		} else {
+			dwc_otg_ddma_add_seg(ep->ring, DWC_DDMA_DESC_CNT,
+				&req->xfer, req->buf, req->length, ep->mps,
+				ep->is_in, 1, req->zero);
+		}
+		if (!ep->is_in)
+			dwc_otg_ddma_set_ioc(ep->ring, &req->xfer);
+		used += req->xfer.cnt;
+		last = req;
+	}
+
+	if (!last)
+		return;
+	dwc_otg_ddma_close(ep->ring, &last->xfer);
+	ep->desc_cnt = used;
+
+	/* DxEPDMAn = ring, EPEna */
+	ep->cur = 0;
+	ep->off = 0;
+	ep->epena = 1;
+	ep->chains++;
+	if (verbose)
+		printf("  chain %d: %d descriptors\n", ep->chains, used);
+}
+
+static void complete(struct ep *ep, int halted)
+{
+	uint32_t actual;
+	int ret;
+	int i;
+
+	while (ep->head < ep->tail) {
+		struct req *req = ep->queue[ep->head];
+
+		if (req->xfer.cnt == 0)
+			break;
+		ret = dwc_otg_ddma_xfer_done(ep->ring, &req->xfer, ep->is_in,
+					     &actual);
+		if (ret == 0)
+			break;
+		req->actual = actual < req->length ? actual : req->length;
+		req->status = ret < 0 ? ret : 0;
+		req->done = 1;
+		ep->head++;
+	}
+
+	if (ep->desc_cnt && !halted && ep->epena)
+		return;
+
+	for (i = ep->head; i < ep->tail; i++)
+		ep->queue[i]->xfer.cnt = 0;
+	ep->desc_cnt = 0;
+	start_chain(ep);
+}
+
+static int ep_queue(struct ep *ep, struct req *req)
+{
+	int need = 0;
+	int n, i;
+
+	if (req->num_sgs) {
+		req->length = 0;
+		for (i = 0; i < req->num_sgs; i++) {
+			n = dwc_otg_ddma_seg_descs(req->sg[i].len, ep->mps,
+					ep->is_in, i == req->num_sgs - 1,
+					req->zero);
+			if (n < 0)
+				return n;
+			need += n;
+			req->length += req->sg[i].len;
+		}
+	} else {
+		need = dwc_otg_ddma_seg_descs(req->length, ep->mps, ep->is_in,
+					      1, req->zero);
+	}
+	if (need < 0 || need > DWC_DDMA_DESC_CNT)
+		return -EINVAL;
+	if (ep->tail == MAX_REQS)
+		die("request queue full");
+
+	req->desc_need = need;
+	req->xfer.cnt = 0;
+	req->done = 0;
+	ep->queue[ep->tail++] = req;
+	start_chain(ep);
+	return 0;
+}
+
+static void ep_dequeue(struct ep *ep, struct req *dreq)
+{
+	uint32_t actual;
+	int keep = ep->head;
+	int ret;
+	int i;
+
+	if (dreq->xfer.cnt)
+		core_disable(ep);
+
+	for (i = ep->head; i < ep->tail; i++) {
+		struct req *req = ep->queue[i];
+
+		if (req->xfer.cnt) {
+			ret = dwc_otg_ddma_xfer_done(ep->ring, &req->xfer,
+						     ep->is_in, &actual);
+			if (ret == 0) {
+				if (!dwc_otg_ddma_xfer_stopped(ep->ring,
+						&req->xfer, &actual) &&
+				    req != dreq) {
+					req->xfer.cnt = 0;
+					ep->queue[keep++] = req;
+					continue;
+				}
+				ret = -ECONNRESET;
+			} else if (req == dreq) {
+				ret = -ECONNRESET;
+			}
+		} else if (req == dreq) {
+			actual = 0;
+			ret = -ECONNRESET;
+		} else {
+			ep->queue[keep++] = req;
+			continue;
+		}
+		req->actual = actual < req->length ? actual : req->length;
+		req->status = ret < 0 ? ret : 0;
+		req->done = 1;
+	}
+	ep->tail = keep;
+
+	if (dreq->xfer.cnt) {
+		ep->desc_cnt = 0;
+		start_chain(ep);
+	}
+	dreq->xfer.cnt = 0;
+}
+
+static void irq(struct ep *ep)
+{
+	if (ep->xfercompl) {
+		ep->xfercompl = 0;
+		ep->irqs++;
+		complete(ep, 0);
+	}
+	if (ep->bna) {
+		ep->bna = 0;
+		ep->bnas++;
+		complete(ep, 1);
+	}
+}
+
+static void run(struct ep *ep, struct host *h)
+{
+	for (;;) {
+		int moved = core_step(ep, h);
+
+		if (ep->xfercompl || ep->bna)
+			irq(ep);
+		else if (!moved)
+			break;
+	}
+}
+
+static struct ep *new_ep(int is_in, unsigned mps)
+{
+	struct ep *ep = calloc(1, sizeof(*ep));
+
+	if (!ep)
+		die("out of memory");
+	ep->is_in = is_in;
+	ep->mps = mps;
+	return ep;
+}
+
+static struct host *new_host(void)
+{
+	struct host *h = calloc(1, sizeof(*h));
+
+	if (!h || !(h->rx = malloc(MEM_SIZE)))
+		die("out of memory");
+	return h;
+}
+
+static void free_host(struct host *h)
+{
+	free(h->rx);
+	free(h);
+}
+
+static void new_req(struct req *req, uint32_t length, int zero, unsigned seed)
+{
+	memset(req, 0, sizeof(*req));
+	req->buf = bus_alloc(length);
+	req->length = length;
+	req->zero = zero;
+	fill(mem + req->buf, length, seed);
+}
+
+/* the packets a USB device controller should send for an IN request */
+static int expect_in_pkts(uint32_t *pkts, uint32_t length, int zero,
+			  unsigned mps)
+{
+	int n = 0;
+
+	while (length >= mps) {
+		pkts[n++] = mps;
+		length -= mps;
+	}
+	if (length || zero || n == 0)
+		pkts[n++] = length;
+	return n;
+}
+
+/* the IN data in the order the requests were queued */
+static void check_in_data(struct host *h, struct req *reqs, int nreqs)
+{
+	uint32_t off = 0;
+	int i, j;
+
+	for (i = 0; i < nreqs; i++) {
+		struct req *req = &reqs[i];
+
+		if (req->num_sgs) {
+			for (j = 0; j < req->num_sgs; j++) {
+				check(!memcmp(h->rx + off, mem + req->sg[j].addr,
+					      req->sg[j].len),
+				      "req %d sg %d data", i, j);
+				off += req->sg[j].len;
+			}
+		} else {
+			check(!memcmp(h->rx + off, mem + req->buf,
+				      req->length), "req %d data", i);
+			off += req->length;
+		}
+	}
+	check(off == h->rx_len, "host got %u bytes, expected %u",
+	      h->rx_len, off);
+}
+
+static void check_in_pkts(struct host *h, struct ep *ep, struct req *reqs,
+			  int nreqs)
+{
+	static uint32_t want[MAX_PKTS];
+	int n = 0;
+	int i;
+
+	for (i = 0; i < nreqs; i++)
+		n += expect_in_pkts(want + n, reqs[i].length, reqs[i].zero,
+				    ep->mps);
+	check(n == h->npkts, "host got %d packets, expected %d", h->npkts, n);
+	for (i = 0; i < n && i < h->npkts; i++) {
+		if (want[i] != h->pkts[i]) {
+			check(0, "packet %d is %u bytes, expected %u",
+			      i, h->pkts[i], want[i]);
+			break;
+		}
+	}
+}
+
+static void check_done(struct req *reqs, int nreqs)
+{
+	int i;
+
+	for (i = 0; i < nreqs; i++) {
+		check(reqs[i].done, "req %d not completed", i);
+		check(reqs[i].status == 0, "req %d status %d", i,
+		      reqs[i].status);
+	}
+}
+
+static void report(const char *name, struct ep *ep, struct host *h)
+{
+	printf("%-10s %s: %d chains, %d interrupts, %d BNA, %d packets\n",
+	       name, failed ? "FAIL" : "ok", ep->chains, ep->irqs, ep->bnas,
+	       ep->is_in ? h->npkts : h->next);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* mixed IN requests: exact packets, short packets, ZLPs, >64K requests */
+static void test_in(void)
+{
+	static const struct { uint32_t len; int zero; } spec[] = {
+		{ 512, 0 }, { 1000, 0 }, { 0, 0 }, { 4096, 1 },
+		{ 70000, 0 }, { 100000, 1 }, { 65024, 1 }, { 131072, 0 },
+	};
+	int nreqs = sizeof(spec) / sizeof(spec[0]);
+	struct req reqs[sizeof(spec) / sizeof(spec[0])];
+	struct ep *ep = new_ep(1, 512);
+	struct host *h = new_host();
+	int i;
+
+	for (i = 0; i < nreqs; i++) {
+		new_req(&reqs[i], spec[i].len, spec[i].zero, i);
+		check(ep_queue(ep, &reqs[i]) == 0, "queue req %d", i);
+	}
+	run(ep, h);
+
+	check_done(reqs, nreqs);
+	for (i = 0; i < nreqs; i++)
+		check(reqs[i].actual == reqs[i].length,
+		      "req %d actual %u, expected %u", i, reqs[i].actual,
+		      reqs[i].length);
+	check_in_data(h, reqs, nreqs);
+	check_in_pkts(h, ep, reqs, nreqs);
+	/* the first request goes out on its own, the rest in one chain */
+	check(ep->chains == 2, "%d chains, expected 2", ep->chains);
+	check(ep->irqs == 2, "%d interrupts, expected 2", ep->irqs);
+	report("in", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+/* OUT requests ended by a full buffer or by a short packet */
+static void test_out(void)
+{
+	static const uint32_t lens[] = { 4096, 4096, 4096, 4096, 100000, 512 };
+	static const uint32_t want[] = { 4096, 100, 4096, 1000, 100000, 0 };
+	static uint32_t script[1024];
+	static uint8_t tx[1 << 20];
+	int nreqs = sizeof(lens) / sizeof(lens[0]);
+	struct req reqs[sizeof(lens) / sizeof(lens[0])];
+	struct ep *ep = new_ep(0, 512);
+	struct host *h = new_host();
+	uint32_t off = 0;
+	int n = 0;
+	int i;
+
+	/* the host sends each request's expected length in packets */
+	for (i = 0; i < nreqs; i++) {
+		uint32_t left = want[i];
+
+		while (left >= 512) {
+			script[n++] = 512;
+			left -= 512;
+		}
+		if (left || want[i] < lens[i])
+			script[n++] = left;
+	}
+	fill(tx, sizeof(tx), 99);
+	h->tx = tx;
+	h->script = script;
+	h->nscript = n;
+
+	for (i = 0; i < nreqs; i++) {
+		new_req(&reqs[i], lens[i], 0, 0);
+		memset(mem + reqs[i].buf, 0, lens[i]);
+		check(ep_queue(ep, &reqs[i]) == 0, "queue req %d", i);
+	}
+	run(ep, h);
+
+	check_done(reqs, nreqs);
+	for (i = 0; i < nreqs; i++) {
+		check(reqs[i].actual == want[i],
+		      "req %d actual %u, expected %u", i, reqs[i].actual,
+		      want[i]);
+		check(!memcmp(mem + reqs[i].buf, tx + off, want[i]),
+		      "req %d data", i);
+		off += want[i];
+	}
+	check(h->next == h->nscript, "host has %d packets left",
+	      h->nscript - h->next);
+	/*
+	 * the first request goes out on its own; short packets in reqs 1,
+	 * 3 and 4 each end a chain early
+	 */
+	check(ep->chains == 5, "%d chains, expected 5", ep->chains);
+	check(ep->irqs == nreqs, "%d interrupts, expected %d", ep->irqs, nreqs);
+	report("out", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+/* scatter-gather requests, and the segments that must be refused */
+static void test_sg(void)
+{
+	struct req reqs[2];
+	struct req bad;
+	struct ep *ep = new_ep(1, 512);
+	struct host *h = new_host();
+	static const uint32_t seg[] = { 1024, 512, 300 };
+	int i;
+
+	memset(reqs, 0, sizeof(reqs));
+	for (i = 0; i < 3; i++) {
+		reqs[0].sg[i].addr = bus_alloc(seg[i]);
+		reqs[0].sg[i].len = seg[i];
+		fill(mem + reqs[0].sg[i].addr, seg[i], 10 + i);
+	}
+	reqs[0].num_sgs = 3;
+	/* 70000 bytes of whole packets in one segment, then a ZLP */
+	reqs[1].sg[0].addr = bus_alloc(512 * 2);
+	reqs[1].sg[0].len = 512 * 2;
+	reqs[1].sg[1].addr = bus_alloc(512 * 140);
+	reqs[1].sg[1].len = 512 * 140;
+	fill(mem + reqs[1].sg[0].addr, 512 * 2, 20);
+	fill(mem + reqs[1].sg[1].addr, 512 * 140, 21);
+	reqs[1].num_sgs = 2;
+	reqs[1].zero = 1;
+	for (i = 0; i < 2; i++)
+		check(ep_queue(ep, &reqs[i]) == 0, "queue sg req %d", i);
+	run(ep, h);
+
+	check_done(reqs, 2);
+	check(reqs[0].actual == 1836, "sg req 0 actual %u", reqs[0].actual);
+	check(reqs[1].actual == 512 * 142, "sg req 1 actual %u",
+	      reqs[1].actual);
+	check_in_data(h, reqs, 2);
+	check_in_pkts(h, ep, reqs, 2);
+
+	memset(&bad, 0, sizeof(bad));
+	bad.num_sgs = 2;
+	bad.sg[0].len = 1000;
+	bad.sg[1].len = 24;
+	check(ep_queue(ep, &bad) == -EINVAL, "misaligned segment accepted");
+	bad.sg[0].len = 0;
+	bad.sg[1].len = 512;
+	check(ep_queue(ep, &bad) == -EINVAL, "empty segment accepted");
+	bad.num_sgs = DWC_DDMA_DESC_CNT + 1;
+	for (i = 0; i < bad.num_sgs; i++)
+		bad.sg[i].len = 512;
+	check(ep_queue(ep, &bad) == -EINVAL, "oversized request accepted");
+	report("sg", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+/* more queued than one ring holds: the chain is rebuilt as it drains */
+static void test_overflow(void)
+{
+	static struct req reqs[40];
+	struct ep *ep = new_ep(1, 512);
+	struct host *h = new_host();
+	int i;
+
+	for (i = 0; i < 40; i++) {
+		/* 4 descriptors each, 16 to a chain */
+		new_req(&reqs[i], 200000, 0, 30 + i);
+		check(ep_queue(ep, &reqs[i]) == 0, "queue req %d", i);
+	}
+	run(ep, h);
+
+	check_done(reqs, 40);
+	check_in_data(h, reqs, 40);
+	check_in_pkts(h, ep, reqs, 40);
+	/* the first on its own, then 16, 16 and the last 7 */
+	check(ep->chains == 4, "%d chains, expected 4", ep->chains);
+	check(ep->irqs == 4, "%d interrupts, expected 4", ep->irqs);
+	report("overflow", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+/* the core finds a descriptor it doesn't own and stops with BNA */
+static void test_bna(void)
+{
+	struct req reqs[4];
+	struct ep *ep = new_ep(1, 64);
+	struct host *h = new_host();
+	int i;
+
+	/* req 0 goes out on its own; reqs 1-3 wait for the next chain */
+	for (i = 0; i < 4; i++) {
+		new_req(&reqs[i], 2048, 0, 80 + i);
+		check(ep_queue(ep, &reqs[i]) == 0, "queue req %d", i);
+		if (i == 0)
+			core_step(ep, h);
+	}
+	irq(ep);
+	check(ep->chains == 2, "%d chains, expected 2", ep->chains);
+	ep->ring[reqs[2].xfer.first].status.b.bs = BS_HOST_BUSY;
+	run(ep, h);
+
+	check_done(reqs, 4);
+	check_in_data(h, reqs, 4);
+	check(ep->bnas == 1, "%d BNA, expected 1", ep->bnas);
+	check(ep->chains == 3, "%d chains, expected 3", ep->chains);
+	report("bna", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+/*
+ * a request is dequeued from the middle of a running OUT chain: the one
+ * the core is filling is cut short, the ones after the dequeued one go
+ * out again in a new chain
+ */
+static void test_dequeue(void)
+{
+	static uint32_t script[32];
+	static uint8_t tx[8 * 2048];
+	struct req reqs[5];
+	struct ep *ep = new_ep(0, 512);
+	struct host *h = new_host();
+	int n = 0;
+	int i;
+
+	/* req 0 in full, half of req 1; reqs 2 and 4 once 3 is gone */
+	for (i = 0; i < 4 + 2 + 4 + 4; i++)
+		script[n++] = 512;
+	fill(tx, sizeof(tx), 7);
+	h->tx = tx;
+	h->script = script;
+	h->nscript = 6;
+
+	for (i = 0; i < 5; i++) {
+		new_req(&reqs[i], 2048, 0, 0);
+		memset(mem + reqs[i].buf, 0, 2048);
+		check(ep_queue(ep, &reqs[i]) == 0, "queue req %d", i);
+	}
+	run(ep, h);
+	check(reqs[0].done && !reqs[1].done, "req 0 only should be done");
+
+	ep_dequeue(ep, &reqs[3]);
+	check(reqs[1].done && reqs[1].status == -ECONNRESET &&
+	      reqs[1].actual == 1024, "req 1 status %d actual %u",
+	      reqs[1].status, reqs[1].actual);
+	check(reqs[3].done && reqs[3].status == -ECONNRESET &&
+	      reqs[3].actual == 0, "req 3 status %d actual %u",
+	      reqs[3].status, reqs[3].actual);
+	check(!reqs[2].done && !reqs[4].done, "reqs 2 and 4 retired");
+
+	h->nscript = n;
+	run(ep, h);
+	for (i = 0; i < 5; i += 2) {
+		check(reqs[i].done && reqs[i].status == 0 &&
+		      reqs[i].actual == 2048, "req %d status %d actual %u",
+		      i, reqs[i].status, reqs[i].actual);
+	}
+	check(!memcmp(mem + reqs[1].buf, tx + 2048, 1024), "req 1 data");
+	check(!memcmp(mem + reqs[2].buf, tx + 3072, 2048), "req 2 data");
+	check(!memcmp(mem + reqs[4].buf, tx + 5120, 2048), "req 4 data");
+	check(h->next == h->nscript, "host has %d packets left",
+	      h->nscript - h->next);
+	/* req 0 on its own, reqs 1-4, then reqs 2 and 4 */
+	check(ep->chains == 3, "%d chains, expected 3", ep->chains);
+	report("dequeue", ep, h);
+	free_host(h);
+	free(ep);
+}
+
+int main(int argc, char **argv)
+{
+	int total = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "v")) != -1) {
+		switch (c) {
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc)
+		usage();
+
+	test_in();
+	total += failed, failed = 0;
+	test_out();
+	total += failed, failed = 0;
+	test_sg();
+	total += failed, failed = 0;
+	test_overflow();
+	total += failed, failed = 0;
+	test_bna();
+	total += failed, failed = 0;
+	test_dequeue();
+	total += failed;
+
+	return total ? 1 : 0;
+}
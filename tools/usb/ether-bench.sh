@@ -0,0 +1,127 @@
+#!/bin/sh
+#
+# Throughput and CPU cost of the ethernet gadget, measured from the host
+# side of the same kernel: the gadget is bound to dummy_hcd, the host
+# side is driven by rndis_host, cdc_ncm or cdc_ether, and iperf runs
+# between the two interfaces.  The host interface is moved into its own
+# network namespace so the traffic really crosses USB.  Besides the
+# throughput, the share of CPU time spent busy and in softirqs (where
+# both ends receive) is reported for each direction.
+#
+#	ether-bench.sh rndis|ncm|ecm
+#
+# These environment variables set the gadget's parameters:
+#
+#	TX_AGG_PKTS	frames per IN transfer, 1 disables (default 8)
+#	TX_AGG_SIZE	IN transfer buffer size (default 16384)
+#	TX_AGG_TIMEOUT	usecs an IN transfer waits for frames (default 500)
+#	UL_PKTS		RNDIS packets per OUT transfer (default 3)
+#	TIME		seconds per iperf run (default 10)
+#
+# Run it once with TX_AGG_PKTS=1 UL_PKTS=1 for the old behaviour.
+#
+
+TX_AGG_PKTS=${TX_AGG_PKTS:-8}
+TX_AGG_SIZE=${TX_AGG_SIZE:-16384}
+TX_AGG_TIMEOUT=${TX_AGG_TIMEOUT:-500}
+UL_PKTS=${UL_PKTS:-3}
+TIME=${TIME:-10}
+
+NS=ether-bench
+DEV_IP=10.42.0.1
+HOST_IP=10.42.0.2
+
+case "$1" in
+rndis)	GADGET=g_ether; HOSTDRV=rndis_host
+	PARAMS=rndis_ul_max_pkt_per_xfer=$UL_PKTS ;;
+ncm)	GADGET=g_ncm; HOSTDRV=cdc_ncm ;;
+ecm)	GADGET=g_ether; HOSTDRV=cdc_ether ;;
+*)	echo "usage: ether-bench.sh rndis|ncm|ecm" >&2; exit 2 ;;
+esac
+
+cleanup() {
+	[ -n "$SERVER" ] && kill $SERVER 2>/dev/null
+	ip netns del $NS 2>/dev/null
+	rmmod $GADGET 2>/dev/null
+	rmmod dummy_hcd 2>/dev/null
+}
+trap cleanup EXIT
+
+# netdev of the gadget (under dummy_udc) or of the host (under dummy_hcd)
+find_if() {
+	for n in /sys/class/net/*; do
+		readlink -f $n | grep -q $1 && echo ${n##*/} && return
+	done
+}
+
+# busy, softirq and total jiffies of all CPUs
+cpu_busy() {
+	awk '/^cpu / { print $2 + $3 + $4 + $7 + $8, $8, $2 + $3 + $4 + $5 + $6 + $7 + $8 }' /proc/stat
+}
+
+run() {
+	printf "%s: " "$1"
+	BEFORE=$(cpu_busy)
+	eval "$IPERF" | tail -1
+	echo $BEFORE $(cpu_busy) |
+		awk '{ printf "  cpu %d%%, softirq %d%%\n",
+			100 * ($4 - $1) / ($6 - $3), 100 * ($5 - $2) / ($6 - $3) }'
+}
+
+modprobe dummy_hcd || exit 1
+modprobe $HOSTDRV
+modprobe $GADGET tx_agg_pkts=$TX_AGG_PKTS tx_agg_size=$TX_AGG_SIZE \
+	tx_agg_timeout=$TX_AGG_TIMEOUT $PARAMS || exit 1
+
+# g_ether offers RNDIS as its second configuration, which the host
+# won't pick by itself
+for i in $(seq 30); do
+	for d in /sys/bus/usb/devices/*; do
+		readlink -f $d | grep -q dummy_hcd || continue
+		[ -f $d/idVendor ] && [ "$(cat $d/bDeviceClass)" != 09 ] && UDEV=$d
+	done
+	[ -n "$UDEV" ] && break
+	sleep 1
+done
+if [ -z "$UDEV" ]; then
+	echo "gadget did not show up" >&2
+	exit 1
+fi
+[ "$1" = rndis ] && echo 2 > $UDEV/bConfigurationValue
+
+for i in $(seq 30); do
+	DEV_IF=$(find_if dummy_udc)
+	HOST_IF=$(find_if dummy_hcd)
+	[ -n "$DEV_IF" ] && [ -n "$HOST_IF" ] && break
+	sleep 1
+done
+if [ -z "$DEV_IF" ] || [ -z "$HOST_IF" ]; then
+	echo "network interfaces did not show up" >&2
+	exit 1
+fi
+
+ip netns add $NS || exit 1
+ip link set $HOST_IF netns $NS
+ip addr add $DEV_IP/24 dev $DEV_IF
+ip link set $DEV_IF up
+ip netns exec $NS ip addr add $HOST_IP/24 dev $HOST_IF
+ip netns exec $NS ip link set $HOST_IF up
+sleep 2
+
+echo "$1: tx_agg_pkts=$TX_AGG_PKTS tx_agg_size=$TX_AGG_SIZE" \
+	"tx_agg_timeout=$TX_AGG_TIMEOUT ul_pkts=$UL_PKTS"
+
+# gadget to host (IN transfers)
+ip netns exec $NS iperf -s >/dev/null 2>&1 &
+SERVER=$!
+sleep 1
+IPERF="iperf -c $HOST_IP -t $TIME"
+run "device -> host"
+kill $SERVER
+
+# host to gadget (OUT transfers)
+iperf -s >/dev/null 2>&1 &
+SERVER=$!
+sleep 1
+IPERF="ip netns exec $NS iperf -c $DEV_IP -t $TIME"
+run "host -> device"
@@ -0,0 +1,293 @@
+/*
+ * mtp-bench - MTP file transfer throughput
+ *
+ * Both ends of a transfer are driven by this program: on the device it
+ * passes a file to the MTP gadget with the MTP_SEND_FILE/MTP_RECEIVE_FILE
+ * ioctls, on the host it moves the data over usbfs with a queue of URBs.
+ * With dummy_hcd both run on the same machine:
+ *
+ *	device# mtp-bench device send /data/test.bin
+ *	host#   mtp-bench host recv /dev/bus/usb/001/002 $(stat -c %s test.bin)
+ *
+ *	host#   mtp-bench host send /dev/bus/usb/001/002 268435456
+ *	device# mtp-bench device recv /data/out.bin 268435456
+ *
+ * Each side prints what it moved and how fast.  The transfer parameters of
+ * the gadget are module parameters of g_android (mtp_tx_req_len etc.).
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+
+#include "../../include/linux/usb/f_mtp.h"
+
+#define URB_SIZE	16384
+#define URB_MAX		64
+
+static int urbs = 8;
+
+static void die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	if (errno)
+		fprintf(stderr, ": %s", strerror(errno));
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: mtp-bench [-q urbs] device send FILE\n"
+		"       mtp-bench [-q urbs] device recv FILE BYTES\n"
+		"       mtp-bench [-q urbs] host send USBDEV BYTES\n"
+		"       mtp-bench [-q urbs] host recv USBDEV BYTES\n");
+	exit(2);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *what, long long bytes, double secs)
+{
+	printf("%s %lld bytes in %.3f s, %.2f MB/s\n", what, bytes, secs,
+	       secs > 0 ? bytes / secs / (1024 * 1024) : 0.0);
+}
+
+static int device(int send, const char *path, long long bytes)
+{
+	struct mtp_file_range mfr;
+	struct stat st;
+	double t;
+	int fd, mtp, ret;
+
+	mtp = open("/dev/mtp_usb", O_RDWR);
+	if (mtp < 0)
+		die("/dev/mtp_usb");
+
+	if (send) {
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || fstat(fd, &st) < 0)
+			die("%s", path);
+		bytes = st.st_size;
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			die("%s", path);
+	}
+
+	memset(&mfr, 0, sizeof(mfr));
+	mfr.fd = fd;
+	mfr.offset = 0;
+	mfr.length = bytes;
+
+	t = now();
+	ret = ioctl(mtp, send ? MTP_SEND_FILE : MTP_RECEIVE_FILE, &mfr);
+	if (ret < 0)
+		die(send ? "MTP_SEND_FILE" : "MTP_RECEIVE_FILE");
+	if (!send && fsync(fd) < 0)
+		die("fsync");
+	t = now() - t;
+
+	report(send ? "device sent" : "device received", bytes, t);
+	close(fd);
+	close(mtp);
+	return 0;
+}
+
+/*
+ * Find the MTP interface: the first one with a bulk IN, a bulk OUT and an
+ * interrupt IN endpoint.  usbfs hands out the device descriptor followed by
+ * the raw configuration descriptors.
+ */
+static int find_mtp(int fd, int *ep_in, int *ep_out)
+{
+	unsigned char buf[4096], *p, *end;
+	int len, intf = -1, in = 0, out = 0, intr = 0;
+
+	len = read(fd, buf, sizeof(buf));
+	if (len < USB_DT_DEVICE_SIZE)
+		die("reading descriptors");
+
+	end = buf + len;
+	for (p = buf + USB_DT_DEVICE_SIZE; p + 2 <= end && p[0]; p += p[0]) {
+		if (p[1] == USB_DT_INTERFACE) {
+			if (intf >= 0 && in && out && intr)
+				break;
+			intf = p[2];
+			in = out = intr = 0;
+		} else if (p[1] == USB_DT_ENDPOINT && intf >= 0) {
+			int addr = p[2], type = p[3] & USB_ENDPOINT_XFERTYPE_MASK;
+
+			if (type == USB_ENDPOINT_XFER_BULK) {
+				if (addr & USB_DIR_IN)
+					in = addr;
+				else
+					out = addr;
+			} else if (type == USB_ENDPOINT_XFER_INT) {
+				intr = addr;
+			}
+		}
+	}
+	if (intf < 0 || !in || !out || !intr) {
+		errno = 0;
+		die("no MTP interface found");
+	}
+
+	*ep_in = in;
+	*ep_out = out;
+	return intf;
+}
+
+static int submit(int fd, struct usbdevfs_urb *urb, int ep, long long len)
+{
+	void *buf = urb->usercontext;
+
+	memset(urb, 0, sizeof(*urb));
+	urb->type = USBDEVFS_URB_TYPE_BULK;
+	urb->endpoint = ep;
+	urb->usercontext = buf;
+	urb->buffer = buf;
+	urb->buffer_length = len < URB_SIZE ? len : URB_SIZE;
+	return ioctl(fd, USBDEVFS_SUBMITURB, urb);
+}
+
+static int host(int send, const char *path, long long bytes)
+{
+	static struct {
+		struct usbdevfs_urb urb;
+		char buf[URB_SIZE];
+	} u[URB_MAX];
+	struct usbdevfs_urb *urb;
+	long long queued = 0, done = 0;
+	int fd, intf, ep_in, ep_out, ep, i, inflight = 0;
+	int zlp;
+	double t;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		die("%s", path);
+	intf = find_mtp(fd, &ep_in, &ep_out);
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf) < 0)
+		die("claiming interface %d", intf);
+
+	ep = send ? ep_out : ep_in;
+	/* the gadget closes a transfer that ends on a packet boundary with a
+	 * ZLP; it knows the length of what it receives, so none is sent
+	 */
+	zlp = !send && (bytes % 512) == 0;
+	for (i = 0; i < URB_MAX; i++)
+		u[i].urb.usercontext = u[i].buf;
+
+	t = now();
+	for (i = 0; i < urbs && queued < bytes; i++, inflight++) {
+		if (submit(fd, &u[i].urb, ep, bytes - queued) < 0)
+			die("SUBMITURB");
+		queued += u[i].urb.buffer_length;
+	}
+
+	while (inflight) {
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb) < 0)
+			die("REAPURB");
+		inflight--;
+		if (urb->status)
+			die("URB status %d", urb->status);
+		done += urb->actual_length;
+		if (!send && urb->actual_length < urb->buffer_length) {
+			zlp = 0;
+			break;
+		}
+
+		if (queued < bytes) {
+			if (submit(fd, urb, ep, bytes - queued) < 0)
+				die("SUBMITURB");
+			queued += urb->buffer_length;
+			inflight++;
+		}
+	}
+
+	if (zlp && !inflight) {
+		if (submit(fd, &u[0].urb, ep, 512) < 0 ||
+		    ioctl(fd, USBDEVFS_REAPURB, &urb) < 0)
+			die("reading ZLP");
+	}
+	t = now() - t;
+
+	report(send ? "host sent" : "host received", done, t);
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+	close(fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long long bytes = 0;
+	int opt, send;
+
+	while ((opt = getopt(argc, argv, "q:")) != -1) {
+		switch (opt) {
+		case 'q':
+			urbs = atoi(optarg);
+			if (urbs < 1 || urbs > URB_MAX)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 3)
+		usage();
+	if (!strcmp(argv[1], "send"))
+		send = 1;
+	else if (!strcmp(argv[1], "recv"))
+		send = 0;
+	else
+		usage();
+
+	if (!strcmp(argv[0], "device")) {
+		if (!send) {
+			if (argc < 4)
+				usage();
+			bytes = strtoll(argv[3], NULL, 0);
+		}
+		return device(send, argv[2], bytes);
+	}
+	if (!strcmp(argv[0], "host")) {
+		if (argc < 4)
+			usage();
+		bytes = strtoll(argv[3], NULL, 0);
+		return host(send, argv[2], bytes);
+	}
+	usage();
+	return 0;
+}
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Throughput of the mass storage gadget, measured from the host side of
+# the same kernel: g_mass_storage is bound to dummy_hcd and the LUN it
+# exports is read and written by usb-storage with dd.
+#
+#	ums-bench.sh [BACKING]
+#
+# BACKING defaults to a loop device over a file in /tmp.  Its contents
+# are overwritten.  These environment variables set the gadget's
+# parameters:
+#
+#	NUM_BUFFERS	depth of the buffer ring (default 4)
+#	BUFLEN		size of each buffer (default 65536)
+#	DIRECT		1 to bypass the page cache of a block device (default 1)
+#	SIZE_MB		amount to transfer each way (default 128)
+#
+# Run it once with DIRECT=0 NUM_BUFFERS=2 BUFLEN=16384 for the old
+# behaviour.
+#
+
+NUM_BUFFERS=${NUM_BUFFERS:-4}
+BUFLEN=${BUFLEN:-65536}
+DIRECT=${DIRECT:-1}
+SIZE_MB=${SIZE_MB:-128}
+
+BACKING=$1
+LOOP=
+IMAGE=
+
+cleanup() {
+	rmmod g_mass_storage 2>/dev/null
+	rmmod dummy_hcd 2>/dev/null
+	[ -n "$LOOP" ] && losetup -d $LOOP
+	[ -n "$IMAGE" ] && rm -f $IMAGE
+}
+trap cleanup EXIT
+
+if [ -z "$BACKING" ]; then
+	IMAGE=/tmp/ums-bench.img
+	dd if=/dev/zero of=$IMAGE bs=1M count=$SIZE_MB 2>/dev/null || exit 1
+	LOOP=$(losetup -f) || exit 1
+	losetup $LOOP $IMAGE || exit 1
+	BACKING=$LOOP
+fi
+
+modprobe dummy_hcd || exit 1
+modprobe g_mass_storage file=$BACKING removable=0 direct=$DIRECT \
+	num_buffers=$NUM_BUFFERS buflen=$BUFLEN || exit 1
+
+# Wait for usb-storage to attach the gadget's LUN
+DISK=
+for i in $(seq 30); do
+	for d in /sys/block/sd*; do
+		readlink -f $d | grep -q dummy_hcd && DISK=/dev/${d##*/}
+	done
+	[ -n "$DISK" ] && break
+	sleep 1
+done
+if [ -z "$DISK" ]; then
+	echo "gadget disk did not show up" >&2
+	exit 1
+fi
+
+echo "$DISK: num_buffers=$NUM_BUFFERS buflen=$BUFLEN direct=$DIRECT"
+printf "write: "
+dd if=/dev/zero of=$DISK bs=1M count=$SIZE_MB oflag=direct 2>&1 | tail -1
+printf "read:  "
+dd if=$DISK of=/dev/null bs=1M count=$SIZE_MB iflag=direct 2>&1 | tail -1